@@ -160,7 +160,21 @@ def home():
                     f"FSM DHT11 Timer = {request.form.get('dht11_t_ms')}\n"
                     f"FSM BH1750 Timer = {request.form.get('bh1750_t_ms')}\n"
                     f"FSM CCS811 Timer = {request.form.get('ccs811_t_ms')}\n"
-                    f"FSM Output Timer = {request.form.get('output_t_ms')}\n")
+                    f"FSM Output Timer = {request.form.get('output_t_ms')}\n"
+                    f"Window Temp = {request.form.get('temp_window', 5)}\n"
+                    f"Window RH = {request.form.get('rh_window', 5)}\n"
+                    f"Window Lux = {request.form.get('lux_window', 5)}\n"
+                    f"Window eCO2 = {request.form.get('eco2_window', 5)}\n"
+                    f"Percentile Temp = {request.form.get('temp_percentile', 0)}\n"
+                    f"Percentile RH = {request.form.get('rh_percentile', 0)}\n"
+                    f"Percentile Lux = {request.form.get('lux_percentile', 0)}\n"
+                    f"Percentile eCO2 = {request.form.get('eco2_percentile', 0)}\n"
+                    f"Deadband Temp = {request.form.get('temp_deadband', 0)}\n"
+                    f"Deadband RH = {request.form.get('rh_deadband', 0)}\n"
+                    f"Deadband Lux = {request.form.get('lux_deadband', 0)}\n"
+                    f"Deadband eCO2 = {request.form.get('eco2_deadband', 0)}\n"
+                    f"Deadband Heartbeat = {request.form.get('deadband_silence_ms', 600000)}\n"
+                    f"Swinging Door = {request.form.get('swinging_door', 0)}\n")
         return render_template("result.html")
     else:
         return 500
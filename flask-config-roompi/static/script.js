@@ -1,7 +1,7 @@
 $(document).ready(function () {
-    // initial disabling
+    // initial disabling, the inputs of class tunable stay editable under any profile
     $(".form-floating > input").each(function (i, el) {
-      if ($("#profile").children("option:selected").val() !== "Custom..." && !($(el).attr("id").endsWith("_t_ms"))) {
+      if ($("#profile").children("option:selected").val() !== "Custom..." && !$(el).hasClass("tunable")) {
         $(el).prop("readonly", true);
       } else {
         $(el).prop("readonly", false);
@@ -36,7 +36,7 @@ $(document).ready(function () {
 
       // subsequent disabling
       $(".form-floating > input").each(function (i, el) {
-        if ($("#profile").children("option:selected").val() !== "Custom..." && !($(el).attr("id").endsWith("_t_ms"))) {
+        if ($("#profile").children("option:selected").val() !== "Custom..." && !$(el).hasClass("tunable")) {
           $(el).prop("readonly", true);
         } else {
           $(el).prop("readonly", false);
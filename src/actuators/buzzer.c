@@ -13,9 +13,10 @@
 /***************/
 
 #include "buzzer.h"
+#include "../libs/arenalib.h"
 
 BuzzerOutput* BuzzerOutput__create(int id, int data_pin) {
-	BuzzerOutput *result = (BuzzerOutput*) malloc(sizeof(BuzzerOutput));
+	BuzzerOutput *result = (BuzzerOutput*) arena_malloc(sizeof(BuzzerOutput));
 	result->data_pin = data_pin;
 	result->status = 0;
 	result->id = id;
@@ -29,7 +30,7 @@ BuzzerOutput* BuzzerOutput__create(int id, int data_pin) {
 void BuzzerOutput__destroy(BuzzerOutput *buzzer) {
 	if (buzzer) {
 		BuzzerOutput__disable(buzzer);
-		free(buzzer);
+		arena_free(buzzer);
 	};
 }
 
@@ -15,11 +15,12 @@
 
 #include "lcd1602vars.h"
 #include "lcd1602.h"
+#include "../libs/arenalib.h"
 
 LCD1602Display* LCD1602Display__create(int id, int rs, int rw, int enable,
 		int fourbitmode, int d0, int d1, int d2, int d3, int d4, int d5, int d6,
 		int d7) {
-	LCD1602Display *result = (LCD1602Display*) malloc(sizeof(LCD1602Display));
+	LCD1602Display *result = (LCD1602Display*) arena_malloc(sizeof(LCD1602Display));
 	result->id = id;
 	result->rs_pin = rs;
 	result->rw_pin = rw;
@@ -45,7 +46,7 @@ LCD1602Display* LCD1602Display__create(int id, int rs, int rw, int enable,
 
 void LCD1602Display__destroy(LCD1602Display *display) {
 	if (display) {
-		free(display);
+		arena_free(display);
 	}
 }
 
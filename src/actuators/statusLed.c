@@ -16,11 +16,12 @@
 
 #include "statusLed.h"
 #include "../utils.h"
+#include "../libs/arenalib.h"
 
 StatusLEDOutput* StatusLEDOutput__create(int id, int series_ic_nr,
 		int clock_pin, int serial_data_pin, int latch_pin,
 		int led_color_flags[3]) {
-	StatusLEDOutput *result = (StatusLEDOutput*) malloc(
+	StatusLEDOutput *result = (StatusLEDOutput*) arena_malloc(
 			sizeof(StatusLEDOutput) + series_ic_nr * sizeof(int));
 	result->id = id;
 	result->series_ic_nr = series_ic_nr;
@@ -48,8 +49,7 @@ StatusLEDOutput* StatusLEDOutput__create(int id, int series_ic_nr,
 void StatusLEDOutput__destroy(StatusLEDOutput *leds) {
 	if (leds) {
 		StatusLEDOutput__set_all_low(leds);
-		free(leds->digital_values);
-		free(leds);
+		arena_free(leds); // digital_values is part of the same block
 	}
 }
 
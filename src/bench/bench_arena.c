@@ -0,0 +1,159 @@
+/*
+ * bench_arena.c
+ *
+ * Allocations of the system objects. First the setup of 8 headless rooms (contexts, windows,
+ * queues, FSMs, timers) from the heap and from an arena, as main() does it: time and heap
+ * allocations. Then the steady state: the rooms carved from a sealed arena, the first one with
+ * its store, rollup log and state file, an acquisition thread publishing a sample of every
+ * channel of every room each period and the real measurement FSMs processing every
+ * samples_per_round periods and writing their lines to the uploader (a dry run, or the URL given,
+ * through libcurl and the arena pools, gzipped as main() does). Reports the heap allocations after the seal, which
+ * should be 0, and the carves after it.
+ *
+ * gcc -O2 -DARENA_COUNT_MALLOC src/bench/bench_arena.c src/sensors/dht11.c src/sensors/bh1750.c src/sensors/ccs811.c src/actuators/lcd1602.c
+ *     src/actuators/buzzer.c src/actuators/statusLed.c src/libs/fsm.c src/libs/timerlib.c src/libs/reactorlib.c
+ *     src/libs/systemlib.c src/libs/systemtype.c src/libs/samplering.c src/libs/windowstats.c src/libs/orderstats.c src/libs/tsdblib.c src/libs/rolluplib.c src/libs/statelib.c src/libs/deadbandlib.c src/libs/spscring.c src/libs/flaglib.c src/libs/uploadlib.c src/libs/lineprotolib.c src/libs/spoollib.c src/libs/arenalib.c src/libs/metricslib.c
+ *     src/controllers/measurementctrl.c src/controllers/outputctrl.c -lpthread -lrt -lwiringPi -lcurl -lz -o bench_arena
+ * ./bench_arena [seconds] [period_ms] [samples_per_round] [url]     (./bench_arena 10 10 5 http://localhost:8086/write?db=db0)
+ *
+ *  Created on: 17 oct. 2026
+ *      Author: Victoria M. Gullon and Marcos Gomez
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../libs/systemtype.h"
+#include "../libs/arenalib.h"
+
+#ifndef ARENA_COUNT_MALLOC
+#error "build with -DARENA_COUNT_MALLOC, the heap allocations are what this benchmark counts"
+#endif
+
+#define N_ROOMS 8
+#define ARENA_SIZE ((5 << 20) + N_ROOMS * (12 << 20)) // as main() reserves it
+#define STORE_PATH "/tmp/bench_arena.tsdb"
+#define ROLLUP_PATH "/tmp/bench_arena.rollup"
+#define STATE_PATH "/tmp/bench_arena.state"
+
+int buzzer_disabled = 0;
+float temp_crit_low = 10, temp_crit_high = 35, temp_warn_low = 17, temp_warn_high = 27, rh_crit_low = 20, rh_crit_high = 80, rh_warn_low = 30, rh_warn_high = 70;
+int lux_crit = 100, lux_warn = 300, eco2_crit = 2000, eco2_warn = 1000;
+
+static SystemType *rooms[N_ROOMS];
+static volatile int producing;
+static int period_ms, samples_per_round;
+
+static double _now_s(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// stands in for the sensor FSMs of the acquisition thread
+static void* _acquisition(void *arg) {
+	for (int n = 1; producing; n++) {
+		usleep(period_ms * 1000);
+		for (int r = 0; r < N_ROOMS; r++) {
+			SystemContext *ctx = rooms[r]->root_system;
+			SensorValueType temp = { .type = is_float, .val.fval = 20.0 + (n + r) % 5 };
+			SensorValueType humid = { .type = is_float, .val.fval = 45.0 + (n + r) % 7 };
+			SensorValueType lux = { .type = is_int, .val.ival = 400 + (n + r) % 50 };
+			SensorValueType eco2 = { .type = is_int, .val.ival = 600 + (n + r) % 80 };
+
+			SystemContext__publish_sample(ctx, SENSOR_QUEUE_TEMP_HUMID, 0, temp);
+			SystemContext__publish_sample(ctx, SENSOR_QUEUE_TEMP_HUMID, 1, humid);
+			SystemContext__publish_sample(ctx, SENSOR_QUEUE_LIGHT, 2, lux);
+			SystemContext__publish_sample(ctx, SENSOR_QUEUE_CO2, 3, eco2);
+			if (n % samples_per_round == 0)
+				flags_set(&ctx->measurement_flags, FLAG_PERFORM_PROCESSING);
+		}
+	}
+	return NULL;
+}
+
+static void _setup_rooms(void) {
+	for (int r = 0; r < N_ROOMS; r++) {
+		SystemContext *ctx = SystemContext__create(r + 1, NULL, NULL, NULL, NULL, NULL, NULL);
+		for (int i = 0; i < 4; i++)
+			SystemContext__set_window(ctx, i, 60); // a minute of samples at the default 1 s period
+		SystemContext__set_filter(ctx, 3, 50);
+		rooms[r] = SystemType__setup(ctx, MeasurementCtrl__setup(ctx), OutputCtrl__setup(ctx));
+	}
+}
+
+static void _destroy_rooms(void) {
+	for (int r = 0; r < N_ROOMS; r++)
+		SystemType__destroy(rooms[r]);
+}
+
+int main(int argc, char **argv) {
+	int seconds = argc > 1 ? atoi(argv[1]) : 10;
+	period_ms = argc > 2 ? atoi(argv[2]) : 10;
+	samples_per_round = argc > 3 ? atoi(argv[3]) : 5;
+	const char *url = argc > 4 ? argv[4] : NULL;
+
+	// setup, heap and arena
+	unsigned long a0 = arena_heap_allocs();
+	double t0 = _now_s();
+	_setup_rooms();
+	double heap_s = _now_s() - t0;
+	unsigned long heap_allocs = arena_heap_allocs() - a0;
+	_destroy_rooms();
+
+	arena_t *arena = arena_new(ARENA_SIZE);
+	arena_use(arena);
+	a0 = arena_heap_allocs();
+	t0 = _now_s();
+	_setup_rooms();
+	double arena_s = _now_s() - t0;
+	unsigned long arena_allocs = arena_heap_allocs() - a0;
+
+	printf("setup of %d rooms   heap  %8.3f ms  %6lu heap allocations\n", N_ROOMS, heap_s * 1e3, heap_allocs);
+	printf("                    arena %8.3f ms  %6lu heap allocations  %lu carves  %zu KB\n", arena_s * 1e3, arena_allocs, arena->carves, arena->used / 1024);
+
+	// steady state
+	unlink(STORE_PATH);
+	unlink(ROLLUP_PATH);
+	unlink(STATE_PATH);
+	SystemContext__open_store(rooms[0]->root_system, STORE_PATH, TSDB_DEFAULT_BLOCKS);
+	SystemContext__open_rollup_log(rooms[0]->root_system, ROLLUP_PATH, ROLLUP_LOG_DEFAULT_RECORDS);
+	SystemContext__open_state(rooms[0]->root_system, STATE_PATH);
+
+	uploader_t *uploader = uploader_new(url);
+	uploader_set_batch(uploader, UPLOADER_BATCH_LINES, 1000); // a post every second
+	uploader_set_compression(uploader, UPLOADER_GZIP_LEVEL, UPLOADER_TARGET_BYTES);
+	reactor_t *reactor = reactor_new();
+	for (int r = 0; r < N_ROOMS; r++) {
+		rooms[r]->root_system->uploader = uploader;
+		SystemType__attach(rooms[r], reactor, NULL, NULL);
+	}
+
+	pthread_t th;
+	producing = 1;
+	pthread_create(&th, NULL, _acquisition, NULL);
+	reactor_run_once(reactor, 0);
+
+	arena_seal(arena);
+	double end = _now_s() + seconds;
+	while (_now_s() < end)
+		reactor_run_once(reactor, (int) ((end - _now_s()) * 1000) + 1);
+	unsigned long steady_allocs = arena_heap_allocs() - arena->heap_allocs_at_seal;
+
+	producing = 0;
+	pthread_join(th, NULL);
+
+	printf("steady state %d s   %lu samples stored  %lu lines uploaded in %lu posts (%lu errors, %s)\n", seconds, rooms[0]->root_system->store->samples,
+			uploader->lines, uploader->posts, uploader->errors, url ? url : "dry run");
+	printf("                    %lu heap allocations  %lu late carves  %lu spills  %lu pool blocks (%lu in use)\n", steady_allocs, arena->late_carves, arena->spills,
+			arena->pool_blocks, arena->pool_in_use);
+
+	reactor_destroy(reactor);
+	unlink(STORE_PATH);
+	unlink(ROLLUP_PATH);
+	unlink(STATE_PATH);
+	return steady_allocs != 0;
+}
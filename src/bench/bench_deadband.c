@@ -0,0 +1,275 @@
+/*
+ * bench_deadband.c
+ *
+ * Report by exception on a replayed series: the raw samples of the four channels, every 5 s,
+ * go through processing rounds every meas_ms (trimmed mean of the last 5 samples, as the default
+ * windows) and the values of the rounds through the dead-band stage of the measurement FSM, which
+ * writes one roompi point per timestamp with the channels that send a value. The samples are
+ * read from a store file of a RoomPi (roompi.tsdb) when one is given, else they are a simulated
+ * classroom: heating and occupancy on weekdays, daylight, DHT11, BH1750 and CCS811 noise and
+ * resolution. For each stage: the values, points and line protocol bytes uploaded, and per
+ * channel the share of values sent and the largest and RMS error of the series rebuilt from them
+ * (the last value held, or straight lines between them for the swinging door) at every round.
+ *
+ * gcc -O2 src/bench/bench_deadband.c src/libs/deadbandlib.c src/libs/lineprotolib.c src/libs/tsdblib.c src/libs/arenalib.c -lm -o bench_deadband
+ * ./bench_deadband [days] [meas_ms] [roompi.tsdb]     (deltas of 0.2 1 20 25 and a 600000 ms heartbeat, as the README suggests for a classroom)
+ *
+ *  Created on: 17 oct. 2026
+ *      Author: Victoria M. Gullon and Marcos Gomez
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "../libs/deadbandlib.h"
+#include "../libs/lineprotolib.h"
+#include "../libs/tsdblib.h"
+
+#define SAMPLE_MS 5000
+#define CHANNELS 4
+
+typedef struct {
+	int64_t ts_ms;
+	float value;
+} sample_t;
+
+static const char *names[CHANNELS] = { "temp", "rh", "lux", "eco2" };
+static const double deltas[CHANNELS] = { 0.2, 1, 20, 25 };
+
+static sample_t *samples[CHANNELS];
+static size_t n_samples[CHANNELS];
+
+// the values of the rounds, as the measurement FSM computes them
+static int64_t *round_ts_ns;
+static double *round_values[CHANNELS];
+static size_t n_rounds;
+
+static double _noise(double sigma) {
+	double u = (rand() + 1.0) / (RAND_MAX + 2.0), v = (rand() + 1.0) / (RAND_MAX + 2.0);
+	return sigma * sqrt(-2 * log(u)) * cos(2 * M_PI * v);
+}
+
+static void _add(int channel, int64_t ts_ms, float value) {
+	if (n_samples[channel] % 65536 == 0)
+		samples[channel] = (sample_t*) realloc(samples[channel], (n_samples[channel] + 65536) * sizeof(sample_t));
+	samples[channel][n_samples[channel]++] = (sample_t ) { ts_ms, value };
+}
+
+// A classroom: heated and occupied 8:00 to 14:00 and 15:00 to 19:00 on weekdays
+static void _simulate(int days) {
+	int64_t t0_ms = 1792195200000LL; // a Monday, 00:00 UTC
+	double temp = 17, rh = 50, eco2 = 420;
+
+	srand(1);
+	for (int64_t t = 0; t < (int64_t) days * 86400000; t += SAMPLE_MS) {
+		double hour = (t % 86400000) / 3600000.0;
+		int weekday = (t / 86400000) % 7 < 5;
+		int occupied = weekday && ((hour >= 8 && hour < 14) || (hour >= 15 && hour < 19));
+		int heating = weekday && hour >= 7 && hour < 19;
+
+		// first order lags towards the setpoints, per 5 s
+		double temp_target = 16 + 1.5 * sin((hour - 9) * M_PI / 12) + (heating ? 5 : 0) + (occupied ? 1.5 : 0);
+		temp += (temp_target - temp) * 0.002;
+		rh += (45 + 8 * sin((hour - 3) * M_PI / 12) + (occupied ? 6 : 0) - rh) * 0.002;
+		eco2 += ((occupied ? 1500 : 420) - eco2) * (occupied ? 0.0015 : 0.0008);
+		double daylight = hour > 7 && hour < 19 ? 500 * sin((hour - 7) * M_PI / 12) : 0;
+		double lux = daylight + (occupied ? 350 : 0);
+
+		// the resolution and noise of each sensor
+		_add(0, t0_ms + t, roundf((temp + _noise(0.15)) * 10) / 10);
+		_add(1, t0_ms + t, roundf(rh + _noise(0.6)));
+		_add(2, t0_ms + t, lux > 0 ? roundf(lux * (1 + _noise(0.02))) : 0);
+		_add(3, t0_ms + t, roundf(eco2 + _noise(12)));
+	}
+}
+
+// The sealed blocks of a store file, each channel in time order
+static int _load(const char *path) {
+	tsdb_t *store = tsdb_open(path, CHANNELS, 0);
+	if (!store)
+		return -1;
+
+	for (uint64_t b = 0; b < tsdb_n_blocks(store); b++) {
+		const tsdb_block_t *block = tsdb_block(store, b);
+		tsdb_iter_t it;
+		int64_t ts_ms;
+		float value;
+
+		if (block->header.channel >= CHANNELS)
+			continue;
+		tsdb_iter_init(&it, block);
+		while (tsdb_iter_next(&it, &ts_ms, &value) == 0)
+			_add(block->header.channel, ts_ms, value);
+	}
+	tsdb_close(store);
+	return 0;
+}
+
+static int _cmp_float(const void *a, const void *b) {
+	float x = *(const float*) a, y = *(const float*) b;
+	return (x > y) - (x < y);
+}
+
+// The value of a round: trimmed mean of the last 5 samples up to its time
+static void _rounds(int meas_ms) {
+	size_t pos[CHANNELS] = { 0 };
+	int64_t first = INT64_MAX, last = INT64_MIN;
+
+	for (int c = 0; c < CHANNELS; c++) {
+		if (n_samples[c] == 0)
+			continue;
+		if (samples[c][0].ts_ms < first)
+			first = samples[c][0].ts_ms;
+		if (samples[c][n_samples[c] - 1].ts_ms > last)
+			last = samples[c][n_samples[c] - 1].ts_ms;
+	}
+	if (first > last)
+		return;
+
+	size_t max_rounds = (last - first) / meas_ms + 1;
+	round_ts_ns = (int64_t*) malloc(max_rounds * sizeof(int64_t));
+	for (int c = 0; c < CHANNELS; c++)
+		round_values[c] = (double*) malloc(max_rounds * sizeof(double));
+
+	for (int64_t t = first + meas_ms; t <= last; t += meas_ms) {
+		int64_t newest = INT64_MIN;
+		for (int c = 0; c < CHANNELS; c++) {
+			float window[5];
+			int n = 0;
+
+			while (pos[c] < n_samples[c] && samples[c][pos[c]].ts_ms <= t)
+				pos[c]++;
+			for (size_t i = pos[c]; i > 0 && n < 5; i--)
+				window[n++] = samples[c][i - 1].value;
+			if (n == 0) {
+				round_values[c][n_rounds] = NAN;
+				continue;
+			}
+			qsort(window, n, sizeof(float), _cmp_float);
+			double sum = 0;
+			for (int i = n > 2 ? 1 : 0; i < (n > 2 ? n - 1 : n); i++)
+				sum += window[i];
+			round_values[c][n_rounds] = sum / (n > 2 ? n - 2 : n);
+			if (c >= 2)
+				round_values[c][n_rounds] = (int) round_values[c][n_rounds]; // lux and eCO2 are integers
+			if (samples[c][pos[c] - 1].ts_ms > newest)
+				newest = samples[c][pos[c] - 1].ts_ms;
+		}
+		round_ts_ns[n_rounds++] = newest * 1000000;
+	}
+}
+
+// What a reader of InfluxDB gets at ts from the values sent
+static double _rebuilt(const deadband_point_t *sent, size_t n_sent, size_t *cursor, int64_t ts_ns, int lines) {
+	while (*cursor + 1 < n_sent && sent[*cursor + 1].ts_ns <= ts_ns)
+		(*cursor)++;
+	const deadband_point_t *a = &sent[*cursor];
+	if (!lines || *cursor + 1 >= n_sent || a->ts_ns >= ts_ns)
+		return a->value;
+	const deadband_point_t *b = a + 1;
+	return a->value + (b->value - a->value) * (double) (ts_ns - a->ts_ns) / (b->ts_ns - a->ts_ns);
+}
+
+static void _run(const char *name, deadband_mode_t mode, double scale, int64_t silence_ms) {
+	deadband_t db[CHANNELS];
+	deadband_point_t *sent[CHANNELS];
+	size_t n_sent[CHANNELS] = { 0 };
+	unsigned long values = 0, points = 0, bytes = 0;
+	char line[256];
+
+	for (int c = 0; c < CHANNELS; c++) {
+		deadband_init(&db[c], mode, deltas[c] * scale, silence_ms);
+		sent[c] = (deadband_point_t*) malloc((2 * n_rounds + 1) * sizeof(deadband_point_t));
+	}
+
+	// one more round at the end: the values a swinging door still keeps back are sent, as a gap would
+	for (size_t r = 0; r <= n_rounds; r++) {
+		deadband_point_t out[CHANNELS][DEADBAND_MAX_POINTS];
+		unsigned int n_out[CHANNELS], next[CHANNELS] = { 0 };
+
+		for (int c = 0; c < CHANNELS; c++) {
+			if (r == n_rounds || isnan(round_values[c][r]))
+				n_out[c] = deadband_reset(&db[c], out[c]);
+			else
+				n_out[c] = deadband_offer(&db[c], round_ts_ns[r], round_values[c][r], out[c]);
+			memcpy(sent[c] + n_sent[c], out[c], n_out[c] * sizeof(deadband_point_t));
+			n_sent[c] += n_out[c];
+			values += n_out[c];
+		}
+
+		// grouped as the measurement FSM does, one point per timestamp
+		while (1) {
+			int64_t ts_ns = INT64_MAX;
+			lineproto_field_t fields[CHANNELS];
+			for (int c = 0; c < CHANNELS; c++)
+				if (next[c] < n_out[c] && out[c][next[c]].ts_ns < ts_ns)
+					ts_ns = out[c][next[c]].ts_ns;
+			if (ts_ns == INT64_MAX)
+				break;
+			for (int c = 0; c < CHANNELS; c++) {
+				fields[c].key = names[c];
+				fields[c].type = LINEPROTO_NONE;
+				if (next[c] < n_out[c] && out[c][next[c]].ts_ns == ts_ns) {
+					fields[c].type = c < 2 ? LINEPROTO_FLOAT : LINEPROTO_INT;
+					if (c < 2)
+						fields[c].val.f = (float) out[c][next[c]].value;
+					else
+						fields[c].val.i = (int64_t) (out[c][next[c]].value + 0.5);
+					next[c]++;
+				}
+			}
+			int len = lineproto_encode(line, sizeof(line), "roompi", "room", 1, fields, CHANNELS, ts_ns);
+			if (len > 0) {
+				points++;
+				bytes += len + 1;
+			}
+		}
+	}
+
+	printf("%-16s %7lu values  %7lu points  %8.1f KB  ", name, values, points, bytes / 1024.0);
+	for (int c = 0; c < CHANNELS; c++) {
+		size_t cursor = 0, n = 0;
+		double worst = 0, sq = 0;
+		for (size_t r = 0; r < n_rounds && n_sent[c]; r++) {
+			if (isnan(round_values[c][r]) || round_ts_ns[r] < sent[c][0].ts_ns)
+				continue;
+			double err = fabs(_rebuilt(sent[c], n_sent[c], &cursor, round_ts_ns[r], mode == DEADBAND_SWINGING_DOOR) - round_values[c][r]);
+			if (err > worst)
+				worst = err;
+			sq += err * err;
+			n++;
+		}
+		printf("  %s %5.1f%% err %.2f rms %.3f", names[c], 100.0 * n_sent[c] / (db[c].offered ? db[c].offered : 1), worst, n ? sqrt(sq / n) : 0);
+		free(sent[c]);
+	}
+	printf("\n");
+}
+
+int main(int argc, char **argv) {
+	int days = argc > 1 ? atoi(argv[1]) : 7;
+	int meas_ms = argc > 2 ? atoi(argv[2]) : 30000;
+
+	if (argc > 3) {
+		if (_load(argv[3]) != 0) {
+			printf("cannot open %s\n", argv[3]);
+			return 1;
+		}
+		printf("%s: ", argv[3]);
+	} else {
+		_simulate(days);
+		printf("%d simulated days: ", days);
+	}
+	_rounds(meas_ms);
+	printf("%zu rounds of %d ms, deltas %.1f %.0f %.0f %.0f, heartbeat %d s\n", n_rounds, meas_ms, deltas[0], deltas[1], deltas[2], deltas[3],
+			DEADBAND_DEFAULT_SILENCE_MS / 1000);
+
+	_run("every value", DEADBAND_OFF, 1, DEADBAND_DEFAULT_SILENCE_MS);
+	_run("hold", DEADBAND_HOLD, 1, DEADBAND_DEFAULT_SILENCE_MS);
+	_run("swinging door", DEADBAND_SWINGING_DOOR, 1, DEADBAND_DEFAULT_SILENCE_MS);
+	_run("hold /2", DEADBAND_HOLD, 0.5, DEADBAND_DEFAULT_SILENCE_MS);
+	_run("swinging door /2", DEADBAND_SWINGING_DOOR, 0.5, DEADBAND_DEFAULT_SILENCE_MS);
+	return 0;
+}
@@ -0,0 +1,131 @@
+/*
+ * bench_flags.c
+ *
+ * Contention microbenchmark of the flag words: several threads set and clear their own bits
+ * while others poll them, as the timers, ISRs and FSM guards do, once with flaglib atomics and
+ * once with the old piLock/piUnlock around every write (a pthread mutex, as wiringPi does).
+ * Also measures the set-to-wake-up latency of flags_wait.
+ *
+ * gcc -O2 src/bench/bench_flags.c src/libs/flaglib.c -lpthread -o bench_flags
+ * ./bench_flags [threads] [operations per thread]
+ *
+ *  Created on: 17 oct. 2026
+ *      Author: Victoria M. Gullon and Marcos Gomez
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "../libs/flaglib.h"
+
+static flags_t flags = FLAGS_INITIALIZER;
+static volatile int locked_flags;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int use_lock;
+static long ops;
+static volatile unsigned long sink;
+
+static double _now_s(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void* _writer(void *arg) {
+	unsigned int bit = 1u << (int) (long) arg;
+
+	for (long i = 0; i < ops; i++) {
+		if (use_lock) {
+			pthread_mutex_lock(&lock);
+			locked_flags |= bit;
+			pthread_mutex_unlock(&lock);
+			pthread_mutex_lock(&lock);
+			locked_flags &= ~bit;
+			pthread_mutex_unlock(&lock);
+		} else {
+			flags_set(&flags, bit);
+			flags_clear(&flags, bit);
+		}
+	}
+	return NULL;
+}
+
+static void* _reader(void *arg) {
+	unsigned long seen = 0;
+
+	for (long i = 0; i < 2 * ops; i++)
+		seen += use_lock ? locked_flags & 0xff : flags_get(&flags) & 0xff; // guards read without the lock
+	sink += seen;
+	return NULL;
+}
+
+static void _run(const char *name, int threads) {
+	pthread_t th[2 * threads];
+
+	double t0 = _now_s();
+	for (int i = 0; i < threads; i++) {
+		pthread_create(&th[2 * i], NULL, _writer, (void*) (long) i);
+		pthread_create(&th[2 * i + 1], NULL, _reader, NULL);
+	}
+	for (int i = 0; i < 2 * threads; i++)
+		pthread_join(th[i], NULL);
+	double wall = _now_s() - t0;
+
+	double writes = 2.0 * threads * ops;
+	printf("%-10s %d writers + %d readers  %8.2f M writes/s  %7.1f ns/write\n", name, threads, threads, writes / wall / 1e6, wall * 1e9 / writes);
+}
+
+/* flags_wait wake-up latency */
+
+static volatile double set_at;
+static volatile int woken;
+
+static void* _waiter(void *arg) {
+	double *lat = (double*) arg;
+	unsigned int seen = 0;
+
+	for (int i = 0; i < 1000; i++) {
+		seen = flags_wait(&flags, 0x1, seen, -1);
+		lat[i] = _now_s() - set_at;
+		woken = i + 1;
+	}
+	return NULL;
+}
+
+int main(int argc, char **argv) {
+	int threads = argc > 1 ? atoi(argv[1]) : 4;
+	ops = argc > 2 ? atol(argv[2]) : 1000000;
+
+	use_lock = 1;
+	_run("piLock", threads);
+	use_lock = 0;
+	_run("atomics", threads);
+
+	double lat[1000], sum = 0, max = 0;
+	pthread_t th;
+	flags_clear(&flags, ~0u);
+	pthread_create(&th, NULL, _waiter, lat);
+	for (int i = 0; i < 1000; i++) {
+		struct timespec ts = { 0, 200000 };
+		while (woken < i)
+			nanosleep(&ts, NULL);
+		nanosleep(&ts, NULL); // let the waiter go to sleep
+		set_at = _now_s();
+		if (i % 2 == 0)
+			flags_set(&flags, 0x1);
+		else
+			flags_clear(&flags, 0x1);
+	}
+	pthread_join(th, NULL);
+	for (int i = 0; i < 1000; i++) {
+		sum += lat[i];
+		if (lat[i] > max)
+			max = lat[i];
+	}
+	printf("flags_wait wake-up latency avg %.1f us  max %.1f us\n", sum / 1000 * 1e6, max * 1e6);
+
+	return 0;
+}
@@ -0,0 +1,118 @@
+/*
+ * bench_fsm.c
+ *
+ * fsm_fire throughput of every FSM of the project, old linear scan of the whole transition
+ * table against the per-state index built by fsm_new. Each FSM is fired in every state in
+ * which no guard is enabled with all flags cleared (the idle case, by far the most common).
+ *
+ * gcc -O2 src/bench/bench_fsm.c src/sensors/dht11.c src/sensors/bh1750.c src/sensors/ccs811.c src/actuators/lcd1602.c
+ *     src/actuators/buzzer.c src/actuators/statusLed.c src/libs/fsm.c src/libs/timerlib.c src/libs/reactorlib.c
+ *     src/libs/systemlib.c src/libs/systemtype.c src/libs/samplering.c src/libs/windowstats.c src/libs/orderstats.c src/libs/tsdblib.c src/libs/rolluplib.c src/libs/statelib.c src/libs/deadbandlib.c src/libs/spscring.c src/libs/flaglib.c src/libs/uploadlib.c src/libs/lineprotolib.c src/libs/spoollib.c src/libs/arenalib.c src/libs/metricslib.c
+ *     src/controllers/measurementctrl.c src/controllers/outputctrl.c -lpthread -lrt -lwiringPi -lcurl -lz -o bench_fsm
+ * ./bench_fsm [fires per state]
+ *
+ *  Created on: 17 oct. 2026
+ *      Author: Victoria M. Gullon and Marcos Gomez
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <wiringPi.h>
+
+#include "../libs/systemtype.h"
+
+int buzzer_disabled = 0;
+float temp_crit_low, temp_crit_high, temp_warn_low, temp_warn_high, rh_crit_low, rh_crit_high, rh_warn_low, rh_warn_high;
+int lux_crit, lux_warn, eco2_crit, eco2_warn;
+
+static double _now_s(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// fsm_fire before the index: walk the whole table comparing orig_state
+static int _linear_fire(fsm_t *this) {
+	fsm_trans_t *t;
+	for (t = this->tt; t->orig_state >= 0; ++t) {
+		if ((this->current_state == t->orig_state) && t->in(this)) {
+			this->current_state = t->dest_state;
+			if (t->out)
+				t->out(this);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static int _idle_state(fsm_t *this, int state) {
+	int found = 0;
+	for (fsm_trans_t *t = this->tt; t->orig_state >= 0; ++t) {
+		if (t->orig_state == state) {
+			if (t->in(this))
+				return 0; // firing would run an output
+			found = 1;
+		}
+	}
+	return found;
+}
+
+static void _bench(const char *name, fsm_t *fsm, long fires) {
+	int n_rows = 0, n_states = 0, initial = fsm->current_state;
+	double t_linear = 0, t_indexed = 0;
+	volatile int sink = 0;
+
+	for (fsm_trans_t *t = fsm->tt; t->orig_state >= 0; ++t)
+		n_rows++;
+
+	for (int s = 0; s < fsm->n_states; s++) {
+		if (!_idle_state(fsm, s))
+			continue;
+		fsm->current_state = s;
+		n_states++;
+
+		double t0 = _now_s();
+		for (long i = 0; i < fires; i++)
+			sink += _linear_fire(fsm);
+		t_linear += _now_s() - t0;
+
+		t0 = _now_s();
+		for (long i = 0; i < fires; i++)
+			sink += fsm_fire(fsm);
+		t_indexed += _now_s() - t0;
+	}
+	fsm->current_state = initial;
+
+	double n = (double) fires * n_states;
+	printf("%-16s %2d rows %d/%d idle states  linear %8.2f M fires/s  indexed %8.2f M fires/s  x%.2f\n", name, n_rows, n_states, fsm->n_states, n / t_linear / 1e6, n / t_indexed / 1e6,
+			t_linear / t_indexed);
+}
+
+int main(int argc, char **argv) {
+	long fires = argc > 1 ? atol(argv[1]) : 5000000;
+
+	wiringPiSetup();
+
+	DHT11Sensor *dht = DHT11Sensor__create(1, 29);
+	BH1750Sensor *bh = BH1750Sensor__create(4, 0x23, CONTINUOUS_H_RES);
+	CCS811Sensor *ccs = CCS811Sensor__create(5, CCS811_ADDR_LOW, 0, 3, 2);
+	SystemContext *ctx = SystemContext__create(1, dht, bh, ccs, NULL, NULL, NULL);
+	MeasurementCtrl *measurement = MeasurementCtrl__setup(ctx);
+	OutputCtrl *output = OutputCtrl__setup(ctx);
+	SystemType__setup(ctx, measurement, output);
+
+	printf("%ld fires per state, all flags cleared\n", fires);
+
+	_bench("MeasurementCtrl", measurement->fsm, fires);
+	_bench("DHT11Sensor", dht->fsm, fires);
+	_bench("BH1750Sensor", bh->fsm, fires);
+	_bench("CCS811Sensor", ccs->fsm, fires);
+	_bench("buzzer", output->fsm_buzzer, fires);
+	_bench("leds", output->fsm_leds, fires);
+	_bench("info", output->fsm_info, fires);
+	_bench("warnings", output->fsm_warnings, fires);
+
+	return 0;
+}
@@ -0,0 +1,148 @@
+/*
+ * bench_fsm_sched.c
+ *
+ * Guard evaluations and transitions per second of eight synthetic FSMs (one flag bit each, as
+ * the guards of main()'s FSMs test measurement_flags/output_flags bits) under three schedulers:
+ * the old busy loop firing every FSM, one shared reactor event waking every FSM on any change,
+ * and the reactor firing only the FSMs subscribed to the flag bits that changed.
+ *
+ * gcc -O2 src/bench/bench_fsm_sched.c src/libs/reactorlib.c src/libs/fsm.c src/libs/flaglib.c src/libs/arenalib.c -lpthread -o bench_fsm_sched
+ * ./bench_fsm_sched [seconds] [period_ms]
+ *
+ *  Created on: 17 oct. 2026
+ *      Author: Victoria M. Gullon and Marcos Gomez
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../libs/fsm.h"
+#include "../libs/flaglib.h"
+#include "../libs/reactorlib.h"
+
+#define N_FSMS 8
+#define EVENT_ANY 0x01
+
+static flags_t flags = FLAGS_INITIALIZER; // one pending bit per FSM
+static fsm_t *fsms[N_FSMS];
+
+static reactor_t *reactor = NULL; // NULL while benchmarking the busy loop
+static int post_event; // shared event mode: the producer posts EVENT_ANY on every change
+static volatile int producing;
+static int period_ms;
+
+static uint64_t _now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int _pending(fsm_t *this) {
+	return flags_get(&flags) & (1u << (int) (intptr_t) this->user_data);
+}
+
+static void _consume(fsm_t *this) {
+	flags_clear(&flags, 1u << (int) (intptr_t) this->user_data);
+}
+
+static fsm_trans_t _bench_tt[] = { { 0, _pending, 0, _consume }, { -1, NULL, -1, NULL } };
+
+static void* _producer(void *arg) {
+	int next = 0;
+	while (producing) {
+		usleep(period_ms * 1000);
+		flags_set(&flags, 1u << next);
+		if (reactor && post_event)
+			reactor_post(reactor, EVENT_ANY);
+		next = (next + 1) % N_FSMS;
+	}
+	return NULL;
+}
+
+static void _reset(void) {
+	for (int i = 0; i < N_FSMS; i++)
+		fsms[i]->guard_evals = fsms[i]->transitions = 0;
+	flags_clear(&flags, ~0u);
+}
+
+static void _report(const char *name, double wall) {
+	unsigned long guard_evals = 0, transitions = 0;
+	for (int i = 0; i < N_FSMS; i++) {
+		guard_evals += fsms[i]->guard_evals;
+		transitions += fsms[i]->transitions;
+	}
+	printf("%-10s guards/s %14.1f  transitions/s %8.1f  guards per transition %12.1f\n", name, guard_evals / wall, transitions / wall,
+			transitions ? (double) guard_evals / transitions : 0.0);
+}
+
+static double _run_reactor(int seconds) {
+	pthread_t th;
+	producing = 1;
+	pthread_create(&th, NULL, _producer, NULL);
+
+	uint64_t t0 = _now_ns(), end = t0 + seconds * 1000000000ULL;
+	while (_now_ns() < end)
+		reactor_run_once(reactor, (end - _now_ns()) / 1000000 + 1);
+	double wall = (_now_ns() - t0) / 1e9;
+
+	producing = 0;
+	pthread_join(th, NULL);
+	return wall;
+}
+
+int main(int argc, char **argv) {
+	int seconds = argc > 1 ? atoi(argv[1]) : 5;
+	period_ms = argc > 2 ? atoi(argv[2]) : 100;
+
+	for (int i = 0; i < N_FSMS; i++)
+		fsms[i] = fsm_new(0, _bench_tt, (void*) (intptr_t) i);
+
+	printf("%d s per run, one flag set every %d ms\n", seconds, period_ms);
+
+	/* old main loop: fire everything, forever */
+	pthread_t th;
+	producing = 1;
+	pthread_create(&th, NULL, _producer, NULL);
+
+	uint64_t t0 = _now_ns(), end = t0 + seconds * 1000000000ULL;
+	while (_now_ns() < end) {
+		for (int i = 0; i < N_FSMS; i++)
+			fsm_fire(fsms[i]);
+	}
+	_report("busy-loop", (_now_ns() - t0) / 1e9);
+	producing = 0;
+	pthread_join(th, NULL);
+
+	/* one event shared by every FSM: every change fires the eight of them */
+	_reset();
+	reactor = reactor_new();
+	for (int i = 0; i < N_FSMS; i++)
+		reactor_add_fsm(reactor, fsms[i], EVENT_ANY);
+	post_event = 1;
+	_report("event", _run_reactor(seconds));
+	reactor_destroy(reactor);
+
+	/* flag subscriptions: a change only fires the FSM whose guard reads the bit */
+	_reset();
+	reactor = reactor_new();
+	for (int i = 0; i < N_FSMS; i++)
+		reactor_subscribe_flags(reactor, reactor_add_fsm(reactor, fsms[i], 0), &flags, 1u << i);
+	post_event = 0;
+	_report("subscribe", _run_reactor(seconds));
+
+	for (int i = 0; i < N_FSMS; i++) {
+		double guard_evals_s, transitions_s;
+		reactor_fsm_rates(reactor, i, &guard_evals_s, &transitions_s);
+		printf("  fsm %d    guards/s %8.2f  transitions/s %8.2f\n", i, guard_evals_s, transitions_s);
+	}
+	reactor_destroy(reactor);
+
+	for (int i = 0; i < N_FSMS; i++)
+		fsm_destroy(fsms[i]);
+
+	return 0;
+}
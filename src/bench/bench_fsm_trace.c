@@ -0,0 +1,78 @@
+/*
+ * bench_fsm_trace.c
+ *
+ * Cost of the FSM tracing instrumentation: ns per fsm_fire of a two-state FSM that transitions
+ * on every fire (the worst case, every fire goes through the traced path) and of one whose
+ * guard is never enabled (the common idle fire). Build it twice to compare the three cases:
+ *
+ * gcc -O2 src/bench/bench_fsm_trace.c src/libs/fsm.c src/libs/arenalib.c -o bench_fsm_trace
+ * gcc -O2 -DFSM_TRACE src/bench/bench_fsm_trace.c src/libs/fsm.c src/libs/arenalib.c -o bench_fsm_trace_on
+ * ./bench_fsm_trace [fires] && ./bench_fsm_trace_on [fires]
+ *
+ *  Created on: 17 oct. 2026
+ *      Author: Victoria M. Gullon and Marcos Gomez
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../libs/fsm.h"
+
+static volatile int enabled_guard = 1;
+static volatile unsigned long outputs;
+
+static double _now_s(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int _always(fsm_t *this) {
+	return enabled_guard;
+}
+
+static int _never(fsm_t *this) {
+	return !enabled_guard;
+}
+
+static void _output(fsm_t *this) {
+	outputs++;
+}
+
+static fsm_trans_t _toggle_tt[] = { { 0, _always, 1, _output }, { 1, _always, 0, _output }, { -1, NULL, -1, NULL } };
+static fsm_trans_t _idle_tt[] = { { 0, _never, 1, _output }, { 1, _never, 0, _output }, { -1, NULL, -1, NULL } };
+
+static double _run(fsm_t *fsm, long fires) {
+	double t0 = _now_s();
+	for (long i = 0; i < fires; i++)
+		fsm_fire(fsm);
+	return (_now_s() - t0) * 1e9 / fires;
+}
+
+int main(int argc, char **argv) {
+	long fires = argc > 1 ? atol(argv[1]) : 20000000;
+
+	fsm_t *toggle = fsm_new(0, _toggle_tt, NULL);
+	fsm_t *idle = fsm_new(0, _idle_tt, NULL);
+
+#ifdef FSM_TRACE
+	const char *build = "compiled in, disabled";
+#else
+	const char *build = "not compiled";
+#endif
+	printf("%ld fires per run\n", fires);
+	printf("%-22s transition %7.2f ns/fire  idle %7.2f ns/fire\n", build, _run(toggle, fires), _run(idle, fires));
+
+#ifdef FSM_TRACE
+	fsm_trace_enable(toggle);
+	fsm_trace_enable(idle);
+	printf("%-22s transition %7.2f ns/fire  idle %7.2f ns/fire\n", "enabled", _run(toggle, fires), _run(idle, fires));
+	fsm_trace_dump(toggle, "toggle", stdout);
+#endif
+
+	fsm_destroy(toggle);
+	fsm_destroy(idle);
+
+	return 0;
+}
@@ -0,0 +1,114 @@
+/*
+ * bench_gateway.c
+ *
+ * Gateway mode scaling: 1, 2, 4 and 8 headless rooms sharing the main loop and one acquisition
+ * thread, as main() runs them with --gateway. The acquisition thread publishes a sample of every
+ * channel of every room each period and asks all the rooms for a processing round every
+ * samples_per_round periods; the real measurement FSMs drain, process, raise alerts and write
+ * their lines to a dry run uploader. Reports process CPU, main loop stalls and lines per second.
+ *
+ * gcc -O2 src/bench/bench_gateway.c src/sensors/dht11.c src/sensors/bh1750.c src/sensors/ccs811.c src/actuators/lcd1602.c
+ *     src/actuators/buzzer.c src/actuators/statusLed.c src/libs/fsm.c src/libs/timerlib.c src/libs/reactorlib.c
+ *     src/libs/systemlib.c src/libs/systemtype.c src/libs/samplering.c src/libs/windowstats.c src/libs/orderstats.c src/libs/tsdblib.c src/libs/rolluplib.c src/libs/statelib.c src/libs/deadbandlib.c src/libs/spscring.c src/libs/flaglib.c src/libs/uploadlib.c src/libs/lineprotolib.c src/libs/spoollib.c src/libs/arenalib.c src/libs/metricslib.c
+ *     src/controllers/measurementctrl.c src/controllers/outputctrl.c -lpthread -lrt -lwiringPi -lcurl -lz -o bench_gateway
+ * ./bench_gateway [seconds] [period_ms] [samples_per_round]
+ *
+ *  Created on: 17 oct. 2026
+ *      Author: Victoria M. Gullon and Marcos Gomez
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#include "../libs/systemtype.h"
+
+#define MAX_ROOMS 8
+
+int buzzer_disabled = 0;
+float temp_crit_low = 10, temp_crit_high = 35, temp_warn_low = 17, temp_warn_high = 27, rh_crit_low = 20, rh_crit_high = 80, rh_warn_low = 30, rh_warn_high = 70;
+int lux_crit = 100, lux_warn = 300, eco2_crit = 2000, eco2_warn = 1000;
+
+static SystemType *rooms[MAX_ROOMS];
+static int n_rooms;
+static volatile int producing;
+static int period_ms, samples_per_round;
+
+static double _now_s(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double _cpu_s(void) {
+	struct rusage ru;
+	getrusage(RUSAGE_SELF, &ru);
+	return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+}
+
+// stands in for the sensor FSMs of the acquisition threads
+static void* _acquisition(void *arg) {
+	for (int n = 1; producing; n++) {
+		usleep(period_ms * 1000);
+		for (int r = 0; r < n_rooms; r++) {
+			SystemContext *ctx = rooms[r]->root_system;
+			SensorValueType temp = { .type = is_float, .val.fval = 20.0 + (n + r) % 5 };
+			SensorValueType humid = { .type = is_float, .val.fval = 45.0 + (n + r) % 7 };
+			SensorValueType lux = { .type = is_int, .val.ival = 400 + (n + r) % 50 };
+			SensorValueType eco2 = { .type = is_int, .val.ival = 600 + (n + r) % 80 };
+
+			SystemContext__publish_sample(ctx, SENSOR_QUEUE_TEMP_HUMID, 0, temp);
+			SystemContext__publish_sample(ctx, SENSOR_QUEUE_TEMP_HUMID, 1, humid);
+			SystemContext__publish_sample(ctx, SENSOR_QUEUE_LIGHT, 2, lux);
+			SystemContext__publish_sample(ctx, SENSOR_QUEUE_CO2, 3, eco2);
+			if (n % samples_per_round == 0)
+				flags_set(&ctx->measurement_flags, FLAG_PERFORM_PROCESSING);
+		}
+	}
+	return NULL;
+}
+
+int main(int argc, char **argv) {
+	int seconds = argc > 1 ? atoi(argv[1]) : 10;
+	period_ms = argc > 2 ? atoi(argv[2]) : 10;
+	samples_per_round = argc > 3 ? atoi(argv[3]) : 5;
+
+	printf("%d s per run, a sample of every channel every %d ms, processing every %d samples\n", seconds, period_ms, samples_per_round);
+
+	for (n_rooms = 1; n_rooms <= MAX_ROOMS; n_rooms *= 2) {
+		uploader_t *uploader = uploader_new(NULL); // dry run, only counts the lines
+		reactor_t *reactor = reactor_new();
+
+		for (int r = 0; r < n_rooms; r++) {
+			SystemContext *ctx = SystemContext__create(r + 1, NULL, NULL, NULL, NULL, NULL, NULL);
+			ctx->uploader = uploader;
+			rooms[r] = SystemType__setup(ctx, MeasurementCtrl__setup(ctx), NULL);
+			SystemType__attach(rooms[r], reactor, NULL, NULL);
+		}
+
+		pthread_t th;
+		producing = 1;
+		pthread_create(&th, NULL, _acquisition, NULL);
+
+		double t0 = _now_s(), cpu0 = _cpu_s(), end = t0 + seconds;
+		while (_now_s() < end)
+			reactor_run_once(reactor, (int) ((end - _now_s()) * 1000) + 1);
+		double wall = _now_s() - t0, cpu = _cpu_s() - cpu0;
+
+		producing = 0;
+		pthread_join(th, NULL);
+
+		printf("%d rooms  cpu %5.2f %%  fires/s %8.1f  stall avg %7.3f ms  max %7.3f ms  lines/s %8.1f\n", n_rooms, 100.0 * cpu / wall, reactor->fires / wall,
+				reactor->dispatches ? reactor->dispatch_sum_ns / 1e6 / reactor->dispatches : 0.0, reactor->dispatch_max_ns / 1e6, uploader->lines / wall);
+
+		reactor_destroy(reactor);
+		for (int r = 0; r < n_rooms; r++)
+			SystemType__destroy(rooms[r]);
+		uploader_destroy(uploader);
+	}
+
+	return 0;
+}
@@ -0,0 +1,103 @@
+/*
+ * bench_lineproto.c
+ *
+ * Encode throughput of the processed values of a room as line protocol, in points per second
+ * (one point: the four channels of a room in a processing round):
+ *   sprintf lines  what the measurement FSM wrote before: one "%s,room=%d value=%f" line per channel, no timestamp
+ *   sprintf point  the same single point as the encoder, with sprintf
+ *   lineproto      lineproto_encode
+ * Then the round trip of the float formatter through strtod over random values from 1e-3 to 1e9.
+ *
+ * gcc -O2 src/bench/bench_lineproto.c src/libs/lineprotolib.c -lm -o bench_lineproto
+ * ./bench_lineproto [points]
+ *
+ *  Created on: 17 oct. 2026
+ *      Author: Victoria M. Gullon and Marcos Gomez
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+
+#include "../libs/lineprotolib.h"
+
+static double _now_s(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static volatile size_t sink; // keeps the encodings from being optimized out
+
+static void _report(const char *name, unsigned long points, double s, size_t bytes) {
+	printf("%-14s %10.0f points/s  %6.1f ns/point  %5.1f bytes/point\n", name, points / s, s * 1e9 / points, (double) bytes / points);
+}
+
+int main(int argc, char **argv) {
+	unsigned long points = argc > 1 ? strtoul(argv[1], NULL, 10) : 2000000;
+	static const char *names[4] = { "temp", "rh", "lux", "eco2" };
+	char buf[256];
+	size_t bytes;
+	int64_t ts_ns = 1792238400000000000LL;
+
+	// the values of a round, varying like a room does
+	float temp[256], rh[256];
+	int lux[256], eco2[256];
+	srand(1);
+	for (int i = 0; i < 256; i++) {
+		temp[i] = 20 + (rand() % 1000) / 100.0f;
+		rh[i] = 40 + (rand() % 2000) / 100.0f;
+		lux[i] = 300 + rand() % 400;
+		eco2[i] = 450 + rand() % 1500;
+	}
+
+	bytes = 0;
+	double t0 = _now_s();
+	for (unsigned long n = 0; n < points; n++) {
+		int k = n & 255;
+		bytes += sprintf(buf, "%s,room=%d value=%f", names[0], 101, temp[k]);
+		bytes += sprintf(buf, "%s,room=%d value=%f", names[1], 101, rh[k]);
+		bytes += sprintf(buf, "%s,room=%d value=%d", names[2], 101, lux[k]);
+		bytes += sprintf(buf, "%s,room=%d value=%d", names[3], 101, eco2[k]);
+		sink += buf[0];
+	}
+	_report("sprintf lines", points, _now_s() - t0, bytes + 4 * points);
+
+	bytes = 0;
+	t0 = _now_s();
+	for (unsigned long n = 0; n < points; n++) {
+		int k = n & 255;
+		bytes += sprintf(buf, "roompi,room=%d temp=%f,rh=%f,lux=%di,eco2=%di %lld", 101, temp[k], rh[k], lux[k], eco2[k], (long long) (ts_ns + n));
+		sink += buf[0];
+	}
+	_report("sprintf point", points, _now_s() - t0, bytes + points);
+
+	bytes = 0;
+	t0 = _now_s();
+	for (unsigned long n = 0; n < points; n++) {
+		int k = n & 255;
+		lineproto_field_t fields[4] = { { "temp", LINEPROTO_FLOAT, { .f = temp[k] } }, { "rh", LINEPROTO_FLOAT, { .f = rh[k] } }, { "lux", LINEPROTO_INT, { .i = lux[k] } }, {
+				"eco2", LINEPROTO_INT, { .i = eco2[k] } } };
+		bytes += lineproto_encode(buf, sizeof(buf), "roompi", "room", 101, fields, 4, ts_ns + n);
+		sink += buf[0];
+	}
+	_report("lineproto", points, _now_s() - t0, bytes + points);
+	printf("               e.g. %s\n", buf);
+
+	// round trip
+	double worst = 0;
+	for (int i = 0; i < 1000000; i++) {
+		double v = pow(10, -3 + 12.0 * rand() / RAND_MAX) * (rand() & 1 ? 1 : -1);
+		size_t len = lineproto_format_float(buf, v);
+		buf[len] = '\0';
+		double err = fabs(strtod(buf, NULL) - v) / fmax(fabs(v), 1);
+		if (err > worst)
+			worst = err;
+	}
+	printf("float round trip, worst error %.2e (of the value, or absolute under 1)\n", worst);
+
+	return 0;
+}
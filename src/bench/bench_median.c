@@ -0,0 +1,160 @@
+/*
+ * bench_median.c
+ *
+ * Sliding window median, one query after every push, with windows of 5, 60 and 3600 samples:
+ * copying the window and sorting it (qsort), keeping a sorted array (binary search + memmove)
+ * and the indexable skiplist of the window statistics. Also the error against the true signal
+ * of the trimmed mean and the median on a DHT11-like signal with 2% spikes.
+ *
+ * gcc -O2 src/bench/bench_median.c src/libs/samplering.c src/libs/windowstats.c src/libs/orderstats.c src/libs/arenalib.c -lm -o bench_median
+ * ./bench_median [pushes]
+ *
+ *  Created on: 17 oct. 2026
+ *      Author: Victoria M. Gullon and Marcos Gomez
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "../libs/samplering.h"
+#include "../libs/windowstats.h"
+
+static double _now_s(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int _cmp(const void *a, const void *b) {
+	double x = *(const double*) a, y = *(const double*) b;
+	return x < y ? -1 : x > y;
+}
+
+static double _truth(long i) {
+	return 22.0 + 2.0 * sin(i / 50000.0);
+}
+
+// noise plus a spike now and then, as the DHT11 and the CCS811 give
+static double _signal(long i) {
+	double v = _truth(i) + ((rand() % 100) - 50) / 100.0;
+	if (rand() % 50 == 0)
+		v += (rand() % 2 ? 1 : -1) * (10 + rand() % 30);
+	return v;
+}
+
+static double _median_sorted(const double *sorted, int n) {
+	return n % 2 ? sorted[n / 2] : (sorted[n / 2 - 1] + sorted[n / 2]) / 2;
+}
+
+static void _bench(int len, const double *x, long pushes) {
+	double *window = (double*) malloc(len * sizeof(double)), *tmp = (double*) malloc(len * sizeof(double)), *sorted = (double*) malloc(len * sizeof(double));
+	volatile double sink = 0;
+	int n;
+
+	/* copy and qsort, too slow to run every push on the long windows */
+	long q_pushes = pushes * 5 / len > 2 * len ? pushes * 5 / len : 2 * len;
+	n = 0;
+	double t0 = _now_s();
+	for (long i = 0; i < q_pushes; i++) {
+		window[i % len] = x[i];
+		if (n < len)
+			n++;
+		memcpy(tmp, window, n * sizeof(double));
+		qsort(tmp, n, sizeof(double), _cmp);
+		sink = _median_sorted(tmp, n);
+	}
+	double t_qsort = (_now_s() - t0) * 1e9 / q_pushes;
+
+	/* sorted array */
+	n = 0;
+	t0 = _now_s();
+	for (long i = 0; i < pushes; i++) {
+		if (n == len) {
+			double old = window[i % len];
+			int lo = 0, hi = n - 1;
+			while (lo < hi) {
+				int mid = (lo + hi) / 2;
+				if (sorted[mid] < old)
+					lo = mid + 1;
+				else
+					hi = mid;
+			}
+			memmove(&sorted[lo], &sorted[lo + 1], (n - lo - 1) * sizeof(double));
+			n--;
+		}
+		window[i % len] = x[i];
+		int lo = 0, hi = n;
+		while (lo < hi) {
+			int mid = (lo + hi) / 2;
+			if (sorted[mid] < x[i])
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		memmove(&sorted[lo + 1], &sorted[lo], (n - lo) * sizeof(double));
+		sorted[lo] = x[i];
+		n++;
+		sink = _median_sorted(sorted, n);
+	}
+	double t_sorted = (_now_s() - t0) * 1e9 / pushes;
+
+	/* window statistics with the skiplist, as the measurement controller uses them */
+	sample_ring_t *ring = sample_ring_new(len);
+	window_stats_t *stats = window_stats_new(ring, len);
+	window_stats_enable_percentiles(stats);
+	double err_median = 0, err_trimmed = 0, med, trimmed;
+	long n_err = 0;
+
+	t0 = _now_s();
+	for (long i = 0; i < pushes; i++) {
+		SensorSampleType s = { .timestamp_ns = i, .channel = 0, .value = { .type = is_float, .val.fval = x[i] } };
+		window_stats_push(stats, &s);
+		window_stats_percentile(stats, 50, &med);
+		sink = med;
+	}
+	double t_skiplist = (_now_s() - t0) * 1e9 / pushes;
+	(void) sink;
+
+	// filter quality, against the true value at the middle of the window
+	window_stats_reset(stats);
+	for (long i = 0; i < pushes; i++) {
+		SensorSampleType s = { .timestamp_ns = i, .channel = 0, .value = { .type = is_float, .val.fval = x[i] } };
+		window_stats_push(stats, &s);
+		if (i >= len && window_stats_percentile(stats, 50, &med) == 0 && window_stats_trimmed_mean(stats, &trimmed) == 0) {
+			double truth = _truth(i - len / 2);
+			err_median += fabs(med - truth);
+			err_trimmed += fabs(trimmed - truth);
+			n_err++;
+		}
+	}
+
+	printf("window %5d  qsort %10.1f ns  sorted array %8.1f ns  skiplist %7.1f ns per push+median   mean abs error  trimmed mean %6.3f  median %6.3f\n", len, t_qsort,
+			t_sorted, t_skiplist, err_trimmed / n_err, err_median / n_err);
+
+	window_stats_destroy(stats);
+	sample_ring_destroy(ring);
+	free(window);
+	free(tmp);
+	free(sorted);
+}
+
+int main(int argc, char **argv) {
+	long pushes = argc > 1 ? atol(argv[1]) : 1000000;
+
+	double *x = (double*) malloc(pushes * sizeof(double));
+	srand(1);
+	for (long i = 0; i < pushes; i++)
+		x[i] = (float) _signal(i); // the samples are stored as floats
+
+	printf("%ld pushes, 2%% spikes of 10-40 units over noise of +-0.5\n", pushes);
+
+	int windows[] = { 5, 60, 3600 };
+	for (int i = 0; i < sizeof(windows) / sizeof(windows[0]); i++)
+		_bench(windows[i], x, pushes);
+
+	free(x);
+	return 0;
+}
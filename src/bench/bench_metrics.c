@@ -0,0 +1,246 @@
+/*
+ * bench_metrics.c
+ *
+ * The /metrics endpoint under load: 8 headless rooms run as in bench_gateway (an acquisition
+ * thread publishing a sample of every channel of every room each period, the real measurement
+ * FSMs processing every samples_per_round periods into a dry run uploader) while 0, 1, 2 and 4
+ * clients scrape it as fast as they can, each over one keep-alive connection. Reports scrapes
+ * per second, scrape latency, body size and render time, and the main loop stalls and CPU next to
+ * the run without clients. Built with -DARENA_COUNT_MALLOC, also the heap allocations while the
+ * clients scrape (their threads started), which should be 0.
+ *
+ * gcc -O2 src/bench/bench_metrics.c src/sensors/dht11.c src/sensors/bh1750.c src/sensors/ccs811.c src/actuators/lcd1602.c
+ *     src/actuators/buzzer.c src/actuators/statusLed.c src/libs/fsm.c src/libs/timerlib.c src/libs/reactorlib.c
+ *     src/libs/systemlib.c src/libs/systemtype.c src/libs/samplering.c src/libs/windowstats.c src/libs/orderstats.c src/libs/tsdblib.c src/libs/rolluplib.c src/libs/statelib.c src/libs/deadbandlib.c src/libs/spscring.c src/libs/flaglib.c src/libs/uploadlib.c src/libs/lineprotolib.c src/libs/spoollib.c src/libs/arenalib.c src/libs/metricslib.c
+ *     src/controllers/measurementctrl.c src/controllers/outputctrl.c -lpthread -lrt -lwiringPi -lcurl -lz -o bench_metrics
+ * ./bench_metrics [seconds] [period_ms] [samples_per_round]
+ *
+ *  Created on: 17 oct. 2026
+ *      Author: Victoria M. Gullon and Marcos Gomez
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "../libs/systemtype.h"
+#include "../libs/arenalib.h"
+#include "../libs/metricslib.h"
+
+#define N_ROOMS 8
+#define MAX_CLIENTS METRICS_MAX_CONNECTIONS
+#define ARENA_SIZE ((5 << 20) + N_ROOMS * (12 << 20)) // as main() reserves it
+
+int buzzer_disabled = 0;
+float temp_crit_low = 10, temp_crit_high = 35, temp_warn_low = 17, temp_warn_high = 27, rh_crit_low = 20, rh_crit_high = 80, rh_warn_low = 30, rh_warn_high = 70;
+int lux_crit = 100, lux_warn = 300, eco2_crit = 2000, eco2_warn = 1000;
+
+typedef struct {
+	unsigned long scrapes;
+	unsigned long failures;
+	double latency_sum_s, latency_max_s;
+	size_t body_bytes; // of the last scrape
+	char response[METRICS_RESPONSE_BYTES + 1];
+} client_t;
+
+static SystemType *rooms[N_ROOMS];
+static SystemContext *contexts[N_ROOMS];
+static client_t clients[MAX_CLIENTS];
+static uploader_t *uploader;
+static atomic_int producing, scraping;
+static int period_ms, samples_per_round, port;
+
+static double _now_s(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double _cpu_s(void) {
+	struct rusage ru;
+	getrusage(RUSAGE_SELF, &ru);
+	return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+}
+
+// what main() renders, less the arena and endpoint counters
+static void _render(void *user_data, metrics_writer_t *w) {
+	uploader_stats_t up;
+
+	MeasurementCtrl__render_metrics(contexts, N_ROOMS, w);
+	uploader_read_stats(uploader, &up);
+	metrics_family(w, "roompi_upload_lines_total", "counter", "Lines handed to the uploader");
+	metrics_sample(w, "roompi_upload_lines_total", NULL, up.lines);
+	metrics_family(w, "roompi_upload_queued_lines", "gauge", "Lines waiting in the queue");
+	metrics_sample(w, "roompi_upload_queued_lines", NULL, uploader_queued(uploader));
+}
+
+// stands in for the sensor FSMs of the acquisition thread
+static void* _acquisition(void *arg) {
+	for (int n = 1; producing; n++) {
+		usleep(period_ms * 1000);
+		for (int r = 0; r < N_ROOMS; r++) {
+			SystemContext *ctx = rooms[r]->root_system;
+			SensorValueType temp = { .type = is_float, .val.fval = 20.0 + (n + r) % 5 };
+			SensorValueType humid = { .type = is_float, .val.fval = 45.0 + (n + r) % 7 };
+			SensorValueType lux = { .type = is_int, .val.ival = 400 + (n + r) % 50 };
+			SensorValueType eco2 = { .type = is_int, .val.ival = 600 + (n + r) % 80 };
+
+			SystemContext__publish_sample(ctx, SENSOR_QUEUE_TEMP_HUMID, 0, temp);
+			SystemContext__publish_sample(ctx, SENSOR_QUEUE_TEMP_HUMID, 1, humid);
+			SystemContext__publish_sample(ctx, SENSOR_QUEUE_LIGHT, 2, lux);
+			SystemContext__publish_sample(ctx, SENSOR_QUEUE_CO2, 3, eco2);
+			if (n % samples_per_round == 0)
+				flags_set(&ctx->measurement_flags, FLAG_PERFORM_PROCESSING);
+		}
+	}
+	return NULL;
+}
+
+// Reads one response: headers, then Content-Length bytes of body. Returns the body length, -1 on error
+static long _read_response(int fd, char *buf, size_t size) {
+	size_t len = 0;
+	char *end = NULL, *cl;
+
+	while (!end) {
+		ssize_t n = read(fd, buf + len, size - 1 - len);
+		if (n <= 0)
+			return -1;
+		len += n;
+		buf[len] = '\0';
+		end = strstr(buf, "\r\n\r\n");
+	}
+	if (strncmp(buf, "HTTP/1.1 200", 12) != 0 || !(cl = strstr(buf, "Content-Length: ")))
+		return -1;
+
+	size_t body = strtoul(cl + 16, NULL, 10), total = end + 4 - buf + body;
+	while (len < total) {
+		ssize_t n = read(fd, buf, total - len < size ? total - len : size);
+		if (n <= 0)
+			return -1;
+		len += n;
+	}
+	return body;
+}
+
+static void* _client(void *arg) {
+	client_t *c = (client_t*) arg;
+	static const char request[] = "GET /metrics HTTP/1.1\r\nHost: localhost\r\nAccept: text/plain\r\n\r\n";
+	struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons(port), .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+	int fd = socket(AF_INET, SOCK_STREAM, 0), one = 1;
+
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	if (connect(fd, (struct sockaddr*) &addr, sizeof(addr)) != 0)
+		scraping = 0;
+	while (scraping) {
+		double t0 = _now_s();
+		long body = write(fd, request, sizeof(request) - 1) == sizeof(request) - 1 ? _read_response(fd, c->response, sizeof(c->response)) : -1;
+		double latency = _now_s() - t0;
+		if (body < 0) {
+			c->failures++;
+			break;
+		}
+		c->scrapes++;
+		c->body_bytes = body;
+		c->latency_sum_s += latency;
+		if (latency > c->latency_max_s)
+			c->latency_max_s = latency;
+	}
+	close(fd);
+	return NULL;
+}
+
+int main(int argc, char **argv) {
+	int seconds = argc > 1 ? atoi(argv[1]) : 10;
+	period_ms = argc > 2 ? atoi(argv[2]) : 10;
+	samples_per_round = argc > 3 ? atoi(argv[3]) : 5;
+
+	printf("%d rooms, %d s per run, a sample of every channel every %d ms, processing every %d samples\n", N_ROOMS, seconds, period_ms, samples_per_round);
+
+	arena_t *arena = arena_new(ARENA_SIZE);
+	arena_use(arena);
+	uploader = uploader_new(NULL); // dry run, only counts the lines
+	reactor_t *reactor = reactor_new();
+	for (int r = 0; r < N_ROOMS; r++) {
+		contexts[r] = SystemContext__create(r + 1, NULL, NULL, NULL, NULL, NULL, NULL);
+		contexts[r]->uploader = uploader;
+		rooms[r] = SystemType__setup(contexts[r], MeasurementCtrl__setup(contexts[r]), NULL);
+		SystemType__attach(rooms[r], reactor, NULL, NULL);
+	}
+	metrics_server_t *metrics = metrics_new(0, _render, NULL);
+	if (!metrics) {
+		printf("cannot listen\n");
+		return 1;
+	}
+	port = metrics->port;
+	arena_seal(arena);
+
+	pthread_t acq;
+	unsigned long heap_allocs = 0;
+	producing = 1;
+	pthread_create(&acq, NULL, _acquisition, NULL);
+
+	for (int n_clients = 0; n_clients <= MAX_CLIENTS; n_clients = n_clients ? n_clients * 2 : 1) {
+		pthread_t th[MAX_CLIENTS];
+		unsigned long long render_sum0 = metrics->render_sum_ns;
+		unsigned long scrapes0 = metrics->scrapes, lines0 = uploader->lines;
+
+		reactor->dispatches = 0;
+		reactor->dispatch_sum_ns = 0;
+		reactor->dispatch_max_ns = 0;
+		scraping = 1;
+		for (int i = 0; i < n_clients; i++) {
+			memset(&clients[i], 0, sizeof(client_t) - sizeof(clients[i].response));
+			pthread_create(&th[i], NULL, _client, &clients[i]);
+		}
+
+		unsigned long allocs0 = arena_heap_allocs();
+		double t0 = _now_s(), cpu0 = _cpu_s(), end = t0 + seconds;
+		while (_now_s() < end)
+			reactor_run_once(reactor, (int) ((end - _now_s()) * 1000) + 1);
+		double wall = _now_s() - t0, cpu = _cpu_s() - cpu0;
+		heap_allocs += arena_heap_allocs() - allocs0;
+
+		scraping = 0;
+		client_t total;
+		memset(&total, 0, sizeof(client_t) - sizeof(total.response));
+		for (int i = 0; i < n_clients; i++) {
+			pthread_join(th[i], NULL);
+			total.scrapes += clients[i].scrapes;
+			total.failures += clients[i].failures;
+			total.latency_sum_s += clients[i].latency_sum_s;
+			if (clients[i].latency_max_s > total.latency_max_s)
+				total.latency_max_s = clients[i].latency_max_s;
+			total.body_bytes = clients[i].body_bytes;
+		}
+		unsigned long scrapes = metrics->scrapes - scrapes0;
+
+		printf("%d clients  scrapes/s %8.1f  latency avg %6.3f ms  max %6.3f ms  body %5zu B  render avg %6.1f us  failed %lu\n", n_clients, total.scrapes / wall,
+				total.scrapes ? total.latency_sum_s * 1e3 / total.scrapes : 0.0, total.latency_max_s * 1e3, total.body_bytes,
+				scrapes ? (metrics->render_sum_ns - render_sum0) / 1e3 / scrapes : 0.0, total.failures);
+		printf("           cpu %5.1f %%  stall avg %7.3f ms  max %7.3f ms  lines/s %8.1f\n", 100.0 * cpu / wall,
+				reactor->dispatches ? reactor->dispatch_sum_ns / 1e6 / reactor->dispatches : 0.0, reactor->dispatch_max_ns / 1e6, (uploader->lines - lines0) / wall);
+	}
+
+	producing = 0;
+	pthread_join(acq, NULL);
+#ifdef ARENA_COUNT_MALLOC
+	printf("heap allocations while scraping %lu, errors %lu refused %lu overflows %lu\n", heap_allocs, metrics->errors,
+			metrics->refused, metrics->overflows);
+#endif
+
+	metrics_destroy(metrics);
+	reactor_destroy(reactor);
+	for (int r = 0; r < N_ROOMS; r++)
+		SystemType__destroy(rooms[r]);
+	uploader_destroy(uploader);
+	return 0;
+}
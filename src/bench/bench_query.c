@@ -0,0 +1,141 @@
+/*
+ * bench_query.c
+ *
+ * Range query latency over the time-series store with a year of 5 s samples of the four channels:
+ * eCO2 over the last day, month and year, as one bucket and in 1 min, 1 h and 1 day buckets,
+ * through the sparse block index (tsdb_query) against decoding every block of the file. Both give
+ * the same counts and sums, checked.
+ *
+ * gcc -O2 src/bench/bench_query.c src/libs/tsdblib.c src/libs/arenalib.c -lm -o bench_query
+ * ./bench_query [days] [repeats]
+ *
+ *  Created on: 17 oct. 2026
+ *      Author: Victoria M. Gullon and Marcos Gomez
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../libs/tsdblib.h"
+
+#define N_CHANNELS 4
+#define PERIOD_MS 5000
+#define CHANNEL 3 // eCO2
+#define DAY_MS 86400000LL
+
+static double _now_s(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static float _value(int channel, long i) {
+	double day = sin(2 * M_PI * i * PERIOD_MS / 86400000.0);
+
+	switch (channel) {
+	case 0:
+		return roundf(10 * (22 + 2 * day + (rand() % 3 - 1) * 0.1)) / 10;
+	case 1:
+		return (float) (int) (45 + 10 * day + rand() % 3 - 1);
+	case 2:
+		return (float) (int) (day > 0 ? 300 + 400 * day + rand() % 20 : rand() % 5);
+	default:
+		return (float) (int) (600 + 300 * (day > 0 ? day : 0) + rand() % 30);
+	}
+}
+
+// without the index: every block of the file is decoded
+static void _scan(tsdb_t *db, int64_t from_ms, int64_t to_ms, int64_t step_ms, tsdb_agg_t *buckets, int n) {
+	for (int k = 0; k < n; k++) {
+		buckets[k].count = 0;
+		buckets[k].sum = 0;
+	}
+	for (uint64_t b = 0; b < tsdb_n_blocks(db); b++) {
+		const tsdb_block_t *block = tsdb_block(db, b);
+		tsdb_iter_t it;
+		int64_t ts_ms;
+		float value;
+
+		if (block->header.channel != CHANNEL)
+			continue;
+		tsdb_iter_init(&it, block);
+		while (tsdb_iter_next(&it, &ts_ms, &value) == 0) {
+			if (ts_ms >= from_ms && ts_ms < to_ms) {
+				buckets[(ts_ms - from_ms) / step_ms].count++;
+				buckets[(ts_ms - from_ms) / step_ms].sum += value;
+			}
+		}
+	}
+}
+
+int main(int argc, char **argv) {
+	double days = argc > 1 ? atof(argv[1]) : 365;
+	int repeats = argc > 2 ? atoi(argv[2]) : 20;
+	long n = (long) (days * DAY_MS / PERIOD_MS);
+	const char *path = "/tmp/bench_query.tsdb";
+
+	unlink(path);
+	tsdb_t *db = tsdb_open(path, N_CHANNELS, TSDB_DEFAULT_BLOCKS * 4);
+	if (!db) {
+		printf("cannot create %s\n", path);
+		return 1;
+	}
+
+	int64_t start = 1789948800000LL, t = start; // midnight UTC
+	srand(1);
+	for (long i = 0; i < n; i++) {
+		t += PERIOD_MS + rand() % 4;
+		for (int c = 0; c < N_CHANNELS; c++)
+			tsdb_append(db, c, t, _value(c, i));
+	}
+	tsdb_close(db);
+	db = tsdb_open(path, 0, 0); // the index is rebuilt from the file, as after a restart
+	printf("%.0f days of 5 s samples, %llu blocks, %llu of them eCO2\n", days, (unsigned long long) tsdb_n_blocks(db), (unsigned long long) db->index[CHANNEL].count);
+
+	// aligned to whole days so that the coarse buckets line up with the end of the data
+	int64_t end = (t / DAY_MS) * DAY_MS;
+	int64_t ranges[3] = { DAY_MS, 30 * DAY_MS, 365 * DAY_MS };
+	const char *range_names[3] = { "1 day", "1 month", "1 year" };
+	int64_t steps[4] = { 0, 60000, 3600000, DAY_MS };
+	const char *step_names[4] = { "whole", "1 min", "1 h", "1 day" };
+	long errors = 0;
+
+	for (int r = 0; r < 3; r++) {
+		if (ranges[r] > end - start)
+			continue;
+		for (int s = 0; s < 4; s++) {
+			int64_t from = end - ranges[r], step = steps[s] ? steps[s] : ranges[r];
+			int n_buckets = ranges[r] / step;
+			tsdb_agg_t *buckets = (tsdb_agg_t*) malloc(n_buckets * sizeof(tsdb_agg_t));
+			tsdb_agg_t *check = (tsdb_agg_t*) malloc(n_buckets * sizeof(tsdb_agg_t));
+
+			db->blocks_summarized = db->blocks_decoded = 0;
+			double t0 = _now_s();
+			for (int i = 0; i < repeats; i++)
+				tsdb_query(db, CHANNEL, from, end, steps[s], buckets, n_buckets);
+			double query_s = (_now_s() - t0) / repeats;
+
+			t0 = _now_s();
+			_scan(db, from, end, step, check, n_buckets);
+			double scan_s = _now_s() - t0;
+
+			for (int k = 0; k < n_buckets; k++) {
+				if (buckets[k].count != check[k].count || fabs(buckets[k].sum - check[k].sum) > 1e-6 * fabs(check[k].sum))
+					errors++;
+			}
+
+			printf("%-8s %-6s buckets %6d  index %9.3f ms (%5lu summarized %5lu decoded)  full scan %9.3f ms\n", range_names[r], step_names[s], n_buckets, query_s * 1e3,
+					db->blocks_summarized / repeats, db->blocks_decoded / repeats, scan_s * 1e3);
+			free(buckets);
+			free(check);
+		}
+	}
+	printf("mismatched buckets %ld\n", errors);
+
+	tsdb_close(db);
+	unlink(path);
+	return errors != 0;
+}
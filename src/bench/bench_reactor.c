@@ -0,0 +1,142 @@
+/*
+ * bench_reactor.c
+ *
+ * Compares the old busy-spinning fsm_fire loop against the epoll reactor: idle CPU %, loop
+ * wakeups per second and event-to-FSM latency. A helper thread plays the role of the periodic
+ * timers, eight synthetic FSMs mirror the ones fired by main().
+ *
+ * gcc -O2 src/bench/bench_reactor.c src/libs/reactorlib.c src/libs/fsm.c src/libs/flaglib.c src/libs/arenalib.c -lpthread -o bench_reactor
+ * ./bench_reactor [seconds] [period_ms]
+ *
+ *  Created on: 17 oct. 2026
+ *      Author: Victoria M. Gullon and Marcos Gomez
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#include "../libs/fsm.h"
+#include "../libs/reactorlib.h"
+
+#define N_FSMS 8
+
+static atomic_uint flags; // one pending bit per FSM
+static atomic_uint_fast64_t post_ns[N_FSMS]; // when the pending bit was raised
+
+static reactor_t *reactor = NULL; // NULL while benchmarking the busy loop
+static volatile int producing;
+static int period_ms;
+
+static uint64_t lat_sum_ns, lat_max_ns, lat_count;
+
+static uint64_t _now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static double _cpu_s(void) {
+	struct rusage ru;
+	getrusage(RUSAGE_SELF, &ru);
+	return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+}
+
+static int _pending(fsm_t *this) {
+	int bit = 1 << (int) (intptr_t) this->user_data;
+	return atomic_load(&flags) & bit;
+}
+
+static void _consume(fsm_t *this) {
+	int id = (int) (intptr_t) this->user_data;
+	atomic_fetch_and(&flags, ~(1u << id));
+
+	uint64_t lat = _now_ns() - atomic_load(&post_ns[id]);
+	lat_sum_ns += lat;
+	if (lat > lat_max_ns)
+		lat_max_ns = lat;
+	lat_count++;
+}
+
+static fsm_trans_t _bench_tt[] = { { 0, _pending, 0, _consume }, { -1, NULL, -1, NULL } };
+
+static void* _producer(void *arg) {
+	int next = 0;
+	while (producing) {
+		usleep(period_ms * 1000);
+		// the timers fire one after the other, as the sensor/controller timers do
+		atomic_store(&post_ns[next], _now_ns());
+		atomic_fetch_or(&flags, 1u << next);
+		if (reactor)
+			reactor_post(reactor, 1u << next);
+		next = (next + 1) % N_FSMS;
+	}
+	return NULL;
+}
+
+static void _report(const char *name, double wall, double cpu, unsigned long wakeups) {
+	printf("%-10s cpu %6.2f %%  idle %6.2f %%  wakeups/s %12.1f  latency avg %8.1f us  max %8.1f us  (%lu events)\n", name, 100.0 * cpu / wall, 100.0 - 100.0 * cpu / wall,
+			wakeups / wall, lat_count ? lat_sum_ns / 1e3 / lat_count : 0.0, lat_max_ns / 1e3, (unsigned long) lat_count);
+}
+
+int main(int argc, char **argv) {
+	int seconds = argc > 1 ? atoi(argv[1]) : 5;
+	period_ms = argc > 2 ? atoi(argv[2]) : 100;
+
+	fsm_t *fsms[N_FSMS];
+	for (int i = 0; i < N_FSMS; i++)
+		fsms[i] = fsm_new(0, _bench_tt, (void*) (intptr_t) i);
+
+	printf("%d s per run, one event every %d ms\n", seconds, period_ms);
+
+	/* old main loop: fire everything, forever, no sleep */
+	pthread_t th;
+	producing = 1;
+	lat_sum_ns = lat_max_ns = lat_count = 0;
+	pthread_create(&th, NULL, _producer, NULL);
+
+	unsigned long iterations = 0;
+	double cpu0 = _cpu_s();
+	uint64_t t0 = _now_ns(), end = t0 + seconds * 1000000000ULL;
+	while (_now_ns() < end) {
+		for (int i = 0; i < N_FSMS; i++)
+			fsm_fire(fsms[i]);
+		iterations++;
+	}
+	double wall = (_now_ns() - t0) / 1e9;
+	_report("busy-loop", wall, _cpu_s() - cpu0, iterations);
+	producing = 0;
+	pthread_join(th, NULL);
+	atomic_store(&flags, 0);
+
+	/* reactor: block in epoll_wait until an event is posted */
+	reactor = reactor_new();
+	for (int i = 0; i < N_FSMS; i++)
+		reactor_add_fsm(reactor, fsms[i], 1u << i);
+
+	producing = 1;
+	lat_sum_ns = lat_max_ns = lat_count = 0;
+	pthread_create(&th, NULL, _producer, NULL);
+
+	cpu0 = _cpu_s();
+	t0 = _now_ns();
+	end = t0 + seconds * 1000000000ULL;
+	while (_now_ns() < end) {
+		reactor_run_once(reactor, (end - _now_ns()) / 1000000 + 1);
+	}
+	wall = (_now_ns() - t0) / 1e9;
+	_report("reactor", wall, _cpu_s() - cpu0, reactor->wakeups);
+	producing = 0;
+	pthread_join(th, NULL);
+
+	reactor_destroy(reactor);
+	for (int i = 0; i < N_FSMS; i++)
+		fsm_destroy(fsms[i]);
+
+	return 0;
+}
@@ -0,0 +1,164 @@
+/*
+ * bench_rollup.c
+ *
+ * Cost of the incremental rollups and what they save at query time. Feeds days of 5 s samples of
+ * the four channels to rollup_add (ns per sample, rollups closed, records written to the rollup
+ * log), then answers "mean, min and max of every channel over the last 30 days" twice: decoding
+ * every raw block of the time-series store, and reading the 1 h records of the rollup log.
+ *
+ * gcc -O2 src/bench/bench_rollup.c src/libs/rolluplib.c src/libs/tsdblib.c src/libs/arenalib.c -lm -o bench_rollup
+ * ./bench_rollup [days]
+ *
+ *  Created on: 17 oct. 2026
+ *      Author: Victoria M. Gullon and Marcos Gomez
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../libs/rolluplib.h"
+#include "../libs/tsdblib.h"
+
+#define N_CHANNELS 4
+#define PERIOD_MS 5000
+#define QUERY_DAYS 30
+
+static rollup_log_t *rollup_log;
+
+static double _now_s(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static float _value(int channel, long i) {
+	double day = sin(2 * M_PI * i * PERIOD_MS / 86400000.0);
+
+	switch (channel) {
+	case 0:
+		return roundf(10 * (22 + 2 * day + (rand() % 3 - 1) * 0.1)) / 10;
+	case 1:
+		return (float) (int) (45 + 10 * day + rand() % 3 - 1);
+	case 2:
+		return (float) (int) (day > 0 ? 300 + 400 * day + rand() % 20 : rand() % 5);
+	default:
+		return (float) (int) (600 + 300 * (day > 0 ? day : 0) + rand() % 30);
+	}
+}
+
+// as SystemContext keeps them: 15 min and longer in the log
+static void _closed(void *user_data, unsigned int channel, int level, const rollup_bucket_t *bucket) {
+	if (level >= 1)
+		rollup_log_append(rollup_log, channel, level, bucket);
+}
+
+int main(int argc, char **argv) {
+	double days = argc > 1 ? atof(argv[1]) : 90;
+	long n = (long) (days * 86400000.0 / PERIOD_MS);
+	const char *tsdb_path = "/tmp/bench_rollup.tsdb", *log_path = "/tmp/bench_rollup.rollup";
+
+	unlink(tsdb_path);
+	unlink(log_path);
+	tsdb_t *db = tsdb_open(tsdb_path, N_CHANNELS, TSDB_DEFAULT_BLOCKS * 4);
+	rollup_log = rollup_log_open(log_path, ROLLUP_LOG_DEFAULT_RECORDS);
+	rollup_t *rollups = rollup_new(N_CHANNELS, _closed, NULL);
+	if (!db || !rollup_log) {
+		printf("cannot create the files in /tmp\n");
+		return 1;
+	}
+
+	// generated up front so that only the rollups are timed
+	int64_t *ts = (int64_t*) malloc(n * sizeof(int64_t));
+	float *values = (float*) malloc(n * N_CHANNELS * sizeof(float));
+	int64_t t = 1790000000000LL;
+	srand(1);
+	for (long i = 0; i < n; i++) {
+		t += PERIOD_MS + rand() % 4;
+		ts[i] = t;
+		for (int c = 0; c < N_CHANNELS; c++)
+			values[i * N_CHANNELS + c] = _value(c, i);
+	}
+
+	double t0 = _now_s();
+	for (long i = 0; i < n; i++) {
+		for (int c = 0; c < N_CHANNELS; c++)
+			rollup_add(rollups, c, ts[i], values[i * N_CHANNELS + c]);
+	}
+	double add_s = _now_s() - t0;
+
+	for (long i = 0; i < n; i++) {
+		for (int c = 0; c < N_CHANNELS; c++)
+			tsdb_append(db, c, ts[i], values[i * N_CHANNELS + c]);
+	}
+	rollup_log_flush(rollup_log);
+
+	printf("%.0f days, %ld samples: rollup_add %.1f ns/sample, %lu rollups closed, %llu kept in the log (%lu page writes)\n", days, n * N_CHANNELS,
+			add_s * 1e9 / (n * N_CHANNELS), rollups->closed, (unsigned long long) rollup_log_n_records(rollup_log), rollup_log->pages);
+
+	// both queries cover the same whole hours, ending a day ago so the raw samples are all in sealed blocks
+	tsdb_flush(db);
+	int64_t to = t - t % rollup_period_ms(2) - 86400000LL, from = to - QUERY_DAYS * 86400000LL;
+	double raw_sum[N_CHANNELS] = { 0 }, roll_sum[N_CHANNELS] = { 0 };
+	unsigned long raw_count[N_CHANNELS] = { 0 }, roll_count[N_CHANNELS] = { 0 };
+	float raw_min[N_CHANNELS], raw_max[N_CHANNELS], roll_min[N_CHANNELS], roll_max[N_CHANNELS];
+	for (int c = 0; c < N_CHANNELS; c++) {
+		raw_min[c] = roll_min[c] = INFINITY;
+		raw_max[c] = roll_max[c] = -INFINITY;
+	}
+
+	t0 = _now_s();
+	for (uint64_t b = 0; b < tsdb_n_blocks(db); b++) {
+		const tsdb_block_t *block = tsdb_block(db, b);
+		if (block->header.last_ts_ms < from || block->header.first_ts_ms >= to)
+			continue;
+
+		tsdb_iter_t it;
+		int64_t sample_ts;
+		float value;
+		int c = block->header.channel;
+		tsdb_iter_init(&it, block);
+		while (tsdb_iter_next(&it, &sample_ts, &value) == 0) {
+			if (sample_ts < from || sample_ts >= to)
+				continue;
+			raw_sum[c] += value;
+			raw_count[c]++;
+			if (value < raw_min[c])
+				raw_min[c] = value;
+			if (value > raw_max[c])
+				raw_max[c] = value;
+		}
+	}
+	double raw_s = _now_s() - t0;
+
+	t0 = _now_s();
+	rollup_record_t r;
+	for (uint64_t i = 0; rollup_log_read(rollup_log, i, &r) == 0; i++) {
+		if (r.level != 2 || r.start_s * 1000LL < from || r.start_s * 1000LL >= to)
+			continue;
+		roll_sum[r.channel] += r.sum;
+		roll_count[r.channel] += r.count;
+		if (r.min < roll_min[r.channel])
+			roll_min[r.channel] = r.min;
+		if (r.max > roll_max[r.channel])
+			roll_max[r.channel] = r.max;
+	}
+	double roll_s = _now_s() - t0;
+
+	printf("%d days query: raw blocks %8.3f ms, 1h rollups %8.3f ms\n", QUERY_DAYS, raw_s * 1e3, roll_s * 1e3);
+	for (int c = 0; c < N_CHANNELS; c++)
+		printf("  channel %d  raw n %7lu mean %8.3f min %7.1f max %7.1f  rollups n %7lu mean %8.3f min %7.1f max %7.1f\n", c, raw_count[c], raw_sum[c] / raw_count[c],
+				raw_min[c], raw_max[c], roll_count[c], roll_sum[c] / roll_count[c], roll_min[c], roll_max[c]);
+
+	rollup_destroy(rollups);
+	rollup_log_close(rollup_log);
+	tsdb_close(db);
+	unlink(tsdb_path);
+	unlink(log_path);
+	free(ts);
+	free(values);
+
+	return 0;
+}
@@ -0,0 +1,94 @@
+/*
+ * bench_samplering.c
+ *
+ * Push and iterate throughput of the typed sample ring against the byte oriented CircularBuffer
+ * it replaces in the sensor storage. "iterate" is what every processing round does: the old path
+ * copies the last window of values to a stack array and sums it, the new one sums the window in
+ * place through its two spans. Runs the project's window (5 of 8 samples) and longer ones.
+ *
+ * gcc -O2 src/bench/bench_samplering.c src/libs/samplering.c src/libs/circularbuffer.c src/libs/arenalib.c -o bench_samplering
+ * ./bench_samplering [operations]
+ *
+ *  Created on: 17 oct. 2026
+ *      Author: Victoria M. Gullon and Marcos Gomez
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../libs/samplering.h"
+#include "../libs/circularbuffer.h"
+
+static double _now_s(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void _bench(unsigned int capacity, unsigned int window, long ops) {
+	CircularBuffer cbuf = CircularBufferCreate(capacity * sizeof(SensorValueType));
+	sample_ring_t *ring = sample_ring_new(capacity);
+	SensorValueType *tmp = (SensorValueType*) malloc(window * sizeof(SensorValueType));
+	volatile float sink = 0;
+
+	double t0 = _now_s();
+	for (long i = 0; i < ops; i++) {
+		SensorValueType v = { .type = is_float, .val.fval = (float) (i & 1023) };
+		CircularBufferPush(cbuf, &v, sizeof(v));
+	}
+	double t_push_old = _now_s() - t0;
+
+	t0 = _now_s();
+	for (long i = 0; i < ops; i++) {
+		SensorSampleType s = { .timestamp_ns = i, .channel = 0, .value = { .type = is_float, .val.fval = (float) (i & 1023) } };
+		sample_ring_push(ring, &s);
+	}
+	double t_push_new = _now_s() - t0;
+
+	long rounds = ops / window;
+	float sum_old = 0, sum_new = 0;
+
+	t0 = _now_s();
+	for (long r = 0; r < rounds; r++) {
+		// the storage only ever holds the window when it is as long as the buffer
+		CircularBufferRead(cbuf, window * sizeof(SensorValueType), tmp);
+		for (unsigned int j = 0; j < window; j++)
+			sum_old += tmp[j].val.fval;
+		sink = sum_old;
+	}
+	double t_iter_old = _now_s() - t0;
+
+	t0 = _now_s();
+	for (long r = 0; r < rounds; r++) {
+		sample_span_t span;
+		sample_ring_window(ring, window, &span);
+		for (int part = 0; part < 2; part++) {
+			for (const SensorSampleType *s = span.data[part]; s < span.data[part] + span.len[part]; s++)
+				sum_new += s->value.val.fval;
+		}
+		sink = sum_new;
+	}
+	double t_iter_new = _now_s() - t0;
+	(void) sink;
+
+	printf("capacity %5u window %5u  push  old %7.1f M/s  new %7.1f M/s  iterate  old %7.1f M samples/s  new %7.1f M samples/s\n", capacity, window, ops / t_push_old / 1e6,
+			ops / t_push_new / 1e6, rounds * (double) window / t_iter_old / 1e6, rounds * (double) window / t_iter_new / 1e6);
+
+	free(tmp);
+	sample_ring_destroy(ring);
+	CircularBufferFree(cbuf);
+}
+
+int main(int argc, char **argv) {
+	long ops = argc > 1 ? atol(argv[1]) : 20000000;
+
+	printf("%ld pushes and %ld iterated samples per case\n", ops, ops);
+
+	// CircularBuffer is sized in bytes and only reads from its oldest byte, so it gets exactly the window
+	_bench(5, 5, ops);
+	_bench(64, 64, ops);
+	_bench(1024, 1024, ops);
+
+	return 0;
+}
@@ -0,0 +1,118 @@
+/*
+ * bench_sensor_stall.c
+ *
+ * Worst-case main loop stall caused by the sensor FSMs, before and after splitting the drivers
+ * into start/collect steps. "before" runs FSMs whose output calls the blocking
+ * __perform_measurement functions (what the old FSMs did), "after" runs the drivers' own FSMs
+ * that wait for the conversions on one-shot timers. Both go through the reactor, so the stall is
+ * the longest dispatch it measured. Run it on the Pi with the sensors attached.
+ *
+ * gcc -O2 src/bench/bench_sensor_stall.c src/sensors/dht11.c src/sensors/bh1750.c src/sensors/ccs811.c src/actuators/lcd1602.c
+ *     src/actuators/buzzer.c src/actuators/statusLed.c src/libs/fsm.c src/libs/timerlib.c src/libs/reactorlib.c
+ *     src/libs/systemlib.c src/libs/samplering.c src/libs/windowstats.c src/libs/orderstats.c src/libs/tsdblib.c src/libs/rolluplib.c src/libs/statelib.c src/libs/deadbandlib.c src/libs/spscring.c src/libs/flaglib.c src/libs/uploadlib.c src/libs/lineprotolib.c src/libs/spoollib.c src/libs/arenalib.c
+ *     -lpthread -lrt -lwiringPi -lcurl -lz -o bench_sensor_stall
+ * ./bench_sensor_stall [seconds] [period_ms]
+ *
+ *  Created on: 17 oct. 2026
+ *      Author: Victoria M. Gullon and Marcos Gomez
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include <wiringPi.h>
+
+#include "../libs/systemtype.h"
+
+static SystemContext *ctx;
+static DHT11Sensor *dht;
+static BH1750Sensor *bh;
+static CCS811Sensor *ccs;
+
+/* old style FSMs: the whole measurement happens inside the output function */
+
+static int _blocking_pending(fsm_t *this) {
+	return (flags_get(&ctx->measurement_flags) & (int) (intptr_t) this->user_data);
+}
+
+static void _blocking_measure(fsm_t *this) {
+	int flag = (int) (intptr_t) this->user_data;
+
+	if (flag == FLAG_TEMP_HUMID_PENDING_MEASUREMENT)
+		DHT11Sensor__perform_measurement(dht);
+	else if (flag == FLAG_LIGHT_PENDING_MEASUREMENT)
+		BH1750Sensor__perform_measurement(bh);
+	else
+		CCS811Sensor__perform_measurement(ccs);
+
+	flags_clear(&ctx->measurement_flags, flag);
+}
+
+static fsm_trans_t _blocking_tt[] = { { 0, _blocking_pending, 0, _blocking_measure }, { -1, NULL, -1, NULL } };
+
+static void _report(const char *name, reactor_t *r, double wall) {
+	printf("%-8s dispatches %6lu  fires %6lu  stall avg %8.3f ms  max %8.3f ms  (%.1f s)\n", name, r->dispatches, r->fires,
+			r->dispatches ? r->dispatch_sum_ns / 1e6 / r->dispatches : 0.0, r->dispatch_max_ns / 1e6, wall);
+}
+
+static double _run(reactor_t *r, int seconds, int period_ms) {
+	dht->reactor = bh->reactor = ccs->reactor = r; // both buses on one loop, as before the acquisition threads
+	reactor_add_timer(r, period_ms, 0); // the sensor timers post the events, this only bounds the loop
+
+	tmr_startms(dht->timer, period_ms);
+	tmr_startms(bh->timer, period_ms);
+	tmr_startms(ccs->timer, period_ms);
+
+	unsigned int start = millis();
+	while (millis() - start < seconds * 1000u)
+		reactor_run_once(r, period_ms);
+
+	tmr_stop(dht->timer);
+	tmr_stop(bh->timer);
+	tmr_stop(ccs->timer);
+	return (millis() - start) / 1e3;
+}
+
+int main(int argc, char **argv) {
+	int seconds = argc > 1 ? atoi(argv[1]) : 30;
+	int period_ms = argc > 2 ? atoi(argv[2]) : 1000;
+
+	wiringPiSetup();
+
+	dht = DHT11Sensor__create(1, 29);
+	bh = BH1750Sensor__create(4, 0x23, CONTINUOUS_H_RES);
+	ccs = CCS811Sensor__create(5, CCS811_ADDR_LOW, 0, 3, 2);
+	CCS811Sensor__connect(ccs);
+
+	ctx = SystemContext__create(1, dht, bh, ccs, NULL, NULL, NULL);
+
+	printf("%d s per run, every sensor measured every %d ms\n", seconds, period_ms);
+
+	/* before: blocking measurements inside the FSM outputs */
+	reactor_t *r = reactor_new();
+	fsm_t *fsm_dht = fsm_new(0, _blocking_tt, (void*) (intptr_t) FLAG_TEMP_HUMID_PENDING_MEASUREMENT);
+	fsm_t *fsm_bh = fsm_new(0, _blocking_tt, (void*) (intptr_t) FLAG_LIGHT_PENDING_MEASUREMENT);
+	fsm_t *fsm_ccs = fsm_new(0, _blocking_tt, (void*) (intptr_t) FLAG_CO2_PENDING_MEASUREMENT);
+	reactor_subscribe_flags(r, reactor_add_fsm(r, fsm_dht, 0), &ctx->measurement_flags, FLAG_TEMP_HUMID_PENDING_MEASUREMENT);
+	reactor_subscribe_flags(r, reactor_add_fsm(r, fsm_bh, 0), &ctx->measurement_flags, FLAG_LIGHT_PENDING_MEASUREMENT);
+	reactor_subscribe_flags(r, reactor_add_fsm(r, fsm_ccs, 0), &ctx->measurement_flags, FLAG_CO2_PENDING_MEASUREMENT);
+	double wall = _run(r, seconds, period_ms);
+	_report("before", r, wall);
+	reactor_destroy(r);
+	fsm_destroy(fsm_dht);
+	fsm_destroy(fsm_bh);
+	fsm_destroy(fsm_ccs);
+	flags_clear(&ctx->measurement_flags, ~0u);
+
+	/* after: the drivers' cooperative FSMs */
+	r = reactor_new();
+	reactor_subscribe_flags(r, reactor_add_fsm(r, dht->fsm, EVENT_TEMP_HUMID), &ctx->measurement_flags, FLAG_TEMP_HUMID_PENDING_MEASUREMENT);
+	reactor_subscribe_flags(r, reactor_add_fsm(r, bh->fsm, EVENT_LIGHT), &ctx->measurement_flags, FLAG_LIGHT_PENDING_MEASUREMENT);
+	reactor_subscribe_flags(r, reactor_add_fsm(r, ccs->fsm, EVENT_CO2), &ctx->measurement_flags, FLAG_CO2_PENDING_MEASUREMENT);
+	wall = _run(r, seconds, period_ms);
+	_report("after", r, wall);
+	reactor_destroy(r);
+
+	return 0;
+}
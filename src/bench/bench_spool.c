@@ -0,0 +1,250 @@
+/*
+ * bench_spool.c
+ *
+ * Uploads through InfluxDB outages. The lines of 8 gateway rooms, 4 channels each, are written
+ * every 10 ms to a local stand-in of the /write endpoint that goes down for down_ms every
+ * period_ms: it closes every connection it gets, before answering. It spends 5 us per line it
+ * takes, about what an InfluxDB on a small box does. Each line carries its write time, the
+ * stand-in keeps the worst age of the lines of the live bodies it takes (the ones newer than any
+ * before, the replayed ones are older): how late the live values get while the spool is replayed. Runs with no spool, with a spool replayed as fast as the
+ * stand-in takes it and with one replayed at replay_rate lines per second. Then the spool
+ * reopened with its last record torn: the records before it are kept, the torn one is skipped.
+ *
+ * gcc -O2 src/bench/bench_spool.c src/libs/uploadlib.c src/libs/spoollib.c src/libs/tsdblib.c src/libs/arenalib.c src/libs/spscring.c src/libs/flaglib.c -lpthread -lcurl -lz -o bench_spool
+ * ./bench_spool [seconds] [period_ms] [down_ms] [replay_rate]
+ *
+ *  Created on: 17 oct. 2026
+ *      Author: Victoria M. Gullon and Marcos Gomez
+ */
+
+#define _GNU_SOURCE // memmem, strcasestr
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "../libs/uploadlib.h"
+
+#define ROOMS 8
+#define SPOOL_DIR "/tmp/bench_spool.spool"
+
+static atomic_ulong received_lines, dropped_connections;
+static atomic_llong newest_us, stale_us; // newest line taken, and the worst age of a live line when taken
+static int period_ms, down_ms;
+static int64_t t0_us;
+static char url[64];
+
+static int64_t _now_us(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int _down(void) {
+	return period_ms && (_now_us() - t0_us) / 1000 % period_ms >= period_ms - down_ms;
+}
+
+/* stand-in server */
+
+static void* _connection(void *arg) {
+	int fd = (int) (intptr_t) arg;
+	size_t size = UPLOADER_BATCH_BYTES + 4096, len = 0;
+	char *buf = (char*) malloc(size);
+
+	while (1) {
+		char *end = NULL;
+		while (!(end = memmem(buf, len, "\r\n\r\n", 4))) {
+			ssize_t n = read(fd, buf + len, size - len);
+			if (n <= 0)
+				goto closed;
+			len += n;
+		}
+
+		size_t header = end + 4 - buf, body = 0;
+		char *cl = strcasestr(buf, "Content-Length:");
+		if (cl && cl < end)
+			body = strtoul(cl + 15, NULL, 10);
+		char *expect = strcasestr(buf, "Expect: 100-continue");
+		if (expect && expect < end)
+			write(fd, "HTTP/1.1 100 Continue\r\n\r\n", 25);
+
+		while (len < header + body) {
+			ssize_t n = read(fd, buf + len, size - len);
+			if (n <= 0)
+				goto closed;
+			len += n;
+		}
+
+		if (_down()) {
+			atomic_fetch_add(&dropped_connections, 1);
+			goto closed;
+		}
+
+		unsigned long lines = 0;
+		int64_t newest = 0, oldest = INT64_MAX;
+		for (char *p = buf + header; p < buf + header + body; p++) {
+			if (*p == '\n')
+				lines++;
+			else if (*p == 'w' && p + 8 < buf + header + body && memcmp(p, "written=", 8) == 0) {
+				int64_t w = strtoll(p + 8, NULL, 10);
+				if (w > newest)
+					newest = w;
+				if (w < oldest)
+					oldest = w;
+			}
+		}
+		usleep(lines * 5);
+		atomic_fetch_add(&received_lines, lines);
+
+		// a body newer than any before holds live lines, the replayed ones are older
+		long long prev_newest = atomic_load(&newest_us);
+		if (newest > prev_newest && atomic_compare_exchange_strong(&newest_us, &prev_newest, newest)) {
+			long long age = _now_us() - oldest, prev = atomic_load(&stale_us);
+			while (age > prev && !atomic_compare_exchange_weak(&stale_us, &prev, age))
+				;
+		}
+
+		const char *resp = "HTTP/1.1 204 No Content\r\nContent-Length: 0\r\n\r\n";
+		write(fd, resp, strlen(resp));
+
+		memmove(buf, buf + header + body, len - header - body);
+		len -= header + body;
+	}
+
+closed:
+	close(fd);
+	free(buf);
+	return NULL;
+}
+
+static void* _server(void *arg) {
+	int listen_fd = (int) (intptr_t) arg;
+
+	while (1) {
+		int fd = accept(listen_fd, NULL, NULL);
+		if (fd < 0)
+			continue;
+
+		pthread_t th;
+		pthread_create(&th, NULL, _connection, (void*) (intptr_t) fd);
+		pthread_detach(th);
+	}
+	return NULL;
+}
+
+/* runs */
+
+static void _run(const char *name, int seconds, int spool, unsigned int replay_rate) {
+	static const char *names[4] = { "temp", "rh", "lux", "eco2" };
+	unsigned long points = 0, lines0 = atomic_load(&received_lines), dropped0 = atomic_load(&dropped_connections);
+	char data[128];
+
+	system("rm -rf " SPOOL_DIR);
+	uploader_t *uploader = uploader_new(url);
+	uploader_set_batch(uploader, UPLOADER_BATCH_LINES, 200);
+	if (spool)
+		uploader_set_spool(uploader, SPOOL_DIR, SPOOL_DEFAULT_MAX_BYTES, replay_rate);
+
+	t0_us = _now_us();
+	atomic_store(&stale_us, 0);
+	atomic_store(&newest_us, 0);
+	while (_now_us() - t0_us < seconds * 1000000LL) {
+		for (int r = 0; r < ROOMS; r++) {
+			for (int i = 0; i < 4; i++) {
+				sprintf(data, "%s,room=%d value=%f,written=%lldi", names[i], 101 + r, 20.0 + (points % 97) / 10.0, (long long) _now_us());
+				uploader_write(uploader, data);
+				points++;
+			}
+		}
+		usleep(10000);
+	}
+
+	// the backfill left, with the stand-in up
+	int64_t t1_us = _now_us();
+	period_ms = 0;
+	uploader_flush(uploader);
+	while (uploader->spool && spool_pending(uploader->spool) > 0 && _now_us() - t1_us < 60000000)
+		usleep(10000);
+	double catch_up = (_now_us() - t1_us) / 1e6;
+	usleep(100000); // the server counts the last body
+
+	printf("%-14s %lu of %lu lines received  %4lu connections dropped  %6lu spooled  %6lu replayed  %5.2f s to catch up  live delay worst %6.0f ms\n", name,
+			atomic_load(&received_lines) - lines0, points, atomic_load(&dropped_connections) - dropped0, uploader->spooled, uploader->replayed, catch_up,
+			atomic_load(&stale_us) / 1e3);
+	if (uploader->spool)
+		printf("               %lu records appended  %lu syncs  %u segments left\n", uploader->spool->appends, uploader->spool->syncs,
+				uploader->spool->last_segment - uploader->spool->first_segment + 1);
+	uploader_destroy(uploader);
+}
+
+static void _torn_record(void) {
+	char body[64], path[64], buf[256];
+	unsigned int lines;
+
+	system("rm -rf " SPOOL_DIR);
+	spool_t *spool = spool_open(SPOOL_DIR, 0);
+	for (int i = 0; i < 3; i++) {
+		sprintf(body, "temp,room=101 value=%d\n", 20 + i);
+		spool_append(spool, body, strlen(body), 1);
+	}
+	uint32_t segment = spool->last_segment;
+	spool_close(spool);
+
+	// a power cut half way through the last record
+	sprintf(path, SPOOL_DIR "/%08x.seg", segment);
+	FILE *f = fopen(path, "r+");
+	fseek(f, 0, SEEK_END);
+	int tear = ftruncate(fileno(f), ftell(f) - 6);
+	fclose(f);
+
+	spool = spool_open(SPOOL_DIR, 0);
+	unsigned int read_back = 0;
+	while (spool_peek(spool, buf, sizeof(buf), 1, &lines) > 0) {
+		spool_commit(spool);
+		read_back += lines;
+	}
+	printf("torn record    %u of 3 lines read back, %lu corrupt records%s\n", read_back, spool->corrupt, tear ? " (could not tear it)" : "");
+	spool_close(spool);
+	system("rm -rf " SPOOL_DIR);
+}
+
+int main(int argc, char **argv) {
+	int seconds = argc > 1 ? atoi(argv[1]) : 10;
+	int period = argc > 2 ? atoi(argv[2]) : 4000;
+	int down = argc > 3 ? atoi(argv[3]) : 2000;
+	unsigned int replay_rate = argc > 4 ? atoi(argv[4]) : UPLOADER_REPLAY_RATE;
+
+	int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+	struct sockaddr_in addr = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK), .sin_port = 0 };
+	socklen_t addr_len = sizeof(addr);
+	bind(listen_fd, (struct sockaddr*) &addr, sizeof(addr));
+	listen(listen_fd, 64);
+	getsockname(listen_fd, (struct sockaddr*) &addr, &addr_len);
+	sprintf(url, "http://127.0.0.1:%d/write?db=db0", ntohs(addr.sin_port));
+
+	pthread_t th;
+	pthread_create(&th, NULL, _server, (void*) (intptr_t) listen_fd);
+
+	printf("%d s per run, %d lines every 10 ms, the stand-in down %d ms every %d ms\n", seconds, ROOMS * 4, down, period);
+
+	period_ms = period, down_ms = down;
+	_run("no spool", seconds, 0, 0);
+	period_ms = period, down_ms = down;
+	_run("spool", seconds, 1, 0);
+	period_ms = period, down_ms = down;
+	char name[32];
+	sprintf(name, "spool %u/s", replay_rate);
+	_run(name, seconds, 1, replay_rate);
+
+	_torn_record();
+	system("rm -rf " SPOOL_DIR);
+	return 0;
+}
@@ -0,0 +1,140 @@
+/*
+ * bench_spscring.c
+ *
+ * Stress test of the sample queues: two producer threads (the I2C and GPIO acquisition threads)
+ * push millions of synthetic timestamped samples that one consumer (the measurement controller)
+ * drains. Checks that every sample arrives once and in order, and compares the throughput with
+ * the previous path, a CircularBuffer guarded by a mutex.
+ *
+ * gcc -O2 src/bench/bench_spscring.c src/libs/spscring.c src/libs/circularbuffer.c src/libs/arenalib.c -lpthread -o bench_spscring
+ * ./bench_spscring [samples per producer] [queue length]
+ *
+ *  Created on: 17 oct. 2026
+ *      Author: Victoria M. Gullon and Marcos Gomez
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+#include "../libs/spscring.h"
+#include "../libs/circularbuffer.h"
+
+#define N_PRODUCERS 2
+
+typedef struct {
+	unsigned long long timestamp_ns;
+	int channel;
+	union {
+		int ival;
+		float fval;
+	} val; // same layout as SensorSampleType
+} SampleType;
+
+static unsigned long samples;
+static spsc_ring_t *rings[N_PRODUCERS];
+static CircularBuffer buffers[N_PRODUCERS];
+static pthread_mutex_t locks[N_PRODUCERS];
+static int use_lock;
+
+static unsigned long long _now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void* _producer(void *arg) {
+	int id = (int) (long) arg;
+	SampleType s = { .channel = id };
+
+	for (unsigned long i = 0; i < samples; i++) {
+		s.timestamp_ns = i; // sequence number, checked by the consumer
+		s.val.ival = (int) i;
+		if (use_lock) {
+			while (1) {
+				pthread_mutex_lock(&locks[id]);
+				int full = CircularBufferGetDataSize(buffers[id]) + sizeof(s) > CircularBufferGetCapacity(buffers[id]);
+				if (!full)
+					CircularBufferPush(buffers[id], &s, sizeof(s));
+				pthread_mutex_unlock(&locks[id]);
+				if (!full)
+					break;
+				sched_yield();
+			}
+		} else {
+			while (spsc_ring_push(rings[id], &s) < 0)
+				sched_yield(); // a real producer drops the sample, here we retry to check that nothing gets lost
+		}
+	}
+	return NULL;
+}
+
+static unsigned long _consume(unsigned long *errors) {
+	unsigned long expected[N_PRODUCERS] = { 0 }, received = 0;
+	SampleType s;
+
+	while (received < N_PRODUCERS * samples) {
+		int idle = 1;
+		for (int id = 0; id < N_PRODUCERS; id++) {
+			int got;
+			if (use_lock) {
+				pthread_mutex_lock(&locks[id]);
+				got = CircularBufferPop(buffers[id], sizeof(s), &s) == sizeof(s);
+				pthread_mutex_unlock(&locks[id]);
+			} else {
+				got = spsc_ring_pop(rings[id], &s) == 0;
+			}
+			if (!got)
+				continue;
+			idle = 0;
+			if (s.channel != id || s.timestamp_ns != expected[id] || s.val.ival != (int) expected[id])
+				(*errors)++;
+			expected[id]++;
+			received++;
+		}
+		if (idle)
+			sched_yield();
+	}
+	return received;
+}
+
+static void _run(const char *name) {
+	pthread_t th[N_PRODUCERS];
+	unsigned long errors = 0;
+
+	unsigned long long t0 = _now_ns();
+	for (int i = 0; i < N_PRODUCERS; i++)
+		pthread_create(&th[i], NULL, _producer, (void*) (long) i);
+	unsigned long received = _consume(&errors);
+	double wall = (_now_ns() - t0) / 1e9;
+	for (int i = 0; i < N_PRODUCERS; i++)
+		pthread_join(th[i], NULL);
+
+	printf("%-18s %lu samples in %.3f s  %8.2f M samples/s  %6.1f ns/sample  errors %lu\n", name, received, wall, received / wall / 1e6, wall * 1e9 / received, errors);
+}
+
+int main(int argc, char **argv) {
+	samples = argc > 1 ? strtoul(argv[1], NULL, 10) : 5000000;
+	int len = argc > 2 ? atoi(argv[2]) : 64;
+
+	printf("%d producers x %lu samples, queue length %d\n", N_PRODUCERS, samples, len);
+
+	for (int i = 0; i < N_PRODUCERS; i++) {
+		rings[i] = spsc_ring_new(len, sizeof(SampleType));
+		buffers[i] = CircularBufferCreate(len * sizeof(SampleType));
+		pthread_mutex_init(&locks[i], NULL);
+	}
+
+	use_lock = 0;
+	_run("spsc ring");
+	use_lock = 1;
+	_run("mutex + circbuf");
+
+	for (int i = 0; i < N_PRODUCERS; i++) {
+		spsc_ring_destroy(rings[i]);
+		CircularBufferFree(buffers[i]);
+	}
+	return 0;
+}
@@ -0,0 +1,174 @@
+/*
+ * bench_timerwheel.c
+ *
+ * Insert/cancel/expire throughput of the timerlib hierarchical timing wheel against one POSIX
+ * timer_create per task, with thousands of periodic tasks.
+ *
+ * gcc -O2 src/bench/bench_timerwheel.c src/libs/timerlib.c src/libs/arenalib.c -lpthread -lrt -o bench_timerwheel
+ * ./bench_timerwheel [tasks] [seconds]
+ *
+ *  Created on: 17 oct. 2026
+ *      Author: Victoria M. Gullon and Marcos Gomez
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#include "../libs/timerlib.h"
+
+static double _now_s(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double _cpu_s(void) {
+	struct rusage ru;
+	getrusage(RUSAGE_SELF, &ru);
+	return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+}
+
+static int _period_ms(int i) {
+	return 50 + (i * 7919) % 950; // 50 ms .. 1 s, spread over the tasks
+}
+
+static atomic_ulong tmr_expirations;
+
+static void _tmr_isr(union sigval value) {
+	atomic_fetch_add(&tmr_expirations, 1);
+}
+
+int main(int argc, char **argv) {
+	int tasks = argc > 1 ? atoi(argv[1]) : 10000;
+	int seconds = argc > 2 ? atoi(argv[2]) : 3;
+
+	printf("%d periodic tasks, periods 50..1000 ms\n\n", tasks);
+
+	// the kernel timers of the last run signal SIGRTMIN, block it before the timer thread exists
+	sigset_t set;
+	sigemptyset(&set);
+	sigaddset(&set, SIGRTMIN);
+	sigprocmask(SIG_BLOCK, &set, NULL);
+
+	/* 1. insert / cancel: wheel vs timer_create + timer_settime */
+	tmr_wheel_t wheel;
+	tmr_wheel_node_t *nodes = calloc(tasks, sizeof(tmr_wheel_node_t));
+	tmr_wheel_init(&wheel, 0);
+
+	double t0 = _now_s();
+	for (int i = 0; i < tasks; i++)
+		tmr_wheel_add(&wheel, &nodes[i], _period_ms(i));
+	double t_ins = _now_s() - t0;
+	t0 = _now_s();
+	for (int i = 0; i < tasks; i++)
+		tmr_wheel_del(&wheel, &nodes[i]);
+	double t_del = _now_s() - t0;
+	printf("wheel        insert %12.0f /s  cancel %12.0f /s\n", tasks / t_ins, tasks / t_del);
+
+	timer_t *ids = calloc(tasks, sizeof(timer_t));
+	struct sigevent se = { .sigev_notify = SIGEV_NONE };
+	int created = 0;
+	t0 = _now_s();
+	for (int i = 0; i < tasks; i++) {
+		if (timer_create(CLOCK_MONOTONIC, &se, &ids[i]) < 0)
+			break;
+		int ms = _period_ms(i);
+		struct itimerspec spec = { { ms / 1000, (ms % 1000) * 1000000 }, { ms / 1000, (ms % 1000) * 1000000 } };
+		timer_settime(ids[i], 0, &spec, NULL);
+		created++;
+	}
+	t_ins = _now_s() - t0;
+	t0 = _now_s();
+	for (int i = 0; i < created; i++)
+		timer_delete(ids[i]);
+	t_del = _now_s() - t0;
+	printf("timer_create insert %12.0f /s  cancel %12.0f /s  (%d timers created)\n\n", created / t_ins, created / t_del, created);
+
+	/* 2. expiry processing in virtual time: one hour of 1 ms ticks, periodic re-insertion */
+	tmr_wheel_init(&wheel, 0);
+	for (int i = 0; i < tasks; i++)
+		tmr_wheel_add(&wheel, &nodes[i], _period_ms(i));
+
+	unsigned long expirations = 0, batches = 0;
+	double cpu0 = _cpu_s();
+	for (uint64_t now = 1; now <= 3600 * 1000; now++) {
+		tmr_wheel_node_t *expired = tmr_wheel_advance(&wheel, now);
+		if (expired)
+			batches++;
+		while (expired) {
+			tmr_wheel_node_t *node = expired;
+			expired = expired->next;
+			tmr_wheel_add(&wheel, node, node->expires + _period_ms(node - nodes));
+			expirations++;
+		}
+	}
+	double cpu = _cpu_s() - cpu0;
+	printf("wheel (virtual 1 h)  %lu expirations in %lu batches, %.0f expirations/s of CPU, %.1f ns each\n\n", expirations, batches, expirations / cpu, cpu * 1e9 / expirations);
+
+	/* 3. real time: timerlib service thread vs one kernel timer per task delivering a signal */
+	tmr_t **tmrs = calloc(tasks, sizeof(tmr_t*));
+	for (int i = 0; i < tasks; i++)
+		tmrs[i] = tmr_new(_tmr_isr);
+
+	cpu0 = _cpu_s();
+	t0 = _now_s();
+	for (int i = 0; i < tasks; i++)
+		tmr_startms(tmrs[i], _period_ms(i));
+	sleep(seconds);
+	for (int i = 0; i < tasks; i++)
+		tmr_stop(tmrs[i]);
+	double wall = _now_s() - t0;
+	cpu = _cpu_s() - cpu0;
+
+	unsigned long overruns = 0;
+	long long jitter_max = 0;
+	for (int i = 0; i < tasks; i++) {
+		tmr_stats_t s = tmr_get_stats(tmrs[i]);
+		overruns += s.overruns;
+		if (s.jitter_max_ns > jitter_max)
+			jitter_max = s.jitter_max_ns;
+		tmr_destroy(tmrs[i]);
+	}
+	unsigned long n = atomic_load(&tmr_expirations);
+	printf("timerlib     %8.0f expirations/s  cpu %5.1f %%  %6.2f us cpu/expiry  overruns %lu  max jitter %.3f ms\n", n / wall, 100 * cpu / wall, cpu * 1e6 / n, overruns, jitter_max / 1e6);
+
+	se = (struct sigevent) { .sigev_notify = SIGEV_SIGNAL, .sigev_signo = SIGRTMIN };
+
+	created = 0;
+	cpu0 = _cpu_s();
+	t0 = _now_s();
+	for (int i = 0; i < tasks; i++) {
+		if (timer_create(CLOCK_MONOTONIC, &se, &ids[i]) < 0)
+			break;
+		int ms = _period_ms(i);
+		struct itimerspec spec = { { ms / 1000, (ms % 1000) * 1000000 }, { ms / 1000, (ms % 1000) * 1000000 } };
+		timer_settime(ids[i], 0, &spec, NULL);
+		created++;
+	}
+	n = 0;
+	overruns = 0;
+	struct timespec timeout = { 0, 100000000 };
+	while (_now_s() - t0 < seconds) {
+		siginfo_t si;
+		if (sigtimedwait(&set, &si, &timeout) > 0) {
+			n++;
+			overruns += si.si_overrun;
+		}
+	}
+	for (int i = 0; i < created; i++)
+		timer_delete(ids[i]);
+	wall = _now_s() - t0;
+	cpu = _cpu_s() - cpu0;
+	printf("timer_create %8.0f expirations/s  cpu %5.1f %%  %6.2f us cpu/expiry  overruns %lu  (%d timers created)\n", n / wall, 100 * cpu / wall, cpu * 1e6 / n, overruns, created);
+
+	free(tmrs);
+	free(ids);
+	free(nodes);
+	return 0;
+}
@@ -0,0 +1,116 @@
+/*
+ * bench_tsdb.c
+ *
+ * Write throughput and bytes per sample of the time-series store with the four channels sampled
+ * every 5 s (a few ms of timer jitter): DHT11 temperature and humidity, BH1750 lux and CCS811
+ * eCO2 with realistic drift and noise. Defaults to 90 days of samples; every block is decoded
+ * back and checked against what was written.
+ *
+ * gcc -O2 src/bench/bench_tsdb.c src/libs/tsdblib.c src/libs/arenalib.c -lm -o bench_tsdb
+ * ./bench_tsdb [days] [file]
+ *
+ *  Created on: 17 oct. 2026
+ *      Author: Victoria M. Gullon and Marcos Gomez
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../libs/tsdblib.h"
+
+#define N_CHANNELS 4
+#define PERIOD_MS 5000
+
+static double _now_s(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static float _value(int channel, long i) {
+	double day = sin(2 * M_PI * i * PERIOD_MS / 86400000.0);
+
+	switch (channel) {
+	case 0:
+		return roundf(10 * (22 + 2 * day + (rand() % 3 - 1) * 0.1)) / 10; // DHT11 decimals are tenths
+	case 1:
+		return (float) (int) (45 + 10 * day + rand() % 3 - 1);
+	case 2:
+		return (float) (int) (day > 0 ? 300 + 400 * day + rand() % 20 : rand() % 5);
+	default:
+		return (float) (int) (600 + 300 * (day > 0 ? day : 0) + rand() % 30);
+	}
+}
+
+int main(int argc, char **argv) {
+	double days = argc > 1 ? atof(argv[1]) : 90;
+	const char *path = argc > 2 ? argv[2] : "/tmp/bench_tsdb.tsdb";
+	long n = (long) (days * 86400000.0 / PERIOD_MS);
+
+	unlink(path);
+	tsdb_t *db = tsdb_open(path, N_CHANNELS, TSDB_DEFAULT_BLOCKS * 4);
+	if (!db) {
+		printf("cannot create %s\n", path);
+		return 1;
+	}
+
+	// generated up front so that only the store is timed
+	int64_t *ts = (int64_t*) malloc(n * sizeof(int64_t));
+	float *values = (float*) malloc(n * N_CHANNELS * sizeof(float));
+	int64_t t = 1790000000000LL;
+	srand(1);
+	for (long i = 0; i < n; i++) {
+		t += PERIOD_MS + rand() % 4; // timer jitter
+		ts[i] = t;
+		for (int c = 0; c < N_CHANNELS; c++)
+			values[i * N_CHANNELS + c] = _value(c, i);
+	}
+
+	double t0 = _now_s();
+	for (long i = 0; i < n; i++) {
+		for (int c = 0; c < N_CHANNELS; c++)
+			tsdb_append(db, c, ts[i] + c, values[i * N_CHANNELS + c]);
+	}
+	double wall = _now_s() - t0;
+	unsigned long flushes = db->flushes;
+
+	tsdb_close(db);
+	db = tsdb_open(path, N_CHANNELS, 0);
+
+	// decode everything back
+	long next[N_CHANNELS] = { 0 }, errors = 0;
+	for (uint64_t b = 0; b < tsdb_n_blocks(db); b++) {
+		const tsdb_block_t *block = tsdb_block(db, b);
+		tsdb_iter_t it;
+		int64_t ts_ms;
+		float v;
+		int c = block->header.channel;
+
+		if (tsdb_crc32(block->payload, (block->header.bits + 7) / 8) != block->header.crc)
+			errors++;
+		tsdb_iter_init(&it, block);
+		while (tsdb_iter_next(&it, &ts_ms, &v) == 0) {
+			if (ts_ms != ts[next[c]] + c || v != values[next[c] * N_CHANNELS + c])
+				errors++;
+			next[c]++;
+		}
+	}
+
+	uint64_t blocks = tsdb_n_blocks(db);
+	double bytes = blocks * (double) TSDB_BLOCK_SIZE;
+	long samples = n * N_CHANNELS;
+	printf("%.0f days, %ld samples in %lu blocks (%lu file writes of up to %d blocks)\n", days, samples, (unsigned long) blocks, flushes, TSDB_STAGE_BLOCKS);
+	printf("append %.2f M samples/s  %.2f bytes/sample (raw 12)  %.2f MB for the whole period  %.1f days per MB\n", samples / wall / 1e6, bytes / samples, bytes / 1e6,
+			days / (bytes / 1e6));
+	for (int c = 0; c < N_CHANNELS; c++)
+		printf("  channel %d decoded %ld/%ld\n", c, next[c], n);
+	printf("decode errors %ld\n", errors);
+
+	tsdb_close(db);
+	free(ts);
+	free(values);
+	return errors != 0;
+}
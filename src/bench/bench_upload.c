@@ -0,0 +1,208 @@
+/*
+ * bench_upload.c
+ *
+ * Points per second and client CPU per point of the InfluxDB uploads against a local stand-in of
+ * the /write endpoint (HTTP/1.1, answers 204 and keeps the connection open, counts the lines it
+ * gets). The rounds are the lines of 8 gateway rooms, 4 channels each, written as the measurement
+ * FSM writes them:
+ *   per line    what the uploader did before: a new curl handle, connection and POST per line,
+ *               asking for HTTP/2
+ *   keep-alive  the uploader with batches of 1 line: one POST per line on a kept connection
+ *   batched     the uploader with its default batches: one POST per max_lines lines
+ * The uploader runs are held back when its queue is full, so that they measure its worker, and
+ * their CPU is that of the writing thread plus the worker.
+ *
+ * gcc -O2 src/bench/bench_upload.c src/libs/uploadlib.c src/libs/spoollib.c src/libs/tsdblib.c src/libs/arenalib.c src/libs/spscring.c src/libs/flaglib.c -lpthread -lcurl -lz -o bench_upload
+ * ./bench_upload [seconds] [max_lines]
+ *
+ *  Created on: 17 oct. 2026
+ *      Author: Victoria M. Gullon and Marcos Gomez
+ */
+
+#define _GNU_SOURCE // memmem, strcasestr
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <curl/curl.h>
+
+#include "../libs/uploadlib.h"
+
+#define ROOMS 8
+
+static atomic_ulong received_lines, accepted;
+static char url[64];
+
+static double _now_s(clockid_t clock) {
+	struct timespec ts;
+	clock_gettime(clock, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* stand-in server */
+
+static void* _connection(void *arg) {
+	int fd = (int) (intptr_t) arg;
+	size_t size = UPLOADER_BATCH_BYTES + 4096, len = 0;
+	char *buf = (char*) malloc(size);
+
+	while (1) {
+		char *end = NULL;
+		while (!(end = memmem(buf, len, "\r\n\r\n", 4))) {
+			ssize_t n = read(fd, buf + len, size - len);
+			if (n <= 0) {
+				close(fd);
+				free(buf);
+				return NULL;
+			}
+			len += n;
+		}
+
+		size_t header = end + 4 - buf, body = 0;
+		char *cl = strcasestr(buf, "Content-Length:");
+		if (cl && cl < end)
+			body = strtoul(cl + 15, NULL, 10);
+		char *expect = strcasestr(buf, "Expect: 100-continue");
+		if (expect && expect < end)
+			write(fd, "HTTP/1.1 100 Continue\r\n\r\n", 25);
+
+		while (len < header + body) {
+			ssize_t n = read(fd, buf + len, size - len);
+			if (n <= 0) {
+				close(fd);
+				free(buf);
+				return NULL;
+			}
+			len += n;
+		}
+
+		unsigned long lines = 0;
+		for (size_t i = header; i < header + body; i++)
+			lines += buf[i] == '\n';
+		atomic_fetch_add(&received_lines, lines ? lines : (body > 0));
+
+		const char *resp = "HTTP/1.1 204 No Content\r\nContent-Length: 0\r\n\r\n";
+		write(fd, resp, strlen(resp));
+
+		memmove(buf, buf + header + body, len - header - body);
+		len -= header + body;
+	}
+}
+
+static void* _server(void *arg) {
+	int listen_fd = (int) (intptr_t) arg;
+
+	while (1) {
+		int fd = accept(listen_fd, NULL, NULL);
+		if (fd < 0)
+			continue;
+		atomic_fetch_add(&accepted, 1);
+
+		pthread_t th;
+		pthread_create(&th, NULL, _connection, (void*) (intptr_t) fd);
+		pthread_detach(th);
+	}
+	return NULL;
+}
+
+/* clients */
+
+static size_t _discard(char *data, size_t size, size_t n, void *user_data) {
+	return size * n;
+}
+
+// the uploader_write of before, one handle and one POST per line
+static int _write_per_line(const char *line) {
+	CURL *hnd = curl_easy_init();
+	curl_easy_setopt(hnd, CURLOPT_BUFFERSIZE, 102400L);
+	curl_easy_setopt(hnd, CURLOPT_URL, url);
+	curl_easy_setopt(hnd, CURLOPT_NOPROGRESS, 1L);
+	curl_easy_setopt(hnd, CURLOPT_POSTFIELDS, line);
+	curl_easy_setopt(hnd, CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t) strlen(line));
+	curl_easy_setopt(hnd, CURLOPT_USERAGENT, "curl/roompisys/7.77.0-DEV");
+	curl_easy_setopt(hnd, CURLOPT_MAXREDIRS, 50L);
+	curl_easy_setopt(hnd, CURLOPT_HTTP_VERSION, (long) CURL_HTTP_VERSION_2_0);
+	curl_easy_setopt(hnd, CURLOPT_CUSTOMREQUEST, "POST");
+	curl_easy_setopt(hnd, CURLOPT_FTP_SKIP_PASV_IP, 1L);
+	curl_easy_setopt(hnd, CURLOPT_TCP_KEEPALIVE, 1L);
+	curl_easy_setopt(hnd, CURLOPT_WRITEFUNCTION, _discard);
+	CURLcode res = curl_easy_perform(hnd);
+	curl_easy_cleanup(hnd);
+	return res == CURLE_OK ? 0 : -1;
+}
+
+static void _run(const char *name, int seconds, uploader_t *uploader) {
+	static const char *names[4] = { "temp", "rh", "lux", "eco2" };
+	unsigned long points = 0, errors = 0;
+	unsigned long lines0 = atomic_load(&received_lines), accepted0 = atomic_load(&accepted);
+	char data[100];
+
+	clockid_t worker_clock = CLOCK_THREAD_CPUTIME_ID;
+	if (uploader)
+		pthread_getcpuclockid(uploader->worker, &worker_clock);
+
+	double t0 = _now_s(CLOCK_MONOTONIC), cpu0 = _now_s(CLOCK_THREAD_CPUTIME_ID), worker0 = uploader ? _now_s(worker_clock) : 0, end = t0 + seconds;
+	while (_now_s(CLOCK_MONOTONIC) < end) {
+		for (int r = 0; r < ROOMS; r++) {
+			for (int i = 0; i < 4; i++) {
+				sprintf(data, "%s,room=%d value=%f", names[i], 101 + r, 20.0 + (points % 97) / 10.0);
+				if (uploader)
+					while (uploader_queued(uploader) >= UPLOADER_QUEUE_LINES - 1)
+						usleep(10);
+				if (uploader ? uploader_write(uploader, data) : _write_per_line(data))
+					errors++;
+				points++;
+			}
+		}
+	}
+	if (uploader)
+		errors += uploader_flush(uploader) != 0;
+	double wall = _now_s(CLOCK_MONOTONIC) - t0, cpu = _now_s(CLOCK_THREAD_CPUTIME_ID) - cpu0;
+	if (uploader)
+		cpu += _now_s(worker_clock) - worker0;
+
+	usleep(100000); // the server counts the last body
+	printf("%-11s %9.0f points/s  %7.2f us cpu/point  %7lu posts  %5lu connections  %lu of %lu points received, %lu errors\n", name, points / wall, cpu * 1e6 / points,
+			uploader ? uploader->posts : points, atomic_load(&accepted) - accepted0, atomic_load(&received_lines) - lines0, points, errors);
+}
+
+int main(int argc, char **argv) {
+	int seconds = argc > 1 ? atoi(argv[1]) : 5;
+	unsigned int max_lines = argc > 2 ? atoi(argv[2]) : UPLOADER_BATCH_LINES;
+
+	int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+	struct sockaddr_in addr = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK), .sin_port = 0 };
+	socklen_t addr_len = sizeof(addr);
+	bind(listen_fd, (struct sockaddr*) &addr, sizeof(addr));
+	listen(listen_fd, 64);
+	getsockname(listen_fd, (struct sockaddr*) &addr, &addr_len);
+	sprintf(url, "http://127.0.0.1:%d/write?db=db0", ntohs(addr.sin_port));
+
+	pthread_t th;
+	pthread_create(&th, NULL, _server, (void*) (intptr_t) listen_fd);
+
+	printf("%d s per run, rounds of %d rooms x 4 channels to %s\n", seconds, ROOMS, url);
+
+	curl_global_init(CURL_GLOBAL_ALL);
+	_run("per line", seconds, NULL);
+
+	uploader_t *uploader = uploader_new(url);
+	uploader_set_batch(uploader, 1, UPLOADER_MAX_DELAY_MS);
+	_run("keep-alive", seconds, uploader);
+	uploader_destroy(uploader);
+
+	uploader = uploader_new(url);
+	uploader_set_batch(uploader, max_lines, UPLOADER_MAX_DELAY_MS);
+	_run("batched", seconds, uploader);
+	uploader_destroy(uploader);
+
+	return 0;
+}
@@ -0,0 +1,246 @@
+/*
+ * bench_upload_async.c
+ *
+ * What a slow InfluxDB does to the main loop. A loop standing in for the measurement FSMs writes
+ * the lines of 8 gateway rooms, 4 channels each, every millisecond to a local stand-in of the
+ * /write endpoint that stalls every answer for stall_ms during the middle third of the run:
+ *   inline      the uploader of before: the loop posts the batch itself when it is due
+ *   drop oldest the uploader: the loop only enqueues, a full queue gives up its oldest lines
+ *   spill       the uploader: the lines that do not fit in the queue go to its spool, posted
+ *               by the worker once the stand-in answers again
+ * For each one the longest loop iteration, the time per write, the latency of the posts, and the
+ * lines received, evicted and spilled.
+ *
+ * gcc -O2 src/bench/bench_upload_async.c src/libs/uploadlib.c src/libs/spoollib.c src/libs/tsdblib.c src/libs/arenalib.c src/libs/spscring.c src/libs/flaglib.c -lpthread -lcurl -lz -o bench_upload_async
+ * ./bench_upload_async [seconds] [stall_ms]
+ *
+ *  Created on: 17 oct. 2026
+ *      Author: Victoria M. Gullon and Marcos Gomez
+ */
+
+#define _GNU_SOURCE // memmem, strcasestr
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <curl/curl.h>
+
+#include "../libs/uploadlib.h"
+
+#define ROOMS 8
+#define BATCH_LINES 1000
+#define SPOOL_DIR "/tmp/bench_upload_async.spool"
+
+static atomic_ulong received_lines;
+static atomic_int stall_ms;
+static char url[64];
+
+static double _now_s(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* stand-in server, answers 204 after stall_ms */
+
+static void* _connection(void *arg) {
+	int fd = (int) (intptr_t) arg;
+	size_t size = UPLOADER_BATCH_BYTES + 4096, len = 0;
+	char *buf = (char*) malloc(size);
+
+	while (1) {
+		char *end = NULL;
+		while (!(end = memmem(buf, len, "\r\n\r\n", 4))) {
+			ssize_t n = read(fd, buf + len, size - len);
+			if (n <= 0) {
+				close(fd);
+				free(buf);
+				return NULL;
+			}
+			len += n;
+		}
+
+		size_t header = end + 4 - buf, body = 0;
+		char *cl = strcasestr(buf, "Content-Length:");
+		if (cl && cl < end)
+			body = strtoul(cl + 15, NULL, 10);
+		char *expect = strcasestr(buf, "Expect: 100-continue");
+		if (expect && expect < end)
+			write(fd, "HTTP/1.1 100 Continue\r\n\r\n", 25);
+
+		while (len < header + body) {
+			ssize_t n = read(fd, buf + len, size - len);
+			if (n <= 0) {
+				close(fd);
+				free(buf);
+				return NULL;
+			}
+			len += n;
+		}
+
+		unsigned long lines = 0;
+		for (size_t i = header; i < header + body; i++)
+			lines += buf[i] == '\n';
+
+		int stall = atomic_load(&stall_ms);
+		if (stall)
+			usleep(stall * 1000);
+		atomic_fetch_add(&received_lines, lines);
+
+		const char *resp = "HTTP/1.1 204 No Content\r\nContent-Length: 0\r\n\r\n";
+		write(fd, resp, strlen(resp));
+
+		memmove(buf, buf + header + body, len - header - body);
+		len -= header + body;
+	}
+}
+
+static void* _server(void *arg) {
+	int listen_fd = (int) (intptr_t) arg;
+
+	while (1) {
+		int fd = accept(listen_fd, NULL, NULL);
+		if (fd < 0)
+			continue;
+
+		pthread_t th;
+		pthread_create(&th, NULL, _connection, (void*) (intptr_t) fd);
+		pthread_detach(th);
+	}
+	return NULL;
+}
+
+/* inline uploads, as the uploader did them before */
+
+static size_t _discard(char *data, size_t size, size_t n, void *user_data) {
+	return size * n;
+}
+
+static CURL *inline_hnd;
+static char inline_batch[UPLOADER_BATCH_BYTES];
+static size_t inline_len;
+static unsigned int inline_lines;
+static double inline_since, inline_post_max;
+
+static void _inline_post(void) {
+	double t0 = _now_s();
+	curl_easy_setopt(inline_hnd, CURLOPT_POSTFIELDS, inline_batch);
+	curl_easy_setopt(inline_hnd, CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t) inline_len);
+	curl_easy_perform(inline_hnd);
+	if (_now_s() - t0 > inline_post_max)
+		inline_post_max = _now_s() - t0;
+	inline_len = 0;
+	inline_lines = 0;
+}
+
+static void _inline_write(const char *line) {
+	size_t len = strlen(line);
+	if (inline_len + len + 1 > UPLOADER_BATCH_BYTES)
+		_inline_post();
+	if (inline_lines == 0)
+		inline_since = _now_s();
+	memcpy(inline_batch + inline_len, line, len);
+	inline_batch[inline_len + len] = '\n';
+	inline_len += len + 1;
+	if (++inline_lines >= BATCH_LINES || _now_s() - inline_since >= 0.1)
+		_inline_post();
+}
+
+/* runs */
+
+static void _run(const char *name, int seconds, int stall, uploader_t *uploader) {
+	static const char *names[4] = { "temp", "rh", "lux", "eco2" };
+	unsigned long points = 0, lines0 = atomic_load(&received_lines);
+	double worst = 0, write_s = 0;
+	char data[100];
+
+	double t0 = _now_s(), next = t0;
+	for (int tick = 0; _now_s() < t0 + seconds; tick++) {
+		double elapsed = _now_s() - t0;
+		atomic_store(&stall_ms, elapsed > seconds / 3.0 && elapsed < 2 * seconds / 3.0 ? stall : 0);
+
+		double start = _now_s();
+		for (int r = 0; r < ROOMS; r++) {
+			for (int i = 0; i < 4; i++) {
+				sprintf(data, "%s,room=%d value=%f", names[i], 101 + r, 20.0 + (points % 97) / 10.0);
+				if (uploader)
+					uploader_write(uploader, data);
+				else
+					_inline_write(data);
+				points++;
+			}
+		}
+		double took = _now_s() - start;
+		write_s += took;
+		if (took > worst)
+			worst = took;
+
+		next += 0.001;
+		if (next > _now_s())
+			usleep((next - _now_s()) * 1e6);
+	}
+	atomic_store(&stall_ms, 0);
+
+	if (uploader) {
+		uploader_flush(uploader);
+		usleep(100000); // the server counts the last body
+		printf("%-11s loop max %8.3f ms  write avg %6.0f ns  post max %6llu ms  %lu of %lu lines received  %lu evicted  %lu spilled\n", name, worst * 1e3,
+				write_s * 1e9 / points, uploader->post_max_ns / 1000000, atomic_load(&received_lines) - lines0, points, uploader->queue->evicted, uploader->spilled);
+	} else {
+		_inline_post();
+		usleep(100000);
+		printf("%-11s loop max %8.3f ms  write avg %6.0f ns  post max %6.0f ms  %lu of %lu lines received\n", name, worst * 1e3, write_s * 1e9 / points,
+				inline_post_max * 1e3, atomic_load(&received_lines) - lines0, points);
+	}
+}
+
+int main(int argc, char **argv) {
+	int seconds = argc > 1 ? atoi(argv[1]) : 6;
+	int stall = argc > 2 ? atoi(argv[2]) : 1000;
+
+	int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+	struct sockaddr_in addr = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK), .sin_port = 0 };
+	socklen_t addr_len = sizeof(addr);
+	bind(listen_fd, (struct sockaddr*) &addr, sizeof(addr));
+	listen(listen_fd, 64);
+	getsockname(listen_fd, (struct sockaddr*) &addr, &addr_len);
+	sprintf(url, "http://127.0.0.1:%d/write?db=db0", ntohs(addr.sin_port));
+
+	pthread_t th;
+	pthread_create(&th, NULL, _server, (void*) (intptr_t) listen_fd);
+
+	printf("%d s per run, %d lines every ms, posts stalled %d ms in the middle third, queue of %d lines\n", seconds, ROOMS * 4, stall, UPLOADER_QUEUE_LINES);
+
+	curl_global_init(CURL_GLOBAL_ALL);
+	inline_hnd = curl_easy_init();
+	curl_easy_setopt(inline_hnd, CURLOPT_URL, url);
+	curl_easy_setopt(inline_hnd, CURLOPT_POST, 1L);
+	curl_easy_setopt(inline_hnd, CURLOPT_HTTP_VERSION, (long) CURL_HTTP_VERSION_1_1);
+	curl_easy_setopt(inline_hnd, CURLOPT_WRITEFUNCTION, _discard);
+	_run("inline", seconds, stall, NULL);
+	curl_easy_cleanup(inline_hnd);
+
+	uploader_t *uploader = uploader_new(url);
+	uploader_set_batch(uploader, BATCH_LINES, 100);
+	_run("drop oldest", seconds, stall, uploader);
+	uploader_destroy(uploader);
+
+	system("rm -rf " SPOOL_DIR);
+	uploader = uploader_new(url);
+	uploader_set_batch(uploader, BATCH_LINES, 100);
+	uploader_set_spool(uploader, SPOOL_DIR, SPOOL_DEFAULT_MAX_BYTES, 0);
+	uploader_set_overflow(uploader, UPLOADER_SPILL);
+	_run("spill", seconds, stall, uploader);
+	uploader_destroy(uploader);
+	system("rm -rf " SPOOL_DIR);
+
+	return 0;
+}
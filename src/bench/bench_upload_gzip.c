@@ -0,0 +1,223 @@
+/*
+ * bench_upload_gzip.c
+ *
+ * Gzipped upload bodies against a local stand-in of the /write endpoint that inflates them, checks
+ * their lines and, to play a slow uplink, holds each body for the time its bytes take at
+ * link_kbps. The points are the roompi points of 8 gateway rooms, one every 5 s per room with
+ * values drifting like a room does, as lineproto_encode writes them. Each run posts the same
+ * points, with the queue held back when it is full:
+ *   raw          the bodies as they are, batches of UPLOADER_BATCH_BYTES
+ *   gzip <level> gzipped at that level, batches of UPLOADER_BATCH_BYTES
+ *   gzip 1 <N>K  gzipped at level 1, batches sized for N KB on the wire
+ * For each run: the bodies posted, their average size before and after compression, the ratio,
+ * the CPU time of deflate and of the whole worker per body, and the points per second the link
+ * lets through.
+ *
+ * gcc -O2 src/bench/bench_upload_gzip.c src/libs/uploadlib.c src/libs/lineprotolib.c src/libs/spoollib.c src/libs/tsdblib.c src/libs/arenalib.c src/libs/spscring.c src/libs/flaglib.c -lpthread -lcurl -lz -o bench_upload_gzip
+ * ./bench_upload_gzip [points] [link_kbps]     (link_kbps 0: no link delay)
+ *
+ *  Created on: 17 oct. 2026
+ *      Author: Victoria M. Gullon and Marcos Gomez
+ */
+
+#define _GNU_SOURCE // memmem, strcasestr
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <zlib.h>
+
+#include "../libs/uploadlib.h"
+#include "../libs/lineprotolib.h"
+
+#define ROOMS 8
+
+static atomic_ulong received_lines, received_bytes, bad_bodies;
+static unsigned int link_kbps;
+static char url[64];
+
+static double _now_s(clockid_t clock) {
+	struct timespec ts;
+	clock_gettime(clock, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* stand-in server */
+
+static void* _connection(void *arg) {
+	int fd = (int) (intptr_t) arg;
+	size_t size = UPLOADER_BATCH_BYTES + 4096, len = 0;
+	char *buf = (char*) malloc(size), *raw = (char*) malloc(UPLOADER_BATCH_BYTES);
+	z_stream z = { 0 };
+	inflateInit2(&z, 16 + MAX_WBITS);
+
+	while (1) {
+		char *end = NULL;
+		while (!(end = memmem(buf, len, "\r\n\r\n", 4))) {
+			ssize_t n = read(fd, buf + len, size - len);
+			if (n <= 0)
+				goto closed;
+			len += n;
+		}
+
+		size_t header = end + 4 - buf, body = 0;
+		char *cl = strcasestr(buf, "Content-Length:");
+		if (cl && cl < end)
+			body = strtoul(cl + 15, NULL, 10);
+		char *ce = strcasestr(buf, "Content-Encoding: gzip");
+		int gzipped = ce && ce < end;
+		char *expect = strcasestr(buf, "Expect: 100-continue");
+		if (expect && expect < end)
+			write(fd, "HTTP/1.1 100 Continue\r\n\r\n", 25);
+
+		while (len < header + body) {
+			ssize_t n = read(fd, buf + len, size - len);
+			if (n <= 0)
+				goto closed;
+			len += n;
+		}
+
+		// the link: the body took this long to come
+		if (link_kbps)
+			usleep(body * 8000ULL / link_kbps);
+
+		const char *lines = buf + header;
+		size_t lines_len = body;
+		if (gzipped) {
+			inflateReset(&z);
+			z.next_in = (Bytef*) buf + header;
+			z.avail_in = body;
+			z.next_out = (Bytef*) raw;
+			z.avail_out = UPLOADER_BATCH_BYTES;
+			if (inflate(&z, Z_FINISH) != Z_STREAM_END)
+				atomic_fetch_add(&bad_bodies, 1);
+			lines = raw;
+			lines_len = UPLOADER_BATCH_BYTES - z.avail_out;
+		}
+
+		unsigned long n_lines = 0;
+		for (size_t i = 0; i < lines_len; i++)
+			n_lines += lines[i] == '\n';
+		if (lines_len == 0 || lines[lines_len - 1] != '\n' || memcmp(lines, "roompi,room=", 12) != 0)
+			atomic_fetch_add(&bad_bodies, 1);
+		atomic_fetch_add(&received_lines, n_lines);
+		atomic_fetch_add(&received_bytes, lines_len);
+
+		const char *resp = "HTTP/1.1 204 No Content\r\nContent-Length: 0\r\n\r\n";
+		write(fd, resp, strlen(resp));
+
+		memmove(buf, buf + header + body, len - header - body);
+		len -= header + body;
+	}
+
+closed:
+	inflateEnd(&z);
+	close(fd);
+	free(buf);
+	free(raw);
+	return NULL;
+}
+
+static void* _server(void *arg) {
+	int listen_fd = (int) (intptr_t) arg;
+
+	while (1) {
+		int fd = accept(listen_fd, NULL, NULL);
+		if (fd < 0)
+			continue;
+
+		pthread_t th;
+		pthread_create(&th, NULL, _connection, (void*) (intptr_t) fd);
+		pthread_detach(th);
+	}
+	return NULL;
+}
+
+/* runs */
+
+static void _run(const char *name, unsigned long points, int level, size_t target_bytes) {
+	unsigned long lines0 = atomic_load(&received_lines), bytes0 = atomic_load(&received_bytes), bad0 = atomic_load(&bad_bodies);
+	double temp[ROOMS], rh[ROOMS], lux[ROOMS], eco2[ROOMS];
+	int64_t ts_ns = 1792238400000000000LL;
+	char data[UPLOADER_LINE_LEN];
+
+	uploader_t *uploader = uploader_new(url);
+	uploader_set_compression(uploader, level, target_bytes);
+
+	srand(1);
+	for (int r = 0; r < ROOMS; r++) {
+		temp[r] = 21, rh[r] = 45, lux[r] = 400, eco2[r] = 600;
+	}
+
+	clockid_t worker_clock;
+	pthread_getcpuclockid(uploader->worker, &worker_clock);
+	double t0 = _now_s(CLOCK_MONOTONIC), worker0 = _now_s(worker_clock);
+
+	for (unsigned long n = 0; n < points; ts_ns += 5000000000LL) {
+		for (int r = 0; r < ROOMS && n < points; r++, n++) {
+			temp[r] += (rand() % 21 - 10) / 200.0;
+			rh[r] += (rand() % 21 - 10) / 100.0;
+			lux[r] += rand() % 21 - 10;
+			eco2[r] += rand() % 11 - 5;
+			lineproto_field_t fields[4] = { { "temp", LINEPROTO_FLOAT, { .f = (float) temp[r] } }, { "rh", LINEPROTO_FLOAT, { .f = (float) rh[r] } }, { "lux",
+					LINEPROTO_INT, { .i = (int64_t) lux[r] } }, { "eco2", LINEPROTO_INT, { .i = (int64_t) eco2[r] } } };
+			lineproto_encode(data, sizeof(data), "roompi", "room", 101 + r, fields, 4, ts_ns + r * 1000003LL);
+
+			while (uploader_queued(uploader) >= UPLOADER_QUEUE_LINES - 1)
+				usleep(10);
+			uploader_write(uploader, data);
+		}
+	}
+	uploader_flush(uploader);
+	double wall = _now_s(CLOCK_MONOTONIC) - t0, worker = _now_s(worker_clock) - worker0;
+
+	usleep(100000); // the server counts the last body
+	unsigned long posts = uploader->posts ? uploader->posts : 1;
+	printf("%-13s %5lu bodies  %5.1f KB raw  %5.1f KB wire  ratio %5.2f  deflate %6.0f us (max %6.0f)  worker %6.0f us/body  %8.0f points/s  %lu of %lu points received%s\n",
+			name, uploader->posts, uploader->bytes / 1024.0 / posts, uploader->wire_bytes / 1024.0 / posts, (double) uploader->bytes / uploader->wire_bytes,
+			uploader->compressed ? uploader->compress_sum_ns / 1e3 / uploader->compressed : 0.0, uploader->compress_max_ns / 1e3, worker * 1e6 / posts, points / wall,
+			atomic_load(&received_lines) - lines0, points,
+			atomic_load(&bad_bodies) != bad0 || atomic_load(&received_bytes) - bytes0 != uploader->bytes ? ", BAD BODIES" : "");
+	uploader_destroy(uploader);
+}
+
+int main(int argc, char **argv) {
+	unsigned long points = argc > 1 ? strtoul(argv[1], NULL, 10) : 200000;
+	link_kbps = argc > 2 ? atoi(argv[2]) : 0;
+	char name[32];
+
+	int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+	struct sockaddr_in addr = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK), .sin_port = 0 };
+	socklen_t addr_len = sizeof(addr);
+	bind(listen_fd, (struct sockaddr*) &addr, sizeof(addr));
+	listen(listen_fd, 64);
+	getsockname(listen_fd, (struct sockaddr*) &addr, &addr_len);
+	sprintf(url, "http://127.0.0.1:%d/write?db=db0", ntohs(addr.sin_port));
+
+	pthread_t th;
+	pthread_create(&th, NULL, _server, (void*) (intptr_t) listen_fd);
+
+	printf("%lu points of %d rooms per run", points, ROOMS);
+	if (link_kbps)
+		printf(", a %u kbit/s link", link_kbps);
+	printf("\n");
+
+	_run("raw", points, 0, 0);
+	for (int level = 1; level <= 9; level += level == 1 ? 5 : 3) {
+		sprintf(name, "gzip %d", level);
+		_run(name, points, level, 0);
+	}
+	sprintf(name, "gzip 1 %dK", UPLOADER_TARGET_BYTES / 1024);
+	_run(name, points, 1, UPLOADER_TARGET_BYTES);
+	_run("gzip 1 4K", points, 1, 4096);
+
+	return 0;
+}
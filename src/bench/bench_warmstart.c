@@ -0,0 +1,143 @@
+/*
+ * bench_warmstart.c
+ *
+ * Time to the first valid processed values of a room after a start, cold and warm. The cold run
+ * starts with an empty state file: the real measurement FSM and timer run on a reactor while a
+ * thread publishes a sample of every channel each period, until every sensor_values entry is
+ * valid (the display shows "Calibrando..." until then). The room is then dropped without closing
+ * anything, as a crash would, and a new one is opened on the same state file. Then the newest
+ * commit page and one sample record are corrupted: the previous commit gives the values, and the
+ * newest valid records the windows. The LCD shows the
+ * values on its next info step (output_t_ms) in both cases.
+ *
+ * gcc -O2 src/bench/bench_warmstart.c src/sensors/dht11.c src/sensors/bh1750.c src/sensors/ccs811.c src/actuators/lcd1602.c
+ *     src/actuators/buzzer.c src/actuators/statusLed.c src/libs/fsm.c src/libs/timerlib.c src/libs/reactorlib.c
+ *     src/libs/systemlib.c src/libs/systemtype.c src/libs/samplering.c src/libs/windowstats.c src/libs/orderstats.c src/libs/tsdblib.c src/libs/rolluplib.c src/libs/statelib.c src/libs/deadbandlib.c src/libs/spscring.c src/libs/flaglib.c src/libs/uploadlib.c src/libs/lineprotolib.c src/libs/spoollib.c src/libs/arenalib.c src/libs/metricslib.c
+ *     src/controllers/measurementctrl.c src/controllers/outputctrl.c -lpthread -lrt -lwiringPi -lcurl -lz -o bench_warmstart
+ * ./bench_warmstart [meas_ms] [period_ms]     (./bench_warmstart 60000 5000 for the default roompi.conf)
+ *
+ *  Created on: 17 oct. 2026
+ *      Author: Victoria M. Gullon and Marcos Gomez
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../libs/systemtype.h"
+
+#define STATE_PATH "/tmp/bench_warmstart.state"
+
+int buzzer_disabled = 0;
+float temp_crit_low = 10, temp_crit_high = 35, temp_warn_low = 17, temp_warn_high = 27, rh_crit_low = 20, rh_crit_high = 80, rh_warn_low = 30, rh_warn_high = 70;
+int lux_crit = 100, lux_warn = 300, eco2_crit = 2000, eco2_warn = 1000;
+
+static SystemContext *room;
+static volatile int producing;
+static int period_ms;
+
+static double _now_s(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int _values_valid(SystemContext *ctx) {
+	for (int i = 0; i < 4; i++) {
+		if (ctx->sensor_values[i].type == is_error)
+			return 0;
+	}
+	return 1;
+}
+
+// stands in for the sensor FSMs of the acquisition thread
+static void* _acquisition(void *arg) {
+	for (int n = 0; producing; n++) {
+		SensorValueType temp = { .type = is_float, .val.fval = 20.0 + n % 5 };
+		SensorValueType humid = { .type = is_float, .val.fval = 45.0 + n % 7 };
+		SensorValueType lux = { .type = is_int, .val.ival = 400 + n % 50 };
+		SensorValueType eco2 = { .type = is_int, .val.ival = 600 + n % 80 };
+
+		SystemContext__publish_sample(room, SENSOR_QUEUE_TEMP_HUMID, 0, temp);
+		SystemContext__publish_sample(room, SENSOR_QUEUE_TEMP_HUMID, 1, humid);
+		SystemContext__publish_sample(room, SENSOR_QUEUE_LIGHT, 2, lux);
+		SystemContext__publish_sample(room, SENSOR_QUEUE_CO2, 3, eco2);
+		usleep(period_ms * 1000);
+	}
+	return NULL;
+}
+
+static double _warm_start(SensorValueType *values, int *restored) {
+	double t0 = _now_s();
+	SystemContext *ctx = SystemContext__create(1, NULL, NULL, NULL, NULL, NULL, NULL);
+	*restored = SystemContext__open_state(ctx, STATE_PATH);
+	double t = _now_s() - t0;
+
+	memcpy(values, ctx->sensor_values, sizeof(ctx->sensor_values));
+	if (!_values_valid(ctx))
+		t = -1;
+	SystemContext__destroy(ctx);
+	return t;
+}
+
+int main(int argc, char **argv) {
+	int meas_ms = argc > 1 ? atoi(argv[1]) : 10000;
+	period_ms = argc > 2 ? atoi(argv[2]) : 1000;
+
+	printf("processing every %d ms, a sample of every channel every %d ms, window %d\n", meas_ms, period_ms, SENSOR_WINDOW_LEN);
+	unlink(STATE_PATH);
+
+	// cold
+	double t0 = _now_s();
+	room = SystemContext__create(1, NULL, NULL, NULL, NULL, NULL, NULL);
+	SystemContext__open_state(room, STATE_PATH);
+	reactor_t *reactor = reactor_new();
+	SystemType *system = SystemType__setup(room, MeasurementCtrl__setup(room), NULL);
+	SystemType__attach(system, reactor, NULL, NULL);
+	tmr_startms(system->root_measurement_ctrl->timer, meas_ms);
+
+	pthread_t th;
+	producing = 1;
+	pthread_create(&th, NULL, _acquisition, NULL);
+
+	while (!_values_valid(room))
+		reactor_run_once(reactor, 100);
+	double cold_s = _now_s() - t0;
+
+	// one more round, so that there is an older commit to fall back to
+	while (room->state->commits < 2)
+		reactor_run_once(reactor, 100);
+	SensorValueType committed[4];
+	memcpy(committed, room->sensor_values, sizeof(committed));
+	producing = 0;
+	pthread_join(th, NULL);
+	tmr_stop(system->root_measurement_ctrl->timer);
+	reactor_destroy(reactor);
+	printf("cold start   first valid values after %10.3f ms  (%lu commits)\n", cold_s * 1e3, room->state->commits);
+	room->state = NULL; // crash: nothing is closed or synced, the mapping is left as it is
+
+	// warm
+	SensorValueType values[4];
+	int restored;
+	double warm_s = _warm_start(values, &restored);
+	int same = memcmp(values, committed, sizeof(values)) == 0;
+	printf("warm start   first valid values after %10.3f ms  (%d samples restored, values %s)\n", warm_s * 1e3, restored, same ? "as committed" : "DIFFERENT");
+
+	// torn newest commit and sample record
+	state_file_t *state = state_open(STATE_PATH, 4, (unsigned int[]) { SENSOR_WINDOW_LEN, SENSOR_WINDOW_LEN, SENSOR_WINDOW_LEN, SENSOR_WINDOW_LEN });
+	uint64_t sequence = state->current.sequence;
+	state->map[(sequence % 2) * STATE_PAGE + 20] ^= 0xff;
+	state->rings[0][0].ts_ms ^= 1; // and a torn sample record
+	state_close(state);
+	double fallback_s = _warm_start(values, &restored);
+	state = state_open(STATE_PATH, 4, (unsigned int[]) { SENSOR_WINDOW_LEN, SENSOR_WINDOW_LEN, SENSOR_WINDOW_LEN, SENSOR_WINDOW_LEN });
+	printf("torn commit  first valid values after %10.3f ms  (%d samples restored, commit %llu of %llu)\n", fallback_s * 1e3, restored,
+			(unsigned long long) state->current.sequence, (unsigned long long) sequence);
+	state_close(state);
+
+	unlink(STATE_PATH);
+	return !same || warm_s < 0 || fallback_s < 0;
+}
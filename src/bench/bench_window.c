@@ -0,0 +1,131 @@
+/*
+ * bench_window.c
+ *
+ * Cost of a processing round against the window length. "rescan" is the previous processing:
+ * find the highest and lowest samples of the window and average the rest, one pass each per
+ * round. "stream" keeps the window statistics up to date on every push and only reads them.
+ * One round every round_every samples, noisy samples with a failed reading now and then; both
+ * results are compared on every round.
+ *
+ * gcc -O2 src/bench/bench_window.c src/libs/samplering.c src/libs/windowstats.c src/libs/orderstats.c src/libs/arenalib.c -lm -o bench_window
+ * ./bench_window [samples] [round_every]
+ *
+ *  Created on: 17 oct. 2026
+ *      Author: Victoria M. Gullon and Marcos Gomez
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+
+#include "../libs/samplering.h"
+#include "../libs/windowstats.h"
+
+static double _now_s(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// previous processing over the last len samples, in place
+static int _rescan_trimmed_mean(sample_ring_t *ring, unsigned int len, double *mean) {
+	sample_span_t span;
+	const SensorSampleType *h = NULL, *l = NULL;
+
+	sample_ring_window(ring, len, &span);
+	for (int part = 0; part < 2; part++) {
+		for (const SensorSampleType *s = span.data[part]; s < span.data[part] + span.len[part]; s++) {
+			if (s->value.type == is_error)
+				continue;
+			if (!h || s->value.val.fval > h->value.val.fval)
+				h = s;
+			if (!l || s->value.val.fval < l->value.val.fval)
+				l = s;
+		}
+	}
+
+	double sum = 0;
+	int n = 0;
+	for (int part = 0; part < 2; part++) {
+		for (const SensorSampleType *s = span.data[part]; s < span.data[part] + span.len[part]; s++) {
+			if (s != h && s != l && s->value.type != is_error) {
+				sum += s->value.val.fval;
+				n++;
+			}
+		}
+	}
+	if (n == 0)
+		return -1;
+	*mean = sum / n;
+	return 0;
+}
+
+static SensorSampleType _sample(long i) {
+	SensorSampleType s = { .timestamp_ns = i, .channel = 0 };
+	if (rand() % 50 == 0) {
+		s.value.type = is_error;
+	} else {
+		s.value.type = is_float;
+		s.value.val.fval = 21.0 + (rand() % 1000) / 100.0;
+	}
+	return s;
+}
+
+static void _bench(unsigned int len, const SensorSampleType *samples, long n_samples, int round_every) {
+	sample_ring_t *ring_rescan = sample_ring_new(len), *ring_stream = sample_ring_new(len);
+	window_stats_t *stats = window_stats_new(ring_stream, len);
+	long rounds = n_samples / round_every;
+	double *res_rescan = (double*) malloc(rounds * sizeof(double)), *res_stream = (double*) malloc(rounds * sizeof(double));
+
+	double t0 = _now_s();
+	for (long r = 0; r < rounds; r++) {
+		for (int j = 0; j < round_every; j++)
+			sample_ring_push(ring_rescan, &samples[r * round_every + j]);
+		if (_rescan_trimmed_mean(ring_rescan, len, &res_rescan[r]) < 0)
+			res_rescan[r] = NAN;
+	}
+	double t_rescan = _now_s() - t0;
+
+	t0 = _now_s();
+	for (long r = 0; r < rounds; r++) {
+		for (int j = 0; j < round_every; j++)
+			window_stats_push(stats, &samples[r * round_every + j]);
+		if (window_stats_trimmed_mean(stats, &res_stream[r]) < 0)
+			res_stream[r] = NAN;
+	}
+	double t_stream = _now_s() - t0;
+
+	double max_diff = 0;
+	for (long r = 0; r < rounds; r++) {
+		if (!isnan(res_rescan[r]) && !isnan(res_stream[r]) && fabs(res_rescan[r] - res_stream[r]) > max_diff)
+			max_diff = fabs(res_rescan[r] - res_stream[r]);
+	}
+
+	printf("window %5u  rescan %9.1f ns/round   stream %7.1f ns/round   x%7.1f   max diff %.2e\n", len, t_rescan * 1e9 / rounds, t_stream * 1e9 / rounds,
+			t_rescan / t_stream, max_diff);
+
+	free(res_rescan);
+	free(res_stream);
+	window_stats_destroy(stats);
+	sample_ring_destroy(ring_rescan);
+	sample_ring_destroy(ring_stream);
+}
+
+int main(int argc, char **argv) {
+	long n_samples = argc > 1 ? atol(argv[1]) : 2000000;
+	int round_every = argc > 2 ? atoi(argv[2]) : 6;
+
+	SensorSampleType *samples = (SensorSampleType*) malloc(n_samples * sizeof(SensorSampleType));
+	for (long i = 0; i < n_samples; i++)
+		samples[i] = _sample(i);
+
+	printf("%ld samples, one processing round (pushes included) every %d samples\n", n_samples, round_every);
+
+	unsigned int windows[] = { 5, 60, 600, 3600 };
+	for (int i = 0; i < sizeof(windows) / sizeof(windows[0]); i++)
+		_bench(windows[i], samples, n_samples, round_every);
+
+	free(samples);
+	return 0;
+}
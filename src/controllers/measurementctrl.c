@@ -7,16 +7,17 @@
 
 #include <stdlib.h>
 #include <wiringPi.h>
-#include <curl/curl.h>
 #include <string.h>
+#include <stdio.h>
+#include <math.h> // NAN
 
 #include "measurementctrl.h"
 #include "../libs/threadlib.h"
 #include "../libs/timerlib.h"
 #include "../libs/systemlib.h"
 #include "../libs/fsm.h"
-
-extern int measurement_flags;
+#include "../libs/arenalib.h"
+#include "../libs/lineprotolib.h"
 
 // Timer
 static void _measurement_timer_isr(union sigval value);
@@ -40,9 +41,10 @@ static fsm_trans_t _measurement_fsm_tt[] = { { MEASUREMENT_PROCESS, _measurement
 		DB_UPDATE, _measurement_do_alerts }, { DB_UPDATE, _measurement_alerts_finished, MEASUREMENT_PROCESS, _measurement_do_database_update }, { -1, NULL, -1, NULL } };
 
 MeasurementCtrl* MeasurementCtrl__setup(SystemContext *this_system) {
-	MeasurementCtrl *result = (MeasurementCtrl*) malloc(sizeof(MeasurementCtrl));
+	MeasurementCtrl *result = (MeasurementCtrl*) arena_malloc(sizeof(MeasurementCtrl));
 	tmr_t *measurement_timer = tmr_new(_measurement_timer_isr); // creado pero no iniciado
 	result->timer = measurement_timer;
+	result->timer->user_data = this_system;
 
 	result->fsm = (fsm_t*) fsm_new(MEASUREMENT_PROCESS, _measurement_fsm_tt, this_system);
 	return result;
@@ -53,296 +55,291 @@ void MeasurementCtrl__destroy(MeasurementCtrl *this) {
 		fsm_destroy(this->fsm);
 		tmr_destroy(this->timer);
 
-		free(this);
+		arena_free(this);
+	}
+}
+
+// Values, alerts and counters of the rooms in the Prometheus text format, one family after the other. Any thread: each room as its
+// last processing round left it
+void MeasurementCtrl__render_metrics(SystemContext **systems, int n_systems, metrics_writer_t *w) {
+	static const char *channels[4] = { "temp", "rh", "lux", "eco2" };
+	static const char *sensors[3] = { "dht11", "bh1750", "ccs811" };
+	static const struct {
+		unsigned int flag;
+		const char *name;
+	} alerts[8] = { { FLAG_TEMP_ANOMALY, "temp_anomaly" }, { FLAG_HUMID_ANOMALY, "humid_anomaly" }, { FLAG_LIGHT_ANOMALY, "light_anomaly" }, { FLAG_CO2_ANOMALY,
+			"co2_anomaly" }, { FLAG_TEMP_EMERGENCY, "temp_emergency" }, { FLAG_HUMID_EMERGENCY, "humid_emergency" }, { FLAG_LIGHT_EMERGENCY, "light_emergency" }, {
+			FLAG_CO2_EMERGENCY, "co2_emergency" } };
+	SystemSnapshot rooms[n_systems];
+	char labels[64];
+
+	for (int r = 0; r < n_systems; r++)
+		SystemContext__read_snapshot(systems[r], &rooms[r]);
+
+	metrics_family(w, "roompi_sensor_value", "gauge", "Processed value of the last round, NaN while the channel fails");
+	for (int r = 0; r < n_systems; r++) {
+		for (int i = 0; i < 4; i++) {
+			SensorValueType value = rooms[r].values[i];
+			snprintf(labels, sizeof(labels), "room=\"%d\",channel=\"%s\"", systems[r]->id_classroom, channels[i]);
+			metrics_sample(w, "roompi_sensor_value", labels, value.type == is_float ? value.val.fval : value.type == is_int ? value.val.ival : NAN);
+		}
+	}
+
+	metrics_family(w, "roompi_sensor_timestamp_seconds", "gauge", "Wall clock time the newest sample behind the values was measured");
+	for (int r = 0; r < n_systems; r++) {
+		snprintf(labels, sizeof(labels), "room=\"%d\"", systems[r]->id_classroom);
+		metrics_sample(w, "roompi_sensor_timestamp_seconds", labels, rooms[r].values_ts_ns / 1e9);
+	}
+
+	metrics_family(w, "roompi_alert", "gauge", "1 while the alert is raised");
+	for (int r = 0; r < n_systems; r++) {
+		for (int i = 0; i < 8; i++) {
+			snprintf(labels, sizeof(labels), "room=\"%d\",alert=\"%s\"", systems[r]->id_classroom, alerts[i].name);
+			metrics_sample(w, "roompi_alert", labels, (rooms[r].flags & alerts[i].flag) != 0);
+		}
+	}
+
+	metrics_family(w, "roompi_sensor_samples_dropped_total", "counter", "Samples lost because the queue of the sensor was full");
+	for (int r = 0; r < n_systems; r++) {
+		for (int i = 0; i < 3; i++) {
+			snprintf(labels, sizeof(labels), "room=\"%d\",sensor=\"%s\"", systems[r]->id_classroom, sensors[i]);
+			metrics_sample(w, "roompi_sensor_samples_dropped_total", labels, rooms[r].samples_dropped[i]);
+		}
+	}
+
+	metrics_family(w, "roompi_samples_stored_total", "counter", "Samples appended to the local history since the start");
+	for (int r = 0; r < n_systems; r++) {
+		snprintf(labels, sizeof(labels), "room=\"%d\"", systems[r]->id_classroom);
+		metrics_sample(w, "roompi_samples_stored_total", labels, rooms[r].samples_stored);
+	}
+
+	metrics_family(w, "roompi_rollups_closed_total", "counter", "Rollup periods closed since the start");
+	for (int r = 0; r < n_systems; r++) {
+		snprintf(labels, sizeof(labels), "room=\"%d\"", systems[r]->id_classroom);
+		metrics_sample(w, "roompi_rollups_closed_total", labels, rooms[r].rollups_closed);
+	}
+
+	metrics_family(w, "roompi_values_total", "counter", "Processed values offered to the report by exception stage");
+	for (int r = 0; r < n_systems; r++) {
+		for (int i = 0; i < 4; i++) {
+			snprintf(labels, sizeof(labels), "room=\"%d\",channel=\"%s\"", systems[r]->id_classroom, channels[i]);
+			metrics_sample(w, "roompi_values_total", labels, rooms[r].values_offered[i]);
+		}
+	}
+
+	metrics_family(w, "roompi_values_uploaded_total", "counter", "Processed values it sent to the uploader");
+	for (int r = 0; r < n_systems; r++) {
+		for (int i = 0; i < 4; i++) {
+			snprintf(labels, sizeof(labels), "room=\"%d\",channel=\"%s\"", systems[r]->id_classroom, channels[i]);
+			metrics_sample(w, "roompi_values_uploaded_total", labels, rooms[r].values_sent[i]);
+		}
 	}
 }
 
 /* Definition of the functions */
 
 static void _measurement_timer_isr(union sigval value) {
-	piLock(MEASUREMENT_LOCK);
-	measurement_flags |= (FLAG_PERFORM_PROCESSING);
-	piUnlock(MEASUREMENT_LOCK);
+	SystemContext *this_system = (SystemContext*) ((tmr_t*) value.sival_ptr)->user_data;
+	flags_set(&this_system->measurement_flags, FLAG_PERFORM_PROCESSING); // the reactor fires the measurement FSM on the change
 }
 
 static int _measurement_pending_processing(fsm_t *this) {
-	return (measurement_flags & FLAG_PERFORM_PROCESSING);
+	return (flags_get(&((SystemContext*) this->user_data)->measurement_flags) & FLAG_PERFORM_PROCESSING);
 }
 
 static int _measurement_processing_finished(fsm_t *this) {
-	return (measurement_flags & FLAG_PROCESSING_READY);
+	return (flags_get(&((SystemContext*) this->user_data)->measurement_flags) & FLAG_PROCESSING_READY);
 }
 
 static int _measurement_alerts_finished(fsm_t *this) {
-	return (measurement_flags & FLAG_ALERTS_READY);
+	return (flags_get(&((SystemContext*) this->user_data)->measurement_flags) & FLAG_ALERTS_READY);
 }
 
 /* helper functions */
 
-static void _temp_humid_do_alerts(SystemContext *this);
-static void _light_do_alerts(SystemContext *this);
-static void _co2_do_alerts(SystemContext *this);
-
-static void _get_highest_lowest_index_from_array(SensorValueType *array, int val_type, int arr_len, int *h_idx, int *l_idx) {
-	SensorValueType highest, lowest;
-
-	int t_h, t_l = -1;
-
-	highest.type = val_type;
-	lowest.type = val_type;
-
-	switch (val_type) {
-	case is_int:
-		highest.val.ival = -99;
-		lowest.val.ival = 999;
-		break;
-	case is_float:
-		highest.val.fval = -99.0;
-		lowest.val.fval = 999.0;
-		break;
-	default:
-		highest.val.ival = -99;
-		lowest.val.ival = 999;
-		break;
-	}
+static unsigned int _temp_humid_do_alerts(SystemContext *this);
+static unsigned int _light_do_alerts(SystemContext *this);
+static unsigned int _co2_do_alerts(SystemContext *this);
 
-	for (int i = 0; i < arr_len; i++) {
-		switch (array[i].type) {
-		case is_int:
-			if (array[i].val.ival > highest.val.ival) {
-				highest = array[i];
-				t_h = i;
-			}
-			if (array[i].val.ival < lowest.val.ival) {
-				lowest = array[i];
-				t_l = i;
-			}
-			break;
-		case is_float:
-			if (array[i].val.fval > highest.val.fval) {
-				highest = array[i];
-				t_h = i;
-			}
-			if (array[i].val.fval < lowest.val.fval) {
-				lowest = array[i];
-				t_l = i;
+static void _measurement_do_processing(fsm_t *this) {
+	SystemContext *this_system = (SystemContext*) this->user_data;
+	flags_clear(&this_system->measurement_flags, FLAG_PERFORM_PROCESSING);
+
+	SystemContext__drain_samples(this_system); // the storage rings are only touched from here, no lock needed
+
+	// iterate for each sensor, the statistics of the window are already up to date whatever its length
+	for (int i = 0; i < sizeof(this_system->sensor_stats) / sizeof(window_stats_t*); i++) {
+		double avg;
+		int err;
+
+		// a percentile (the median usually) rejects spikes whatever the window length, the trimmed mean only drops one of each side
+		if (this_system->sensor_percentile[i] > 0)
+			err = window_stats_percentile(this_system->sensor_stats[i], this_system->sensor_percentile[i], &avg);
+		else
+			err = window_stats_trimmed_mean(this_system->sensor_stats[i], &avg);
+
+		if (err == 0) {
+			SensorValueType value;
+
+			if (i < 2) {
+				value.type = is_float;
+				value.val.fval = avg;
+			} else {
+				value.type = is_int;
+				value.val.ival = avg;
 			}
-			break;
-		default:
-			break;
+
+			this_system->sensor_values[i] = value;
+		} else {
+			SensorValueType error_val = { .type = is_error, .val.ival = 0 };
+			this_system->sensor_values[i] = error_val;
 		}
+
 	}
 
-	*h_idx = t_h;
-	*l_idx = t_l;
+	SystemContext__commit_state(this_system);
+	flags_set(&this_system->measurement_flags, FLAG_PROCESSING_READY);
 }
 
-static void _measurement_do_processing(fsm_t *this) {
-	piLock(MEASUREMENT_LOCK);
-	measurement_flags &= ~(FLAG_PERFORM_PROCESSING);
-	piUnlock(MEASUREMENT_LOCK);
+static void _measurement_do_alerts(fsm_t *this) {
+	unsigned int alerts = _temp_humid_do_alerts(this->user_data) | _light_do_alerts(this->user_data) | _co2_do_alerts(this->user_data);
 
-	SystemContext *this_system = (SystemContext*) this->user_data;
-	// iterate for each sensor
-	for (int i = 0; i < sizeof(this_system->sensor_storage) / sizeof(CircularBuffer); i++) {
-		SensorValueType tmp[5];
+	// replace every anomaly/emergency bit at once, the output FSMs never see a half updated set
+	// only the output FSMs subscribed to the bits that actually changed get fired
+	flags_update(&((SystemContext*) this->user_data)->measurement_flags, FLAG_PROCESSING_READY | FLAG_ALERTS_MASK, alerts | FLAG_ALERTS_READY);
+}
 
-		piLock(STORAGE_LOCK);
-		CircularBufferRead(this_system->sensor_storage[i], 5 * sizeof(SensorValueType), tmp); // copy circular buffer to SensorValueType array
-		piUnlock(STORAGE_LOCK);
+static void _measurement_upload_values(SystemContext *this_system) {
+	static const char *field_keys[4] = { "temp", "rh", "lux", "eco2" };
+	static const lineproto_type_t field_types[4] = { LINEPROTO_FLOAT, LINEPROTO_FLOAT, LINEPROTO_INT, LINEPROTO_INT }; // also for a value sent as the channel fails
+	deadband_point_t sent[4][DEADBAND_MAX_POINTS];
+	unsigned int n_sent[4], next[4] = { 0, 0, 0, 0 };
+	char data[UPLOADER_LINE_LEN];
 
-		int type = i < 2 ? is_float : is_int;
+	// report by exception: each channel sends only what is needed to rebuild its series, a failed one nothing
+	for (int i = 0; i < sizeof(this_system->sensor_values) / sizeof(SensorValueType); i++) {
+		SensorValueType *value = &this_system->sensor_values[i];
 
-		int h_idx, l_idx;
-		_get_highest_lowest_index_from_array(tmp, type, 5, &h_idx, &l_idx);
+		if (value->type == is_error) {
+			n_sent[i] = deadband_reset(&this_system->sensor_deadband[i], sent[i]); // what a swinging door kept back before the gap
+		} else {
+			n_sent[i] = deadband_offer(&this_system->sensor_deadband[i], this_system->sensor_values_ts_ns, value->type == is_float ? value->val.fval : value->val.ival,
+					sent[i]);
+		}
+	}
 
-		SensorValueType avg = { .type = type, .val.ival = 0, .val.fval = 0.0 };
+	// one point per timestamp, with the channels sending a value at it: the current one, and an earlier one where a swinging door closed
+	while (1) {
+		int64_t ts_ns = INT64_MAX;
+		lineproto_field_t fields[4];
 
-		int iters = 0;
+		for (int i = 0; i < 4; i++)
+			if (next[i] < n_sent[i] && sent[i][next[i]].ts_ns < ts_ns)
+				ts_ns = sent[i][next[i]].ts_ns;
+		if (ts_ns == INT64_MAX)
+			break;
 
-		for (int j = 0; j < sizeof(tmp) / sizeof(SensorValueType); j++) {
-			if (j != h_idx && j != l_idx && tmp[j].type != is_error) {
-				switch (type) {
-				case is_int:
-					avg.val.ival += tmp[j].val.ival;
-					break;
-				case is_float:
-					avg.val.fval += tmp[j].val.fval;
+		for (int i = 0; i < 4; i++) {
+			fields[i].key = field_keys[i];
+			fields[i].type = LINEPROTO_NONE;
+			if (next[i] < n_sent[i] && sent[i][next[i]].ts_ns == ts_ns) {
+				fields[i].type = field_types[i];
+				if (field_types[i] == LINEPROTO_INT) {
+					fields[i].val.i = (int64_t) (sent[i][next[i]].value + (sent[i][next[i]].value < 0 ? -0.5 : 0.5)); // a swinging door value may be off the integers
+				} else {
+					fields[i].val.f = sent[i][next[i]].value;
 				}
-				iters++;
-			}
-		}
-
-		if (iters != 0) {
-			switch (type) {
-			case is_int:
-				avg.val.ival /= iters;
-				break;
-			case is_float:
-				avg.val.fval /= iters;
+				next[i]++;
 			}
-
-			this_system->sensor_values[i] = avg;
-		} else {
-			SensorValueType error_val = { .type = is_error, .val.ival = 0 };
-			this_system->sensor_values[i] = error_val;
 		}
 
+		// stamped with the time the newest sample was measured, not when InfluxDB gets the batch; tagged with the room, a gateway writes several
+		if (lineproto_encode(data, sizeof(data), MEASUREMENT_DB_NAME, "room", this_system->id_classroom, fields, 4, ts_ns) > 0)
+			uploader_write(this_system->uploader, data);
 	}
-
-	piLock(MEASUREMENT_LOCK);
-	measurement_flags |= FLAG_PROCESSING_READY;
-	piUnlock(MEASUREMENT_LOCK);
-}
-
-static void _measurement_do_alerts(fsm_t *this) {
-	piLock(MEASUREMENT_LOCK);
-	measurement_flags &= ~(FLAG_PROCESSING_READY);
-	piUnlock(MEASUREMENT_LOCK);
-
-	_temp_humid_do_alerts(this->user_data);
-	_light_do_alerts(this->user_data);
-	_co2_do_alerts(this->user_data);
-
-	piLock(MEASUREMENT_LOCK);
-	measurement_flags |= FLAG_ALERTS_READY;
-	piUnlock(MEASUREMENT_LOCK);
 }
 
 static void _measurement_do_database_update(fsm_t *this) {
-	piLock(MEASUREMENT_LOCK);
-	measurement_flags &= ~(FLAG_ALERTS_READY);
-	piUnlock(MEASUREMENT_LOCK);
-
 	SystemContext *this_system = (SystemContext*) this->user_data;
+	flags_clear(&this_system->measurement_flags, FLAG_ALERTS_READY);
 
-	char sensor_meas_name[4][6] = { "temp", "rh", "lux", "eco2" };
+	if (this_system->uploader)
+		_measurement_upload_values(this_system);
 
-	// iterate for each sensor
-	for (int i = 0; i < sizeof(this_system->sensor_values) / sizeof(SensorValueType); i++) {
-		if (this_system->sensor_values[i].type != is_error) {
-			char data[100];
-
-			switch (this_system->sensor_values[i].type) {
-			case is_int:
-				sprintf(data, "%s value=%d", sensor_meas_name[i], this_system->sensor_values[i].val.ival);
-				break;
-			case is_float:
-				sprintf(data, "%s value=%f", sensor_meas_name[i], this_system->sensor_values[i].val.fval);
-				break;
-			default:
-				break;
-			}
-
-			CURL *hnd;
-
-			hnd = curl_easy_init();
-			curl_easy_setopt(hnd, CURLOPT_BUFFERSIZE, 102400L);
-			curl_easy_setopt(hnd, CURLOPT_URL, "http://localhost:8086/write?db=db0");
-			curl_easy_setopt(hnd, CURLOPT_NOPROGRESS, 1L);
-			curl_easy_setopt(hnd, CURLOPT_POSTFIELDS, data);
-			curl_easy_setopt(hnd, CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t ) strlen(data));
-			curl_easy_setopt(hnd, CURLOPT_USERAGENT, "curl/roompisys/7.77.0-DEV");
-			curl_easy_setopt(hnd, CURLOPT_MAXREDIRS, 50L);
-			curl_easy_setopt(hnd, CURLOPT_HTTP_VERSION, (long )CURL_HTTP_VERSION_2_0);
-			curl_easy_setopt(hnd, CURLOPT_CUSTOMREQUEST, "POST");
-			curl_easy_setopt(hnd, CURLOPT_FTP_SKIP_PASV_IP, 1L);
-			curl_easy_setopt(hnd, CURLOPT_TCP_KEEPALIVE, 1L);
-
-			curl_easy_perform(hnd);
-
-			curl_easy_cleanup(hnd);
-			hnd = NULL;
-		}
-	}
+	// end of the round: its values, alerts and counters for the other threads (/metrics)
+	SystemContext__publish_snapshot(this_system);
 }
 
-static void _temp_humid_do_alerts(SystemContext *this) {
+static unsigned int _temp_humid_do_alerts(SystemContext *this) {
 	float t_val = this->sensor_values[0].val.fval;
 	float rh_val = this->sensor_values[1].val.fval;
 
-	piLock(MEASUREMENT_LOCK);
-	measurement_flags &= ~(FLAG_TEMP_ANOMALY | FLAG_TEMP_EMERGENCY | FLAG_HUMID_ANOMALY | FLAG_HUMID_EMERGENCY); // assume there are no abnormal values
-	piUnlock(MEASUREMENT_LOCK);
+	unsigned int alerts = 0; // assume there are no abnormal values
 
 	extern float temp_warn_low, temp_warn_high, rh_warn_low, rh_warn_high, temp_crit_low, temp_crit_high, rh_crit_low, rh_crit_high;
 
 	if (this->sensor_values[0].type != is_error && this->sensor_values[1].type != is_error) {
 		// if there is an abnormal temperature value
 		if (t_val < temp_warn_low || t_val > temp_warn_high) {
-			piLock(MEASUREMENT_LOCK);
-			measurement_flags |= FLAG_TEMP_ANOMALY;
-			piUnlock(MEASUREMENT_LOCK);
+			alerts |= FLAG_TEMP_ANOMALY;
 		}
 
 		// if there is an abnormal humidity value
 		if (rh_val < rh_warn_low || rh_val > rh_warn_high) {
-			piLock(MEASUREMENT_LOCK);
-			measurement_flags |= FLAG_HUMID_ANOMALY;
-			piUnlock(MEASUREMENT_LOCK);
+			alerts |= FLAG_HUMID_ANOMALY;
 		}
 
 		// if there is a critical temperature value
 		if (t_val < temp_crit_low || t_val > temp_crit_high) {
-			piLock(MEASUREMENT_LOCK);
-			measurement_flags |= FLAG_TEMP_EMERGENCY;
-			piUnlock(MEASUREMENT_LOCK);
+			alerts |= FLAG_TEMP_EMERGENCY;
 		}
 
 		// if there is an critical humidity value
 		if (rh_val < rh_crit_low || rh_val > rh_crit_high) {
-			piLock(MEASUREMENT_LOCK);
-			measurement_flags |= FLAG_HUMID_EMERGENCY;
-			piUnlock(MEASUREMENT_LOCK);
+			alerts |= FLAG_HUMID_EMERGENCY;
 		}
 	}
+
+	return alerts;
 }
 
-static void _light_do_alerts(SystemContext *this) {
+static unsigned int _light_do_alerts(SystemContext *this) {
 	int l_val = this->sensor_values[2].val.ival;
 
-	piLock(MEASUREMENT_LOCK);
-	measurement_flags &= ~(FLAG_LIGHT_ANOMALY | FLAG_LIGHT_EMERGENCY); // assume there are no abnormal values
-	piUnlock(MEASUREMENT_LOCK);
+	unsigned int alerts = 0; // assume there are no abnormal values
 
 	extern int lux_warn, lux_crit;
 
 	if (this->sensor_values[2].type != is_error) {
 		// if there is an abnormal light value
 		if (l_val < lux_warn) {
-			piLock(MEASUREMENT_LOCK);
-			measurement_flags |= FLAG_LIGHT_ANOMALY;
-			piUnlock(MEASUREMENT_LOCK);
+			alerts |= FLAG_LIGHT_ANOMALY;
 		}
 
 		// if there is a critical light value
 		if (l_val < lux_crit) {
-			piLock(MEASUREMENT_LOCK);
-			measurement_flags |= FLAG_LIGHT_EMERGENCY;
-			piUnlock(MEASUREMENT_LOCK);
+			alerts |= FLAG_LIGHT_EMERGENCY;
 		}
 	}
+
+	return alerts;
 }
 
-static void _co2_do_alerts(SystemContext *this) {
+static unsigned int _co2_do_alerts(SystemContext *this) {
 	int eco2_val = this->sensor_values[3].val.ival;
 
-	piLock(MEASUREMENT_LOCK);
-	measurement_flags &= ~(FLAG_CO2_ANOMALY | FLAG_CO2_EMERGENCY); // assume there are no abnormal values
-	piUnlock(MEASUREMENT_LOCK);
+	unsigned int alerts = 0; // assume there are no abnormal values
 
 	extern int eco2_warn, eco2_crit;
 
 	if (this->sensor_values[3].type != is_error) {
 		if (eco2_val > eco2_warn) {
-			piLock(MEASUREMENT_LOCK);
-			measurement_flags |= FLAG_CO2_ANOMALY;
-			piUnlock(MEASUREMENT_LOCK);
+			alerts |= FLAG_CO2_ANOMALY;
 		}
 		if (eco2_val > eco2_crit) {
-			piLock(MEASUREMENT_LOCK);
-			measurement_flags |= FLAG_CO2_EMERGENCY;
-			piUnlock(MEASUREMENT_LOCK);
+			alerts |= FLAG_CO2_EMERGENCY;
 		}
 	}
+
+	return alerts;
 }
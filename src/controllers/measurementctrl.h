@@ -11,6 +11,7 @@
 #include "../libs/fsm.h"
 #include "../libs/timerlib.h"
 #include "../libs/systemlib.h"
+#include "../libs/metricslib.h"
 
 // 00X1111X1111X111
 #define FLAG_PERFORM_PROCESSING 0x2000
@@ -27,8 +28,14 @@
 #define FLAG_LIGHT_EMERGENCY 0x800
 #define FLAG_CO2_EMERGENCY 0x1000
 // FUTURE: keep adding sensors and emergency values flags (0x2000 Sound Level emergency)
+#define FLAG_ALERTS_MASK (FLAG_TEMP_ANOMALY | FLAG_HUMID_ANOMALY | FLAG_LIGHT_ANOMALY | FLAG_CO2_ANOMALY | FLAG_TEMP_EMERGENCY | FLAG_HUMID_EMERGENCY | FLAG_LIGHT_EMERGENCY | FLAG_CO2_EMERGENCY)
+#define FLAG_ANOMALY_MASK (FLAG_TEMP_ANOMALY | FLAG_HUMID_ANOMALY | FLAG_LIGHT_ANOMALY | FLAG_CO2_ANOMALY)
+#define FLAG_EMERGENCY_MASK (FLAG_TEMP_EMERGENCY | FLAG_HUMID_EMERGENCY | FLAG_LIGHT_EMERGENCY | FLAG_CO2_EMERGENCY)
 
-#define MEASUREMENT_LOCK 0
+#define MEASUREMENT_DB_NAME "roompi" // measurement of the processed values, one point per room and round with a field per channel
+
+// measurement_flags bits read by the guards of the measurement FSM (the reactor only fires it when one changes)
+#define MEASUREMENT_FSM_FLAGS (FLAG_PERFORM_PROCESSING | FLAG_PROCESSING_READY | FLAG_ALERTS_READY)
 
 typedef struct {
 	fsm_t *fsm; // FSM that performs measurements from the various sensors and stores them in the sensors' objects
@@ -37,5 +44,6 @@ typedef struct {
 
 MeasurementCtrl* MeasurementCtrl__setup(SystemContext *this_system);
 void MeasurementCtrl__destroy(MeasurementCtrl *this);
+void MeasurementCtrl__render_metrics(SystemContext **systems, int n_systems, metrics_writer_t *w);
 
 #endif /* CONTROLLERS_MEASUREMENTCTRL_H_ */
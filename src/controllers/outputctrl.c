@@ -15,9 +15,7 @@
 #include "../libs/timerlib.h"
 #include "../libs/systemlib.h"
 #include "../libs/fsm.h"
-
-extern int output_flags;
-extern int measurement_flags;
+#include "../libs/arenalib.h"
 
 // Timer
 static void _output_timer_isr(union sigval value);
@@ -142,9 +140,10 @@ static fsm_trans_t _warning_fsm_tt[] = { { NO_WARNING, _not_general_anomaly_and_
 		_next_display_warning, NO_WARNING, NULL }, { LIGHT_WARNING, _next_display_warning, NO_WARNING, NULL }, { CO2_WARNING, _next_display_warning, NO_WARNING, NULL }, { -1, NULL, -1, NULL } };
 
 OutputCtrl* OutputCtrl__setup(SystemContext *this_system) {
-	OutputCtrl *result = (OutputCtrl*) malloc(sizeof(OutputCtrl));
+	OutputCtrl *result = (OutputCtrl*) arena_malloc(sizeof(OutputCtrl));
 	tmr_t *output_timer = tmr_new(_output_timer_isr); // creado pero no iniciado
 	result->timer = output_timer;
+	result->timer->user_data = this_system;
 
 	result->fsm_buzzer = (fsm_t*) fsm_new(OFF, _buzzer_fsm_tt, this_system);
 	result->fsm_leds = (fsm_t*) fsm_new(NORMAL, _leds_fsm_tt, this_system);
@@ -163,55 +162,53 @@ void OutputCtrl__destroy(OutputCtrl *this) {
 
 		tmr_destroy(this->timer);
 
-		free(this);
+		arena_free(this);
 	}
 }
 
 /* Definition of the functions */
 
 static void _output_timer_isr(union sigval value) {
-	piLock(OUTPUT_LOCK);
-	output_flags |= FLAG_NEXT_DISPLAY_INFO;
-	output_flags |= FLAG_NEXT_DISPLAY_WARNING;
-	piUnlock(OUTPUT_LOCK);
+	SystemContext *this_system = (SystemContext*) ((tmr_t*) value.sival_ptr)->user_data;
+	flags_set(&this_system->output_flags, FLAG_NEXT_DISPLAY_INFO | FLAG_NEXT_DISPLAY_WARNING); // the reactor fires the display FSMs on the change
 }
 
 static int _next_display_info(fsm_t *this) {
-	int res = output_flags & FLAG_NEXT_DISPLAY_INFO;
+	int res = flags_get(&((SystemContext*) this->user_data)->output_flags) & FLAG_NEXT_DISPLAY_INFO;
 	return res;
 }
 static int _next_display_warning(fsm_t *this) {
-	int res = output_flags & FLAG_NEXT_DISPLAY_WARNING;
+	int res = flags_get(&((SystemContext*) this->user_data)->output_flags) & FLAG_NEXT_DISPLAY_WARNING;
 	return res;
 }
 
 static int _general_anomaly(fsm_t *this) {
-	int res = measurement_flags & (FLAG_TEMP_ANOMALY | FLAG_HUMID_ANOMALY | FLAG_LIGHT_ANOMALY | FLAG_CO2_ANOMALY);
+	int res = flags_get(&((SystemContext*) this->user_data)->measurement_flags) & FLAG_ANOMALY_MASK;
 	return res;
 }
 
 static int _general_emergency(fsm_t *this) {
-	int res = measurement_flags & (FLAG_TEMP_EMERGENCY | FLAG_HUMID_EMERGENCY | FLAG_LIGHT_EMERGENCY | FLAG_CO2_EMERGENCY);
+	int res = flags_get(&((SystemContext*) this->user_data)->measurement_flags) & FLAG_EMERGENCY_MASK;
 	return res;
 }
 
 static int _temp_anomaly(fsm_t *this) {
-	int res = measurement_flags & FLAG_TEMP_ANOMALY;
+	int res = flags_get(&((SystemContext*) this->user_data)->measurement_flags) & FLAG_TEMP_ANOMALY;
 	return res;
 }
 
 static int _humid_anomaly(fsm_t *this) {
-	int res = measurement_flags & FLAG_HUMID_ANOMALY;
+	int res = flags_get(&((SystemContext*) this->user_data)->measurement_flags) & FLAG_HUMID_ANOMALY;
 	return res;
 }
 
 static int _light_anomaly(fsm_t *this) {
-	int res = measurement_flags & FLAG_LIGHT_ANOMALY;
+	int res = flags_get(&((SystemContext*) this->user_data)->measurement_flags) & FLAG_LIGHT_ANOMALY;
 	return res;
 }
 
 static int _co2_anomaly(fsm_t *this) {
-	int res = measurement_flags & FLAG_CO2_ANOMALY;
+	int res = flags_get(&((SystemContext*) this->user_data)->measurement_flags) & FLAG_CO2_ANOMALY;
 	return res;
 }
 
@@ -262,18 +259,16 @@ static void _show_info_hour(fsm_t *this) {
 	LCD1602Display *display = ((SystemContext*) this->user_data)->actuator_display;
 
 	time_t rawtime;
-	struct tm *timeinfo;
+	struct tm tm_buf, *timeinfo;
 	time(&rawtime);
-	timeinfo = localtime(&rawtime);
+	timeinfo = localtime_r(&rawtime, &tm_buf); // localtime copies the TZ setting to the heap on every call
 
 	LCD1602Display__set_cursor(display, 0, 1);
 	LCD1602Display__print(display, "                ");
 	LCD1602Display__set_cursor(display, 0, 1);
 	LCD1602Display__print(display, "%02d:%02d %02d-%02d-%d", timeinfo->tm_hour, timeinfo->tm_min, timeinfo->tm_mday, 1 + timeinfo->tm_mon, 1900 + timeinfo->tm_year);
 
-	piLock(OUTPUT_LOCK);
-	output_flags &= ~(FLAG_NEXT_DISPLAY_INFO);
-	piUnlock(OUTPUT_LOCK);
+	flags_clear(&((SystemContext*) this->user_data)->output_flags, FLAG_NEXT_DISPLAY_INFO);
 }
 
 static void _show_info_temp(fsm_t *this) {
@@ -297,9 +292,7 @@ static void _show_info_temp(fsm_t *this) {
 		}
 	}
 
-	piLock(OUTPUT_LOCK);
-	output_flags &= ~(FLAG_NEXT_DISPLAY_INFO);
-	piUnlock(OUTPUT_LOCK);
+	flags_clear(&((SystemContext*) this->user_data)->output_flags, FLAG_NEXT_DISPLAY_INFO);
 }
 
 static void _show_info_humid(fsm_t *this) {
@@ -320,9 +313,7 @@ static void _show_info_humid(fsm_t *this) {
 		}
 	}
 
-	piLock(OUTPUT_LOCK);
-	output_flags &= ~(FLAG_NEXT_DISPLAY_INFO);
-	piUnlock(OUTPUT_LOCK);
+	flags_clear(&((SystemContext*) this->user_data)->output_flags, FLAG_NEXT_DISPLAY_INFO);
 }
 
 static void _show_info_light(fsm_t *this) {
@@ -343,9 +334,7 @@ static void _show_info_light(fsm_t *this) {
 		}
 	}
 
-	piLock(OUTPUT_LOCK);
-	output_flags &= ~(FLAG_NEXT_DISPLAY_INFO);
-	piUnlock(OUTPUT_LOCK);
+	flags_clear(&((SystemContext*) this->user_data)->output_flags, FLAG_NEXT_DISPLAY_INFO);
 }
 
 static void _show_info_co2(fsm_t *this) {
@@ -366,9 +355,7 @@ static void _show_info_co2(fsm_t *this) {
 		}
 	}
 
-	piLock(OUTPUT_LOCK);
-	output_flags &= ~(FLAG_NEXT_DISPLAY_INFO);
-	piUnlock(OUTPUT_LOCK);
+	flags_clear(&((SystemContext*) this->user_data)->output_flags, FLAG_NEXT_DISPLAY_INFO);
 }
 
 static void _show_warning_none(fsm_t *this) {
@@ -379,9 +366,7 @@ static void _show_warning_none(fsm_t *this) {
 	LCD1602Display__set_cursor(display, 0, 0);
 	LCD1602Display__print(display, "roomPi      v7.0");
 
-	piLock(OUTPUT_LOCK);
-	output_flags &= ~(FLAG_NEXT_DISPLAY_WARNING);
-	piUnlock(OUTPUT_LOCK);
+	flags_clear(&((SystemContext*) this->user_data)->output_flags, FLAG_NEXT_DISPLAY_WARNING);
 }
 
 static void _show_warning_temp(fsm_t *this) {
@@ -393,9 +378,7 @@ static void _show_warning_temp(fsm_t *this) {
 	LCD1602Display__write(display, 4);
 	LCD1602Display__print(display, " AVISO TEMP.");
 
-	piLock(OUTPUT_LOCK);
-	output_flags &= ~(FLAG_NEXT_DISPLAY_WARNING);
-	piUnlock(OUTPUT_LOCK);
+	flags_clear(&((SystemContext*) this->user_data)->output_flags, FLAG_NEXT_DISPLAY_WARNING);
 }
 
 static void _show_warning_humid(fsm_t *this) {
@@ -407,9 +390,7 @@ static void _show_warning_humid(fsm_t *this) {
 	LCD1602Display__write(display, 5);
 	LCD1602Display__print(display, " AVISO HUMED.");
 
-	piLock(OUTPUT_LOCK);
-	output_flags &= ~(FLAG_NEXT_DISPLAY_WARNING);
-	piUnlock(OUTPUT_LOCK);
+	flags_clear(&((SystemContext*) this->user_data)->output_flags, FLAG_NEXT_DISPLAY_WARNING);
 }
 
 static void _show_warning_light(fsm_t *this) {
@@ -421,9 +402,7 @@ static void _show_warning_light(fsm_t *this) {
 	LCD1602Display__write(display, 7);
 	LCD1602Display__print(display, " MUY POCA LUZ");
 
-	piLock(OUTPUT_LOCK);
-	output_flags &= ~(FLAG_NEXT_DISPLAY_WARNING);
-	piUnlock(OUTPUT_LOCK);
+	flags_clear(&((SystemContext*) this->user_data)->output_flags, FLAG_NEXT_DISPLAY_WARNING);
 }
 
 static void _show_warning_co2(fsm_t *this) {
@@ -435,7 +414,5 @@ static void _show_warning_co2(fsm_t *this) {
 	LCD1602Display__write(display, 3);
 	LCD1602Display__print(display, " AVISO CO2");
 
-	piLock(OUTPUT_LOCK);
-	output_flags &= ~(FLAG_NEXT_DISPLAY_WARNING);
-	piUnlock(OUTPUT_LOCK);
+	flags_clear(&((SystemContext*) this->user_data)->output_flags, FLAG_NEXT_DISPLAY_WARNING);
 }
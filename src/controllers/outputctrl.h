@@ -11,11 +11,17 @@
 #include "../libs/fsm.h"
 #include "../libs/timerlib.h"
 #include "../libs/systemlib.h"
+#include "measurementctrl.h"
 
 #define FLAG_NEXT_DISPLAY_INFO 0x01
 #define FLAG_NEXT_DISPLAY_WARNING 0x02
 
-#define OUTPUT_LOCK 1
+// Flag bits read by the guards of each FSM (the reactor only fires an FSM when one of them changes)
+#define OUTPUT_BUZZER_FSM_MEASUREMENT_FLAGS FLAG_EMERGENCY_MASK
+#define OUTPUT_LEDS_FSM_MEASUREMENT_FLAGS (FLAG_ANOMALY_MASK | FLAG_EMERGENCY_MASK)
+#define OUTPUT_INFO_FSM_OUTPUT_FLAGS FLAG_NEXT_DISPLAY_INFO
+#define OUTPUT_WARNINGS_FSM_OUTPUT_FLAGS FLAG_NEXT_DISPLAY_WARNING
+#define OUTPUT_WARNINGS_FSM_MEASUREMENT_FLAGS FLAG_ANOMALY_MASK
 
 typedef struct {
 	fsm_t *fsm_buzzer; // FSM buzzer
@@ -0,0 +1,240 @@
+/*
+ * arenalib.c
+ *
+ *  Created on: 17 oct. 2026
+ *      Author: Victoria M. Gullon and Marcos Gomez
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+
+#include "arenalib.h"
+
+#define ARENA_POOL_HEAP 0xff // class of a pool block too large for the pools
+
+// in front of every pool block
+typedef struct {
+	uint32_t cls;
+	uint32_t size; // requested, for realloc
+	uint64_t reserved; // keeps the block ARENA_ALIGN aligned
+} _pool_header_t;
+
+static arena_t *_arena_current;
+static atomic_ulong _heap_allocs;
+
+#ifdef ARENA_COUNT_MALLOC
+// Interposed over the libc allocator for the whole process (libcurl and libc included), same heap underneath
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t n, size_t size);
+extern void* __libc_realloc(void *ptr, size_t size);
+
+void* malloc(size_t size) {
+	atomic_fetch_add_explicit(&_heap_allocs, 1, memory_order_relaxed);
+	return __libc_malloc(size);
+}
+
+void* calloc(size_t n, size_t size) {
+	atomic_fetch_add_explicit(&_heap_allocs, 1, memory_order_relaxed);
+	return __libc_calloc(n, size);
+}
+
+void* realloc(void *ptr, size_t size) {
+	atomic_fetch_add_explicit(&_heap_allocs, 1, memory_order_relaxed);
+	return __libc_realloc(ptr, size);
+}
+#endif
+
+// Heap allocations of the process so far, always 0 unless built with -DARENA_COUNT_MALLOC
+unsigned long arena_heap_allocs(void) {
+	return atomic_load_explicit(&_heap_allocs, memory_order_relaxed);
+}
+
+// Reserves size bytes of address space, the kernel backs a page the first time it is carved
+arena_t* arena_new(size_t size) {
+	void *base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (base == MAP_FAILED)
+		return NULL;
+
+	arena_t *this = (arena_t*) base; // the arena describes itself from its first bytes
+	memset(this, 0, sizeof(arena_t));
+	this->base = (unsigned char*) base;
+	this->size = size;
+	this->used = (sizeof(arena_t) + ARENA_ALIGN - 1) & ~(size_t) (ARENA_ALIGN - 1);
+	pthread_mutex_init(&this->lock, NULL);
+
+	return this;
+}
+
+void arena_destroy(arena_t *this) {
+	if (this) {
+		if (_arena_current == this)
+			_arena_current = NULL;
+		pthread_mutex_destroy(&this->lock);
+		munmap(this->base, this->size);
+	}
+}
+
+// Objects created from now on are carved from this arena (NULL: from the heap)
+void arena_use(arena_t *this) {
+	_arena_current = this;
+}
+
+arena_t* arena_current(void) {
+	return _arena_current;
+}
+
+// End of the setup: every carve after this one is counted as a late one
+void arena_seal(arena_t *this) {
+	this->sealed = 1;
+	this->heap_allocs_at_seal = arena_heap_allocs();
+}
+
+// align is a power of two, ARENA_ALIGN or more
+static void* _carve(arena_t *this, size_t size, size_t align, int pool) {
+	void *p = NULL;
+
+	pthread_mutex_lock(&this->lock);
+	size = (size + ARENA_ALIGN - 1) & ~(size_t) (ARENA_ALIGN - 1);
+	size_t skip = (align - ((uintptr_t) (this->base + this->used) & (align - 1))) & (align - 1);
+	if (skip + size <= this->size - this->used) {
+		p = this->base + this->used + skip;
+		this->used += skip + size;
+		if (pool) {
+			this->pool_blocks++;
+			this->pool_in_use++;
+		} else {
+			this->carves++;
+			if (this->sealed)
+				this->late_carves++;
+		}
+	} else {
+		this->spills++;
+	}
+	pthread_mutex_unlock(&this->lock);
+
+	return p;
+}
+
+static int _owns(arena_t *this, const void *ptr) {
+	return this && (const unsigned char*) ptr >= this->base && (const unsigned char*) ptr < this->base + this->size;
+}
+
+void* arena_malloc(size_t size) {
+	void *p = _arena_current ? _carve(_arena_current, size, ARENA_ALIGN, 0) : NULL;
+	return p ? p : malloc(size);
+}
+
+void* arena_calloc(size_t n, size_t size) {
+	void *p = _arena_current ? _carve(_arena_current, n * size, ARENA_ALIGN, 0) : NULL;
+	if (!p)
+		return calloc(n, size);
+	memset(p, 0, n * size); // a fresh page is zero already, but a spilled-over region may not be
+	return p;
+}
+
+// For objects laid out on cache lines. align is a power of two and size a multiple of it (as aligned_alloc wants it)
+void* arena_aligned_malloc(size_t align, size_t size) {
+	void *p = _arena_current ? _carve(_arena_current, size, align > ARENA_ALIGN ? align : ARENA_ALIGN, 0) : NULL;
+	return p ? p : aligned_alloc(align, size);
+}
+
+// Carved objects stay until the process ends, only heap ones are freed
+void arena_free(void *ptr) {
+	if (ptr && !_owns(_arena_current, ptr))
+		free(ptr);
+}
+
+/* pools */
+
+static int _pool_class(size_t size) {
+	int cls = 0;
+
+	while (cls < ARENA_POOL_CLASSES && ((size_t) 1 << (cls + ARENA_POOL_MIN_SHIFT)) < size + sizeof(_pool_header_t))
+		cls++;
+	return cls;
+}
+
+void* arena_pool_malloc(size_t size) {
+	arena_t *this = _arena_current;
+	int cls = _pool_class(size);
+	_pool_header_t *h = NULL;
+
+	if (this && cls < ARENA_POOL_CLASSES) {
+		pthread_mutex_lock(&this->lock);
+		h = (_pool_header_t*) this->free_lists[cls];
+		if (h) {
+			this->free_lists[cls] = *(void**) (h + 1);
+			this->pool_in_use++;
+		}
+		pthread_mutex_unlock(&this->lock);
+
+		// the class is empty: one more block for it, the pools grow until the request pattern is covered
+		if (!h)
+			h = (_pool_header_t*) _carve(this, (size_t) 1 << (cls + ARENA_POOL_MIN_SHIFT), ARENA_ALIGN, 1);
+	}
+	if (!h) {
+		h = (_pool_header_t*) malloc(sizeof(_pool_header_t) + size);
+		if (!h)
+			return NULL;
+		cls = ARENA_POOL_HEAP;
+	}
+
+	h->cls = cls;
+	h->size = size;
+	return h + 1;
+}
+
+void arena_pool_free(void *ptr) {
+	if (!ptr)
+		return;
+
+	_pool_header_t *h = (_pool_header_t*) ptr - 1;
+	arena_t *this = _arena_current;
+
+	if (h->cls == ARENA_POOL_HEAP || !_owns(this, h)) {
+		free(h);
+		return;
+	}
+
+	pthread_mutex_lock(&this->lock);
+	*(void**) ptr = this->free_lists[h->cls];
+	this->free_lists[h->cls] = h;
+	this->pool_in_use--;
+	pthread_mutex_unlock(&this->lock);
+}
+
+void* arena_pool_calloc(size_t n, size_t size) {
+	void *p = arena_pool_malloc(n * size);
+	if (p)
+		memset(p, 0, n * size);
+	return p;
+}
+
+void* arena_pool_realloc(void *ptr, size_t size) {
+	if (!ptr)
+		return arena_pool_malloc(size);
+
+	_pool_header_t *h = (_pool_header_t*) ptr - 1;
+	if (h->cls != ARENA_POOL_HEAP && size + sizeof(_pool_header_t) <= ((size_t) 1 << (h->cls + ARENA_POOL_MIN_SHIFT))) {
+		h->size = size; // still fits in its block
+		return ptr;
+	}
+
+	void *p = arena_pool_malloc(size);
+	if (p) {
+		memcpy(p, ptr, h->size < size ? h->size : size);
+		arena_pool_free(ptr);
+	}
+	return p;
+}
+
+char* arena_pool_strdup(const char *str) {
+	size_t len = strlen(str) + 1;
+	char *p = (char*) arena_pool_malloc(len);
+	if (p)
+		memcpy(p, str, len);
+	return p;
+}
@@ -0,0 +1,66 @@
+/*
+ * arenalib.h
+ *
+ * Memory of the system objects. systemSetup reserves one region sized for the configured rooms and
+ * every object is carved from it with a pointer bump: no malloc once the system is running, no
+ * fragmentation, nothing freed one by one (the region lives as long as the process). The region is
+ * reserved address space, only the pages actually carved take memory. libcurl, which allocates
+ * and frees on every request, gets size-class pools carved from the same region: a freed block
+ * goes back to the list of its class and the next request reuses it.
+ *
+ * While no arena is in use arena_malloc/arena_free are malloc/free, which is how the benchmarks
+ * build the objects. Built with -DARENA_COUNT_MALLOC, malloc, calloc and realloc of the whole
+ * process (libc and libcurl included) are counted, see arena_heap_allocs.
+ *
+ *  Created on: 17 oct. 2026
+ *      Author: Victoria M. Gullon and Marcos Gomez
+ */
+
+#ifndef LIBS_ARENALIB_H_
+#define LIBS_ARENALIB_H_
+
+#include <stddef.h>
+#include <pthread.h>
+
+#define ARENA_ALIGN 16
+#define ARENA_POOL_MIN_SHIFT 5 // 32 byte blocks for the smallest class
+#define ARENA_POOL_CLASSES 14 // up to 256 KB, larger pool requests go to the heap
+
+typedef struct {
+	unsigned char *base;
+	size_t size;
+	size_t used;
+	pthread_mutex_t lock; // the pools are used from the uploader, carving from the setup
+
+	void *free_lists[ARENA_POOL_CLASSES];
+	unsigned long pool_blocks; // carved for the pools, they grow until the request pattern is covered
+	unsigned long pool_in_use; // pool blocks handed out and not freed
+
+	// statistics
+	unsigned long carves; // objects
+	unsigned long late_carves; // after arena_seal, should stay at 0
+	unsigned long spills; // requests the region could not hold, served by the heap
+	int sealed;
+	unsigned long heap_allocs_at_seal;
+} arena_t;
+
+arena_t* arena_new(size_t size);
+void arena_destroy(arena_t *this);
+void arena_use(arena_t *this);
+arena_t* arena_current(void);
+void arena_seal(arena_t *this);
+
+void* arena_malloc(size_t size);
+void* arena_calloc(size_t n, size_t size);
+void* arena_aligned_malloc(size_t align, size_t size);
+void arena_free(void *ptr);
+
+void* arena_pool_malloc(size_t size);
+void* arena_pool_calloc(size_t n, size_t size);
+void* arena_pool_realloc(void *ptr, size_t size);
+char* arena_pool_strdup(const char *str);
+void arena_pool_free(void *ptr);
+
+unsigned long arena_heap_allocs(void);
+
+#endif /* LIBS_ARENALIB_H_ */
@@ -1,9 +1,10 @@
 #include "circularbuffer.h"
+#include "arenalib.h"
 #include <string.h>
 
 CircularBuffer CircularBufferCreate(size_t size) {
 	size_t totalSize = sizeof(struct s_circularBuffer) + size;
-	void *p = malloc(totalSize);
+	void *p = arena_malloc(totalSize);
 	CircularBuffer buffer = (CircularBuffer) p;
 	buffer->buffer = p + sizeof(struct s_circularBuffer);
 	buffer->size = size;
@@ -16,7 +17,7 @@ void CircularBufferFree(CircularBuffer cBuf) {
 	cBuf->size = 0;
 	cBuf->dataSize = 0;
 	cBuf->buffer = NULL;
-	free(cBuf);
+	arena_free(cBuf);
 }
 
 void CircularBufferReset(CircularBuffer cBuf) {
@@ -160,14 +161,13 @@ size_t CircularBufferRead(CircularBuffer cBuf, size_t length, void *dataOut) {
 	return inter_circularBuffer_read(cBuf, length, dataOut, false);
 }
 
-//print circular buffer's content into str,
+//print circular buffer's content, straight to stdout (no buffer to allocate)
 void CircularBufferPrint(CircularBuffer cBuf, bool hex) {
 	char *b = cBuf->buffer;
 	size_t cSize = CircularBufferGetSize(cBuf);
-	char *str = malloc(2 * cSize + 1);
-
 	char c;
 
+	printf("CircularBuffer: ");
 	for (size_t i = 0; i < cSize; i++) {
 		if (CircularBufferGetDataSize(cBuf) == 0) {
 			c = '_';
@@ -183,12 +183,10 @@ void CircularBufferPrint(CircularBuffer cBuf, bool hex) {
 				c = b[i];
 		}
 		if (hex)
-			sprintf(str + i * 2, "%02X|", c);
+			printf("%02X|", (unsigned char) c);
 		else
-			sprintf(str + i * 2, "%c|", c);
+			printf("%c|", c);
 	}
 
-	printf("CircularBuffer: %s <size %zu dataSize:%zu>\n", str, CircularBufferGetSize(cBuf), CircularBufferGetDataSize(cBuf));
-
-	free(str);
+	printf(" <size %zu dataSize:%zu>\n", CircularBufferGetSize(cBuf), CircularBufferGetDataSize(cBuf));
 }
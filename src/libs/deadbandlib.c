@@ -0,0 +1,106 @@
+/*
+ * deadbandlib.c
+ *
+ *  Created on: 17 oct. 2026
+ *      Author: Victoria M. Gullon and Marcos Gomez
+ */
+
+#include <math.h> // INFINITY
+
+#include "deadbandlib.h"
+
+void deadband_init(deadband_t *this, deadband_mode_t mode, double delta, int64_t max_silence_ms) {
+	this->mode = delta > 0 ? mode : DEADBAND_OFF;
+	this->delta = delta;
+	this->max_silence_ns = (max_silence_ms > 0 ? max_silence_ms : DEADBAND_DEFAULT_SILENCE_MS) * 1000000;
+	this->offered = 0;
+	this->sent_values = 0;
+	this->sent = 0;
+	this->held = 0;
+}
+
+static unsigned int _send(deadband_t *this, deadband_point_t p, deadband_point_t *out) {
+	*out = p;
+	this->last = p;
+	this->sent = 1;
+	this->held = 0;
+	this->slope_min = -INFINITY;
+	this->slope_max = INFINITY;
+	this->sent_values++;
+	return 1;
+}
+
+// Narrows the door from last by the band of p. Returns 0, leaving it as it was, once no line goes through every band
+static int _door(deadband_t *this, deadband_point_t p) {
+	double dt = (p.ts_ns - this->last.ts_ns) / 1e9;
+	double lo = (p.value - this->delta - this->last.value) / dt, hi = (p.value + this->delta - this->last.value) / dt;
+
+	if ((lo > this->slope_min ? lo : this->slope_min) > (hi < this->slope_max ? hi : this->slope_max))
+		return 0;
+	if (lo > this->slope_min)
+		this->slope_min = lo;
+	if (hi < this->slope_max)
+		this->slope_max = hi;
+	return 1;
+}
+
+// p moved onto the closest line through the door, within delta of p: the line from last to it passes within delta of every value since
+static deadband_point_t _on_door(deadband_t *this, deadband_point_t p) {
+	double dt = (p.ts_ns - this->last.ts_ns) / 1e9, slope = (p.value - this->last.value) / dt;
+
+	if (slope < this->slope_min)
+		slope = this->slope_min;
+	if (slope > this->slope_max)
+		slope = this->slope_max;
+	p.value = this->last.value + slope * dt;
+	return p;
+}
+
+// A gap in the series (a failed reading, the end of a replay): the value a swinging door keeps back is written to out with its
+// own timestamp, as when the door closes, and returned (1, else 0) to be sent. The next value is sent, nothing is rebuilt across it
+unsigned int deadband_reset(deadband_t *this, deadband_point_t *out) {
+	unsigned int n = 0;
+
+	if (this->held)
+		n = _send(this, _on_door(this, this->newest), out);
+	this->sent = 0;
+	this->held = 0;
+	return n;
+}
+
+// Offers the next value of the channel. Writes the values to send to out, at most DEADBAND_MAX_POINTS in time order, and returns how many
+unsigned int deadband_offer(deadband_t *this, int64_t ts_ns, double value, deadband_point_t *out) {
+	deadband_point_t p = { ts_ns, value };
+	unsigned int n = 0;
+
+	// no newer sample behind it: the same value again
+	if (this->sent && ts_ns <= (this->held ? this->newest.ts_ns : this->last.ts_ns))
+		return 0;
+	this->offered++;
+
+	if (!this->sent || this->mode == DEADBAND_OFF)
+		return _send(this, p, out);
+
+	switch (this->mode) {
+	case DEADBAND_HOLD:
+		if (value - this->last.value > this->delta || this->last.value - value > this->delta)
+			n = _send(this, p, out);
+		break;
+	case DEADBAND_SWINGING_DOOR:
+		if (!_door(this, p)) {
+			// the door closed: the line ends at the newest value kept back, the next one starts there
+			n = _send(this, _on_door(this, this->newest), out);
+			_door(this, p);
+		}
+		this->held = 1;
+		this->newest = p;
+		break;
+	default:
+		break;
+	}
+
+	// heartbeat, a quiet channel still looks alive
+	if (ts_ns - this->last.ts_ns >= this->max_silence_ns)
+		n += _send(this, this->mode == DEADBAND_SWINGING_DOOR ? _on_door(this, p) : p, out + n);
+	return n;
+}
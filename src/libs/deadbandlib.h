@@ -0,0 +1,59 @@
+/*
+ * deadbandlib.h
+ *
+ * Report by exception for one channel: of the processed values offered, in time order, only the
+ * ones needed to rebuild the series within delta are sent. Two ways of rebuilding it:
+ *   DEADBAND_HOLD             a value is sent when it moves more than delta from the last one
+ *                             sent; in between the series is that last value (fill previous)
+ *   DEADBAND_SWINGING_DOOR    the series is the straight lines between the values sent: a value
+ *                             is kept back while one line from the last one sent stays within
+ *                             delta of every value since, and sent once none does (the door
+ *                             closes), so a steady drift costs a value per change of slope, not per delta
+ * Whatever the mode a value is sent when none was for max_silence, so that a quiet channel is
+ * still seen alive. With the swinging door a value is sent when the next one closes the door: it
+ * carries its own, earlier, timestamp, and is moved (by delta at most) onto the closest line
+ * through the door so that the error stays within delta; a gap (deadband_reset) sends the value kept
+ * back the same way. No allocation, the state is a few numbers.
+ *
+ *  Created on: 17 oct. 2026
+ *      Author: Victoria M. Gullon and Marcos Gomez
+ */
+
+#ifndef LIBS_DEADBANDLIB_H_
+#define LIBS_DEADBANDLIB_H_
+
+#include <stdint.h>
+
+#define DEADBAND_MAX_POINTS 2 // sent by one offer: the value that closed the door, and a heartbeat
+#define DEADBAND_DEFAULT_SILENCE_MS 600000 // 10 min
+
+typedef enum {
+	DEADBAND_OFF, DEADBAND_HOLD, DEADBAND_SWINGING_DOOR
+} deadband_mode_t;
+
+typedef struct {
+	int64_t ts_ns; // of the value offered
+	double value;
+} deadband_point_t;
+
+typedef struct {
+	deadband_mode_t mode; // OFF: every value is sent
+	double delta; // largest error of the rebuilt series
+	int64_t max_silence_ns;
+
+	int sent; // a value was sent since the last reset
+	deadband_point_t last; // the last one sent
+	int held; // a value was offered and kept back since
+	deadband_point_t newest; // the last one offered
+	double slope_min, slope_max; // per second, of the lines from last within delta of every value since
+
+	// statistics
+	unsigned long offered;
+	unsigned long sent_values;
+} deadband_t;
+
+void deadband_init(deadband_t *this, deadband_mode_t mode, double delta, int64_t max_silence_ms);
+unsigned int deadband_reset(deadband_t *this, deadband_point_t *out);
+unsigned int deadband_offer(deadband_t *this, int64_t ts_ns, double value, deadband_point_t *out);
+
+#endif /* LIBS_DEADBANDLIB_H_ */
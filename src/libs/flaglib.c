@@ -0,0 +1,151 @@
+/*
+ * flaglib.c
+ *
+ *  Created on: 17 oct. 2026
+ *      Author: Victoria M. Gullon and Marcos Gomez
+ */
+
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
+#include "flaglib.h"
+
+static void _flags_changed(flags_t *this, unsigned int changed) {
+	atomic_fetch_add(&this->seq, 1);
+	if (atomic_load(&this->waiters))
+		syscall(SYS_futex, &this->seq, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+
+	for (int i = 0; i < this->n_listeners; i++)
+		this->listeners[i].fn(changed, this->listeners[i].user_data);
+}
+
+unsigned int flags_get(flags_t *this) {
+	return atomic_load(&this->bits);
+}
+
+// Returns the bits before the change
+unsigned int flags_set(flags_t *this, unsigned int mask) {
+	unsigned int prev = atomic_fetch_or(&this->bits, mask);
+	if ((prev | mask) != prev)
+		_flags_changed(this, mask & ~prev);
+	return prev;
+}
+
+unsigned int flags_clear(flags_t *this, unsigned int mask) {
+	unsigned int prev = atomic_fetch_and(&this->bits, ~mask);
+	if (prev & mask)
+		_flags_changed(this, prev & mask);
+	return prev;
+}
+
+// Clears and sets bits in one step, so that readers never see the intermediate value
+unsigned int flags_update(flags_t *this, unsigned int clear_mask, unsigned int set_mask) {
+	unsigned int prev = atomic_load(&this->bits);
+	while (!atomic_compare_exchange_weak(&this->bits, &prev, (prev & ~clear_mask) | set_mask))
+		;
+	unsigned int changed = ((prev & ~clear_mask) | set_mask) ^ prev;
+	if (changed)
+		_flags_changed(this, changed);
+	return prev;
+}
+
+// Sleeps until a bit of mask differs from seen (or timeout_ms, -1 forever). Returns the current bits
+unsigned int flags_wait(flags_t *this, unsigned int mask, unsigned int seen, int timeout_ms) {
+	struct timespec deadline, now, ts;
+
+	// the timeout runs from the call: wake-ups for other bits only wait for what is left of it
+	if (timeout_ms >= 0) {
+		clock_gettime(CLOCK_MONOTONIC, &deadline);
+		deadline.tv_sec += timeout_ms / 1000;
+		deadline.tv_nsec += (timeout_ms % 1000) * 1000000L;
+		if (deadline.tv_nsec >= 1000000000L) {
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000L;
+		}
+	}
+
+	while (1) {
+		unsigned int seq = atomic_load(&this->seq);
+		unsigned int bits = atomic_load(&this->bits);
+		if ((bits ^ seen) & mask)
+			return bits;
+
+		if (timeout_ms >= 0) {
+			clock_gettime(CLOCK_MONOTONIC, &now);
+			ts.tv_sec = deadline.tv_sec - now.tv_sec;
+			ts.tv_nsec = deadline.tv_nsec - now.tv_nsec;
+			if (ts.tv_nsec < 0) {
+				ts.tv_sec--;
+				ts.tv_nsec += 1000000000L;
+			}
+			if (ts.tv_sec < 0)
+				return bits;
+		}
+
+		atomic_fetch_add(&this->waiters, 1);
+		long r = syscall(SYS_futex, &this->seq, FUTEX_WAIT_PRIVATE, seq, timeout_ms < 0 ? NULL : &ts, NULL, 0);
+		atomic_fetch_sub(&this->waiters, 1);
+		if (r < 0 && timeout_ms >= 0 && errno == ETIMEDOUT)
+			return atomic_load(&this->bits);
+	}
+}
+
+// Must be called before other threads start changing the flags
+int flags_add_listener(flags_t *this, flags_listener_func_t fn, void *user_data) {
+	if (this->n_listeners >= FLAGS_MAX_LISTENERS)
+		return -1;
+
+	this->listeners[this->n_listeners].fn = fn;
+	this->listeners[this->n_listeners].user_data = user_data;
+	return this->n_listeners++;
+}
+
+// Same rule as flags_add_listener: nobody may be changing the flags
+void flags_remove_listener(flags_t *this, flags_listener_func_t fn, void *user_data) {
+	for (int i = 0; i < this->n_listeners; i++) {
+		if (this->listeners[i].fn == fn && this->listeners[i].user_data == user_data) {
+			for (int j = i + 1; j < this->n_listeners; j++)
+				this->listeners[j - 1] = this->listeners[j];
+			this->n_listeners--;
+			return;
+		}
+	}
+}
+
+// The snapshot is copied a word at a time with relaxed atomics: a reader racing with a rewrite copies garbage, then retries
+static void _seqlock_copy(void *dst, const void *src, size_t len) {
+	unsigned int *d = (unsigned int*) dst;
+	const unsigned int *s = (const unsigned int*) src;
+
+	for (size_t i = 0; i < len / sizeof(unsigned int); i++)
+		__atomic_store_n(&d[i], __atomic_load_n(&s[i], __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+	for (size_t i = len - len % sizeof(unsigned int); i < len; i++)
+		__atomic_store_n((unsigned char*) dst + i, __atomic_load_n((const unsigned char*) src + i, __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+}
+
+// Single writer: copies len bytes of src over the snapshot (both word aligned)
+void flags_seqlock_write(flags_seqlock_t *this, void *snapshot, const void *src, size_t len) {
+	unsigned int seq = atomic_load_explicit(&this->seq, memory_order_relaxed);
+
+	atomic_store_explicit(&this->seq, seq + 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release); // the odd count is seen before any word of the rewrite
+	_seqlock_copy(snapshot, src, len);
+	atomic_store_explicit(&this->seq, seq + 2, memory_order_release);
+}
+
+// Any thread: copies the snapshot to dst as one write left it
+void flags_seqlock_read(flags_seqlock_t *this, void *dst, const void *snapshot, size_t len) {
+	while (1) {
+		unsigned int seq = atomic_load_explicit(&this->seq, memory_order_acquire);
+		if (seq & 1)
+			continue; // a rewrite is under way, it takes a few hundred bytes of copy
+		_seqlock_copy(dst, snapshot, len);
+		atomic_thread_fence(memory_order_acquire); // the copy is done before the count is read again
+		if (atomic_load_explicit(&this->seq, memory_order_relaxed) == seq)
+			return;
+	}
+}
@@ -0,0 +1,57 @@
+/*
+ * flaglib.h
+ *
+ * Shared flag words on C11 atomics: setting or clearing bits is a single atomic_fetch_or/and,
+ * reading is a plain atomic load, no lock. A thread can sleep on a futex until any bit of
+ * interest changes; the futex is only touched when somebody is actually waiting. Listeners
+ * (e.g. the reactors) are told which bits changed, from the thread that changed them.
+ *
+ * Also a sequence lock for state larger than a word: one thread rewrites a snapshot and any other
+ * copies it out whole, without a lock and retrying if a rewrite went on meanwhile.
+ *
+ *  Created on: 17 oct. 2026
+ *      Author: Victoria M. Gullon and Marcos Gomez
+ */
+
+#ifndef LIBS_FLAGLIB_H_
+#define LIBS_FLAGLIB_H_
+
+#include <stddef.h>
+#include <stdatomic.h>
+
+#define FLAGS_MAX_LISTENERS 4
+
+typedef void (*flags_listener_func_t)(unsigned int changed, void *user_data);
+
+typedef struct {
+	flags_listener_func_t fn;
+	void *user_data;
+} flags_listener_t;
+
+typedef struct {
+	atomic_uint bits;
+	atomic_uint seq; // futex word, bumped whenever bits change
+	atomic_uint waiters;
+
+	// registered before the writers start, read only afterwards
+	flags_listener_t listeners[FLAGS_MAX_LISTENERS];
+	int n_listeners;
+} flags_t;
+
+#define FLAGS_INITIALIZER { 0, 0, 0 }
+
+typedef struct {
+	atomic_uint seq; // odd while the snapshot is being rewritten
+} flags_seqlock_t;
+
+unsigned int flags_get(flags_t *this);
+unsigned int flags_set(flags_t *this, unsigned int mask);
+unsigned int flags_clear(flags_t *this, unsigned int mask);
+unsigned int flags_update(flags_t *this, unsigned int clear_mask, unsigned int set_mask);
+unsigned int flags_wait(flags_t *this, unsigned int mask, unsigned int seen, int timeout_ms);
+int flags_add_listener(flags_t *this, flags_listener_func_t fn, void *user_data);
+void flags_remove_listener(flags_t *this, flags_listener_func_t fn, void *user_data);
+void flags_seqlock_write(flags_seqlock_t *this, void *snapshot, const void *src, size_t len);
+void flags_seqlock_read(flags_seqlock_t *this, void *dst, const void *snapshot, size_t len);
+
+#endif /* LIBS_FLAGLIB_H_ */
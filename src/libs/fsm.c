@@ -6,40 +6,221 @@
  */
 
 #include <stdlib.h>
+#ifdef FSM_TRACE
+#include <time.h>
+#endif
 #include "fsm.h"
+#include "arenalib.h"
 
 fsm_t*
 fsm_new (int state, fsm_trans_t* tt, void* user_data)
 {
-  fsm_t* this = (fsm_t*) malloc (sizeof (fsm_t));
+  fsm_t* this = (fsm_t*) arena_malloc (sizeof (fsm_t));
   fsm_init (this, state, tt, user_data);
   return this;
 }
 
+/* Groups the transitions by origin state (counting sort, keeps the
+   priority order of the table) so that fsm_fire does not scan it all */
+static void
+fsm_compile (fsm_t* this)
+{
+  fsm_trans_t* t;
+  int n_trans = 0, n_states = 0;
+
+  for (t = this->tt; t->orig_state >= 0; ++t) {
+    if (t->orig_state >= n_states)
+      n_states = t->orig_state + 1;
+    n_trans++;
+  }
+
+  this->n_states = n_states;
+  this->index = (int*) arena_calloc (n_states + 1, sizeof (int));
+  this->trans = (fsm_trans_t*) arena_malloc ((n_trans ? n_trans : 1) * sizeof (fsm_trans_t));
+
+  for (t = this->tt; t->orig_state >= 0; ++t)
+    this->index[t->orig_state + 1]++;
+  for (int s = 0; s < n_states; ++s)
+    this->index[s + 1] += this->index[s];
+
+  int fill[n_states ? n_states : 1];
+  for (int s = 0; s < n_states; ++s)
+    fill[s] = this->index[s];
+  for (t = this->tt; t->orig_state >= 0; ++t)
+    this->trans[fill[t->orig_state]++] = *t;
+}
+
 void
 fsm_init (fsm_t* this, int state, fsm_trans_t* tt, void* user_data)
 {
   this->current_state = state;
   this->tt = tt;
   this->user_data = user_data;
+  this->guard_evals = 0;
+  this->transitions = 0;
+#ifdef FSM_TRACE
+  this->trace = NULL;
+#endif
+  fsm_compile (this);
 }
 
 void
 fsm_destroy (fsm_t* this)
 {
-  free(this);
+  if (this) {
+#ifdef FSM_TRACE
+    if (this->trace) {
+      arena_free (this->trace->tt_pos);
+      arena_free (this->trace->fired);
+      arena_free (this->trace->out_sum_ns);
+      arena_free (this->trace->out_max_ns);
+      arena_free (this->trace->out_hist);
+      arena_free (this->trace);
+    }
+#endif
+    arena_free (this->index);
+    arena_free (this->trans);
+    arena_free (this);
+  }
+}
+
+#ifdef FSM_TRACE
+static unsigned long long
+fsm_trace_now_ns (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (unsigned long long) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Runs the output of t timing it, and records the transition */
+static void
+fsm_trace_fire (fsm_t* this, fsm_trans_t* t)
+{
+  fsm_trace_t* tr = this->trace;
+  unsigned long long t0 = fsm_trace_now_ns ();
+  if (t->out)
+    t->out(this);
+  unsigned int out_ns = (unsigned int) (fsm_trace_now_ns () - t0);
+
+  int pos = tr->tt_pos[t - this->trans];
+  tr->fired[pos]++;
+  tr->out_sum_ns[pos] += out_ns;
+  if (out_ns > tr->out_max_ns[pos])
+    tr->out_max_ns[pos] = out_ns;
+
+  int bucket = 0;
+  for (unsigned int us = out_ns / 1000; us && bucket < FSM_TRACE_HIST_BUCKETS - 1; us >>= 1)
+    bucket++;
+  tr->out_hist[pos][bucket]++;
+
+  unsigned long head = atomic_load_explicit (&tr->head, memory_order_relaxed);
+  fsm_trace_entry_t* e = &tr->ring[head & (FSM_TRACE_RING_LEN - 1)];
+  e->timestamp_ns = t0;
+  e->out_ns = out_ns;
+  e->trans = pos;
+  atomic_store_explicit (&tr->head, head + 1, memory_order_release);
+}
+
+/* Must be called before the FSM is fired from another thread */
+void
+fsm_trace_enable (fsm_t* this)
+{
+  if (this->trace)
+    return;
+
+  int n_trans = this->index[this->n_states];
+  int n = n_trans ? n_trans : 1;
+  fsm_trace_t* tr = (fsm_trace_t*) arena_calloc (1, sizeof (fsm_trace_t));
+  tr->tt_pos = (int*) arena_malloc (n * sizeof (int));
+  tr->fired = (unsigned long*) arena_calloc (n, sizeof (unsigned long));
+  tr->out_sum_ns = (unsigned long long*) arena_calloc (n, sizeof (unsigned long long));
+  tr->out_max_ns = (unsigned int*) arena_calloc (n, sizeof (unsigned int));
+  tr->out_hist = arena_calloc (n, sizeof (*tr->out_hist));
+  atomic_init (&tr->head, 0);
+
+  /* same counting sort as fsm_compile, remembering where each row came from */
+  int fill[this->n_states ? this->n_states : 1];
+  for (int s = 0; s < this->n_states; ++s)
+    fill[s] = this->index[s];
+  for (int i = 0; i < n_trans; ++i)
+    tr->tt_pos[fill[this->tt[i].orig_state]++] = i;
+
+  this->trace = tr;
 }
 
 void
+fsm_trace_dump (fsm_t* this, const char* name, FILE* out)
+{
+  fsm_trace_t* tr = this->trace;
+  if (!tr)
+    return;
+
+  for (int i = 0; i < this->index[this->n_states]; ++i) {
+    if (!tr->fired[i])
+      continue;
+    fprintf (out, "[LOG-Trace] %-12s #%-2d %d -> %d fired %lu out avg %.1f us max %.1f us |", name, i, this->tt[i].orig_state, this->tt[i].dest_state, tr->fired[i],
+             tr->out_sum_ns[i] / 1e3 / tr->fired[i], tr->out_max_ns[i] / 1e3);
+    for (int b = 0; b < FSM_TRACE_HIST_BUCKETS; ++b)
+      if (tr->out_hist[i][b])
+        fprintf (out, " %s%uus:%lu", b == FSM_TRACE_HIST_BUCKETS - 1 ? ">=" : "<", 1u << (b == FSM_TRACE_HIST_BUCKETS - 1 ? b - 1 : b), tr->out_hist[i][b]);
+    fprintf (out, "\n");
+  }
+
+  /* copy the ring, then keep only the entries that were not being overwritten: the writer fills
+     slot head before it bumps head, so the oldest slot may already be taken by the next entry */
+  fsm_trace_entry_t ring[FSM_TRACE_RING_LEN];
+  unsigned long head = atomic_load_explicit (&tr->head, memory_order_acquire);
+  unsigned long first = head > FSM_TRACE_RING_LEN ? head - FSM_TRACE_RING_LEN : 0;
+  for (unsigned long h = first; h < head; ++h)
+    ring[h & (FSM_TRACE_RING_LEN - 1)] = tr->ring[h & (FSM_TRACE_RING_LEN - 1)];
+  unsigned long head2 = atomic_load_explicit (&tr->head, memory_order_acquire);
+  if (head2 + 1 > first + FSM_TRACE_RING_LEN)
+    first = head2 + 1 - FSM_TRACE_RING_LEN;
+
+  for (unsigned long h = first; h < head; ++h) {
+    fsm_trace_entry_t* e = &ring[h & (FSM_TRACE_RING_LEN - 1)];
+    fprintf (out, "[LOG-Trace] %-12s %llu.%09llu #%-2d %d -> %d out %.1f us\n", name, e->timestamp_ns / 1000000000ULL, e->timestamp_ns % 1000000000ULL, e->trans,
+             this->tt[e->trans].orig_state, this->tt[e->trans].dest_state, e->out_ns / 1e3);
+  }
+}
+#endif
+
+int
 fsm_fire (fsm_t* this)
 {
-  fsm_trans_t* t;
-  for (t = this->tt; t->orig_state >= 0; ++t) {
-    if ((this->current_state == t->orig_state) && t->in(this)) {
+  int s = this->current_state;
+  if (s < 0 || s >= this->n_states)
+    return 0;
+
+  fsm_trans_t* t = this->trans + this->index[s];
+  fsm_trans_t* end = this->trans + this->index[s + 1];
+  for (; t < end; ++t) {
+    this->guard_evals++;
+    if (t->in(this)) {
+      this->transitions++;
       this->current_state = t->dest_state;
+#ifdef FSM_TRACE
+      if (this->trace) {
+        fsm_trace_fire (this, t);
+        return 1;
+      }
+#endif
       if (t->out)
         t->out(this);
-      break;
+      return 1;
     }
   }
+  return 0;
+}
+
+/* Fires until no transition is enabled (or max_fires transitions), returns
+   the number of transitions fired */
+int
+fsm_fire_until_stable (fsm_t* this, int max_fires)
+{
+  int fires = 0;
+  while (fires < max_fires && fsm_fire (this))
+    fires++;
+  return fires;
 }
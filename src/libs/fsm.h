@@ -8,6 +8,11 @@
 #ifndef FSM_H_
 #define FSM_H_
 
+#ifdef FSM_TRACE
+#include <stdio.h>
+#include <stdatomic.h>
+#endif
+
 typedef struct fsm_t fsm_t;
 
 typedef int (*fsm_input_func_t) (fsm_t*);
@@ -20,15 +25,61 @@ typedef struct fsm_trans_t {
   fsm_output_func_t out;
 } fsm_trans_t;
 
+#ifdef FSM_TRACE
+/* Opt-in instrumentation (build with -DFSM_TRACE, then fsm_trace_enable):
+   per transition fire count and output latency histogram, and a ring of
+   the last FSM_TRACE_RING_LEN transitions */
+#define FSM_TRACE_HIST_BUCKETS 20	/* < 1 us, < 2 us, < 4 us ... last one open */
+#define FSM_TRACE_RING_LEN 64	/* power of two */
+
+typedef struct fsm_trace_entry_t {
+  unsigned long long timestamp_ns;	/* CLOCK_MONOTONIC, when the guard was found enabled */
+  unsigned int out_ns;	/* time spent in the output function */
+  int trans;	/* position in the transition table */
+} fsm_trace_entry_t;
+
+typedef struct fsm_trace_t {
+  int* tt_pos;	/* position in tt of each compiled transition */
+  unsigned long* fired;	/* per tt position */
+  unsigned long long* out_sum_ns;
+  unsigned int* out_max_ns;
+  unsigned long (*out_hist)[FSM_TRACE_HIST_BUCKETS];
+
+  /* written only by the thread firing the FSM, readers copy and then
+     drop what head says may have been overwritten meanwhile */
+  fsm_trace_entry_t ring[FSM_TRACE_RING_LEN];
+  atomic_ulong head;
+} fsm_trace_t;
+#endif
+
 struct fsm_t {
   int current_state;
   fsm_trans_t* tt;
   void* user_data;
+
+  /* tt compiled by fsm_init: the transitions leaving state s are
+     trans[index[s]] .. trans[index[s + 1] - 1], in table order */
+  int n_states;
+  int* index;
+  fsm_trans_t* trans;
+
+  unsigned long guard_evals;	/* input functions called */
+  unsigned long transitions;	/* transitions fired */
+
+#ifdef FSM_TRACE
+  fsm_trace_t* trace;	/* NULL while tracing is disabled */
+#endif
 };
 
 fsm_t* fsm_new (int state, fsm_trans_t* tt, void* user_data);
 void fsm_init (fsm_t* this, int state, fsm_trans_t* tt, void* user_data);
-void fsm_fire (fsm_t* this);
+int fsm_fire (fsm_t* this);
+int fsm_fire_until_stable (fsm_t* this, int max_fires);
 void fsm_destroy (fsm_t* this);
 
+#ifdef FSM_TRACE
+void fsm_trace_enable (fsm_t* this);
+void fsm_trace_dump (fsm_t* this, const char* name, FILE* out);
+#endif
+
 #endif /* FSM_H_ */
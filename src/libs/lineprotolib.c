@@ -0,0 +1,168 @@
+/*
+ * lineprotolib.c
+ *
+ *  Created on: 17 oct. 2026
+ *      Author: Victoria M. Gullon and Marcos Gomez
+ */
+
+#include <string.h>
+
+#include "lineprotolib.h"
+
+static const uint64_t _scale = 1000000; // 10^LINEPROTO_DECIMALS
+
+static const char _digit_pairs[201] = "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+		"40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+		"8081828384858687888990919293949596979899";
+
+// Digits of value, two at a time from the right
+static size_t _format_uint(char *out, uint64_t value) {
+	char tmp[20];
+	char *p = tmp + sizeof(tmp);
+
+	while (value >= 100) {
+		unsigned int pair = (value % 100) * 2;
+		value /= 100;
+		*--p = _digit_pairs[pair + 1];
+		*--p = _digit_pairs[pair];
+	}
+	if (value >= 10) {
+		*--p = _digit_pairs[value * 2 + 1];
+		*--p = _digit_pairs[value * 2];
+	} else {
+		*--p = '0' + value;
+	}
+
+	size_t len = tmp + sizeof(tmp) - p;
+	memcpy(out, p, len);
+	return len;
+}
+
+// Writes value with the 'i' suffix of the integer fields. Returns the length, at most LINEPROTO_NUMBER_LEN, not NUL terminated
+size_t lineproto_format_int(char *out, int64_t value) {
+	char *p = out;
+
+	if (value < 0) {
+		*p++ = '-';
+		p += _format_uint(p, -(uint64_t) value);
+	} else {
+		p += _format_uint(p, value);
+	}
+	*p++ = 'i';
+	return p - out;
+}
+
+// Writes a finite value, rounded to LINEPROTO_DECIMALS decimals. Returns the length, at most LINEPROTO_NUMBER_LEN, not NUL terminated
+size_t lineproto_format_float(char *out, double value) {
+	char *p = out;
+
+	if (value < 0) {
+		*p++ = '-';
+		value = -value;
+	}
+
+	if (value < LINEPROTO_FIXED_MAX) {
+		uint64_t scaled = (uint64_t) (value * _scale + 0.5);
+		uint64_t frac = scaled % _scale;
+		int digits = LINEPROTO_DECIMALS;
+
+		p += _format_uint(p, scaled / _scale);
+		if (frac) {
+			while (frac % 10 == 0) {
+				frac /= 10;
+				digits--;
+			}
+			*p++ = '.';
+			for (int i = digits - 1; i >= 0; i--) {
+				p[i] = '0' + frac % 10;
+				frac /= 10;
+			}
+			p += digits;
+		}
+	} else {
+		// d.dddddde<exponent>
+		int exponent = 0;
+		while (value >= 1e10) {
+			value /= 1e10;
+			exponent += 10;
+		}
+		while (value >= 10) {
+			value /= 10;
+			exponent++;
+		}
+		p += lineproto_format_float(p, value);
+		*p++ = 'e';
+		p += _format_uint(p, exponent);
+	}
+	return p - out;
+}
+
+// Copies a name escaping the characters the line protocol gives a meaning to. Returns 0 if it does not fit
+static int _put_name(char **p, char *end, const char *name, int escape_equals) {
+	char *q = *p;
+
+	for (; *name; name++) {
+		if (*name == ',' || *name == ' ' || (escape_equals && *name == '=')) {
+			if (q >= end)
+				return 0;
+			*q++ = '\\';
+		}
+		if (q >= end)
+			return 0;
+		*q++ = *name;
+	}
+	*p = q;
+	return 1;
+}
+
+// Writes "measurement,tag_key=tag_value field=value,... ts_ns" into buf, NUL terminated (tag_key NULL for no tag).
+// Returns the length, or -1 if it does not fit in size or no field is a number
+int lineproto_encode(char *buf, size_t size, const char *measurement, const char *tag_key, long tag_value, const lineproto_field_t *fields, unsigned int n_fields,
+		int64_t ts_ns) {
+	char *p = buf, *end = buf + size;
+	unsigned int written = 0;
+
+	if (!_put_name(&p, end, measurement, 0))
+		return -1;
+
+	if (tag_key) {
+		if (p >= end)
+			return -1;
+		*p++ = ',';
+		if (!_put_name(&p, end, tag_key, 1) || end - p < 1 + LINEPROTO_NUMBER_LEN)
+			return -1;
+		*p++ = '=';
+		if (tag_value < 0)
+			*p++ = '-';
+		p += _format_uint(p, tag_value < 0 ? -(uint64_t) tag_value : (uint64_t) tag_value);
+	}
+
+	for (unsigned int i = 0; i < n_fields; i++) {
+		const lineproto_field_t *f = &fields[i];
+
+		// NaN fails both comparisons
+		if (f->type == LINEPROTO_NONE || (f->type == LINEPROTO_FLOAT && !(f->val.f > -1e308 && f->val.f < 1e308)))
+			continue;
+
+		if (p >= end)
+			return -1;
+		*p++ = written++ ? ',' : ' ';
+		if (!_put_name(&p, end, f->key, 1) || end - p < 1 + LINEPROTO_NUMBER_LEN)
+			return -1;
+		*p++ = '=';
+		p += f->type == LINEPROTO_INT ? lineproto_format_int(p, f->val.i) : lineproto_format_float(p, f->val.f);
+	}
+	if (written == 0)
+		return -1;
+
+	// the timestamp and the NUL
+	if (end - p < 2 + LINEPROTO_NUMBER_LEN)
+		return -1;
+	*p++ = ' ';
+	if (ts_ns < 0)
+		*p++ = '-';
+	p += _format_uint(p, ts_ns < 0 ? -(uint64_t) ts_ns : (uint64_t) ts_ns);
+	*p = '\0';
+
+	return p - buf;
+}
@@ -0,0 +1,43 @@
+/*
+ * lineprotolib.h
+ *
+ * InfluxDB line protocol encoder: one point (measurement, one integer tag, fields and a
+ * nanosecond timestamp) written straight into a caller buffer, no allocation and no printf. The
+ * numbers have their own formatters: integers with the 'i' suffix of the integer fields, floats
+ * in fixed point with LINEPROTO_DECIMALS decimals and no trailing zeros, in exponent notation
+ * past LINEPROTO_FIXED_MAX. Fields that are not numbers (NaN, inf, a failed reading) are left
+ * out; a point with none left is not written, InfluxDB would reject it.
+ *
+ *  Created on: 17 oct. 2026
+ *      Author: Victoria M. Gullon and Marcos Gomez
+ */
+
+#ifndef LIBS_LINEPROTOLIB_H_
+#define LIBS_LINEPROTOLIB_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define LINEPROTO_DECIMALS 6 // as %f wrote them
+#define LINEPROTO_FIXED_MAX 1e12 // larger floats in exponent notation, their fixed point digits would not fit in 63 bits
+#define LINEPROTO_NUMBER_LEN 32 // longest formatted number
+
+typedef enum {
+	LINEPROTO_NONE, LINEPROTO_INT, LINEPROTO_FLOAT
+} lineproto_type_t;
+
+typedef struct {
+	const char *key;
+	lineproto_type_t type; // NONE: left out
+	union {
+		int64_t i;
+		double f;
+	} val;
+} lineproto_field_t;
+
+size_t lineproto_format_int(char *out, int64_t value);
+size_t lineproto_format_float(char *out, double value);
+int lineproto_encode(char *buf, size_t size, const char *measurement, const char *tag_key, long tag_value, const lineproto_field_t *fields, unsigned int n_fields,
+		int64_t ts_ns);
+
+#endif /* LIBS_LINEPROTOLIB_H_ */
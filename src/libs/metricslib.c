@@ -0,0 +1,300 @@
+/*
+ * metricslib.c
+ *
+ *  Created on: 17 oct. 2026
+ *      Author: Victoria M. Gullon and Marcos Gomez
+ */
+
+#define _GNU_SOURCE // memmem, accept4
+
+#include <stdio.h>
+#include <math.h> // isnan, isinf
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include "metricslib.h"
+#include "lineprotolib.h"
+#include "arenalib.h"
+
+static int64_t _now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* exposition format */
+
+// Appends len bytes if they fit whole, else leaves the rest of the render out
+static void _put(metrics_writer_t *w, const char *line, size_t len) {
+	if (w->overflow || w->len + len > w->size) {
+		w->overflow = 1;
+		return;
+	}
+	memcpy(w->buf + w->len, line, len);
+	w->len += len;
+}
+
+static char* _copy(char *p, char *end, const char *s) {
+	while (*s && p < end)
+		*p++ = *s++;
+	return p;
+}
+
+// "# HELP" and "# TYPE" of a family, before its samples
+void metrics_family(metrics_writer_t *w, const char *name, const char *type, const char *help) {
+	char line[METRICS_LINE_LEN * 2];
+	char *p = line, *end = line + sizeof(line) - 1;
+
+	p = _copy(p, end, "# HELP ");
+	p = _copy(p, end, name);
+	p = _copy(p, end, " ");
+	p = _copy(p, end, help);
+	p = _copy(p, end, "\n# TYPE ");
+	p = _copy(p, end, name);
+	p = _copy(p, end, " ");
+	p = _copy(p, end, type);
+	*p++ = '\n';
+	_put(w, line, p - line);
+}
+
+// One sample, labels as they go between the braces (room="1",channel="temp") or NULL
+void metrics_sample(metrics_writer_t *w, const char *name, const char *labels, double value) {
+	char line[METRICS_LINE_LEN];
+	char *p = line, *end = line + sizeof(line) - LINEPROTO_NUMBER_LEN - 2;
+
+	p = _copy(p, end, name);
+	if (labels && *labels) {
+		p = _copy(p, end, "{");
+		p = _copy(p, end, labels);
+		p = _copy(p, end, "}");
+	}
+	*p++ = ' ';
+	if (isnan(value))
+		p = _copy(p, p + 3, "NaN");
+	else if (isinf(value))
+		p = _copy(p, p + 4, value > 0 ? "+Inf" : "-Inf");
+	else
+		p += lineproto_format_float(p, value);
+	*p++ = '\n';
+	_put(w, line, p - line);
+}
+
+/* server */
+
+static void _close(metrics_server_t *this, metrics_conn_t *c) {
+	epoll_ctl(this->epfd, EPOLL_CTL_DEL, c->fd, NULL);
+	close(c->fd);
+	c->fd = -1;
+}
+
+// Writes what is pending. Returns -1 if the connection is gone
+static int _flush(metrics_server_t *this, metrics_conn_t *c) {
+	while (c->pending_len) {
+		ssize_t n = write(c->fd, c->pending, c->pending_len);
+		if (n < 0 && errno == EAGAIN) {
+			struct epoll_event ev = { .events = EPOLLOUT | EPOLLRDHUP, .data.ptr = c };
+			epoll_ctl(this->epfd, EPOLL_CTL_MOD, c->fd, &ev);
+			return 0;
+		}
+		if (n <= 0)
+			return -1;
+		c->pending += n;
+		c->pending_len -= n;
+	}
+	if (c->close_after)
+		return -1;
+
+	struct epoll_event ev = { .events = EPOLLIN | EPOLLRDHUP, .data.ptr = c };
+	epoll_ctl(this->epfd, EPOLL_CTL_MOD, c->fd, &ev);
+	return 0;
+}
+
+// Puts the status line and headers right before the body at out + METRICS_HEADER_BYTES
+static void _respond(metrics_server_t *this, metrics_conn_t *c, const char *status, size_t body_len) {
+	char header[METRICS_HEADER_BYTES];
+	int len = snprintf(header, sizeof(header), "HTTP/1.1 %s\r\nContent-Type: text/plain; version=0.0.4; charset=utf-8\r\nContent-Length: %zu\r\n%s\r\n", status, body_len,
+			c->close_after ? "Connection: close\r\n" : "");
+
+	c->pending = c->out + METRICS_HEADER_BYTES - len;
+	memcpy((char*) c->pending, header, len);
+	c->pending_len = len + body_len;
+}
+
+// Answers the request at the start of in, header_len bytes
+static void _handle(metrics_server_t *this, metrics_conn_t *c, size_t header_len) {
+	char *req = c->in, *eol = memchr(req, '\r', header_len);
+	size_t line_len = eol - req;
+
+	// keep-alive unless HTTP/1.0 or asked to close
+	c->in[header_len - 1] = '\0';
+	c->close_after = line_len < 9 || memcmp(eol - 8, "HTTP/1.1", 8) != 0 || strstr(eol, "onnection: close") != NULL;
+
+	if (line_len >= 13 && memcmp(req, "GET /metrics", 12) == 0 && (req[12] == ' ' || req[12] == '?')) {
+		metrics_writer_t w = { c->out + METRICS_HEADER_BYTES, METRICS_RESPONSE_BYTES - METRICS_HEADER_BYTES, 0, 0 };
+		int64_t t0 = _now_ns();
+
+		this->render(this->user_data, &w);
+
+		unsigned long long render_ns = _now_ns() - t0;
+		this->render_sum_ns += render_ns;
+		if (render_ns > this->render_max_ns)
+			this->render_max_ns = render_ns;
+		this->scrapes++;
+		this->overflows += w.overflow;
+		this->bytes += w.len;
+		_respond(this, c, "200 OK", w.len);
+	} else {
+		static const char *not_found = "Only /metrics here\n";
+		size_t len = strlen(not_found);
+		memcpy(c->out + METRICS_HEADER_BYTES, not_found, len);
+		this->errors++;
+		_respond(this, c, memcmp(req, "GET ", 4) == 0 ? "404 Not Found" : "405 Method Not Allowed", len);
+	}
+}
+
+// Answers every complete request in the buffer, in order: a pipelined one waits for the response before it to be written. Returns -1 if the connection is gone
+static int _process(metrics_server_t *this, metrics_conn_t *c) {
+	char *end;
+
+	while (c->pending_len == 0 && (end = memmem(c->in, c->in_len, "\r\n\r\n", 4))) {
+		size_t header_len = end + 4 - c->in;
+		_handle(this, c, header_len);
+		memmove(c->in, c->in + header_len, c->in_len - header_len);
+		c->in_len -= header_len;
+		if (_flush(this, c) != 0)
+			return -1;
+	}
+	return 0;
+}
+
+static void _readable(metrics_server_t *this, metrics_conn_t *c) {
+	while (c->pending_len == 0) {
+		ssize_t n = read(c->fd, c->in + c->in_len, sizeof(c->in) - 1 - c->in_len);
+		if (n < 0 && errno == EAGAIN)
+			break;
+		if (n <= 0 || (c->in_len += n, _process(this, c)) != 0) {
+			_close(this, c);
+			return;
+		}
+		if (c->in_len >= sizeof(c->in) - 1) {
+			// a header longer than the buffer
+			this->errors++;
+			_close(this, c);
+			return;
+		}
+	}
+}
+
+static void _accept(metrics_server_t *this) {
+	int fd;
+
+	while ((fd = accept4(this->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+		metrics_conn_t *c = NULL;
+		for (int i = 0; i < METRICS_MAX_CONNECTIONS && !c; i++)
+			if (this->conns[i].fd < 0)
+				c = &this->conns[i];
+		if (!c) {
+			this->refused++;
+			close(fd);
+			continue;
+		}
+
+		int one = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+		c->fd = fd;
+		c->in_len = 0;
+		c->pending_len = 0;
+		c->close_after = 0;
+		struct epoll_event ev = { .events = EPOLLIN | EPOLLRDHUP, .data.ptr = c };
+		epoll_ctl(this->epfd, EPOLL_CTL_ADD, fd, &ev);
+	}
+}
+
+static void* _serve(void *arg) {
+	metrics_server_t *this = (metrics_server_t*) arg;
+	struct epoll_event evs[METRICS_MAX_CONNECTIONS + 2];
+
+	while (1) {
+		int n = epoll_wait(this->epfd, evs, METRICS_MAX_CONNECTIONS + 2, -1);
+		for (int i = 0; i < n; i++) {
+			metrics_conn_t *c = (metrics_conn_t*) evs[i].data.ptr;
+
+			if (c == NULL)
+				return NULL; // the eventfd: stop
+			if (c == (metrics_conn_t*) this) {
+				_accept(this);
+				continue;
+			}
+			if (c->fd < 0)
+				continue; // closed by an earlier event of this round
+			if (evs[i].events & (EPOLLERR | EPOLLHUP))
+				_close(this, c);
+			else if (evs[i].events & EPOLLOUT) {
+				if (_flush(this, c) != 0 || _process(this, c) != 0)
+					_close(this, c);
+			} else
+				_readable(this, c); // a peer that closed is seen by the read
+		}
+	}
+}
+
+// Listens on every interface at port (0: any free one) and starts the server thread. Returns NULL if the port cannot be bound
+metrics_server_t* metrics_new(int port, metrics_render_func_t render, void *user_data) {
+	int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0), one = 1;
+	struct sockaddr_in addr = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_ANY), .sin_port = htons(port) };
+	socklen_t addr_len = sizeof(addr);
+
+	if (fd < 0)
+		return NULL;
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	if (bind(fd, (struct sockaddr*) &addr, sizeof(addr)) != 0 || listen(fd, 16) != 0) {
+		close(fd);
+		return NULL;
+	}
+	getsockname(fd, (struct sockaddr*) &addr, &addr_len);
+
+	metrics_server_t *this = (metrics_server_t*) arena_calloc(1, sizeof(metrics_server_t));
+	this->listen_fd = fd;
+	this->port = ntohs(addr.sin_port);
+	this->render = render;
+	this->user_data = user_data;
+	for (int i = 0; i < METRICS_MAX_CONNECTIONS; i++) {
+		this->conns[i].fd = -1;
+		this->conns[i].out = (char*) arena_malloc(METRICS_RESPONSE_BYTES);
+	}
+
+	this->epfd = epoll_create1(EPOLL_CLOEXEC);
+	this->evfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	struct epoll_event ev = { .events = EPOLLIN, .data.ptr = NULL }; // NULL marks the stop eventfd, this the listening socket
+	epoll_ctl(this->epfd, EPOLL_CTL_ADD, this->evfd, &ev);
+	ev.data.ptr = this;
+	epoll_ctl(this->epfd, EPOLL_CTL_ADD, fd, &ev);
+
+	pthread_create(&this->thread, NULL, _serve, this);
+	return this;
+}
+
+void metrics_destroy(metrics_server_t *this) {
+	if (this) {
+		uint64_t one = 1;
+		write(this->evfd, &one, sizeof(one));
+		pthread_join(this->thread, NULL);
+
+		for (int i = 0; i < METRICS_MAX_CONNECTIONS; i++) {
+			if (this->conns[i].fd >= 0)
+				close(this->conns[i].fd);
+			arena_free(this->conns[i].out);
+		}
+		close(this->listen_fd);
+		close(this->evfd);
+		close(this->epfd);
+		arena_free(this);
+	}
+}
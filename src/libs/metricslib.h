@@ -0,0 +1,72 @@
+/*
+ * metricslib.h
+ *
+ * Embedded pull endpoint: a thread of its own serving GET /metrics in the Prometheus text
+ * exposition format, on epoll with non-blocking sockets and HTTP/1.1 keep-alive, nothing but
+ * libc. Every scrape calls the render callback, which writes the families and samples of the
+ * moment with metrics_family and metrics_sample. The connection slots and their response buffers
+ * are carved once when the server is created: a scrape allocates nothing, and a render that does
+ * not fit in METRICS_RESPONSE_BYTES is cut at the last whole sample (counted in overflows). A
+ * connection finding every slot taken is closed at once.
+ *
+ *  Created on: 17 oct. 2026
+ *      Author: Victoria M. Gullon and Marcos Gomez
+ */
+
+#ifndef LIBS_METRICSLIB_H_
+#define LIBS_METRICSLIB_H_
+
+#include <stddef.h>
+#include <pthread.h>
+
+#define METRICS_DEFAULT_PORT 9110
+#define METRICS_MAX_CONNECTIONS 4 // Prometheus keeps one per target
+#define METRICS_REQUEST_BYTES 2048 // longest request header
+#define METRICS_RESPONSE_BYTES 65536 // status line, headers and body
+#define METRICS_HEADER_BYTES 160 // room left before the body for the status line and headers
+#define METRICS_LINE_LEN 256 // longest sample line
+
+typedef struct {
+	char *buf;
+	size_t size;
+	size_t len;
+	int overflow; // a line did not fit, it and the ones after it were left out
+} metrics_writer_t;
+
+typedef void (*metrics_render_func_t)(void *user_data, metrics_writer_t *w);
+
+typedef struct {
+	int fd; // -1 for a free slot
+	char in[METRICS_REQUEST_BYTES];
+	size_t in_len;
+	char *out; // METRICS_RESPONSE_BYTES
+	const char *pending; // response bytes not written yet
+	size_t pending_len;
+	int close_after; // the client asked for it, or a bad request
+} metrics_conn_t;
+
+typedef struct {
+	int listen_fd;
+	int port; // bound, the one asked for or the one the system gave for 0
+	int epfd;
+	int evfd; // wakes the thread to stop
+	pthread_t thread;
+	metrics_render_func_t render;
+	void *user_data;
+	metrics_conn_t conns[METRICS_MAX_CONNECTIONS];
+
+	// statistics, written by the server thread
+	unsigned long scrapes;
+	unsigned long errors; // requests answered with an error status
+	unsigned long refused; // connections closed for want of a slot
+	unsigned long overflows; // renders cut short
+	unsigned long long bytes; // bodies served
+	unsigned long long render_sum_ns, render_max_ns;
+} metrics_server_t;
+
+metrics_server_t* metrics_new(int port, metrics_render_func_t render, void *user_data);
+void metrics_destroy(metrics_server_t *this);
+void metrics_family(metrics_writer_t *w, const char *name, const char *type, const char *help);
+void metrics_sample(metrics_writer_t *w, const char *name, const char *labels, double value);
+
+#endif /* LIBS_METRICSLIB_H_ */
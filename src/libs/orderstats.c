@@ -0,0 +1,192 @@
+/*
+ * orderstats.c
+ *
+ *  Created on: 17 oct. 2026
+ *      Author: Victoria M. Gullon and Marcos Gomez
+ */
+
+#include <stdlib.h>
+
+#include "orderstats.h"
+#include "arenalib.h"
+
+#define NIL -1
+
+static int _random_level(order_stats_t *this) {
+	int level = 1;
+
+	// xorshift32, deterministic and cheap
+	this->seed ^= this->seed << 13;
+	this->seed ^= this->seed >> 17;
+	this->seed ^= this->seed << 5;
+
+	unsigned int bits = this->seed;
+	while ((bits & 3) == 0 && level < ORDER_STATS_MAX_LEVEL) {
+		level++;
+		bits >>= 2;
+	}
+	return level;
+}
+
+order_stats_t* order_stats_new(unsigned int capacity) {
+	order_stats_t *this = (order_stats_t*) arena_malloc(sizeof(order_stats_t));
+	this->nodes = (order_stats_node_t*) arena_malloc((capacity + 1) * sizeof(order_stats_node_t));
+	this->capacity = capacity;
+	this->seed = 0x9e3779b9;
+	order_stats_reset(this);
+
+	return this;
+}
+
+void order_stats_destroy(order_stats_t *this) {
+	if (this) {
+		arena_free(this->nodes);
+		arena_free(this);
+	}
+}
+
+void order_stats_reset(order_stats_t *this) {
+	order_stats_node_t *head = &this->nodes[0];
+
+	for (int i = 0; i < ORDER_STATS_MAX_LEVEL; i++) {
+		head->next[i] = NIL;
+		head->width[i] = 0;
+	}
+	this->size = 0;
+	this->level = 1;
+
+	this->free_list = NIL;
+	for (int i = this->capacity; i >= 1; i--) {
+		this->nodes[i].next[0] = this->free_list;
+		this->free_list = i;
+	}
+}
+
+// Returns 0, or -1 if the list is full
+int order_stats_insert(order_stats_t *this, double value) {
+	int update[ORDER_STATS_MAX_LEVEL];
+	unsigned int rank[ORDER_STATS_MAX_LEVEL];
+	order_stats_node_t *nodes = this->nodes;
+
+	if (this->free_list == NIL)
+		return -1;
+
+	// last node before the value on every level and its rank
+	int x = 0;
+	for (int i = this->level - 1; i >= 0; i--) {
+		rank[i] = i == this->level - 1 ? 0 : rank[i + 1];
+		while (nodes[x].next[i] != NIL && nodes[nodes[x].next[i]].value < value) {
+			rank[i] += nodes[x].width[i];
+			x = nodes[x].next[i];
+		}
+		update[i] = x;
+	}
+
+	int level = _random_level(this);
+	if (level > this->level) {
+		for (int i = this->level; i < level; i++) {
+			rank[i] = 0;
+			update[i] = 0;
+			nodes[0].width[i] = this->size;
+		}
+		this->level = level;
+	}
+
+	int n = this->free_list;
+	this->free_list = nodes[n].next[0];
+	nodes[n].value = value;
+
+	for (int i = 0; i < level; i++) {
+		nodes[n].next[i] = nodes[update[i]].next[i];
+		nodes[update[i]].next[i] = n;
+		nodes[n].width[i] = nodes[update[i]].width[i] - (rank[0] - rank[i]);
+		nodes[update[i]].width[i] = rank[0] - rank[i] + 1;
+	}
+	for (int i = level; i < this->level; i++)
+		nodes[update[i]].width[i]++;
+
+	this->size++;
+	return 0;
+}
+
+// Removes one occurrence of the value. Returns 0, or -1 if it is not in the list
+int order_stats_remove(order_stats_t *this, double value) {
+	int update[ORDER_STATS_MAX_LEVEL];
+	order_stats_node_t *nodes = this->nodes;
+
+	int x = 0;
+	for (int i = this->level - 1; i >= 0; i--) {
+		while (nodes[x].next[i] != NIL && nodes[nodes[x].next[i]].value < value)
+			x = nodes[x].next[i];
+		update[i] = x;
+	}
+
+	x = nodes[x].next[0];
+	if (x == NIL || nodes[x].value != value)
+		return -1;
+
+	for (int i = 0; i < this->level; i++) {
+		if (nodes[update[i]].next[i] == x) {
+			nodes[update[i]].width[i] += nodes[x].width[i] - 1;
+			nodes[update[i]].next[i] = nodes[x].next[i];
+		} else {
+			nodes[update[i]].width[i]--;
+		}
+	}
+	while (this->level > 1 && nodes[0].next[this->level - 1] == NIL)
+		this->level--;
+
+	nodes[x].next[0] = this->free_list;
+	this->free_list = x;
+	this->size--;
+	return 0;
+}
+
+// node of rank, which must be in range
+static int _select_node(order_stats_t *this, unsigned int rank) {
+	order_stats_node_t *nodes = this->nodes;
+	unsigned int traversed = 0;
+
+	int x = 0;
+	for (int i = this->level - 1; i >= 0; i--) {
+		while (nodes[x].next[i] != NIL && traversed + nodes[x].width[i] <= rank + 1) {
+			traversed += nodes[x].width[i];
+			x = nodes[x].next[i];
+		}
+		if (traversed == rank + 1)
+			break;
+	}
+	return x;
+}
+
+// k-th smallest value, rank 0 is the minimum. Returns 0, or -1 if rank is out of range
+int order_stats_select(order_stats_t *this, unsigned int rank, double *value) {
+	if (rank >= this->size)
+		return -1;
+
+	*value = this->nodes[_select_node(this, rank)].value;
+	return 0;
+}
+
+// Linear interpolation between the closest ranks, percentile 50 is the median. Returns 0, or -1 if the list is empty
+int order_stats_percentile(order_stats_t *this, double percentile, double *value) {
+	if (this->size == 0)
+		return -1;
+
+	double pos = percentile / 100.0 * (this->size - 1);
+	if (pos < 0)
+		pos = 0;
+	if (pos > this->size - 1)
+		pos = this->size - 1;
+
+	unsigned int k = (unsigned int) pos;
+	int x = _select_node(this, k);
+	double lo = this->nodes[x].value;
+	if (k + 1 < this->size && pos > k) {
+		double hi = this->nodes[this->nodes[x].next[0]].value; // rank k + 1 is the next node
+		*value = lo + (hi - lo) * (pos - k);
+	} else {
+		*value = lo;
+	}
+	return 0;
+}
@@ -0,0 +1,41 @@
+/*
+ * orderstats.h
+ *
+ * Indexable skiplist of doubles: insert, remove and select the k-th smallest value in O(log n).
+ * Every link also stores how many values it skips, so ranks are found on the way down. Nodes
+ * come from a pool allocated at creation, no allocation after that. Meant for sliding window
+ * medians and percentiles: insert the new sample, remove the one leaving the window.
+ *
+ *  Created on: 17 oct. 2026
+ *      Author: Victoria M. Gullon and Marcos Gomez
+ */
+
+#ifndef LIBS_ORDERSTATS_H_
+#define LIBS_ORDERSTATS_H_
+
+#define ORDER_STATS_MAX_LEVEL 8 // one level every 4 nodes, fine up to 65536 values
+
+typedef struct {
+	double value;
+	int next[ORDER_STATS_MAX_LEVEL]; // node index, -1 at the end
+	unsigned int width[ORDER_STATS_MAX_LEVEL]; // values skipped by the link, the node it lands on included
+} order_stats_node_t;
+
+typedef struct {
+	order_stats_node_t *nodes; // nodes[0] is the head
+	unsigned int capacity;
+	unsigned int size;
+	int level;
+	int free_list; // unused nodes chained through next[0]
+	unsigned int seed;
+} order_stats_t;
+
+order_stats_t* order_stats_new(unsigned int capacity);
+void order_stats_destroy(order_stats_t *this);
+void order_stats_reset(order_stats_t *this);
+int order_stats_insert(order_stats_t *this, double value);
+int order_stats_remove(order_stats_t *this, double value);
+int order_stats_select(order_stats_t *this, unsigned int rank, double *value);
+int order_stats_percentile(order_stats_t *this, double percentile, double *value);
+
+#endif /* LIBS_ORDERSTATS_H_ */
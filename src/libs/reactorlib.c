@@ -0,0 +1,275 @@
+/*
+ * reactorlib.c
+ *
+ *  Created on: 17 oct. 2026
+ *      Author: Victoria M. Gullon and Marcos Gomez
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+
+#include "reactorlib.h"
+#include "arenalib.h"
+
+static void _reactor_timer_cb(int fd, void *user_data);
+static void _reactor_flags_changed(unsigned int changed, void *user_data);
+static void _reactor_dispatch(reactor_t *this, unsigned int events, unsigned int *changed);
+static long long _reactor_now_ns(void);
+
+reactor_t* reactor_new(void) {
+	reactor_t *this = (reactor_t*) arena_calloc(1, sizeof(reactor_t));
+
+	this->epfd = epoll_create1(EPOLL_CLOEXEC);
+	this->evfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	atomic_init(&this->pending, 0);
+	this->running = 0;
+
+	struct epoll_event ev = { .events = EPOLLIN, .data.ptr = NULL }; // NULL marks the wake-up eventfd
+	epoll_ctl(this->epfd, EPOLL_CTL_ADD, this->evfd, &ev);
+
+	return this;
+}
+
+void reactor_destroy(reactor_t *this) {
+	if (this) {
+		for (int i = 0; i < this->n_sources; i++) {
+			if (this->sources[i].cb == _reactor_timer_cb)
+				close(this->sources[i].fd); // timerfds are owned by the reactor
+		}
+		for (int k = 0; k < this->n_flags; k++)
+			flags_remove_listener(this->flags[k].flags, _reactor_flags_changed, &this->flags[k]);
+		close(this->evfd);
+		close(this->epfd);
+		arena_free(this);
+	}
+}
+
+int reactor_add_fsm(reactor_t *this, fsm_t *fsm, unsigned int events) {
+	if (this->n_fsms >= REACTOR_MAX_FSMS)
+		return -1;
+
+	this->fsms[this->n_fsms].fsm = fsm;
+	this->fsms[this->n_fsms].events = events;
+	this->fsms[this->n_fsms].n_subs = 0;
+	this->fsms[this->n_fsms].last_rates_ns = _reactor_now_ns();
+	return this->n_fsms++;
+}
+
+// Fires the FSM whenever a bit of mask changes in flags. Must be called before other threads start changing the flags
+int reactor_subscribe_flags(reactor_t *this, int fsm_idx, flags_t *flags, unsigned int mask) {
+	if (fsm_idx < 0 || fsm_idx >= this->n_fsms)
+		return -1;
+
+	reactor_fsm_t *rf = &this->fsms[fsm_idx];
+	int k, s;
+	for (k = 0; k < this->n_flags; k++) {
+		if (this->flags[k].flags == flags)
+			break;
+	}
+
+	if (k == this->n_flags) {
+		if (this->n_flags >= REACTOR_MAX_FLAGS)
+			return -1;
+
+		reactor_flags_t *watch = &this->flags[k];
+		watch->flags = flags;
+		watch->mask = 0;
+		atomic_init(&watch->changed, 0);
+		watch->reactor = this;
+		if (flags_add_listener(flags, _reactor_flags_changed, watch) < 0)
+			return -1;
+		this->n_flags++;
+	}
+
+	for (s = 0; s < rf->n_subs; s++) {
+		if (rf->subs[s].flags == k)
+			break;
+	}
+	if (s == rf->n_subs) {
+		if (rf->n_subs >= REACTOR_MAX_FSM_SUBS)
+			return -1;
+		rf->subs[s].flags = k;
+		rf->subs[s].mask = 0;
+		rf->n_subs++;
+	}
+
+	this->flags[k].mask |= mask;
+	rf->subs[s].mask |= mask;
+	return 0;
+}
+
+int reactor_add_fd(reactor_t *this, int fd, reactor_source_func_t cb, void *user_data) {
+	if (this->n_sources >= REACTOR_MAX_SOURCES)
+		return -1;
+
+	reactor_source_t *src = &this->sources[this->n_sources];
+	src->fd = fd;
+	src->cb = cb;
+	src->user_data = user_data;
+	src->events = 0;
+
+	struct epoll_event ev = { .events = EPOLLIN, .data.ptr = src };
+	if (epoll_ctl(this->epfd, EPOLL_CTL_ADD, fd, &ev) < 0)
+		return -1;
+
+	return this->n_sources++;
+}
+
+int reactor_add_timer(reactor_t *this, int ms, unsigned int events) {
+	int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (fd < 0)
+		return -1;
+
+	struct itimerspec spec;
+	spec.it_value.tv_sec = ms / 1000;
+	spec.it_value.tv_nsec = (ms % 1000) * 1000000;
+	spec.it_interval = spec.it_value;
+	timerfd_settime(fd, 0, &spec, NULL);
+
+	int idx = reactor_add_fd(this, fd, _reactor_timer_cb, this);
+	if (idx < 0) {
+		close(fd);
+		return -1;
+	}
+	this->sources[idx].events = events;
+
+	return idx;
+}
+
+// Safe to call from any thread (timer threads, wiringPi ISR threads, FSM outputs)
+void reactor_post(reactor_t *this, unsigned int events) {
+	unsigned int prev = atomic_fetch_or(&this->pending, events);
+
+	// only the first poster since the last dispatch needs to wake up the loop
+	if (prev == 0) {
+		uint64_t one = 1;
+		ssize_t r = write(this->evfd, &one, sizeof(one));
+		(void) r;
+	}
+}
+
+int reactor_run_once(reactor_t *this, int timeout_ms) {
+	struct epoll_event evs[REACTOR_MAX_SOURCES + 1];
+
+	int n = epoll_wait(this->epfd, evs, REACTOR_MAX_SOURCES + 1, timeout_ms);
+	if (n < 0)
+		return n; // EINTR, let the caller loop again
+
+	this->wakeups++;
+
+	for (int i = 0; i < n; i++) {
+		reactor_source_t *src = (reactor_source_t*) evs[i].data.ptr;
+		if (src == NULL) {
+			// drain the eventfd before collecting the pending bits (see reactor_post)
+			uint64_t cnt;
+			ssize_t r = read(this->evfd, &cnt, sizeof(cnt));
+			(void) r;
+		} else {
+			src->cb(src->fd, src->user_data);
+		}
+	}
+
+	// collected after pending: a flag change that found pending bits did not write the eventfd, but it is already in changed
+	unsigned int events = atomic_exchange(&this->pending, 0);
+	unsigned int changed[REACTOR_MAX_FLAGS];
+	unsigned int any_changed = 0;
+	for (int k = 0; k < this->n_flags; k++) {
+		changed[k] = atomic_exchange(&this->flags[k].changed, 0);
+		any_changed |= changed[k];
+	}
+
+	if (events || any_changed)
+		_reactor_dispatch(this, events, changed);
+
+	return n;
+}
+
+void reactor_run(reactor_t *this) {
+	this->running = 1;
+	while (this->running) {
+		reactor_run_once(this, -1);
+	}
+}
+
+void reactor_stop(reactor_t *this) {
+	this->running = 0;
+	uint64_t one = 1; // no event bits, just wake up the loop
+	ssize_t r = write(this->evfd, &one, sizeof(one));
+	(void) r;
+}
+
+// Guard evaluations and transitions per second of an FSM since the previous call
+void reactor_fsm_rates(reactor_t *this, int fsm_idx, double *guard_evals_s, double *transitions_s) {
+	reactor_fsm_t *rf = &this->fsms[fsm_idx];
+	long long now = _reactor_now_ns();
+	double elapsed = (now - rf->last_rates_ns) / 1e9;
+
+	*guard_evals_s = elapsed > 0 ? (rf->fsm->guard_evals - rf->last_guard_evals) / elapsed : 0.0;
+	*transitions_s = elapsed > 0 ? (rf->fsm->transitions - rf->last_transitions) / elapsed : 0.0;
+
+	rf->last_guard_evals = rf->fsm->guard_evals;
+	rf->last_transitions = rf->fsm->transitions;
+	rf->last_rates_ns = now;
+}
+
+/* helper functions */
+
+static void _reactor_timer_cb(int fd, void *user_data) {
+	reactor_t *this = (reactor_t*) user_data;
+	uint64_t expirations;
+
+	if (read(fd, &expirations, sizeof(expirations)) != sizeof(expirations))
+		return;
+
+	for (int i = 0; i < this->n_sources; i++) {
+		if (this->sources[i].fd == fd) {
+			atomic_fetch_or(&this->pending, this->sources[i].events);
+			break;
+		}
+	}
+}
+
+// flaglib listener, runs on the thread that changed the flags
+static void _reactor_flags_changed(unsigned int changed, void *user_data) {
+	reactor_flags_t *watch = (reactor_flags_t*) user_data;
+
+	changed &= watch->mask;
+	if (changed == 0)
+		return; // no FSM of this reactor reads these bits, do not wake it up
+
+	atomic_fetch_or(&watch->changed, changed);
+	reactor_post(watch->reactor, 0);
+}
+
+static long long _reactor_now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void _reactor_dispatch(reactor_t *this, unsigned int events, unsigned int *changed) {
+	long long t0 = _reactor_now_ns();
+
+	for (int i = 0; i < this->n_fsms; i++) {
+		reactor_fsm_t *rf = &this->fsms[i];
+		int ready = (rf->events & events) != 0;
+		for (int s = 0; s < rf->n_subs && !ready; s++)
+			ready = (rf->subs[s].mask & changed[rf->subs[s].flags]) != 0;
+		if (!ready)
+			continue;
+
+		// keep firing while the FSM moves, outputs usually enable the next transition
+		this->fires += fsm_fire_until_stable(this->fsms[i].fsm, REACTOR_MAX_CHAIN);
+	}
+
+	long long elapsed = _reactor_now_ns() - t0;
+	this->dispatches++;
+	this->dispatch_sum_ns += elapsed;
+	if (elapsed > this->dispatch_max_ns)
+		this->dispatch_max_ns = elapsed;
+}
@@ -0,0 +1,93 @@
+/*
+ * reactorlib.h
+ *
+ * Event-driven reactor built on epoll, eventfd and timerfd. Timers, button ISRs and sensor
+ * completions post event bits, the loop blocks until something is ready and then fires only
+ * the FSMs subscribed to the posted events. FSMs can also subscribe to bits of flag words
+ * (flaglib): they are fired again only when one of the bits their guards read changes.
+ *
+ *  Created on: 17 oct. 2026
+ *      Author: Victoria M. Gullon and Marcos Gomez
+ */
+
+#ifndef LIBS_REACTORLIB_H_
+#define LIBS_REACTORLIB_H_
+
+#include <stdatomic.h>
+
+#include "fsm.h"
+#include "flaglib.h"
+
+#define REACTOR_MAX_FSMS 64 // enough for the FSMs of every room of a gateway
+#define REACTOR_MAX_SOURCES 8
+#define REACTOR_MAX_FLAGS 32 // flag words watched by one reactor (two per room)
+#define REACTOR_MAX_FSM_SUBS 2 // flag words one FSM can subscribe to
+#define REACTOR_MAX_CHAIN 16 // max transitions fired in a row on the same FSM per dispatch
+
+typedef struct reactor_t reactor_t;
+
+typedef void (*reactor_source_func_t)(int fd, void *user_data);
+
+typedef struct {
+	fsm_t *fsm;
+	unsigned int events; // event bits this FSM reacts to
+	struct {
+		int flags; // index in the reactor's watched flag words
+		unsigned int mask; // bits of that word its guards read
+	} subs[REACTOR_MAX_FSM_SUBS];
+	int n_subs;
+
+	// guard_evals/transitions of the FSM at the last reactor_fsm_rates call
+	unsigned long last_guard_evals;
+	unsigned long last_transitions;
+	long long last_rates_ns;
+} reactor_fsm_t;
+
+typedef struct {
+	int fd;
+	reactor_source_func_t cb;
+	void *user_data;
+	unsigned int events; // event bits posted when a timer source expires (0 for plain fd sources)
+} reactor_source_t;
+
+typedef struct {
+	flags_t *flags;
+	unsigned int mask; // union of the bits subscribed by the FSMs
+	atomic_uint changed; // subscribed bits changed but not dispatched yet
+	reactor_t *reactor;
+} reactor_flags_t;
+
+struct reactor_t {
+	int epfd; // epoll instance
+	int evfd; // eventfd used to wake up the loop from other threads
+	atomic_uint pending; // event bits posted but not dispatched yet
+	volatile int running;
+
+	reactor_fsm_t fsms[REACTOR_MAX_FSMS];
+	int n_fsms;
+	reactor_source_t sources[REACTOR_MAX_SOURCES];
+	int n_sources;
+	reactor_flags_t flags[REACTOR_MAX_FLAGS];
+	int n_flags;
+
+	// statistics
+	unsigned long wakeups; // times epoll_wait returned
+	unsigned long fires; // transitions fired
+	long long dispatch_max_ns; // longest dispatch, i.e. the worst main loop stall caused by FSM outputs
+	long long dispatch_sum_ns;
+	unsigned long dispatches;
+};
+
+reactor_t* reactor_new(void);
+void reactor_destroy(reactor_t *this);
+int reactor_add_fsm(reactor_t *this, fsm_t *fsm, unsigned int events);
+int reactor_subscribe_flags(reactor_t *this, int fsm_idx, flags_t *flags, unsigned int mask);
+int reactor_add_fd(reactor_t *this, int fd, reactor_source_func_t cb, void *user_data);
+int reactor_add_timer(reactor_t *this, int ms, unsigned int events);
+void reactor_post(reactor_t *this, unsigned int events);
+int reactor_run_once(reactor_t *this, int timeout_ms);
+void reactor_run(reactor_t *this);
+void reactor_stop(reactor_t *this);
+void reactor_fsm_rates(reactor_t *this, int fsm_idx, double *guard_evals_s, double *transitions_s);
+
+#endif /* LIBS_REACTORLIB_H_ */
@@ -0,0 +1,195 @@
+/*
+ * rolluplib.c
+ *
+ *  Created on: 17 oct. 2026
+ *      Author: Victoria M. Gullon and Marcos Gomez
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "rolluplib.h"
+#include "arenalib.h"
+
+#define ROLLUP_LOG_PAGE_RECORDS (ROLLUP_LOG_PAGE / sizeof(rollup_record_t))
+
+static const int64_t _period_ms[ROLLUP_LEVELS] = { 60000LL, 900000LL, 3600000LL, 86400000LL };
+static const char *_level_names[ROLLUP_LEVELS] = { "1m", "15m", "1h", "1d" };
+
+int64_t rollup_period_ms(int level) {
+	return _period_ms[level];
+}
+
+const char* rollup_level_name(int level) {
+	return _level_names[level];
+}
+
+double rollup_mean(const rollup_bucket_t *bucket) {
+	return bucket->count ? bucket->sum / bucket->count : 0;
+}
+
+double rollup_variance(const rollup_bucket_t *bucket) {
+	if (bucket->count == 0)
+		return 0;
+	double mean = bucket->sum / bucket->count;
+	double var = bucket->sum_sq / bucket->count - mean * mean;
+	return var > 0 ? var : 0;
+}
+
+rollup_t* rollup_new(unsigned int n_channels, rollup_emit_func_t emit, void *user_data) {
+	if (n_channels > ROLLUP_MAX_CHANNELS)
+		return NULL;
+
+	rollup_t *this = (rollup_t*) arena_calloc(1, sizeof(rollup_t));
+	this->n_channels = n_channels;
+	this->emit = emit;
+	this->user_data = user_data;
+
+	return this;
+}
+
+void rollup_destroy(rollup_t *this) {
+	if (this) {
+		arena_free(this);
+	}
+}
+
+// O(1): one comparison per level, plus the emit of the periods the sample closes
+void rollup_add(rollup_t *this, unsigned int channel, int64_t ts_ms, float value) {
+	if (channel >= this->n_channels)
+		return;
+
+	for (int level = 0; level < ROLLUP_LEVELS; level++) {
+		rollup_bucket_t *b = &this->open[channel][level];
+		int64_t start = ts_ms - ((ts_ms % _period_ms[level]) + _period_ms[level]) % _period_ms[level];
+
+		if (b->count > 0 && start != b->start_ms) {
+			if (start < b->start_ms)
+				continue; // late sample of an already closed period, dropped from this level
+			if (this->emit)
+				this->emit(this->user_data, channel, level, b);
+			this->closed++;
+			b->count = 0;
+		}
+
+		if (b->count == 0) {
+			b->start_ms = start;
+			b->min = b->max = value;
+			b->sum = b->sum_sq = 0;
+		} else if (value < b->min) {
+			b->min = value;
+		} else if (value > b->max) {
+			b->max = value;
+		}
+		b->count++;
+		b->sum += value;
+		b->sum_sq += (double) value * value;
+	}
+}
+
+/* rollup log */
+
+rollup_log_t* rollup_log_open(const char *path, uint32_t capacity) {
+	int fd = open(path, O_RDWR | O_CREAT, 0644);
+	if (fd < 0)
+		return NULL;
+
+	rollup_log_t *this = (rollup_log_t*) arena_calloc(1, sizeof(rollup_log_t));
+	this->fd = fd;
+
+	// an existing log keeps its own capacity
+	if (pread(fd, &this->header, sizeof(this->header), 0) != sizeof(this->header) || memcmp(this->header.magic, ROLLUP_LOG_MAGIC, 8) != 0
+			|| this->header.record_size != sizeof(rollup_record_t)) {
+		capacity = (capacity + ROLLUP_LOG_PAGE_RECORDS - 1) / ROLLUP_LOG_PAGE_RECORDS * ROLLUP_LOG_PAGE_RECORDS;
+		memcpy(this->header.magic, ROLLUP_LOG_MAGIC, 8);
+		this->header.record_size = sizeof(rollup_record_t);
+		this->header.capacity = capacity;
+		this->header.written = 0;
+
+		if (ftruncate(fd, 0) != 0 || posix_fallocate(fd, 0, ROLLUP_LOG_PAGE + (off_t) capacity * sizeof(rollup_record_t)) != 0
+				|| pwrite(fd, &this->header, sizeof(this->header), 0) != sizeof(this->header)) {
+			close(fd);
+			arena_free(this);
+			return NULL;
+		}
+	}
+
+	return this;
+}
+
+// Writes the partial page as well
+void rollup_log_close(rollup_log_t *this) {
+	if (this) {
+		rollup_log_flush(this);
+		fsync(this->fd);
+		close(this->fd);
+		arena_free(this);
+	}
+}
+
+// Returns 0, or -1 if the page could not be written
+int rollup_log_append(rollup_log_t *this, unsigned int channel, int level, const rollup_bucket_t *bucket) {
+	rollup_record_t *r = &this->page[this->n_page++];
+
+	r->start_s = bucket->start_ms / 1000;
+	r->count = bucket->count < UINT16_MAX ? bucket->count : UINT16_MAX;
+	r->channel = channel;
+	r->level = level;
+	r->min = bucket->min;
+	r->max = bucket->max;
+	r->sum = bucket->sum;
+	r->sum_sq = bucket->sum_sq;
+
+	if (this->n_page == ROLLUP_LOG_PAGE_RECORDS)
+		return rollup_log_flush(this);
+	return 0;
+}
+
+// Writes the records of the page being filled, split in two if the log wraps
+int rollup_log_flush(rollup_log_t *this) {
+	unsigned int done = 0;
+
+	while (done < this->n_page) {
+		uint64_t slot = this->header.written % this->header.capacity;
+		unsigned int n = this->n_page - done;
+		if (slot + n > this->header.capacity)
+			n = this->header.capacity - slot;
+
+		size_t len = n * sizeof(rollup_record_t);
+		if (pwrite(this->fd, &this->page[done], len, ROLLUP_LOG_PAGE + slot * sizeof(rollup_record_t)) != len) {
+			this->n_page = 0; // dropped, the page must not overflow
+			return -1;
+		}
+		this->header.written += n;
+		done += n;
+	}
+
+	if (this->n_page > 0) {
+		this->n_page = 0;
+		this->pages++;
+		if (pwrite(this->fd, &this->header, sizeof(this->header), 0) != sizeof(this->header))
+			return -1;
+	}
+	return 0;
+}
+
+// Records in the file, the oldest ones already overwritten are not counted
+uint64_t rollup_log_n_records(rollup_log_t *this) {
+	return this->header.written < this->header.capacity ? this->header.written : this->header.capacity;
+}
+
+// i-th oldest record in the file. Returns 0, or -1 if out of range
+int rollup_log_read(rollup_log_t *this, uint64_t i, rollup_record_t *record) {
+	uint64_t n = rollup_log_n_records(this);
+
+	if (i >= n)
+		return -1;
+
+	uint64_t slot = (this->header.written - n + i) % this->header.capacity;
+	if (pread(this->fd, record, sizeof(rollup_record_t), ROLLUP_LOG_PAGE + slot * sizeof(rollup_record_t)) != sizeof(rollup_record_t))
+		return -1;
+	return 0;
+}
@@ -0,0 +1,87 @@
+/*
+ * rolluplib.h
+ *
+ * Incremental rollups of the samples of each channel at 1 min, 15 min, 1 h and 1 day: count, min,
+ * max, sum and sum of squares of the open period of every level, updated in O(1) per sample.
+ * Periods are aligned to the wall clock (UTC days). When a sample falls in a later period the open
+ * one is closed and handed to the emit callback. Closed rollups can be kept in a rollup log, a
+ * fixed size circular file of 32 byte records written a page at a time.
+ *
+ *  Created on: 17 oct. 2026
+ *      Author: Victoria M. Gullon and Marcos Gomez
+ */
+
+#ifndef LIBS_ROLLUPLIB_H_
+#define LIBS_ROLLUPLIB_H_
+
+#include <stdint.h>
+
+#define ROLLUP_LEVELS 4 // 1 min, 15 min, 1 h, 1 day
+#define ROLLUP_MAX_CHANNELS 8
+
+#define ROLLUP_LOG_MAGIC "RPROLL01"
+#define ROLLUP_LOG_PAGE 4096
+#define ROLLUP_LOG_DEFAULT_RECORDS 65536 // 2 MB, over four months of the 15 min, 1 h and 1 day rollups of four channels
+
+typedef struct {
+	int64_t start_ms; // CLOCK_REALTIME, ms, start of the period
+	uint32_t count;
+	float min;
+	float max;
+	double sum;
+	double sum_sq;
+} rollup_bucket_t;
+
+typedef void (*rollup_emit_func_t)(void *user_data, unsigned int channel, int level, const rollup_bucket_t *bucket);
+
+typedef struct {
+	unsigned int n_channels;
+	rollup_bucket_t open[ROLLUP_MAX_CHANNELS][ROLLUP_LEVELS]; // count 0 while no sample has arrived
+	rollup_emit_func_t emit;
+	void *user_data;
+	unsigned long closed; // rollups emitted
+} rollup_t;
+
+// on disk record
+typedef struct {
+	uint32_t start_s;
+	uint16_t count; // saturates, the 1 day rollup of a 1 s sensor would not fit
+	uint8_t channel;
+	uint8_t level;
+	float min;
+	float max;
+	double sum;
+	double sum_sq;
+} rollup_record_t;
+
+typedef struct {
+	char magic[8]; // ROLLUP_LOG_MAGIC
+	uint32_t record_size;
+	uint32_t capacity; // records, a multiple of a page
+	uint64_t written; // records ever written, record i lives in slot i % capacity
+} rollup_log_header_t;
+
+typedef struct {
+	int fd;
+	rollup_log_header_t header;
+	rollup_record_t page[ROLLUP_LOG_PAGE / sizeof(rollup_record_t)]; // records of the page being filled
+	unsigned int n_page;
+	unsigned long pages; // page writes
+} rollup_log_t;
+
+rollup_t* rollup_new(unsigned int n_channels, rollup_emit_func_t emit, void *user_data);
+void rollup_destroy(rollup_t *this);
+void rollup_add(rollup_t *this, unsigned int channel, int64_t ts_ms, float value);
+int64_t rollup_period_ms(int level);
+const char* rollup_level_name(int level);
+double rollup_mean(const rollup_bucket_t *bucket);
+double rollup_variance(const rollup_bucket_t *bucket);
+
+rollup_log_t* rollup_log_open(const char *path, uint32_t capacity);
+void rollup_log_close(rollup_log_t *this);
+int rollup_log_append(rollup_log_t *this, unsigned int channel, int level, const rollup_bucket_t *bucket);
+int rollup_log_flush(rollup_log_t *this);
+uint64_t rollup_log_n_records(rollup_log_t *this);
+int rollup_log_read(rollup_log_t *this, uint64_t i, rollup_record_t *record);
+
+#endif /* LIBS_ROLLUPLIB_H_ */
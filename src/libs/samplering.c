@@ -0,0 +1,68 @@
+/*
+ * samplering.c
+ *
+ *  Created on: 17 oct. 2026
+ *      Author: Victoria M. Gullon and Marcos Gomez
+ */
+
+#include <stdlib.h>
+
+#include "samplering.h"
+#include "arenalib.h"
+
+sample_ring_t* sample_ring_new(unsigned int capacity) {
+	unsigned int size = 1;
+	while (size < capacity)
+		size <<= 1;
+
+	sample_ring_t *this = (sample_ring_t*) arena_malloc(sizeof(sample_ring_t));
+	this->data = (SensorSampleType*) arena_malloc((size_t) size * sizeof(SensorSampleType));
+	this->mask = size - 1;
+	this->head = 0;
+	this->count = 0;
+
+	return this;
+}
+
+void sample_ring_destroy(sample_ring_t *this) {
+	if (this) {
+		arena_free(this->data);
+		arena_free(this);
+	}
+}
+
+void sample_ring_reset(sample_ring_t *this) {
+	this->head = 0;
+	this->count = 0;
+}
+
+void sample_ring_push(sample_ring_t *this, const SensorSampleType *sample) {
+	this->data[this->head & this->mask] = *sample;
+	this->head++;
+	if (this->count <= this->mask)
+		this->count++;
+}
+
+unsigned int sample_ring_size(sample_ring_t *this) {
+	return this->count;
+}
+
+unsigned int sample_ring_capacity(sample_ring_t *this) {
+	return this->mask + 1;
+}
+
+// Points span at the last n samples (fewer if the ring holds less), valid until the next push. Returns how many
+unsigned int sample_ring_window(sample_ring_t *this, unsigned int n, sample_span_t *span) {
+	if (n > this->count)
+		n = this->count;
+
+	unsigned int first = (this->head - n) & this->mask;
+	unsigned int len = this->mask + 1 - first; // contiguous slots up to the end of the array
+
+	span->data[0] = this->data + first;
+	span->data[1] = this->data;
+	span->len[0] = n < len ? n : len;
+	span->len[1] = n - span->len[0];
+
+	return n;
+}
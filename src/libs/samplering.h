@@ -0,0 +1,53 @@
+/*
+ * samplering.h
+ *
+ * Ring of timestamped sensor samples kept for processing. Fixed size records, power of two
+ * capacity and mask indexing; a push over a full ring overwrites the oldest sample. The last n
+ * samples are read in place through a span of at most two contiguous parts (before and after
+ * the wrap), nothing is copied.
+ *
+ *  Created on: 17 oct. 2026
+ *      Author: Victoria M. Gullon and Marcos Gomez
+ */
+
+#ifndef LIBS_SAMPLERING_H_
+#define LIBS_SAMPLERING_H_
+
+typedef struct {
+	enum {
+		is_int, is_float, is_error
+	} type;
+	union {
+		int ival;
+		float fval;
+	} val;
+} SensorValueType; // This is a new type defined because we have sensors that give float value and int values depending on the sensor
+
+typedef struct {
+	unsigned long long timestamp_ns; // CLOCK_MONOTONIC time of the measurement
+	int channel; // index in sensor_storage/sensor_values: Temp, Humid, Light, CO2
+	SensorValueType value;
+} SensorSampleType;
+
+typedef struct {
+	SensorSampleType *data;
+	unsigned int mask;
+	unsigned int head; // next slot is head & mask
+	unsigned int count; // live samples, saturates at the capacity
+} sample_ring_t;
+
+// Oldest first: data[0][0 .. len[0]-1] then data[1][0 .. len[1]-1]
+typedef struct {
+	const SensorSampleType *data[2];
+	unsigned int len[2];
+} sample_span_t;
+
+sample_ring_t* sample_ring_new(unsigned int capacity);
+void sample_ring_destroy(sample_ring_t *this);
+void sample_ring_reset(sample_ring_t *this);
+void sample_ring_push(sample_ring_t *this, const SensorSampleType *sample);
+unsigned int sample_ring_size(sample_ring_t *this);
+unsigned int sample_ring_capacity(sample_ring_t *this);
+unsigned int sample_ring_window(sample_ring_t *this, unsigned int n, sample_span_t *span);
+
+#endif /* LIBS_SAMPLERING_H_ */
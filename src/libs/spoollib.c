@@ -0,0 +1,309 @@
+/*
+ * spoollib.c
+ *
+ *  Created on: 17 oct. 2026
+ *      Author: Victoria M. Gullon and Marcos Gomez
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#include "spoollib.h"
+#include "tsdblib.h"
+#include "arenalib.h"
+
+static int64_t _now_ms(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void _segment_path(spool_t *this, uint32_t segment, char *path) {
+	snprintf(path, SPOOL_PATH_LEN + 16, "%s/%08x.seg", this->dir, segment);
+}
+
+static int _open_segment(spool_t *this, uint32_t segment, int flags) {
+	char path[SPOOL_PATH_LEN + 16];
+
+	_segment_path(this, segment, path);
+	return open(path, flags | O_CLOEXEC, 0644);
+}
+
+static uint64_t _file_size(int fd) {
+	struct stat st;
+	return fd >= 0 && fstat(fd, &st) == 0 ? (uint64_t) st.st_size : 0;
+}
+
+static void _save_cursor(spool_t *this) {
+	spool_cursor_t cursor = { this->first_segment, 0, this->read_offset };
+
+	// not synced: after a power cut some records may be posted twice, none is lost
+	pwrite(this->cursor_fd, &cursor, sizeof(cursor), 0);
+}
+
+// The read segment is done with: deleted, reading goes on with the next one
+static void _next_segment(spool_t *this) {
+	char path[SPOOL_PATH_LEN + 16];
+	uint64_t left = _file_size(this->read_fd) - this->read_offset;
+
+	this->pending_bytes -= left < this->pending_bytes ? left : this->pending_bytes;
+	close(this->read_fd);
+	_segment_path(this, this->first_segment, path);
+	unlink(path);
+
+	this->first_segment++;
+	this->read_fd = _open_segment(this, this->first_segment, O_RDONLY);
+	this->read_offset = 0;
+	_save_cursor(this);
+}
+
+// Skips the segments read to the end, except the one being written
+static void _skip_finished(spool_t *this) {
+	while (this->first_segment != this->last_segment && this->read_offset >= _file_size(this->read_fd))
+		_next_segment(this);
+}
+
+// Opens the spool in dir, created if needed, with the segments and cursor of a previous run. Returns NULL if dir cannot be used
+spool_t* spool_open(const char *dir, uint64_t max_bytes) {
+	spool_cursor_t cursor = { 0, 0, 0 };
+	uint32_t first = UINT32_MAX, last = 0;
+	uint64_t bytes = 0;
+	char path[SPOOL_PATH_LEN + 16];
+
+	if (strlen(dir) >= SPOOL_PATH_LEN || (mkdir(dir, 0755) != 0 && errno != EEXIST))
+		return NULL;
+
+	spool_t *this = (spool_t*) arena_calloc(1, sizeof(spool_t));
+	strcpy(this->dir, dir);
+	pthread_mutex_init(&this->lock, NULL);
+	this->max_bytes = max_bytes ? max_bytes : SPOOL_DEFAULT_MAX_BYTES;
+	this->sync_fd = -1;
+	this->synced_ms = _now_ms();
+
+	snprintf(path, sizeof(path), "%s/cursor", dir);
+	this->cursor_fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+	if (this->cursor_fd < 0) {
+		pthread_mutex_destroy(&this->lock);
+		arena_free(this);
+		return NULL;
+	}
+	if (pread(this->cursor_fd, &cursor, sizeof(cursor), 0) != sizeof(cursor))
+		memset(&cursor, 0, sizeof(cursor));
+
+	// segments of a previous run, the ones before the cursor were all posted
+	DIR *d = opendir(dir);
+	struct dirent *e;
+	while (d && (e = readdir(d))) {
+		uint32_t segment;
+		char tail;
+		if (strlen(e->d_name) != 12 || sscanf(e->d_name, "%8x.se%c", &segment, &tail) != 2 || tail != 'g')
+			continue;
+
+		if (segment < cursor.segment) {
+			_segment_path(this, segment, path);
+			unlink(path);
+			continue;
+		}
+		_segment_path(this, segment, path);
+		struct stat st;
+		if (stat(path, &st) == 0)
+			bytes += st.st_size;
+		if (segment < first)
+			first = segment;
+		if (segment > last)
+			last = segment;
+	}
+	if (d)
+		closedir(d);
+
+	if (first == UINT32_MAX) {
+		first = last = cursor.segment ? cursor.segment : 1;
+	} else {
+		last++; // never appended to again, its last record may be torn
+		if (first == cursor.segment)
+			this->read_offset = cursor.offset;
+	}
+
+	this->first_segment = first;
+	this->last_segment = last;
+	this->write_fd = _open_segment(this, last, O_WRONLY | O_CREAT | O_TRUNC);
+	this->read_fd = _open_segment(this, first, O_RDONLY);
+	if (this->write_fd < 0 || this->read_fd < 0) {
+		spool_close(this);
+		return NULL;
+	}
+	this->pending_bytes = bytes > this->read_offset ? bytes - this->read_offset : 0;
+	_save_cursor(this);
+	_skip_finished(this); // the empty segments of the runs that never spooled
+
+	return this;
+}
+
+void spool_close(spool_t *this) {
+	if (this) {
+		spool_sync(this, 1);
+		if (this->write_fd >= 0)
+			close(this->write_fd);
+		if (this->read_fd >= 0)
+			close(this->read_fd);
+		close(this->cursor_fd);
+		pthread_mutex_destroy(&this->lock);
+		arena_free(this);
+	}
+}
+
+// Appends one body (whole lines). Only waits for the SD card if the last full segment is not synced yet. Returns -1 if it could not be written
+int spool_append(spool_t *this, const char *body, size_t len, unsigned int lines) {
+	spool_record_header_t h = { SPOOL_RECORD_MAGIC, (uint32_t) len, lines, tsdb_crc32((const uint8_t*) body, len) };
+	struct iovec iov[2] = { { &h, sizeof(h) }, { (void*) body, len } };
+	int res = 0;
+
+	pthread_mutex_lock(&this->lock);
+
+	if (this->write_offset > 0 && this->write_offset + sizeof(h) + len > SPOOL_SEGMENT_BYTES) {
+		// the full segment is synced by the next spool_sync, or here if that one has not come yet
+		if (this->sync_fd >= 0) {
+			fdatasync(this->sync_fd);
+			close(this->sync_fd);
+			this->syncs++;
+		}
+		int fd = _open_segment(this, this->last_segment + 1, O_WRONLY | O_CREAT | O_TRUNC);
+		if (fd >= 0) {
+			this->sync_fd = this->write_fd;
+			this->write_fd = fd;
+			this->write_offset = 0;
+			this->last_segment++;
+		} else {
+			this->sync_fd = -1;
+		}
+	}
+
+	ssize_t n = writev(this->write_fd, iov, 2);
+	if (n == (ssize_t) (sizeof(h) + len)) {
+		this->write_offset += n;
+		this->unsynced += n;
+		this->pending_bytes += n;
+		this->appends++;
+	} else {
+		if (n > 0 && ftruncate(this->write_fd, this->write_offset) == 0)
+			lseek(this->write_fd, this->write_offset, SEEK_SET);
+		res = -1;
+	}
+
+	// bounded: the oldest records are given up first
+	while (this->pending_bytes > this->max_bytes && this->first_segment != this->last_segment) {
+		uint64_t before = this->pending_bytes;
+		_next_segment(this);
+		this->lost_bytes += before - this->pending_bytes;
+	}
+
+	pthread_mutex_unlock(&this->lock);
+	return res;
+}
+
+// Syncs the appended records to the SD card if SPOOL_SYNC_BYTES or SPOOL_SYNC_MS are due (or force). Returns 1 if it synced
+int spool_sync(spool_t *this, int force) {
+	int64_t now_ms = _now_ms();
+	int closed_fd, write_fd = -1;
+
+	pthread_mutex_lock(&this->lock);
+	closed_fd = this->sync_fd;
+	this->sync_fd = -1;
+	if (this->unsynced && (force || this->unsynced >= SPOOL_SYNC_BYTES || now_ms - this->synced_ms >= SPOOL_SYNC_MS)) {
+		write_fd = dup(this->write_fd); // a rotation may close it while syncing, the lock is not held meanwhile
+		this->unsynced = 0;
+		this->synced_ms = now_ms;
+	}
+	if (closed_fd >= 0 || write_fd >= 0)
+		this->syncs++;
+	pthread_mutex_unlock(&this->lock);
+
+	if (closed_fd >= 0) {
+		fdatasync(closed_fd);
+		close(closed_fd);
+	}
+	if (write_fd >= 0) {
+		fdatasync(write_fd);
+		close(write_fd);
+	}
+	return closed_fd >= 0 || write_fd >= 0;
+}
+
+// Copies the oldest records not posted yet to buf, whole records up to size bytes and max_lines lines (at least one record).
+// Returns the bytes copied, 0 if there are none; spool_commit consumes them
+size_t spool_peek(spool_t *this, char *buf, size_t size, unsigned int max_lines, unsigned int *lines) {
+	size_t total = 0;
+	unsigned int n_lines = 0;
+
+	pthread_mutex_lock(&this->lock);
+	_skip_finished(this);
+
+	uint64_t offset = this->read_offset;
+	while (1) {
+		spool_record_header_t h;
+		uint64_t end = _file_size(this->read_fd);
+
+		if (offset + sizeof(h) > end)
+			break;
+		int valid = pread(this->read_fd, &h, sizeof(h), offset) == sizeof(h) && h.magic == SPOOL_RECORD_MAGIC && h.len <= size && offset + sizeof(h) + h.len <= end;
+		if (valid && (total + h.len > size || (n_lines && n_lines + h.lines > max_lines)))
+			break;
+		valid = valid && pread(this->read_fd, buf + total, h.len, offset + sizeof(h)) == h.len && h.crc == tsdb_crc32((const uint8_t*) buf + total, h.len);
+
+		if (!valid) {
+			if (total)
+				break; // what was read so far is returned, the next peek skips this one
+			// torn or damaged: nothing after it can be trusted in this segment
+			this->corrupt++;
+			this->pending_bytes -= end - offset < this->pending_bytes ? end - offset : this->pending_bytes;
+			this->read_offset = offset = end;
+			_save_cursor(this);
+			if (this->first_segment == this->last_segment)
+				break;
+			_next_segment(this);
+			offset = this->read_offset;
+			continue;
+		}
+
+		total += h.len;
+		n_lines += h.lines;
+		offset += sizeof(h) + h.len;
+	}
+
+	this->peek_segment = this->first_segment;
+	this->peek_offset = offset;
+	pthread_mutex_unlock(&this->lock);
+
+	*lines = n_lines;
+	return total;
+}
+
+// The records of the last spool_peek were posted
+void spool_commit(spool_t *this) {
+	pthread_mutex_lock(&this->lock);
+	// unless their segment was given up in between
+	if (this->peek_segment == this->first_segment && this->peek_offset > this->read_offset) {
+		uint64_t n = this->peek_offset - this->read_offset;
+		this->pending_bytes -= n < this->pending_bytes ? n : this->pending_bytes;
+		this->read_offset = this->peek_offset;
+		_save_cursor(this);
+		_skip_finished(this);
+	}
+	pthread_mutex_unlock(&this->lock);
+}
+
+// Bytes of the records not posted yet
+uint64_t spool_pending(spool_t *this) {
+	pthread_mutex_lock(&this->lock);
+	uint64_t bytes = this->pending_bytes;
+	pthread_mutex_unlock(&this->lock);
+	return bytes;
+}
@@ -0,0 +1,81 @@
+/*
+ * spoollib.h
+ *
+ * Store-and-forward spool of the uploads: bodies of line protocol that InfluxDB could not take
+ * are appended to a log of segment files in a directory, each record with its length, line count
+ * and a CRC, and read back oldest first to be posted again once it answers. Appends go to the
+ * file at once but are synced to the SD card SPOOL_SYNC_BYTES or SPOOL_SYNC_MS at a time by
+ * spool_sync, called from the uploader worker, so that spool_append does not wait for the card. A segment is deleted once every record in it was posted,
+ * and the read position is kept in a small cursor file so that a restart does not post them
+ * twice. A record torn by a power cut fails its check and ends its segment; a new segment is
+ * started at every open so that the torn one is never appended to. Past max_bytes the oldest
+ * segment is given up. Every call is thread safe.
+ *
+ *  Created on: 17 oct. 2026
+ *      Author: Victoria M. Gullon and Marcos Gomez
+ */
+
+#ifndef LIBS_SPOOLLIB_H_
+#define LIBS_SPOOLLIB_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+
+#define SPOOL_RECORD_MAGIC 0x4c4f5053 // "SPOL"
+#define SPOOL_PATH_LEN 128
+#define SPOOL_SEGMENT_BYTES (1 << 20)
+#define SPOOL_SYNC_BYTES (64 << 10)
+#define SPOOL_SYNC_MS 1000
+#define SPOOL_DEFAULT_MAX_BYTES (64 << 20) // days of the lines of a gateway
+
+typedef struct {
+	uint32_t magic; // SPOOL_RECORD_MAGIC
+	uint32_t len; // of the body
+	uint32_t lines; // in the body, each one ended by '\n'
+	uint32_t crc; // of the body
+} spool_record_header_t;
+
+// read position, the cursor file
+typedef struct {
+	uint32_t segment;
+	uint32_t reserved;
+	uint64_t offset;
+} spool_cursor_t;
+
+typedef struct {
+	char dir[SPOOL_PATH_LEN];
+	pthread_mutex_t lock;
+	uint64_t max_bytes;
+
+	uint32_t first_segment; // being read
+	uint32_t last_segment; // being written
+	int read_fd;
+	uint64_t read_offset;
+	uint32_t peek_segment;
+	uint64_t peek_offset; // end of what the last spool_peek returned
+	int write_fd;
+	uint64_t write_offset;
+	int cursor_fd;
+
+	int sync_fd; // closed segment not synced yet, -1 if none
+	uint64_t unsynced; // bytes appended since the last sync
+	int64_t synced_ms; // CLOCK_MONOTONIC
+
+	uint64_t pending_bytes; // of the records not posted yet, headers included
+
+	unsigned long appends;
+	unsigned long syncs;
+	unsigned long corrupt; // records that failed their check, the rest of their segment is skipped
+	unsigned long long lost_bytes; // segments given up to stay under max_bytes
+} spool_t;
+
+spool_t* spool_open(const char *dir, uint64_t max_bytes);
+void spool_close(spool_t *this);
+int spool_append(spool_t *this, const char *body, size_t len, unsigned int lines);
+int spool_sync(spool_t *this, int force);
+size_t spool_peek(spool_t *this, char *buf, size_t size, unsigned int max_lines, unsigned int *lines);
+void spool_commit(spool_t *this);
+uint64_t spool_pending(spool_t *this);
+
+#endif /* LIBS_SPOOLLIB_H_ */
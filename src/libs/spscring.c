@@ -0,0 +1,116 @@
+/*
+ * spscring.c
+ *
+ *  Created on: 17 oct. 2026
+ *      Author: Victoria M. Gullon and Marcos Gomez
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "spscring.h"
+#include "arenalib.h"
+
+// Counters have a single writer, the producer: a relaxed load and store, no read-modify-write
+static void _count(atomic_ulong *counter) {
+	atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + 1, memory_order_relaxed);
+}
+
+spsc_ring_t* spsc_ring_new(unsigned int capacity, size_t elem_size) {
+	unsigned int size = 1;
+	while (size < capacity)
+		size <<= 1;
+
+	spsc_ring_t *this = (spsc_ring_t*) arena_aligned_malloc(SPSC_RING_CACHE_LINE, sizeof(spsc_ring_t));
+	memset(this, 0, sizeof(spsc_ring_t));
+	atomic_init(&this->head, 0);
+	atomic_init(&this->tail, 0);
+	this->mask = size - 1;
+	this->elem_size = elem_size;
+	this->data = (unsigned char*) arena_malloc((size_t) size * elem_size);
+
+	return this;
+}
+
+void spsc_ring_destroy(spsc_ring_t *this) {
+	if (this) {
+		arena_free(this->data);
+		arena_free(this);
+	}
+}
+
+// Producer only. Returns 0, or -1 if the ring is full (the record is dropped)
+int spsc_ring_push(spsc_ring_t *this, const void *elem) {
+	unsigned int head = atomic_load_explicit(&this->head, memory_order_relaxed);
+
+	if (head - this->tail_cache > this->mask) {
+		this->tail_cache = atomic_load_explicit(&this->tail, memory_order_acquire);
+		if (head - this->tail_cache > this->mask) {
+			_count(&this->dropped);
+			return -1;
+		}
+	}
+
+	memcpy(this->data + (size_t) (head & this->mask) * this->elem_size, elem, this->elem_size);
+	atomic_store_explicit(&this->head, head + 1, memory_order_release); // publishes the record
+	_count(&this->pushed);
+	return 0;
+}
+
+// Consumer only. Returns 0, or -1 if the ring is empty
+int spsc_ring_pop(spsc_ring_t *this, void *elem) {
+	unsigned int tail = atomic_load_explicit(&this->tail, memory_order_relaxed);
+
+	if (tail == this->head_cache) {
+		this->head_cache = atomic_load_explicit(&this->head, memory_order_acquire);
+		if (tail == this->head_cache)
+			return -1;
+	}
+
+	memcpy(elem, this->data + (size_t) (tail & this->mask) * this->elem_size, this->elem_size);
+	atomic_store_explicit(&this->tail, tail + 1, memory_order_release); // gives the slot back
+	return 0;
+}
+
+// Producer only, the consumer must use spsc_ring_pop_shared. Never refuses: a full ring gives up its oldest record.
+// Returns 0, or 1 if a record was evicted
+int spsc_ring_push_evict(spsc_ring_t *this, const void *elem) {
+	unsigned int head = atomic_load_explicit(&this->head, memory_order_relaxed);
+	unsigned int tail = atomic_load_explicit(&this->tail, memory_order_acquire);
+	int evicted = 0;
+
+	// if the consumer moves the tail first the slot is free anyway
+	if (head - tail > this->mask && atomic_compare_exchange_strong_explicit(&this->tail, &tail, tail + 1, memory_order_acq_rel, memory_order_acquire)) {
+		_count(&this->evicted);
+		evicted = 1;
+	}
+
+	memcpy(this->data + (size_t) (head & this->mask) * this->elem_size, elem, this->elem_size);
+	atomic_store_explicit(&this->head, head + 1, memory_order_release);
+	_count(&this->pushed);
+	return evicted;
+}
+
+// Consumer of a ring pushed with spsc_ring_push_evict. Returns 0, or -1 if the ring is empty
+int spsc_ring_pop_shared(spsc_ring_t *this, void *elem) {
+	unsigned int tail = atomic_load_explicit(&this->tail, memory_order_acquire);
+
+	while (1) {
+		if (tail == atomic_load_explicit(&this->head, memory_order_acquire))
+			return -1;
+
+		memcpy(elem, this->data + (size_t) (tail & this->mask) * this->elem_size, this->elem_size);
+		// a failed exchange means the record was evicted, maybe while being copied: the copy is dropped
+		if (atomic_compare_exchange_strong_explicit(&this->tail, &tail, tail + 1, memory_order_acq_rel, memory_order_acquire))
+			return 0;
+	}
+}
+
+// Approximate when called from a thread that is neither the producer nor the consumer
+unsigned int spsc_ring_size(spsc_ring_t *this) {
+	return atomic_load_explicit(&this->head, memory_order_acquire) - atomic_load_explicit(&this->tail, memory_order_acquire);
+}
+
+unsigned int spsc_ring_capacity(spsc_ring_t *this) {
+	return this->mask + 1;
+}
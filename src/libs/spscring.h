@@ -0,0 +1,52 @@
+/*
+ * spscring.h
+ *
+ * Wait-free single-producer/single-consumer ring of fixed size records. One thread pushes, one
+ * thread pops, no locks: each side only writes its own index and reads the other one with
+ * acquire/release ordering. The capacity is rounded up to a power of two.
+ *
+ * A ring can instead keep the newest records when full: the producer pushes with
+ * spsc_ring_push_evict, which takes the oldest slot by moving the tail itself, and the consumer
+ * pops with spsc_ring_pop_shared, which claims a record with a compare-and-swap on the tail and
+ * discards its copy if the producer got there first.
+ *
+ *  Created on: 17 oct. 2026
+ *      Author: Victoria M. Gullon and Marcos Gomez
+ */
+
+#ifndef LIBS_SPSCRING_H_
+#define LIBS_SPSCRING_H_
+
+#include <stddef.h>
+#include <stdatomic.h>
+
+#define SPSC_RING_CACHE_LINE 64
+
+typedef struct {
+	// producer side
+	_Alignas(SPSC_RING_CACHE_LINE) atomic_uint head; // next slot to write
+	unsigned int tail_cache; // last tail seen by the producer, avoids touching the consumer line on every push
+	atomic_ulong pushed; // the counters are written by the producer only, and can be read from any thread
+	atomic_ulong dropped; // pushes refused because the ring was full
+	atomic_ulong evicted; // oldest records given up by spsc_ring_push_evict
+
+	// consumer side
+	_Alignas(SPSC_RING_CACHE_LINE) atomic_uint tail; // next slot to read
+	unsigned int head_cache;
+
+	// read only after creation
+	_Alignas(SPSC_RING_CACHE_LINE) unsigned int mask;
+	size_t elem_size;
+	unsigned char *data;
+} spsc_ring_t;
+
+spsc_ring_t* spsc_ring_new(unsigned int capacity, size_t elem_size);
+void spsc_ring_destroy(spsc_ring_t *this);
+int spsc_ring_push(spsc_ring_t *this, const void *elem);
+int spsc_ring_pop(spsc_ring_t *this, void *elem);
+int spsc_ring_push_evict(spsc_ring_t *this, const void *elem);
+int spsc_ring_pop_shared(spsc_ring_t *this, void *elem);
+unsigned int spsc_ring_size(spsc_ring_t *this);
+unsigned int spsc_ring_capacity(spsc_ring_t *this);
+
+#endif /* LIBS_SPSCRING_H_ */
@@ -0,0 +1,186 @@
+/*
+ * statelib.c
+ *
+ *  Created on: 17 oct. 2026
+ *      Author: Victoria M. Gullon and Marcos Gomez
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "statelib.h"
+#include "tsdblib.h"
+#include "arenalib.h"
+
+#define STATE_COMMIT_PAGES 2
+
+static uint32_t _record_crc(const state_record_t *r) {
+	state_record_t copy = *r;
+
+	copy.crc = 0;
+	return tsdb_crc32((const uint8_t*) &copy, sizeof(copy));
+}
+
+static int _record_valid(const state_record_t *r, uint64_t seq) {
+	return r->seq == (uint32_t) seq && r->crc == _record_crc(r);
+}
+
+static state_commit_t* _commit_page(state_file_t *this, uint64_t sequence) {
+	return (state_commit_t*) (this->map + (sequence % STATE_COMMIT_PAGES) * STATE_PAGE);
+}
+
+static int _commit_valid(const state_commit_t *c, unsigned int n_channels, const unsigned int *capacity) {
+	if (memcmp(c->magic, STATE_MAGIC, 8) != 0 || c->crc != tsdb_crc32((const uint8_t*) c, offsetof(state_commit_t, crc)) || c->n_channels != n_channels)
+		return 0;
+	for (unsigned int i = 0; i < n_channels; i++) {
+		if (c->capacity[i] != capacity[i])
+			return 0;
+	}
+	return 1;
+}
+
+// Newest record of a channel written after its window was last committed, the samples keep going in between commits
+static uint64_t _find_head(state_file_t *this, unsigned int channel) {
+	uint32_t capacity = this->current.capacity[channel];
+	uint64_t committed = this->current.head[channel];
+	uint64_t head = committed;
+
+	for (uint32_t slot = 0; slot < capacity; slot++) {
+		const state_record_t *r = &this->rings[channel][slot];
+		int32_t ahead = (int32_t) (r->seq - (uint32_t) committed);
+		uint64_t seq = committed + ahead;
+
+		if (ahead >= 0 && seq % capacity == slot && seq >= head && _record_valid(r, seq))
+			head = seq + 1;
+	}
+	return head;
+}
+
+// Opens the state file, creating it for rings of those capacities if it does not exist or was made for other ones
+state_file_t* state_open(const char *path, unsigned int n_channels, const unsigned int *capacity) {
+	struct stat st;
+	size_t map_size = STATE_COMMIT_PAGES * STATE_PAGE;
+
+	if (n_channels == 0 || n_channels > STATE_MAX_CHANNELS)
+		return NULL;
+	for (unsigned int i = 0; i < n_channels; i++)
+		map_size += capacity[i] * sizeof(state_record_t);
+	map_size = (map_size + STATE_PAGE - 1) / STATE_PAGE * STATE_PAGE;
+
+	int fd = open(path, O_RDWR | O_CREAT, 0644);
+	if (fd < 0)
+		return NULL;
+
+	int reuse = fstat(fd, &st) == 0 && st.st_size == map_size;
+	if (!reuse && (ftruncate(fd, 0) != 0 || posix_fallocate(fd, 0, map_size) != 0)) {
+		close(fd);
+		return NULL;
+	}
+
+	void *map = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED) {
+		close(fd);
+		return NULL;
+	}
+
+	state_file_t *this = (state_file_t*) arena_calloc(1, sizeof(state_file_t));
+	this->fd = fd;
+	this->map = (uint8_t*) map;
+	this->map_size = map_size;
+
+	state_record_t *records = (state_record_t*) (this->map + STATE_COMMIT_PAGES * STATE_PAGE);
+	for (unsigned int i = 0; i < n_channels; i++) {
+		this->rings[i] = records;
+		records += capacity[i];
+	}
+
+	// the newest valid commit made for these rings
+	const state_commit_t *best = NULL;
+	for (int p = 0; p < STATE_COMMIT_PAGES; p++) {
+		const state_commit_t *c = _commit_page(this, p);
+		if (_commit_valid(c, n_channels, capacity) && (!best || c->sequence > best->sequence))
+			best = c;
+	}
+
+	if (best) {
+		this->current = *best;
+		this->restored = 1;
+		for (unsigned int i = 0; i < n_channels; i++)
+			this->head[i] = _find_head(this, i);
+	} else {
+		// neither a stale commit nor stale records of other rings may be taken for new ones
+		memset(this->map, 0, map_size);
+		memcpy(this->current.magic, STATE_MAGIC, 8);
+		this->current.n_channels = n_channels;
+		for (unsigned int i = 0; i < n_channels; i++)
+			this->current.capacity[i] = capacity[i];
+	}
+
+	return this;
+}
+
+void state_close(state_file_t *this) {
+	if (this) {
+		msync(this->map, this->map_size, MS_SYNC);
+		munmap(this->map, this->map_size);
+		close(this->fd);
+		arena_free(this);
+	}
+}
+
+// Main loop only. A store in the mapping, no system call
+void state_put_sample(state_file_t *this, unsigned int channel, int64_t ts_ms, const SensorValueType *value) {
+	if (channel >= this->current.n_channels)
+		return;
+
+	state_record_t *r = &this->rings[channel][this->head[channel] % this->current.capacity[channel]];
+
+	r->seq = (uint32_t) this->head[channel];
+	r->ts_ms = ts_ms;
+	r->value = *value;
+	r->crc = 0;
+	r->crc = _record_crc(r);
+	this->head[channel]++;
+}
+
+// Writes the heads and the values to the commit page not holding the current commit, then schedules the write back
+void state_commit(state_file_t *this, const SensorValueType *values, int64_t now_ms) {
+	this->current.sequence++;
+	this->current.commit_ms = now_ms;
+	for (unsigned int i = 0; i < this->current.n_channels; i++) {
+		this->current.head[i] = this->head[i];
+		this->current.values[i] = values[i];
+	}
+	this->current.crc = tsdb_crc32((const uint8_t*) &this->current, offsetof(state_commit_t, crc));
+
+	*_commit_page(this, this->current.sequence) = this->current;
+	msync(this->map, this->map_size, MS_ASYNC);
+	this->commits++;
+}
+
+// Copies the last max (at most the ring capacity) valid samples of a channel, oldest first. Returns how many
+unsigned int state_restore_samples(state_file_t *this, unsigned int channel, int64_t *ts_ms, SensorValueType *values, unsigned int max) {
+	if (channel >= this->current.n_channels || !this->restored)
+		return 0;
+
+	uint32_t capacity = this->current.capacity[channel];
+	uint64_t head = this->head[channel];
+	uint64_t n = head < capacity ? head : capacity;
+	unsigned int out = 0;
+
+	if (n > max)
+		n = max;
+	for (uint64_t seq = head - n; seq < head; seq++) {
+		const state_record_t *r = &this->rings[channel][seq % capacity];
+		if (_record_valid(r, seq)) {
+			ts_ms[out] = r->ts_ms;
+			values[out] = r->value;
+			out++;
+		}
+	}
+	return out;
+}
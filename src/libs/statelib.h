@@ -0,0 +1,63 @@
+/*
+ * statelib.h
+ *
+ * Warm restart state of a room: the samples of the processing windows and the last processed
+ * values, kept in one small mmap'd file so that a restarted daemon resumes with them instead of
+ * waiting for the windows to refill. Each channel has a ring of fixed size records written as the
+ * samples are drained, every record carries its sequence number and a CRC. A commit copies the
+ * ring heads and the processed values to one of two commit pages, alternately, with a CRC: a
+ * torn commit leaves the previous one valid, and records overwritten or torn after the commit
+ * fail their check and are skipped on restore. Nothing waits for the SD card, msync is async.
+ *
+ *  Created on: 17 oct. 2026
+ *      Author: Victoria M. Gullon and Marcos Gomez
+ */
+
+#ifndef LIBS_STATELIB_H_
+#define LIBS_STATELIB_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "samplering.h"
+
+#define STATE_MAGIC "RPSTAT01"
+#define STATE_PAGE 4096
+#define STATE_MAX_CHANNELS 8
+
+typedef struct {
+	uint32_t seq; // index of the sample in its channel (low bits), the slot is seq % capacity
+	uint32_t crc; // of the record with this field 0
+	int64_t ts_ms; // CLOCK_REALTIME
+	SensorValueType value;
+} state_record_t;
+
+typedef struct {
+	char magic[8]; // STATE_MAGIC
+	uint32_t n_channels;
+	uint32_t capacity[STATE_MAX_CHANNELS]; // records in the ring of each channel
+	uint64_t sequence; // commits ever made, the valid page with the highest one is the current commit
+	int64_t commit_ms; // CLOCK_REALTIME
+	uint64_t head[STATE_MAX_CHANNELS]; // samples ever written to each channel
+	SensorValueType values[STATE_MAX_CHANNELS];
+	uint32_t crc; // of everything before
+} state_commit_t;
+
+typedef struct {
+	int fd;
+	uint8_t *map;
+	size_t map_size;
+	state_record_t *rings[STATE_MAX_CHANNELS];
+	state_commit_t current; // last commit, read at open or written since
+	int restored; // the file held a valid commit when opened
+	uint64_t head[STATE_MAX_CHANNELS]; // samples written, committed or not
+	unsigned long commits;
+} state_file_t;
+
+state_file_t* state_open(const char *path, unsigned int n_channels, const unsigned int *capacity);
+void state_close(state_file_t *this);
+void state_put_sample(state_file_t *this, unsigned int channel, int64_t ts_ms, const SensorValueType *value);
+void state_commit(state_file_t *this, const SensorValueType *values, int64_t now_ms);
+unsigned int state_restore_samples(state_file_t *this, unsigned int channel, int64_t *ts_ms, SensorValueType *values, unsigned int max);
+
+#endif /* LIBS_STATELIB_H_ */
@@ -5,17 +5,34 @@
  *      Author: Victoria M. Gullon and Marcos Gomez
  */
 
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
 #include "systemlib.h"
+#include "lineprotolib.h"
+#include "arenalib.h"
+
+static void _rollup_closed(void *user_data, unsigned int channel, int level, const rollup_bucket_t *bucket);
+static long long _realtime_ms(void);
 
 SystemContext* SystemContext__create(int id_classroom,
 		DHT11Sensor *sensor_temp_humid, BH1750Sensor *sensor_light, CCS811Sensor *sensor_co2,
 		LCD1602Display *actuator_display, BuzzerOutput *actuator_buzzer,
 		StatusLEDOutput *actuator_leds) {
-	SystemContext *result = (SystemContext*) malloc(sizeof(SystemContext));
+	SystemContext *result = (SystemContext*) arena_malloc(sizeof(SystemContext));
 
 	result->id_classroom = id_classroom;
+	result->measurement_flags = (flags_t) FLAGS_INITIALIZER;
+	result->output_flags = (flags_t) FLAGS_INITIALIZER;
+	result->uploader = NULL;
+	result->store = NULL;
+	result->rollups = rollup_new(sizeof(result->sensor_storage) / sizeof(sample_ring_t*), _rollup_closed, result);
+	result->sensor_values_ts_ns = _realtime_ms() * 1000000LL; // until the first sample
+	result->rollup_log = NULL;
+	result->state = NULL;
+	atomic_init(&result->snapshot_lock.seq, 0);
 	result->sensor_temp_humid = sensor_temp_humid;
 	result->sensor_light = sensor_light;
 	result->sensor_co2 = sensor_co2;
@@ -23,15 +40,31 @@ SystemContext* SystemContext__create(int id_classroom,
 	result->actuator_buzzer = actuator_buzzer;
 	result->actuator_leds = actuator_leds;
 
-	// Create circular buffers
-	for (int i = 0; i < sizeof(result->sensor_storage) / sizeof(CircularBuffer); i++) {
-		result->sensor_storage[i] = CircularBufferCreate(5 * sizeof(SensorValueType));
+	// the drivers reach their room (flags, sample queues) through these
+	if (sensor_temp_humid)
+		sensor_temp_humid->system = result;
+	if (sensor_light)
+		sensor_light->system = result;
+	if (sensor_co2)
+		sensor_co2->system = result;
+
+	// Create the sample queues and the sample rings
+	for (int i = 0; i < sizeof(result->sensor_queues) / sizeof(spsc_ring_t*); i++) {
+		result->sensor_queues[i] = spsc_ring_new(SENSOR_QUEUE_LEN, sizeof(SensorSampleType));
+	}
+	for (int i = 0; i < sizeof(result->sensor_storage) / sizeof(sample_ring_t*); i++) {
+		result->sensor_storage[i] = NULL;
+		result->sensor_stats[i] = NULL;
+		result->sensor_percentile[i] = 0;
+		SystemContext__set_window(result, i, SENSOR_WINDOW_LEN);
 	}
 
 	for (int i = 0; i < sizeof(result->sensor_values) / sizeof(SensorValueType); i++) {
 		SensorValueType aux = {.type = is_error, .val.ival = -99 };
 		result->sensor_values[i] = aux;
+		deadband_init(&result->sensor_deadband[i], DEADBAND_OFF, 0, DEADBAND_DEFAULT_SILENCE_MS);
 	}
+	SystemContext__publish_snapshot(result);
 
 	return result;
 }
@@ -45,6 +78,256 @@ void SystemContext__destroy(SystemContext *this) {
 		BuzzerOutput__destroy(this->actuator_buzzer);
 		StatusLEDOutput__destroy(this->actuator_leds);
 
-		free(this);
+		for (int i = 0; i < sizeof(this->sensor_queues) / sizeof(spsc_ring_t*); i++) {
+			spsc_ring_destroy(this->sensor_queues[i]);
+		}
+		tsdb_close(this->store);
+		rollup_log_close(this->rollup_log);
+		rollup_destroy(this->rollups);
+		state_close(this->state);
+
+		for (int i = 0; i < sizeof(this->sensor_storage) / sizeof(sample_ring_t*); i++) {
+			window_stats_destroy(this->sensor_stats[i]);
+			sample_ring_destroy(this->sensor_storage[i]);
+		}
+
+		arena_free(this);
 	}
 }
+
+// Sets the number of samples processed on a channel, discarding the stored ones. Only before the sensor timers start
+int SystemContext__set_window(SystemContext *this, int channel, unsigned int len) {
+	if (channel < 0 || channel >= sizeof(this->sensor_storage) / sizeof(sample_ring_t*) || len == 0 || len > SENSOR_WINDOW_MAX)
+		return -1;
+
+	window_stats_destroy(this->sensor_stats[channel]);
+	sample_ring_destroy(this->sensor_storage[channel]);
+	this->sensor_storage[channel] = sample_ring_new(len);
+	this->sensor_stats[channel] = window_stats_new(this->sensor_storage[channel], len);
+	if (this->sensor_percentile[channel] > 0)
+		window_stats_enable_percentiles(this->sensor_stats[channel]);
+
+	return 0;
+}
+
+// Selects how a channel is processed, see sensor_percentile. Only before the sensor timers start
+int SystemContext__set_filter(SystemContext *this, int channel, float percentile) {
+	if (channel < 0 || channel >= sizeof(this->sensor_stats) / sizeof(window_stats_t*) || percentile < 0 || percentile > 100)
+		return -1;
+
+	this->sensor_percentile[channel] = percentile;
+	if (percentile > 0)
+		window_stats_enable_percentiles(this->sensor_stats[channel]);
+
+	return 0;
+}
+
+// Sends the values of a channel to InfluxDB only when they move more than delta (0 sends every one), or when none was for max_silence_ms
+int SystemContext__set_deadband(SystemContext *this, int channel, deadband_mode_t mode, double delta, int64_t max_silence_ms) {
+	if (channel < 0 || channel >= sizeof(this->sensor_deadband) / sizeof(deadband_t) || delta < 0 || max_silence_ms < 0)
+		return -1;
+
+	deadband_init(&this->sensor_deadband[channel], mode, delta, max_silence_ms);
+	return 0;
+}
+
+// Sizes the sample queues for what the sensors publish between two processing rounds, twice over so that a late round loses
+// none (the DHT11 publishes two samples per reading). Setup only, before the acquisition threads start. Returns -1 for a period <= 0
+int SystemContext__set_periods(SystemContext *this, int meas_ms, int temp_humid_ms, int light_ms, int co2_ms) {
+	int periods[3] = { temp_humid_ms, light_ms, co2_ms };
+	unsigned int per_reading[3] = { 2, 1, 1 };
+
+	if (meas_ms <= 0)
+		return -1;
+	for (int i = 0; i < sizeof(this->sensor_queues) / sizeof(spsc_ring_t*); i++) {
+		if (periods[i] <= 0)
+			return -1;
+		unsigned long long len = 2ULL * per_reading[i] * ((meas_ms + periods[i] - 1) / periods[i]);
+		if (len < SENSOR_QUEUE_LEN)
+			len = SENSOR_QUEUE_LEN;
+		if (len > SENSOR_QUEUE_MAX)
+			len = SENSOR_QUEUE_MAX;
+		if (len > spsc_ring_capacity(this->sensor_queues[i])) {
+			spsc_ring_destroy(this->sensor_queues[i]);
+			this->sensor_queues[i] = spsc_ring_new(len, sizeof(SensorSampleType));
+		}
+	}
+	return 0;
+}
+
+// Opens (or creates with room for that many blocks) the file keeping the history of the room. Returns -1 if it cannot
+int SystemContext__open_store(SystemContext *this, const char *path, uint64_t blocks) {
+	tsdb_close(this->store);
+	this->store = tsdb_open(path, sizeof(this->sensor_storage) / sizeof(sample_ring_t*), blocks);
+
+	return this->store ? 0 : -1;
+}
+
+// Opens (or creates with room for that many records) the file keeping the closed rollups. Returns -1 if it cannot
+int SystemContext__open_rollup_log(SystemContext *this, const char *path, uint32_t records) {
+	rollup_log_close(this->rollup_log);
+	this->rollup_log = rollup_log_open(path, records);
+
+	return this->rollup_log ? 0 : -1;
+}
+
+// Called from the main loop every SYSTEM_CHECKPOINT_MS: what the history and the rollup log still hold in memory goes to their files
+void SystemContext__checkpoint(SystemContext *this) {
+	if (this->store)
+		tsdb_checkpoint(this->store);
+	if (this->rollup_log)
+		rollup_log_flush(this->rollup_log); // the records of the page being filled, however few
+}
+
+static long long _realtime_ms(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+// Opens the warm restart state of the room, after the windows are set (the file is made for their lengths). If it holds a
+// recent commit, the windows and the processed values are restored from it. Returns the samples restored, or -1 if it cannot
+int SystemContext__open_state(SystemContext *this, const char *path) {
+	unsigned int n_channels = sizeof(this->sensor_stats) / sizeof(window_stats_t*);
+	unsigned int capacity[STATE_MAX_CHANNELS];
+
+	for (int i = 0; i < n_channels; i++)
+		capacity[i] = this->sensor_stats[i]->len;
+
+	state_close(this->state);
+	this->state = state_open(path, n_channels, capacity);
+	if (!this->state)
+		return -1;
+
+	long long age_ms = _realtime_ms() - this->state->current.commit_ms;
+	if (!this->state->restored || age_ms < 0 || age_ms > SENSOR_STATE_MAX_AGE_MS)
+		return 0;
+
+	// the samples get CLOCK_MONOTONIC times again, those from before a reboot would be negative
+	struct timespec mono;
+	clock_gettime(CLOCK_MONOTONIC, &mono);
+	long long monotonic_offset_ms = _realtime_ms() - (mono.tv_sec * 1000LL + mono.tv_nsec / 1000000);
+
+	// scratch for the longest window, carved once at setup like the windows themselves
+	unsigned int longest = 0;
+	for (int i = 0; i < n_channels; i++)
+		longest = capacity[i] > longest ? capacity[i] : longest;
+	int64_t *ts_ms = (int64_t*) arena_malloc(longest * sizeof(int64_t));
+	SensorValueType *values = (SensorValueType*) arena_malloc(longest * sizeof(SensorValueType));
+	int restored = 0;
+	for (int i = 0; i < n_channels; i++) {
+		unsigned int n = state_restore_samples(this->state, i, ts_ms, values, capacity[i]);
+
+		for (unsigned int k = 0; k < n; k++) {
+			long long mono_ms = ts_ms[k] - monotonic_offset_ms;
+			SensorSampleType sample = { .timestamp_ns = mono_ms > 0 ? mono_ms * 1000000ULL : 0, .channel = i, .value = values[k] };
+			window_stats_push(this->sensor_stats[i], &sample);
+		}
+		this->sensor_values[i] = this->state->current.values[i];
+		restored += n;
+	}
+	this->sensor_values_ts_ns = this->state->current.commit_ms * 1000000LL;
+	arena_free(ts_ms);
+	arena_free(values);
+	SystemContext__publish_snapshot(this);
+
+	return restored;
+}
+
+// Main loop only, after a processing round: the windows and the values it used survive a restart from now on
+void SystemContext__commit_state(SystemContext *this) {
+	if (this->state)
+		state_commit(this->state, this->sensor_values, _realtime_ms());
+}
+
+// Main loop only, at the end of a processing round
+void SystemContext__publish_snapshot(SystemContext *this) {
+	SystemSnapshot snapshot;
+
+	memcpy(snapshot.values, this->sensor_values, sizeof(snapshot.values));
+	snapshot.values_ts_ns = this->sensor_values_ts_ns;
+	snapshot.flags = flags_get(&this->measurement_flags);
+	for (int i = 0; i < 3; i++)
+		snapshot.samples_dropped[i] = atomic_load_explicit(&this->sensor_queues[i]->dropped, memory_order_relaxed);
+	snapshot.samples_stored = this->store ? this->store->samples : 0;
+	snapshot.rollups_closed = this->rollups->closed;
+	for (int i = 0; i < 4; i++) {
+		snapshot.values_offered[i] = this->sensor_deadband[i].offered;
+		snapshot.values_sent[i] = this->sensor_deadband[i].sent_values;
+	}
+	flags_seqlock_write(&this->snapshot_lock, &this->snapshot, &snapshot, sizeof(snapshot));
+}
+
+// Any thread: the room as of its last processing round (or its setup)
+void SystemContext__read_snapshot(SystemContext *this, SystemSnapshot *snapshot) {
+	flags_seqlock_read(&this->snapshot_lock, snapshot, &this->snapshot, sizeof(SystemSnapshot));
+}
+
+// Main loop, from SystemContext__drain_samples: a period of a channel has closed
+static void _rollup_closed(void *user_data, unsigned int channel, int level, const rollup_bucket_t *bucket) {
+	SystemContext *this = (SystemContext*) user_data;
+	static const char *channel_names[4] = { "temp", "rh", "lux", "eco2" };
+
+	if (this->rollup_log && level >= ROLLUP_LOG_MIN_LEVEL)
+		rollup_log_append(this->rollup_log, channel, level, bucket);
+
+	if (this->uploader) {
+		char measurement[16], data[UPLOADER_LINE_LEN];
+		lineproto_field_t fields[6] = { { "count", LINEPROTO_INT, { .i = bucket->count } }, { "min", LINEPROTO_FLOAT, { .f = bucket->min } },
+				{ "max", LINEPROTO_FLOAT, { .f = bucket->max } }, { "mean", LINEPROTO_FLOAT, { .f = rollup_mean(bucket) } },
+				{ "sum", LINEPROTO_FLOAT, { .f = bucket->sum } }, { "sum_sq", LINEPROTO_FLOAT, { .f = bucket->sum_sq } } };
+
+		// pre-aggregated series for the dashboards, timestamped with the start of the period
+		strcpy(measurement, channel_names[channel]);
+		strcat(measurement, "_");
+		strcat(measurement, rollup_level_name(level));
+		if (lineproto_encode(data, sizeof(data), measurement, "room", this->id_classroom, fields, 6, bucket->start_ms * 1000000LL) > 0)
+			uploader_write(this->uploader, data);
+	}
+}
+
+// Called from the acquisition thread that owns the sensor, never blocks (the sample is dropped, and counted by the queue, if it is full)
+void SystemContext__publish_sample(SystemContext *this, int queue, int channel, SensorValueType value) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	SensorSampleType sample = { .timestamp_ns = (unsigned long long) ts.tv_sec * 1000000000ULL + ts.tv_nsec, .channel = channel, .value = value };
+	spsc_ring_push(this->sensor_queues[queue], &sample);
+}
+
+// Called from the main loop only, moves the queued samples to the storage rings and updates their statistics. Returns the number of samples moved
+int SystemContext__drain_samples(SystemContext *this) {
+	SensorSampleType sample;
+	int n = 0;
+	struct timespec mono, real;
+
+	// the samples carry CLOCK_MONOTONIC times, the history and the rollups wall clock ones
+	clock_gettime(CLOCK_MONOTONIC, &mono);
+	clock_gettime(CLOCK_REALTIME, &real);
+	long long realtime_offset_ns = (real.tv_sec - mono.tv_sec) * 1000000000LL + (real.tv_nsec - mono.tv_nsec);
+	unsigned long long newest_ns = 0;
+
+	for (int i = 0; i < sizeof(this->sensor_queues) / sizeof(spsc_ring_t*); i++) {
+		while (spsc_ring_pop(this->sensor_queues[i], &sample) == 0) {
+			long long ts_ms = ((long long) sample.timestamp_ns + realtime_offset_ns) / 1000000;
+
+			window_stats_push(this->sensor_stats[sample.channel], &sample);
+			if (this->state)
+				state_put_sample(this->state, sample.channel, ts_ms, &sample.value);
+			if (sample.value.type != is_error) {
+				float value = sample.value.type == is_int ? sample.value.val.ival : sample.value.val.fval;
+
+				if (this->store)
+					tsdb_append(this->store, sample.channel, ts_ms, value);
+				rollup_add(this->rollups, sample.channel, ts_ms, value);
+			}
+			if (sample.timestamp_ns > newest_ns)
+				newest_ns = sample.timestamp_ns;
+			n++;
+		}
+	}
+	if (n)
+		this->sensor_values_ts_ns = (long long) newest_ns + realtime_offset_ns;
+
+	return n;
+}
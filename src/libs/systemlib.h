@@ -19,26 +19,57 @@
 #include "../actuators/statusLed.h"
 
 #include "../libs/timerlib.h"
-#include "../libs/circularbuffer.h"
+#include "../libs/samplering.h"
+#include "../libs/windowstats.h"
+#include "../libs/reactorlib.h"
+#include "../libs/spscring.h"
+#include "../libs/flaglib.h"
+#include "../libs/uploadlib.h"
+#include "../libs/tsdblib.h"
+#include "../libs/rolluplib.h"
+#include "../libs/statelib.h"
+#include "../libs/deadbandlib.h"
 
-// Mutexes
-#define MEASUREMENT_LOCK 0
-#define OUTPUT_LOCK 1
-#define STORAGE_LOCK 2
+// Reactor events for guards that do not read flags, posted by the sensors' one-shot conversion timers to their bus
+// reactor (all the sensors of a kind on the same bus share the event). Everything else is scheduled by the flag bits
+// each FSM subscribes to (see reactor_subscribe_flags)
+#define EVENT_TEMP_HUMID 0x02 // DHT11 FSM
+#define EVENT_LIGHT 0x04 // BH1750 FSM
+#define EVENT_CO2 0x08 // CCS811 FSM
 
-typedef struct {
-	enum {
-		is_int, is_float, is_error
-	} type;
-	union {
-		int ival;
-		float fval;
-	} val;
-} SensorValueType; // This is a new type defined because we have sensors that give float value and int values depending on the sensor
+// Sample queues, one per sensor so that each one has a single producer (the thread of the sensor's bus)
+#define SENSOR_QUEUE_TEMP_HUMID 0
+#define SENSOR_QUEUE_LIGHT 1
+#define SENSOR_QUEUE_CO2 2
+#define SENSOR_QUEUE_LEN 64 // samples buffered between two processing rounds, at least (see SystemContext__set_periods)
+#define SENSOR_QUEUE_MAX 65536
+
+#define SYSTEM_CHECKPOINT_MS 300000 // the history files are brought up to date this often, the most a crash or a power cut loses
+#define SENSOR_WINDOW_LEN 5 // default number of last samples averaged by each processing round
+#define SENSOR_WINDOW_MAX 16384
+
+#define SENSOR_STATE_MAX_AGE_MS 600000 // an older warm restart state is not restored, the room may have changed meanwhile
+
+#define ROLLUP_LOG_MIN_LEVEL 1 // the 1 min rollups are only uploaded, the store already keeps every sample
 
+// What the other threads (/metrics) read of a room, published by the main loop at the end of every processing round
 typedef struct {
+	SensorValueType values[4];
+	int64_t values_ts_ns;
+	unsigned int flags; // measurement_flags, with the alerts of the round
+	unsigned long samples_dropped[3]; // by each sample queue
+	unsigned long samples_stored;
+	unsigned long rollups_closed;
+	unsigned long values_offered[4], values_sent[4]; // by the report by exception stage
+} SystemSnapshot;
+
+typedef struct SystemContext {
 	int id_classroom; // id/number of the classroom the system is in (corridor, building, location...)
 
+	// Room flags, read by the guards of the room's FSMs
+	flags_t measurement_flags;
+	flags_t output_flags;
+
 	// Sensors attached
 	DHT11Sensor *sensor_temp_humid;
 	BH1750Sensor *sensor_light;
@@ -50,13 +81,40 @@ typedef struct {
 	StatusLEDOutput *actuator_leds;
 
 	// Sensor values storage
-	CircularBuffer sensor_storage[4]; // At the moment, four circular/ring buffers representing Temp, Humid, Light, CO2
+	spsc_ring_t *sensor_queues[3]; // Samples published by the acquisition threads, drained by the measurement controller
+	sample_ring_t *sensor_storage[4]; // At the moment, four sample rings representing Temp, Humid, Light, CO2
+	window_stats_t *sensor_stats[4]; // Statistics of the processing window of each ring, updated on every sample
+	float sensor_percentile[4]; // Filter of each channel: 0 for the trimmed mean, else that percentile of the window (50 median)
 	SensorValueType sensor_values[4]; // Final processed values representing Temp, Humid, Light, CO2
+	int64_t sensor_values_ts_ns; // CLOCK_REALTIME time of the newest sample behind them
+	deadband_t sensor_deadband[4]; // Which of the processed values are uploaded, report by exception
+
+	uploader_t *uploader; // shared by every room of the process, NULL to keep the values local
+	tsdb_t *store; // local history of every sample, NULL to keep none
+	rollup_t *rollups; // 1 min to 1 day aggregates of every channel, uploaded as their periods close
+	rollup_log_t *rollup_log; // local history of the closed rollups, NULL to keep none
+	state_file_t *state; // windows and processed values for a warm restart, NULL to always start cold
+
+	flags_seqlock_t snapshot_lock;
+	SystemSnapshot snapshot;
 } SystemContext;
 
 SystemContext* SystemContext__create(int id_classroom, DHT11Sensor *sensor_temp_humid, BH1750Sensor *sensor_light, CCS811Sensor *sensor_co2, LCD1602Display *actuator_display,
 		BuzzerOutput *actuator_buzzer, StatusLEDOutput *actuator_leds);
 
 void SystemContext__destroy(SystemContext *this);
+int SystemContext__set_window(SystemContext *this, int channel, unsigned int len);
+int SystemContext__set_filter(SystemContext *this, int channel, float percentile);
+int SystemContext__set_periods(SystemContext *this, int meas_ms, int temp_humid_ms, int light_ms, int co2_ms);
+int SystemContext__set_deadband(SystemContext *this, int channel, deadband_mode_t mode, double delta, int64_t max_silence_ms);
+int SystemContext__open_store(SystemContext *this, const char *path, uint64_t blocks);
+int SystemContext__open_rollup_log(SystemContext *this, const char *path, uint32_t records);
+void SystemContext__checkpoint(SystemContext *this);
+int SystemContext__open_state(SystemContext *this, const char *path);
+void SystemContext__commit_state(SystemContext *this);
+void SystemContext__publish_snapshot(SystemContext *this);
+void SystemContext__read_snapshot(SystemContext *this, SystemSnapshot *snapshot);
+void SystemContext__publish_sample(SystemContext *this, int queue, int channel, SensorValueType value);
+int SystemContext__drain_samples(SystemContext *this);
 
 #endif /* SYSTEMLIB_H_ */
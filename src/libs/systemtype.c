@@ -8,9 +8,10 @@
 
 #include "systemtype.h"
 #include "../controllers/measurementctrl.h"
+#include "arenalib.h"
 
 SystemType* SystemType__setup(SystemContext* system, MeasurementCtrl* measurementctrl, OutputCtrl* outputctrl) {
-	SystemType* result = (SystemType*) malloc(sizeof(SystemType));
+	SystemType* result = (SystemType*) arena_malloc(sizeof(SystemType));
 	result->root_system = system;
 	result->root_measurement_ctrl = measurementctrl;
 	result->root_output_ctrl = outputctrl;
@@ -18,11 +19,56 @@ SystemType* SystemType__setup(SystemContext* system, MeasurementCtrl* measuremen
 	return result;
 }
 
+// Registers the FSMs of the room on the reactors (shared by every room of a gateway), each one subscribed to the flag
+// bits its guards read. Sensors and actuators the room does not have are skipped. Returns -1 if a reactor is full
+int SystemType__attach(SystemType* this, reactor_t* main_reactor, reactor_t* i2c_reactor, reactor_t* gpio_reactor) {
+	SystemContext* ctx = this->root_system;
+	int idx, err = 0;
+
+	idx = reactor_add_fsm(main_reactor, this->root_measurement_ctrl->fsm, 0);
+	err |= reactor_subscribe_flags(main_reactor, idx, &ctx->measurement_flags, MEASUREMENT_FSM_FLAGS);
+
+	if (ctx->actuator_buzzer) {
+		idx = reactor_add_fsm(main_reactor, this->root_output_ctrl->fsm_buzzer, 0);
+		err |= reactor_subscribe_flags(main_reactor, idx, &ctx->measurement_flags, OUTPUT_BUZZER_FSM_MEASUREMENT_FLAGS);
+	}
+	if (ctx->actuator_leds) {
+		idx = reactor_add_fsm(main_reactor, this->root_output_ctrl->fsm_leds, 0);
+		err |= reactor_subscribe_flags(main_reactor, idx, &ctx->measurement_flags, OUTPUT_LEDS_FSM_MEASUREMENT_FLAGS);
+	}
+	if (ctx->actuator_display) {
+		idx = reactor_add_fsm(main_reactor, this->root_output_ctrl->fsm_info, 0);
+		err |= reactor_subscribe_flags(main_reactor, idx, &ctx->output_flags, OUTPUT_INFO_FSM_OUTPUT_FLAGS);
+		idx = reactor_add_fsm(main_reactor, this->root_output_ctrl->fsm_warnings, 0);
+		err |= reactor_subscribe_flags(main_reactor, idx, &ctx->output_flags, OUTPUT_WARNINGS_FSM_OUTPUT_FLAGS);
+		err |= reactor_subscribe_flags(main_reactor, idx, &ctx->measurement_flags, OUTPUT_WARNINGS_FSM_MEASUREMENT_FLAGS);
+	}
+
+	// The sensor FSMs run on the acquisition threads and publish their samples through SPSC queues
+	if (ctx->sensor_light) {
+		ctx->sensor_light->reactor = i2c_reactor;
+		idx = reactor_add_fsm(i2c_reactor, ctx->sensor_light->fsm, EVENT_LIGHT);
+		err |= reactor_subscribe_flags(i2c_reactor, idx, &ctx->measurement_flags, FLAG_LIGHT_PENDING_MEASUREMENT);
+	}
+	if (ctx->sensor_co2) {
+		ctx->sensor_co2->reactor = i2c_reactor;
+		idx = reactor_add_fsm(i2c_reactor, ctx->sensor_co2->fsm, EVENT_CO2);
+		err |= reactor_subscribe_flags(i2c_reactor, idx, &ctx->measurement_flags, FLAG_CO2_PENDING_MEASUREMENT);
+	}
+	if (ctx->sensor_temp_humid) {
+		ctx->sensor_temp_humid->reactor = gpio_reactor;
+		idx = reactor_add_fsm(gpio_reactor, ctx->sensor_temp_humid->fsm, EVENT_TEMP_HUMID);
+		err |= reactor_subscribe_flags(gpio_reactor, idx, &ctx->measurement_flags, FLAG_TEMP_HUMID_PENDING_MEASUREMENT);
+	}
+
+	return err ? -1 : 0;
+}
+
 void SystemType__destroy(SystemType* this) {
 	if (this) {
 		MeasurementCtrl__destroy(this->root_measurement_ctrl);
 		OutputCtrl__destroy(this->root_output_ctrl);
 		SystemContext__destroy(this->root_system);
-		free(this);
+		arena_free(this);
 	}
 }
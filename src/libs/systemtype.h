@@ -21,6 +21,7 @@ typedef struct {
 } SystemType;
 
 SystemType* SystemType__setup(SystemContext* system, MeasurementCtrl* measurementctrl, OutputCtrl* outputctrl);
+int SystemType__attach(SystemType* this, reactor_t* main_reactor, reactor_t* i2c_reactor, reactor_t* gpio_reactor);
 void SystemType__destroy(SystemType* this);
 
 #endif /* LIBS_SYSTEMTYPE_H_ */
@@ -16,6 +16,12 @@ int multithreadingThreadCreate(void* (*fn)(void*)) {
 	return pthread_create(&myThread, NULL, fn, NULL);
 }
 
+int multithreadingThreadCreateArg(void* (*fn)(void*), void *arg) {
+	pthread_t myThread;
+
+	return pthread_create(&myThread, NULL, fn, arg);
+}
+
 void multithreadingLock(int key) {
 	pthread_mutex_lock(&multithreadingMutexes[key]);
 }
@@ -15,6 +15,7 @@
 #define	M_THREAD(X)	void *X (__attribute__((unused)) void *dummy)
 
 int multithreadingThreadCreate (void *(*fn)(void *));
+int multithreadingThreadCreateArg (void *(*fn)(void *), void *arg);
 void multithreadingLock(int key);
 void multithreadingUnlock(int key);
 
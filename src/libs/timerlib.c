@@ -6,39 +6,321 @@
  */
 
 #include "timerlib.h"
+#include "arenalib.h"
 
 #include <stdlib.h>
+#include <stdint.h>
 #include <signal.h>
 #include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/timerfd.h>
+
+#define TMR_WHEEL_MASK (TMR_WHEEL_SLOTS - 1)
+#define TMR_WHEEL_RANGE (1ULL << (TMR_WHEEL_BITS * TMR_WHEEL_LEVELS))
+
+/* Timing wheel */
+
+static void _wheel_place(tmr_wheel_t *this, tmr_wheel_node_t *node) {
+	uint64_t e = node->expires < this->now ? this->now : node->expires;
+	uint64_t delta = e - this->now;
+	int level = 0;
+
+	while (level < TMR_WHEEL_LEVELS - 1 && delta >= (1ULL << (TMR_WHEEL_BITS * (level + 1))))
+		level++;
+	if (delta >= TMR_WHEEL_RANGE)
+		e = this->now + TMR_WHEEL_RANGE - 1; // parked on the top level, re-placed when cascaded
+
+	int slot = (e >> (TMR_WHEEL_BITS * level)) & TMR_WHEEL_MASK;
+	tmr_wheel_node_t **head = &this->slots[level][slot];
+
+	node->level = level;
+	node->slot = slot;
+	node->next = *head;
+	if (*head)
+		(*head)->pprev = &node->next;
+	*head = node;
+	node->pprev = head;
+	this->occupied[level] |= 1ULL << slot;
+}
+
+static tmr_wheel_node_t* _wheel_detach_slot(tmr_wheel_t *this, int level, int slot) {
+	tmr_wheel_node_t *list = this->slots[level][slot];
+	this->slots[level][slot] = NULL;
+	this->occupied[level] &= ~(1ULL << slot);
+	return list;
+}
+
+static uint64_t _rotr64(uint64_t v, int n) {
+	return n ? (v >> n) | (v << (64 - n)) : v;
+}
+
+void tmr_wheel_init(tmr_wheel_t *this, uint64_t now) {
+	*this = (tmr_wheel_t) { 0 };
+	this->now = now;
+}
+
+void tmr_wheel_add(tmr_wheel_t *this, tmr_wheel_node_t *node, uint64_t expires) {
+	node->expires = expires;
+	_wheel_place(this, node);
+	this->count++;
+}
+
+void tmr_wheel_del(tmr_wheel_t *this, tmr_wheel_node_t *node) {
+	if (!node->pprev)
+		return;
+
+	*node->pprev = node->next;
+	if (node->next)
+		node->next->pprev = node->pprev;
+	if (!this->slots[node->level][node->slot])
+		this->occupied[node->level] &= ~(1ULL << node->slot);
+
+	node->next = NULL;
+	node->pprev = NULL;
+	this->count--;
+}
+
+// First tick >= now at which an entry expires or a non empty slot cascades, so the caller can sleep until then
+uint64_t tmr_wheel_next_tick(tmr_wheel_t *this) {
+	uint64_t next = TMR_WHEEL_NEVER;
+
+	for (int level = 0; level < TMR_WHEEL_LEVELS; level++) {
+		uint64_t occ = this->occupied[level];
+		if (!occ)
+			continue;
+
+		int shift = TMR_WHEEL_BITS * level;
+		uint64_t base = this->now >> shift;
+		int cur = base & TMR_WHEEL_MASK;
+		uint64_t rot = _rotr64(occ, cur);
+		uint64_t t;
+
+		if (level > 0 && (this->now & ((1ULL << shift) - 1)))
+			rot &= ~1ULL; // the current slot of this level already cascaded, next time is a whole turn away
+
+		if (rot)
+			t = (base + __builtin_ctzll(rot)) << shift;
+		else
+			t = (base + TMR_WHEEL_SLOTS) << shift;
+
+		if (t < next)
+			next = t;
+	}
+
+	return next;
+}
+
+// Processes every tick up to now (included) and returns the expired entries linked through next
+tmr_wheel_node_t* tmr_wheel_advance(tmr_wheel_t *this, uint64_t now) {
+	tmr_wheel_node_t *expired = NULL, **tail = &expired;
+
+	while (this->now <= now) {
+		uint64_t t = tmr_wheel_next_tick(this);
+		if (t > now) {
+			this->now = now + 1; // nothing happens in between, skip the empty ticks
+			break;
+		}
+		this->now = t;
+
+		int idx = t & TMR_WHEEL_MASK;
+		if (idx == 0) {
+			// cascade the higher levels whose index wraps around at this tick
+			for (int level = 1; level < TMR_WHEEL_LEVELS; level++) {
+				int slot = (t >> (TMR_WHEEL_BITS * level)) & TMR_WHEEL_MASK;
+				tmr_wheel_node_t *list = _wheel_detach_slot(this, level, slot);
+				while (list) {
+					tmr_wheel_node_t *node = list;
+					list = list->next;
+					_wheel_place(this, node);
+				}
+				if (slot != 0)
+					break;
+			}
+		}
+
+		tmr_wheel_node_t *list = _wheel_detach_slot(this, 0, idx);
+		if (list) {
+			*tail = list;
+			for (; list; list = list->next) {
+				list->pprev = NULL;
+				this->count--;
+				tail = &list->next;
+			}
+		}
+
+		this->now = t + 1;
+	}
+
+	return expired;
+}
+
+/* Timer service: one thread, one timerfd, one wheel for every tmr_t */
+
+#define TMR_MAX_BATCH 256 // expirations notified per wakeup, the rest stay due for the next tick
+
+typedef struct {
+	notify_func_t isr;
+	tmr_t *tmr;
+} _tmr_call_t;
+
+static tmr_wheel_t _tmr_wheel;
+static pthread_mutex_t _tmr_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct timespec _tmr_epoch; // tick 0
+static int _tmr_fd = -1;
+static pthread_once_t _tmr_once = PTHREAD_ONCE_INIT;
+
+static void* _tmr_thread(void *arg);
+
+static void _tmr_service_init(void) {
+	pthread_t th;
+
+	clock_gettime(CLOCK_MONOTONIC, &_tmr_epoch);
+	tmr_wheel_init(&_tmr_wheel, 0);
+	_tmr_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+	pthread_create(&th, NULL, _tmr_thread, NULL);
+	pthread_detach(th);
+}
+
+static long long _tmr_now_ns(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (long long) (now.tv_sec - _tmr_epoch.tv_sec) * 1000000000LL + (now.tv_nsec - _tmr_epoch.tv_nsec);
+}
+
+// Arms the timerfd for the next wheel event. Must be called with _tmr_mutex held
+static void _tmr_rearm(void) {
+	struct itimerspec spec = { { 0, 0 }, { 0, 0 } };
+	uint64_t next = tmr_wheel_next_tick(&_tmr_wheel);
+
+	if (next != TMR_WHEEL_NEVER) {
+		spec.it_value.tv_sec = _tmr_epoch.tv_sec + next / 1000;
+		spec.it_value.tv_nsec = _tmr_epoch.tv_nsec + (next % 1000) * 1000000;
+		if (spec.it_value.tv_nsec >= 1000000000) {
+			spec.it_value.tv_sec++;
+			spec.it_value.tv_nsec -= 1000000000;
+		}
+		if (spec.it_value.tv_sec == 0 && spec.it_value.tv_nsec == 0)
+			spec.it_value.tv_nsec = 1; // zero would disarm
+	}
+	timerfd_settime(_tmr_fd, TFD_TIMER_ABSTIME, &spec, NULL);
+}
 
 tmr_t* tmr_new(notify_func_t isr) {
-	tmr_t *this = (tmr_t*) malloc(sizeof(tmr_t));
+	tmr_t *this = (tmr_t*) arena_malloc(sizeof(tmr_t));
 	tmr_init(this, isr);
 	return this;
 
 }
 
 void tmr_init(tmr_t *this, notify_func_t isr) {
-	this->se.sigev_notify = SIGEV_THREAD;
-	this->se.sigev_value.sival_ptr = &(this->timerid);
-	this->se.sigev_notify_function = isr;
-	this->se.sigev_notify_attributes = NULL;
-	timer_create(CLOCK_REALTIME, &(this->se), &(this->timerid)); /* o CLOCK_MONOTONIC si se soporta */
+	pthread_once(&_tmr_once, _tmr_service_init);
+
+	this->node = (tmr_wheel_node_t) { 0 };
+	this->isr = isr;
+	this->period_ms = 0;
+	this->user_data = NULL;
+	this->stats = (tmr_stats_t) { 0 };
 }
 
 void tmr_destroy(tmr_t *this) {
 	tmr_stop(this);
-	free(this);
+	arena_free(this);
+}
+
+static void _tmr_start(tmr_t *this, int ms, int period_ms) {
+	pthread_mutex_lock(&_tmr_mutex);
+	tmr_wheel_del(&_tmr_wheel, &this->node);
+	this->period_ms = period_ms;
+	// round the current time up to the next tick so that a timer never fires early
+	uint64_t now_tick = (_tmr_now_ns() + 999999) / 1000000;
+	tmr_wheel_add(&_tmr_wheel, &this->node, now_tick + ms);
+	_tmr_rearm();
+	pthread_mutex_unlock(&_tmr_mutex);
 }
 
 void tmr_startms(tmr_t *this, int ms) {
-	this->spec.it_value.tv_sec = ms / 1000;
-	this->spec.it_value.tv_nsec = (ms % 1000) * 1000000;
-	this->spec.it_interval.tv_sec = ms / 1000;
-	this->spec.it_interval.tv_nsec = (ms % 1000) * 1000000;
-	timer_settime(this->timerid, 0, &(this->spec), NULL);
+	_tmr_start(this, ms, ms);
+}
+
+// Fires once after ms, used for deadlines (e.g. sensor conversion times)
+void tmr_startms_oneshot(tmr_t *this, int ms) {
+	_tmr_start(this, ms, 0);
 }
 
 void tmr_stop(tmr_t *this) {
-	timer_delete(this->timerid);
+	pthread_mutex_lock(&_tmr_mutex);
+	tmr_wheel_del(&_tmr_wheel, &this->node);
+	this->period_ms = 0;
+	pthread_mutex_unlock(&_tmr_mutex);
+}
+
+tmr_stats_t tmr_get_stats(tmr_t *this) {
+	return this->stats;
+}
+
+void tmr_print_stats(tmr_t *this, const char *name, FILE *out) {
+	tmr_stats_t s = this->stats;
+	fprintf(out, "[LOG-Timer] %-16s expirations %lu overruns %lu jitter last %.3f ms avg %.3f ms max %.3f ms\n", name, s.expirations, s.overruns, s.jitter_last_ns / 1e6,
+			s.expirations ? s.jitter_sum_ns / 1e6 / s.expirations : 0.0, s.jitter_max_ns / 1e6);
+}
+
+/* Timer thread: every expiry of every timer is notified from here */
+
+static void* _tmr_thread(void *arg) {
+	_tmr_call_t calls[TMR_MAX_BATCH]; // no allocation on the timer thread
+
+	while (1) {
+		uint64_t count;
+		if (read(_tmr_fd, &count, sizeof(count)) != sizeof(count))
+			continue;
+
+		pthread_mutex_lock(&_tmr_mutex);
+		long long now_ns = _tmr_now_ns();
+		uint64_t now_tick = now_ns / 1000000;
+		size_t n_calls = 0;
+
+		// bookkeeping of the whole batch under the lock, notify functions are called without it
+		tmr_wheel_node_t *expired = tmr_wheel_advance(&_tmr_wheel, now_tick);
+		while (expired) {
+			tmr_t *this = (tmr_t*) expired;
+			expired = expired->next;
+
+			if (n_calls == TMR_MAX_BATCH) {
+				tmr_wheel_add(&_tmr_wheel, &this->node, this->node.expires); // placed on the next tick, the jitter keeps counting
+				continue;
+			}
+
+			long long jitter = now_ns - (long long) this->node.expires * 1000000LL;
+			this->stats.expirations++;
+			this->stats.jitter_last_ns = jitter;
+			this->stats.jitter_sum_ns += jitter;
+			if (jitter > this->stats.jitter_max_ns)
+				this->stats.jitter_max_ns = jitter;
+
+			// periodic: keep the original phase, skipping the periods we were too late for
+			if (this->period_ms > 0) {
+				uint64_t next = this->node.expires + this->period_ms;
+				if (next <= now_tick) {
+					uint64_t missed = (now_tick - next) / this->period_ms + 1;
+					this->stats.overruns += missed;
+					next += missed * this->period_ms;
+				}
+				tmr_wheel_add(&_tmr_wheel, &this->node, next);
+			}
+
+			calls[n_calls].isr = this->isr;
+			calls[n_calls].tmr = this;
+			n_calls++;
+		}
+		_tmr_rearm();
+		pthread_mutex_unlock(&_tmr_mutex);
+
+		for (size_t i = 0; i < n_calls; i++) {
+			union sigval value = { .sival_ptr = calls[i].tmr };
+			calls[i].isr(value);
+		}
+	}
+
+	return NULL;
 }
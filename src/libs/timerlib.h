@@ -1,6 +1,10 @@
 /*
  * timerlib.h
  *
+ * Timers are entries of a hierarchical timing wheel (1 ms ticks) serviced by a single timer
+ * thread sleeping on one CLOCK_MONOTONIC timerfd, armed for the next wheel event. No thread per
+ * expiry as with SIGEV_THREAD, no kernel timer per object and no schedule shifts on NTP steps.
+ *
  *  Created on: 14 mar. 2021
  *      Author: Victoria M. Gullon and Marcos Gomez
  */
@@ -9,22 +13,67 @@
 #define TIMERLIB_H_
 
 #include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <time.h>
 
-struct tmr_t {
-    timer_t timerid;
-    struct itimerspec spec;
-    struct sigevent se;
+/* Hierarchical timing wheel: O(1) insert and cancel, batched expiry */
+
+#define TMR_WHEEL_BITS 6
+#define TMR_WHEEL_SLOTS (1 << TMR_WHEEL_BITS)
+#define TMR_WHEEL_LEVELS 4 // 2^24 ticks (~4.6 h at 1 ms) before an entry gets re-cascaded from the top level
+#define TMR_WHEEL_NEVER UINT64_MAX
+
+typedef struct tmr_wheel_node_t tmr_wheel_node_t;
+struct tmr_wheel_node_t {
+	tmr_wheel_node_t *next;
+	tmr_wheel_node_t **pprev; // NULL while not scheduled
+	uint64_t expires; // absolute tick
+	unsigned char level, slot;
 };
-typedef struct tmr_t tmr_t;
+
+typedef struct {
+	uint64_t now; // next tick to be processed
+	uint64_t occupied[TMR_WHEEL_LEVELS]; // bitmap of non empty slots per level
+	tmr_wheel_node_t *slots[TMR_WHEEL_LEVELS][TMR_WHEEL_SLOTS];
+	unsigned long count; // scheduled entries
+} tmr_wheel_t;
+
+void tmr_wheel_init(tmr_wheel_t *this, uint64_t now);
+void tmr_wheel_add(tmr_wheel_t *this, tmr_wheel_node_t *node, uint64_t expires);
+void tmr_wheel_del(tmr_wheel_t *this, tmr_wheel_node_t *node);
+uint64_t tmr_wheel_next_tick(tmr_wheel_t *this);
+tmr_wheel_node_t* tmr_wheel_advance(tmr_wheel_t *this, uint64_t now);
+
+/* Timers */
 
 typedef void (*notify_func_t) (union sigval);
 
+typedef struct {
+	unsigned long expirations; // times the notify function was called
+	unsigned long overruns; // periods missed because the timer thread was late
+	long long jitter_last_ns; // lateness of the last expiry
+	long long jitter_max_ns;
+	long long jitter_sum_ns; // to compute the average lateness
+} tmr_stats_t;
+
+struct tmr_t {
+    tmr_wheel_node_t node; // must be the first member
+    notify_func_t isr;
+    int period_ms; // 0 when stopped or one-shot
+    void* user_data; // owner of the timer, the notify function gets the tmr_t in sival_ptr
+    tmr_stats_t stats;
+};
+typedef struct tmr_t tmr_t;
+
 tmr_t* tmr_new (notify_func_t isr);
 void tmr_init (tmr_t* this, notify_func_t isr);
 void tmr_destroy(tmr_t* this);
 void tmr_startms(tmr_t* this, int ms);
+void tmr_startms_oneshot(tmr_t* this, int ms);
 void tmr_stop (tmr_t* this);
+tmr_stats_t tmr_get_stats (tmr_t* this);
+void tmr_print_stats (tmr_t* this, const char* name, FILE* out);
 
 
 
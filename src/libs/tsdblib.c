@@ -0,0 +1,535 @@
+/*
+ * tsdblib.c
+ *
+ *  Created on: 17 oct. 2026
+ *      Author: Victoria M. Gullon and Marcos Gomez
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "tsdblib.h"
+#include "arenalib.h"
+
+#define TSDB_HEADER_SIZE TSDB_BLOCK_SIZE // the file header takes the first page
+#define TSDB_MAX_SAMPLE_BITS 80 // 4 + 32 timestamp, 2 + 10 + 32 value
+#define TSDB_PAYLOAD_BITS (TSDB_PAYLOAD_SIZE * 8)
+
+/* bit stream, most significant bit first */
+
+static void _put_bits(tsdb_block_t *b, uint32_t v, int n) {
+	while (n > 0) {
+		uint32_t pos = b->header.bits;
+		int room = 8 - (pos & 7);
+		int take = n < room ? n : room;
+		uint8_t chunk = (v >> (n - take)) & ((1u << take) - 1);
+
+		b->payload[pos >> 3] |= chunk << (room - take);
+		b->header.bits += take;
+		n -= take;
+	}
+}
+
+static uint32_t _get_bits(tsdb_iter_t *it, int n) {
+	uint32_t v = 0;
+
+	while (n > 0) {
+		int room = 8 - (it->pos & 7);
+		int take = n < room ? n : room;
+		uint8_t byte = it->block->payload[it->pos >> 3];
+
+		v = (v << take) | ((byte >> (room - take)) & ((1u << take) - 1));
+		it->pos += take;
+		n -= take;
+	}
+	return v;
+}
+
+static int _fits(int64_t v, int bits) {
+	return v >= -(1LL << (bits - 1)) && v < (1LL << (bits - 1));
+}
+
+static uint32_t _float_bits(float value) {
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return bits;
+}
+
+static float _bits_float(uint32_t bits) {
+	float value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+uint32_t tsdb_crc32(const uint8_t *data, size_t len) {
+	uint32_t crc = 0xffffffff;
+
+	for (size_t i = 0; i < len; i++) {
+		crc ^= data[i];
+		for (int k = 0; k < 8; k++)
+			crc = (crc >> 1) ^ (0xedb88320 & -(crc & 1));
+	}
+	return ~crc;
+}
+
+/* index */
+
+static tsdb_index_entry_t* _index_entry(tsdb_index_t *idx, uint64_t capacity, uint64_t i) {
+	return &idx->entries[(idx->head + i) % capacity];
+}
+
+static void _index_push(tsdb_t *this, const tsdb_block_header_t *h, uint64_t slot) {
+	tsdb_index_t *idx = &this->index[h->channel];
+	tsdb_index_entry_t *e = _index_entry(idx, this->header->capacity, idx->count++);
+
+	e->first_ts_ms = h->first_ts_ms;
+	e->last_ts_ms = h->last_ts_ms;
+	e->sum = h->sum;
+	e->min = h->min;
+	e->max = h->max;
+	e->count = h->count;
+	e->slot = slot;
+}
+
+// The block in that slot is about to be overwritten, it is the oldest one of its channel
+static void _index_evict(tsdb_t *this, uint64_t slot) {
+	const tsdb_block_header_t *h = &this->blocks[slot].header;
+
+	if (h->magic != TSDB_BLOCK_MAGIC || h->channel >= this->n_channels)
+		return;
+
+	tsdb_index_t *idx = &this->index[h->channel];
+	if (idx->count > 0 && idx->entries[idx->head].slot == slot) {
+		idx->head = (idx->head + 1) % this->header->capacity;
+		idx->count--;
+	}
+}
+
+/* file */
+
+// A capacity of 0 only opens an existing store, and then n_channels 0 takes the channels of the file
+tsdb_t* tsdb_open(const char *path, unsigned int n_channels, uint64_t capacity) {
+	struct stat st;
+
+	if (n_channels > TSDB_MAX_CHANNELS || (n_channels == 0 && capacity > 0))
+		return NULL;
+	int writer = capacity > 0; // only the writer recovers the open blocks, a reader may run next to it
+
+	int fd = open(path, capacity > 0 ? O_RDWR | O_CREAT : O_RDWR, 0644);
+	if (fd < 0)
+		return NULL;
+
+	// an existing store keeps its own capacity, the files made before the open block pages get them
+	tsdb_file_header_t existing;
+	int reuse = fstat(fd, &st) == 0 && st.st_size >= TSDB_HEADER_SIZE && pread(fd, &existing, sizeof(existing), 0) == sizeof(existing)
+			&& memcmp(existing.magic, TSDB_MAGIC, 8) == 0 && existing.block_size == TSDB_BLOCK_SIZE
+			&& (n_channels == 0 || existing.n_channels == n_channels) && existing.n_channels <= TSDB_MAX_CHANNELS
+			&& (st.st_size == TSDB_HEADER_SIZE + existing.capacity * TSDB_BLOCK_SIZE
+					|| st.st_size == TSDB_HEADER_SIZE + (existing.capacity + TSDB_OPEN_BLOCKS) * TSDB_BLOCK_SIZE);
+	if (reuse) {
+		capacity = existing.capacity;
+		n_channels = existing.n_channels;
+	} else if (capacity == 0) {
+		close(fd);
+		return NULL;
+	}
+
+	int has_open = !reuse || writer || st.st_size == TSDB_HEADER_SIZE + (capacity + TSDB_OPEN_BLOCKS) * TSDB_BLOCK_SIZE;
+	size_t map_size = TSDB_HEADER_SIZE + (capacity + (has_open ? TSDB_OPEN_BLOCKS : 0)) * TSDB_BLOCK_SIZE;
+
+	// reserve the blocks now, running out of space later would be a SIGBUS on the mapping
+	if ((!reuse && (ftruncate(fd, 0) != 0 || posix_fallocate(fd, 0, map_size) != 0)) || (reuse && st.st_size != map_size && posix_fallocate(fd, 0, map_size) != 0)) {
+		close(fd);
+		return NULL;
+	}
+
+	void *map = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED) {
+		close(fd);
+		return NULL;
+	}
+
+	tsdb_t *this = (tsdb_t*) arena_calloc(1, sizeof(tsdb_t));
+	this->fd = fd;
+	this->header = (tsdb_file_header_t*) map;
+	this->blocks = (tsdb_block_t*) ((uint8_t*) map + TSDB_HEADER_SIZE);
+	this->open = has_open ? this->blocks + capacity : NULL;
+	this->map_size = map_size;
+	this->n_channels = n_channels;
+	this->stage = (tsdb_block_t*) arena_malloc(TSDB_STAGE_BLOCKS * sizeof(tsdb_block_t));
+
+	if (!reuse) {
+		memcpy(this->header->magic, TSDB_MAGIC, 8);
+		this->header->block_size = TSDB_BLOCK_SIZE;
+		this->header->n_channels = n_channels;
+		this->header->capacity = capacity;
+		this->header->sealed = 0;
+	}
+
+	// rebuilt from the block headers, one page read per block
+	for (unsigned int c = 0; c < n_channels; c++)
+		this->index[c].entries = (tsdb_index_entry_t*) arena_malloc(capacity * sizeof(tsdb_index_entry_t));
+	for (uint64_t i = 0; i < tsdb_n_blocks(this); i++) {
+		const tsdb_block_header_t *h = &tsdb_block(this, i)->header;
+		if (h->magic == TSDB_BLOCK_MAGIC && h->channel < n_channels)
+			_index_push(this, h, (this->header->sealed - tsdb_n_blocks(this) + i) % capacity);
+	}
+
+	// open blocks of the last checkpoint, unless the file already has them sealed (a clean close, or sealed after it)
+	for (unsigned int c = 0; writer && c < n_channels; c++) {
+		const tsdb_block_header_t *h = &this->open[c].header;
+		tsdb_index_t *idx = &this->index[c];
+		if (h->magic != TSDB_BLOCK_MAGIC || h->channel != c || h->count == 0 || h->bits > TSDB_PAYLOAD_BITS
+				|| h->crc != tsdb_crc32(this->open[c].payload, (h->bits + 7) / 8))
+			continue;
+		if (idx->count == 0 || h->first_ts_ms > _index_entry(idx, capacity, idx->count - 1)->last_ts_ms) {
+			this->stage[this->n_staged++] = this->open[c];
+			this->recovered++;
+		}
+	}
+	if (writer) {
+		tsdb_flush(this);
+		memset(this->open, 0, TSDB_OPEN_BLOCKS * sizeof(tsdb_block_t));
+	}
+
+	return this;
+}
+
+static void _seal(tsdb_t *this, tsdb_writer_t *w) {
+	tsdb_block_t *b = &w->block;
+
+	b->header.crc = tsdb_crc32(b->payload, (b->header.bits + 7) / 8);
+	this->stage[this->n_staged++] = *b;
+	b->header.count = 0;
+
+	if (this->n_staged == TSDB_STAGE_BLOCKS)
+		tsdb_flush(this);
+}
+
+// Closing seals the open blocks, even if they are not full
+void tsdb_close(tsdb_t *this) {
+	if (this) {
+		for (unsigned int c = 0; c < this->n_channels; c++) {
+			if (this->writers[c].block.header.count > 0)
+				_seal(this, &this->writers[c]);
+		}
+		tsdb_flush(this);
+		if (this->open && this->samples)
+			memset(this->open, 0, TSDB_OPEN_BLOCKS * sizeof(tsdb_block_t)); // all sealed, nothing to recover
+		msync(this->header, this->map_size, MS_SYNC);
+		munmap(this->header, this->map_size);
+		close(this->fd);
+		arena_free(this->stage);
+		for (unsigned int c = 0; c < this->n_channels; c++)
+			arena_free(this->index[c].entries);
+		arena_free(this);
+	}
+}
+
+// Writes the staged blocks to the file, one sequential run of pages (two if it wraps). Returns the number of blocks
+int tsdb_flush(tsdb_t *this) {
+	uint64_t capacity = this->header->capacity;
+	uint64_t first = this->header->sealed % capacity;
+	int n = this->n_staged;
+
+	if (n == 0)
+		return 0;
+
+	for (int i = 0; i < n; i++) {
+		uint64_t slot = (first + i) % capacity;
+		if (this->header->sealed + i >= capacity)
+			_index_evict(this, slot);
+		this->blocks[slot] = this->stage[i];
+		_index_push(this, &this->stage[i].header, slot);
+	}
+	this->header->sealed += n; // after the blocks
+	this->n_staged = 0;
+	this->flushes++;
+
+	// the kernel writes the dirty run back together, the header page goes with it
+	msync(this->header, TSDB_HEADER_SIZE, MS_ASYNC);
+	if (first + n <= capacity) {
+		msync(&this->blocks[first], n * TSDB_BLOCK_SIZE, MS_ASYNC);
+	} else {
+		msync(&this->blocks[first], (capacity - first) * TSDB_BLOCK_SIZE, MS_ASYNC);
+		msync(&this->blocks[0], (first + n - capacity) * TSDB_BLOCK_SIZE, MS_ASYNC);
+	}
+
+	return n;
+}
+
+// Writes the staged blocks however few, and a copy of every open block to its page. Called every few minutes, this bounds
+// what a stop without tsdb_close loses. Returns the number of open blocks copied
+int tsdb_checkpoint(tsdb_t *this) {
+	int n = 0;
+
+	tsdb_flush(this);
+	for (unsigned int c = 0; this->open && c < this->n_channels; c++) {
+		tsdb_block_t *b = &this->writers[c].block;
+		if (b->header.count > 0) {
+			b->header.crc = tsdb_crc32(b->payload, (b->header.bits + 7) / 8);
+			this->open[c] = *b;
+			n++;
+		} else {
+			this->open[c].header.magic = 0;
+		}
+	}
+	this->checkpoints++;
+	if (this->open)
+		msync(this->open, this->n_channels * TSDB_BLOCK_SIZE, MS_ASYNC);
+
+	return n;
+}
+
+/* encoder */
+
+static void _start_block(tsdb_writer_t *w, unsigned int channel, int64_t ts_ms, float value) {
+	tsdb_block_t *b = &w->block;
+
+	memset(b, 0, sizeof(tsdb_block_t));
+	b->header.magic = TSDB_BLOCK_MAGIC;
+	b->header.channel = channel;
+	b->header.count = 1;
+	b->header.first_ts_ms = b->header.last_ts_ms = ts_ms;
+	b->header.first_value = b->header.min = b->header.max = value;
+	b->header.sum = value;
+
+	w->prev_ts_ms = ts_ms;
+	w->prev_delta = 0;
+	w->prev_bits = _float_bits(value);
+	w->prev_leading = w->prev_trailing = -1;
+}
+
+// Returns 0, or -1 if the channel does not exist
+int tsdb_append(tsdb_t *this, unsigned int channel, int64_t ts_ms, float value) {
+	if (channel >= this->n_channels)
+		return -1;
+
+	tsdb_writer_t *w = &this->writers[channel];
+	tsdb_block_t *b = &w->block;
+	this->samples++;
+
+	int64_t delta = ts_ms - w->prev_ts_ms;
+	int64_t dod = delta - w->prev_delta;
+
+	if (b->header.count > 0 && (b->header.bits + TSDB_MAX_SAMPLE_BITS > TSDB_PAYLOAD_BITS || b->header.count == UINT16_MAX || !_fits(dod, 32)))
+		_seal(this, w);
+
+	if (b->header.count == 0) {
+		_start_block(w, channel, ts_ms, value);
+		return 0;
+	}
+
+	// timestamp: delta of delta, the sensor periods make it 0 or a few ms of jitter
+	if (dod == 0) {
+		_put_bits(b, 0x0, 1);
+	} else if (_fits(dod, 4)) {
+		_put_bits(b, 0x2, 2);
+		_put_bits(b, (uint32_t) dod & 0xf, 4);
+	} else if (_fits(dod, 7)) {
+		_put_bits(b, 0x6, 3);
+		_put_bits(b, (uint32_t) dod & 0x7f, 7);
+	} else if (_fits(dod, 12)) {
+		_put_bits(b, 0xe, 4);
+		_put_bits(b, (uint32_t) dod & 0xfff, 12);
+	} else {
+		_put_bits(b, 0xf, 4);
+		_put_bits(b, (uint32_t) dod, 32);
+	}
+
+	// value: XOR with the previous one, only its meaningful bits
+	uint32_t bits = _float_bits(value);
+	uint32_t xor = bits ^ w->prev_bits;
+
+	if (xor == 0) {
+		_put_bits(b, 0x0, 1);
+	} else {
+		int leading = __builtin_clz(xor), trailing = __builtin_ctz(xor);
+
+		if (w->prev_leading >= 0 && leading >= w->prev_leading && trailing >= w->prev_trailing) {
+			_put_bits(b, 0x2, 2); // same window as the last one
+			_put_bits(b, xor >> w->prev_trailing, 32 - w->prev_leading - w->prev_trailing);
+		} else {
+			int len = 32 - leading - trailing;
+			_put_bits(b, 0x3, 2);
+			_put_bits(b, leading, 5);
+			_put_bits(b, len - 1, 5);
+			_put_bits(b, xor >> trailing, len);
+			w->prev_leading = leading;
+			w->prev_trailing = trailing;
+		}
+	}
+
+	w->prev_ts_ms = ts_ms;
+	w->prev_delta = delta;
+	w->prev_bits = bits;
+
+	b->header.count++;
+	b->header.last_ts_ms = ts_ms;
+	b->header.sum += value;
+	if (value < b->header.min)
+		b->header.min = value;
+	if (value > b->header.max)
+		b->header.max = value;
+
+	return 0;
+}
+
+/* reading */
+
+// Blocks in the file, the oldest ones already overwritten are not counted
+uint64_t tsdb_n_blocks(tsdb_t *this) {
+	return this->header->sealed < this->header->capacity ? this->header->sealed : this->header->capacity;
+}
+
+// i-th oldest block in the file
+const tsdb_block_t* tsdb_block(tsdb_t *this, uint64_t i) {
+	uint64_t n = tsdb_n_blocks(this);
+
+	if (i >= n)
+		return NULL;
+	return &this->blocks[(this->header->sealed - n + i) % this->header->capacity];
+}
+
+void tsdb_iter_init(tsdb_iter_t *it, const tsdb_block_t *block) {
+	it->block = block;
+	it->pos = 0;
+	it->index = 0;
+	it->ts_ms = block->header.first_ts_ms;
+	it->delta = 0;
+	it->bits = _float_bits(block->header.first_value);
+	it->leading = it->trailing = 0;
+}
+
+// Returns 0 and the next sample, or -1 at the end of the block
+int tsdb_iter_next(tsdb_iter_t *it, int64_t *ts_ms, float *value) {
+	if (it->index >= it->block->header.count)
+		return -1;
+
+	if (it->index > 0) {
+		int64_t dod;
+
+		if (_get_bits(it, 1) == 0)
+			dod = 0;
+		else if (_get_bits(it, 1) == 0)
+			dod = (int32_t) (_get_bits(it, 4) << 28) >> 28;
+		else if (_get_bits(it, 1) == 0)
+			dod = (int32_t) (_get_bits(it, 7) << 25) >> 25;
+		else if (_get_bits(it, 1) == 0)
+			dod = (int32_t) (_get_bits(it, 12) << 20) >> 20;
+		else
+			dod = (int32_t) _get_bits(it, 32);
+
+		it->delta += dod;
+		it->ts_ms += it->delta;
+
+		if (_get_bits(it, 1)) {
+			if (_get_bits(it, 1)) {
+				it->leading = _get_bits(it, 5);
+				int len = _get_bits(it, 5) + 1;
+				it->trailing = 32 - it->leading - len;
+			}
+			it->bits ^= _get_bits(it, 32 - it->leading - it->trailing) << it->trailing;
+		}
+	}
+
+	it->index++;
+	*ts_ms = it->ts_ms;
+	*value = _bits_float(it->bits);
+	return 0;
+}
+
+/* queries */
+
+static void _agg_add(tsdb_agg_t *bucket, uint32_t count, float min, float max, double sum) {
+	if (bucket->count == 0 || min < bucket->min)
+		bucket->min = min;
+	if (bucket->count == 0 || max > bucket->max)
+		bucket->max = max;
+	bucket->count += count;
+	bucket->sum += sum;
+}
+
+static void _query_block(tsdb_t *this, const tsdb_index_entry_t *e, const tsdb_block_t *block, int64_t from_ms, int64_t to_ms, int64_t step_ms,
+		tsdb_agg_t *buckets) {
+	// whole block in one bucket: its summary is enough, the payload is not touched
+	if (e->first_ts_ms >= from_ms && e->last_ts_ms < to_ms && (e->first_ts_ms - from_ms) / step_ms == (e->last_ts_ms - from_ms) / step_ms) {
+		_agg_add(&buckets[(e->first_ts_ms - from_ms) / step_ms], e->count, e->min, e->max, e->sum);
+		this->blocks_summarized++;
+		return;
+	}
+
+	tsdb_iter_t it;
+	int64_t ts_ms;
+	float value;
+
+	tsdb_iter_init(&it, block);
+	while (tsdb_iter_next(&it, &ts_ms, &value) == 0) {
+		if (ts_ms >= to_ms)
+			break;
+		if (ts_ms >= from_ms)
+			_agg_add(&buckets[(ts_ms - from_ms) / step_ms], 1, value, value, value);
+	}
+	this->blocks_decoded++;
+}
+
+static void _query_unindexed(tsdb_t *this, const tsdb_block_t *block, int64_t from_ms, int64_t to_ms, int64_t step_ms, tsdb_agg_t *buckets) {
+	const tsdb_block_header_t *h = &block->header;
+	tsdb_index_entry_t e = { h->first_ts_ms, h->last_ts_ms, h->sum, h->min, h->max, h->count, 0 };
+
+	if (h->count > 0 && h->last_ts_ms >= from_ms && h->first_ts_ms < to_ms)
+		_query_block(this, &e, block, from_ms, to_ms, step_ms, buckets);
+}
+
+// Count, min, max and sum of the samples of a channel in [from_ms, to_ms), in buckets of step_ms starting at from_ms (one bucket
+// for the whole range if step_ms is 0). Includes the samples not in the file yet. Returns the number of buckets, or -1 if they
+// do not fit in n_buckets
+int tsdb_query(tsdb_t *this, unsigned int channel, int64_t from_ms, int64_t to_ms, int64_t step_ms, tsdb_agg_t *buckets, unsigned int n_buckets) {
+	if (channel >= this->n_channels || to_ms <= from_ms || step_ms < 0)
+		return -1;
+	if (step_ms == 0)
+		step_ms = to_ms - from_ms;
+
+	int64_t n = (to_ms - from_ms + step_ms - 1) / step_ms;
+	if (n > n_buckets)
+		return -1;
+
+	for (int64_t k = 0; k < n; k++) {
+		memset(&buckets[k], 0, sizeof(tsdb_agg_t));
+		buckets[k].start_ms = from_ms + k * step_ms;
+	}
+
+	// binary search of the first block ending at or after from_ms, the blocks of a channel are in time order
+	tsdb_index_t *idx = &this->index[channel];
+	uint64_t capacity = this->header->capacity, lo = 0, hi = idx->count;
+	while (lo < hi) {
+		uint64_t mid = lo + (hi - lo) / 2;
+		if (_index_entry(idx, capacity, mid)->last_ts_ms < from_ms)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	for (uint64_t i = lo; i < idx->count; i++) {
+		const tsdb_index_entry_t *e = _index_entry(idx, capacity, i);
+		if (e->first_ts_ms >= to_ms)
+			break;
+		_query_block(this, e, &this->blocks[e->slot], from_ms, to_ms, step_ms, buckets);
+	}
+
+	for (unsigned int i = 0; i < this->n_staged; i++) {
+		if (this->stage[i].header.channel == channel)
+			_query_unindexed(this, &this->stage[i], from_ms, to_ms, step_ms, buckets);
+	}
+	_query_unindexed(this, &this->writers[channel].block, from_ms, to_ms, step_ms, buckets);
+
+	return n;
+}
+
+double tsdb_agg_mean(const tsdb_agg_t *bucket) {
+	return bucket->count ? bucket->sum / bucket->count : 0;
+}
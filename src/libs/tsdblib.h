@@ -0,0 +1,152 @@
+/*
+ * tsdblib.h
+ *
+ * Local time-series store: one mmap'd file of fixed size blocks, each holding the samples of one
+ * channel compressed Gorilla style (delta-of-delta millisecond timestamps, XOR of consecutive
+ * float values). Samples are encoded into an open block per channel kept in memory; full blocks
+ * are sealed, staged, and copied to the file TSDB_STAGE_BLOCKS at a time so the SD card sees
+ * large sequential writes of whole pages. The file is append-only and circular: once it is full
+ * the oldest block is overwritten.
+ *
+ * tsdb_checkpoint writes the staged blocks however few, and copies the open block of every channel
+ * to a page of its own after the circular part. After a stop without tsdb_close (a crash, a power
+ * cut) the next tsdb_open seals those copies into the file, so only the samples since the last
+ * checkpoint are lost.
+ *
+ * Range queries go through a sparse index kept in memory: one entry per block (time span, count,
+ * min, max and sum) in time order per channel, rebuilt from the block headers when the file is
+ * opened. Blocks entirely inside one bucket of a query are answered from their entry, only the
+ * blocks crossing a bucket edge are decoded.
+ *
+ *  Created on: 17 oct. 2026
+ *      Author: Victoria M. Gullon and Marcos Gomez
+ */
+
+#ifndef LIBS_TSDBLIB_H_
+#define LIBS_TSDBLIB_H_
+
+#include <stdint.h>
+
+#define TSDB_MAGIC "RPTSDB02"
+#define TSDB_BLOCK_MAGIC 0x4b4c4254 // "TBLK"
+#define TSDB_BLOCK_SIZE 4096 // one page, a block is never rewritten once in the file
+#define TSDB_MAX_CHANNELS 8
+#define TSDB_STAGE_BLOCKS 16 // sealed blocks written to the file at once (64 KB)
+#define TSDB_DEFAULT_BLOCKS 4096 // 16 MB, about three months of 5 s samples of four channels
+#define TSDB_OPEN_BLOCKS TSDB_MAX_CHANNELS // pages after the circular part for the open blocks of the last checkpoint
+
+typedef struct {
+	uint32_t magic; // TSDB_BLOCK_MAGIC
+	uint16_t channel;
+	uint16_t count; // samples in the block
+	uint32_t bits; // payload bits used
+	uint32_t crc; // of the payload
+	int64_t first_ts_ms; // CLOCK_REALTIME, ms
+	int64_t last_ts_ms;
+	float first_value;
+	float min;
+	float max;
+	uint32_t reserved;
+	double sum; // of the values, for the queries answered from the header
+} tsdb_block_header_t;
+
+#define TSDB_PAYLOAD_SIZE (TSDB_BLOCK_SIZE - sizeof(tsdb_block_header_t))
+
+typedef struct {
+	tsdb_block_header_t header;
+	uint8_t payload[TSDB_PAYLOAD_SIZE];
+} tsdb_block_t;
+
+typedef struct {
+	char magic[8]; // TSDB_MAGIC
+	uint32_t block_size;
+	uint32_t n_channels;
+	uint64_t capacity; // blocks in the file after this header page
+	uint64_t sealed; // blocks ever written, block i lives in slot i % capacity
+} tsdb_file_header_t;
+
+// summary of a sealed block in the index
+typedef struct {
+	int64_t first_ts_ms;
+	int64_t last_ts_ms;
+	double sum;
+	float min;
+	float max;
+	uint32_t count;
+	uint32_t slot; // of the block in the file
+} tsdb_index_entry_t;
+
+// sealed blocks of one channel, oldest first, a ring of capacity entries
+typedef struct {
+	tsdb_index_entry_t *entries;
+	uint64_t head;
+	uint64_t count;
+} tsdb_index_t;
+
+// encoder state of the open block of a channel
+typedef struct {
+	tsdb_block_t block;
+	int64_t prev_ts_ms;
+	int64_t prev_delta;
+	uint32_t prev_bits; // previous value as raw float bits
+	int prev_leading, prev_trailing; // meaningful bits window of the last XOR, -1 before the first
+} tsdb_writer_t;
+
+typedef struct {
+	int fd;
+	tsdb_file_header_t *header; // start of the mapping
+	tsdb_block_t *blocks; // capacity slots after the header page
+	tsdb_block_t *open; // TSDB_OPEN_BLOCKS pages after them, one per channel
+	size_t map_size;
+	unsigned int n_channels;
+
+	tsdb_writer_t writers[TSDB_MAX_CHANNELS];
+	tsdb_block_t *stage; // sealed blocks not in the file yet
+	unsigned int n_staged;
+
+	tsdb_index_t index[TSDB_MAX_CHANNELS];
+
+	unsigned long samples; // appended since opened
+	unsigned long flushes; // stage writes to the file
+	unsigned long checkpoints;
+	unsigned long recovered; // open blocks sealed by tsdb_open from the last checkpoint before an unclean stop
+	unsigned long blocks_summarized; // by the queries, answered from the index
+	unsigned long blocks_decoded;
+} tsdb_t;
+
+// one bucket of a query result
+typedef struct {
+	int64_t start_ms;
+	uint32_t count;
+	float min;
+	float max;
+	double sum;
+} tsdb_agg_t;
+
+// decoder over a sealed block
+typedef struct {
+	const tsdb_block_t *block;
+	uint32_t pos; // bit position in the payload
+	unsigned int index; // next sample
+	int64_t ts_ms;
+	int64_t delta;
+	uint32_t bits;
+	int leading, trailing;
+} tsdb_iter_t;
+
+tsdb_t* tsdb_open(const char *path, unsigned int n_channels, uint64_t capacity);
+void tsdb_close(tsdb_t *this);
+int tsdb_append(tsdb_t *this, unsigned int channel, int64_t ts_ms, float value);
+int tsdb_flush(tsdb_t *this);
+int tsdb_checkpoint(tsdb_t *this);
+uint64_t tsdb_n_blocks(tsdb_t *this);
+const tsdb_block_t* tsdb_block(tsdb_t *this, uint64_t i);
+uint32_t tsdb_crc32(const uint8_t *data, size_t len);
+
+void tsdb_iter_init(tsdb_iter_t *it, const tsdb_block_t *block);
+int tsdb_iter_next(tsdb_iter_t *it, int64_t *ts_ms, float *value);
+
+int tsdb_query(tsdb_t *this, unsigned int channel, int64_t from_ms, int64_t to_ms, int64_t step_ms, tsdb_agg_t *buckets, unsigned int n_buckets);
+double tsdb_agg_mean(const tsdb_agg_t *bucket);
+
+#endif /* LIBS_TSDBLIB_H_ */
@@ -0,0 +1,428 @@
+/*
+ * uploadlib.c
+ *
+ *  Created on: 17 oct. 2026
+ *      Author: Victoria M. Gullon and Marcos Gomez
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <curl/curl.h>
+#include <zlib.h>
+
+#include "uploadlib.h"
+#include "arenalib.h"
+
+static pthread_once_t _curl_once = PTHREAD_ONCE_INIT;
+
+// libcurl allocates and frees on every request: from the pools of the arena, the heap if there is none
+static void _curl_init(void) {
+	curl_global_init_mem(CURL_GLOBAL_ALL, arena_pool_malloc, arena_pool_free, arena_pool_realloc, arena_pool_strdup, arena_pool_calloc);
+}
+
+static int64_t _now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// InfluxDB answers 204 with no body, error bodies are not printed to stdout
+static size_t _discard(char *data, size_t size, size_t n, void *user_data) {
+	return size * n;
+}
+
+// zlib allocates its buffers once, in deflateInit2: from the pools like libcurl
+static voidpf _zalloc(voidpf opaque, uInt items, uInt size) {
+	return arena_pool_calloc(items, size);
+}
+
+static void _zfree(voidpf opaque, voidpf ptr) {
+	arena_pool_free(ptr);
+}
+
+/* worker */
+
+// Raw bytes of a batch so that its body takes about target_bytes on the wire
+static void _resize_batch(uploader_t *this) {
+	double limit = this->target_bytes ? this->target_bytes * (this->gzip_level ? this->ratio : 1) : UPLOADER_BATCH_BYTES;
+
+	if (limit > UPLOADER_BATCH_BYTES)
+		limit = UPLOADER_BATCH_BYTES;
+	if (limit < UPLOADER_MIN_BATCH_BYTES)
+		limit = UPLOADER_MIN_BATCH_BYTES;
+	this->batch_limit = (size_t) limit;
+}
+
+// Gzips one body into wire. Returns its compressed length, 0 if it could not be compressed
+static size_t _compress(uploader_t *this, const char *body, size_t len) {
+	z_stream *z = (z_stream*) this->zstream;
+	struct timespec c0, c1;
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &c0);
+	deflateReset(z);
+	z->next_in = (Bytef*) body;
+	z->avail_in = len;
+	z->next_out = (Bytef*) this->wire;
+	z->avail_out = this->wire_size;
+	int res = deflate(z, Z_FINISH);
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &c1);
+
+	unsigned long long cpu_ns = (c1.tv_sec - c0.tv_sec) * 1000000000LL + c1.tv_nsec - c0.tv_nsec;
+	this->compress_sum_ns += cpu_ns;
+	if (cpu_ns > this->compress_max_ns)
+		this->compress_max_ns = cpu_ns;
+	if (res != Z_STREAM_END)
+		return 0;
+
+	size_t wire_len = this->wire_size - z->avail_out;
+	this->compressed++;
+	if (len >= UPLOADER_MIN_BATCH_BYTES) {
+		this->ratio += ((double) len / wire_len - this->ratio) / 4;
+		_resize_batch(this);
+	}
+	return wire_len;
+}
+
+// Posts one body. Returns 0 on success (always for a dry run)
+static int _post(uploader_t *this, const char *body, size_t len, int64_t since_ns) {
+	int res = 0;
+	size_t wire_len = this->gzip_level ? _compress(this, body, len) : 0;
+	const char *wire = wire_len ? this->wire : body;
+	int64_t t0 = _now_ns();
+
+	if (!wire_len)
+		wire_len = len;
+	this->posts++;
+	this->bytes += len;
+	this->wire_bytes += wire_len;
+
+	if (this->hnd) {
+		long status = 0;
+		CURL *hnd = (CURL*) this->hnd;
+
+		curl_easy_setopt(hnd, CURLOPT_HTTPHEADER, wire == body ? NULL : (struct curl_slist*) this->headers);
+		curl_easy_setopt(hnd, CURLOPT_POSTFIELDS, wire);
+		curl_easy_setopt(hnd, CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t) wire_len);
+		if (curl_easy_perform(hnd) != CURLE_OK || curl_easy_getinfo(hnd, CURLINFO_RESPONSE_CODE, &status) != CURLE_OK || status >= 300) {
+			this->errors++;
+			res = -1;
+		}
+	}
+
+	int64_t t1 = _now_ns();
+	unsigned long long post_ns = t1 - t0, delay_ms = (t1 - since_ns) / 1000000;
+	this->post_sum_ns += post_ns;
+	if (post_ns > this->post_max_ns)
+		this->post_max_ns = post_ns;
+	this->delay_sum_ms += delay_ms;
+	if (delay_ms > this->delay_max_ms)
+		this->delay_max_ms = delay_ms;
+
+	this->last_res = res;
+	return res;
+}
+
+// Posts the batch of queued lines, kept in the spool if the post fails
+static void _post_queued(uploader_t *this) {
+	if (this->batch_lines == 0)
+		return;
+
+	if (_post(this, this->batch, this->batch_len, this->batch_since_ns) != 0) {
+		if (this->spool && spool_append(this->spool, this->batch, this->batch_len, this->batch_lines) == 0)
+			this->spooled += this->batch_lines;
+		else
+			this->dropped += this->batch_lines;
+		this->replay_retry_ns = _now_ns() + (int64_t) UPLOADER_RETRY_MS * 1000000;
+	} else {
+		this->replay_retry_ns = 0; // InfluxDB is back, the replay can start
+	}
+	this->batch_len = 0;
+	this->batch_lines = 0;
+}
+
+static void _add(uploader_t *this, const uploader_line_t *line) {
+	if (this->batch_len + line->len + 1 > this->batch_limit)
+		_post_queued(this);
+
+	if (this->batch_lines == 0)
+		this->batch_since_ns = line->enqueued_ns;
+	memcpy(this->batch + this->batch_len, line->text, line->len);
+	this->batch[this->batch_len + line->len] = '\n';
+	this->batch_len += line->len + 1;
+	this->batch_lines++;
+
+	if (this->batch_lines >= this->max_lines)
+		_post_queued(this);
+}
+
+// Posts the oldest spooled records, as many as the rate allows. Returns the ms until the next replay is due, -1 if none is
+static int _replay(uploader_t *this) {
+	int64_t now_ns = _now_ns();
+
+	if (!this->spool || spool_pending(this->spool) == 0)
+		return -1;
+	if (now_ns < this->replay_retry_ns)
+		return (int) ((this->replay_retry_ns - now_ns) / 1000000) + 1;
+
+	// token bucket of lines, one batch of burst
+	unsigned int budget = this->max_lines > UPLOADER_BATCH_LINES ? this->max_lines : UPLOADER_BATCH_LINES;
+	if (this->replay_rate) {
+		this->replay_tokens += (double) this->replay_rate * (now_ns - this->replay_refill_ns) / 1e9;
+		if (this->replay_tokens > budget)
+			this->replay_tokens = budget;
+		this->replay_refill_ns = now_ns;
+		if (this->replay_tokens < 1)
+			return (int) ((1 - this->replay_tokens) * 1000 / this->replay_rate) + 1;
+		budget = (unsigned int) this->replay_tokens;
+	}
+
+	// the whole buffer, not batch_limit: a record spooled while the batches were larger must still fit
+	unsigned int lines;
+	size_t len = spool_peek(this->spool, this->replay, UPLOADER_BATCH_BYTES, budget, &lines);
+	if (len == 0)
+		return -1;
+
+	if (_post(this, this->replay, len, now_ns) != 0) {
+		this->replay_retry_ns = _now_ns() + (int64_t) UPLOADER_RETRY_MS * 1000000;
+		return UPLOADER_RETRY_MS;
+	}
+	spool_commit(this->spool);
+	this->replayed += lines;
+	this->replay_tokens -= lines; // a record larger than the budget leaves it negative for a while
+	return 0;
+}
+
+// Worker only: the counters it writes, for uploader_read_stats
+static void _publish_stats(uploader_t *this) {
+	uploader_stats_t stats = { .posts = this->posts, .errors = this->errors, .dropped = this->dropped, .spooled = this->spooled, .replayed = this->replayed,
+			.bytes = this->bytes, .wire_bytes = this->wire_bytes };
+	flags_seqlock_write(&this->published_lock, &this->published, &stats, sizeof(stats));
+}
+
+static void* _worker(void *arg) {
+	uploader_t *this = (uploader_t*) arg;
+	uploader_line_t line;
+
+	while (1) {
+		unsigned int bits = flags_clear(&this->flags, UPLOADER_FLAG_FULL);
+
+		while (spsc_ring_pop_shared(this->queue, &line) == 0)
+			_add(this, &line);
+
+		if (this->batch_lines && ((bits & (UPLOADER_FLAG_FLUSH | UPLOADER_FLAG_STOP)) || _now_ns() - this->batch_since_ns >= (int64_t) this->max_delay_ms * 1000000))
+			_post_queued(this);
+
+		// the backfill once the queue is caught up with, the live lines go first
+		int replay_ms = bits & UPLOADER_FLAG_STOP ? -1 : _replay(this);
+		if (this->spool)
+			spool_sync(this->spool, (bits & UPLOADER_FLAG_STOP) != 0);
+		_publish_stats(this);
+
+		if (bits & UPLOADER_FLAG_STOP)
+			return NULL;
+		if (replay_ms == 0)
+			continue;
+		if (bits & UPLOADER_FLAG_FLUSH) {
+			flags_clear(&this->flags, UPLOADER_FLAG_FLUSH);
+			continue;
+		}
+
+		// woken by a write, a full queue, a flush or stop; or by the batch, replay or spool sync coming due
+		int timeout_ms = replay_ms;
+		if (this->spool && this->spool->unsynced && (timeout_ms < 0 || timeout_ms > SPOOL_SYNC_MS))
+			timeout_ms = SPOOL_SYNC_MS;
+		if (this->batch_lines) {
+			// QUEUED stays set: the writes in the meantime do not wake the worker, a full queue or the deadline do
+			int64_t left_ns = this->batch_since_ns + (int64_t) this->max_delay_ms * 1000000 - _now_ns();
+			int batch_ms = left_ns > 0 ? (int) (left_ns / 1000000) + 1 : 0;
+			if (timeout_ms < 0 || batch_ms < timeout_ms)
+				timeout_ms = batch_ms;
+			if (timeout_ms > 0)
+				flags_wait(&this->flags, UPLOADER_FLAG_FULL | UPLOADER_FLAG_FLUSH | UPLOADER_FLAG_STOP, 0, timeout_ms);
+		} else {
+			flags_clear(&this->flags, UPLOADER_FLAG_QUEUED);
+			if (spsc_ring_size(this->queue) == 0) // else written before the clear, its QUEUED is lost
+				flags_wait(&this->flags, UPLOADER_FLAG_QUEUED | UPLOADER_FLAG_FULL | UPLOADER_FLAG_FLUSH | UPLOADER_FLAG_STOP, 0, timeout_ms);
+		}
+	}
+}
+
+/* uploader */
+
+uploader_t* uploader_new(const char *url) {
+	uploader_t *this = (uploader_t*) arena_calloc(1, sizeof(uploader_t));
+
+	this->queue = spsc_ring_new(UPLOADER_QUEUE_LINES, sizeof(uploader_line_t));
+	this->flags = (flags_t) FLAGS_INITIALIZER;
+	this->overflow = UPLOADER_DROP_OLDEST;
+	this->max_lines = UPLOADER_BATCH_LINES;
+	this->max_delay_ms = UPLOADER_MAX_DELAY_MS;
+	this->ratio = 1;
+	_resize_batch(this);
+
+	if (url) {
+		strncpy(this->url, url, UPLOADER_URL_LEN - 1);
+		pthread_once(&_curl_once, _curl_init);
+
+		// set once, every post only changes the body
+		CURL *hnd = curl_easy_init();
+		curl_easy_setopt(hnd, CURLOPT_URL, this->url);
+		curl_easy_setopt(hnd, CURLOPT_NOPROGRESS, 1L);
+		curl_easy_setopt(hnd, CURLOPT_POST, 1L);
+		curl_easy_setopt(hnd, CURLOPT_USERAGENT, "curl/roompisys/7.77.0-DEV");
+		curl_easy_setopt(hnd, CURLOPT_HTTP_VERSION, (long) CURL_HTTP_VERSION_1_1); // what the InfluxDB 1.x endpoint speaks
+		curl_easy_setopt(hnd, CURLOPT_TCP_KEEPALIVE, 1L);
+		curl_easy_setopt(hnd, CURLOPT_CONNECTTIMEOUT_MS, (long) UPLOADER_TIMEOUT_MS);
+		curl_easy_setopt(hnd, CURLOPT_TIMEOUT_MS, (long) UPLOADER_TIMEOUT_MS);
+		curl_easy_setopt(hnd, CURLOPT_NOSIGNAL, 1L); // the timeouts must not raise signals in the worker
+		curl_easy_setopt(hnd, CURLOPT_WRITEFUNCTION, _discard);
+		this->hnd = hnd;
+	}
+
+	pthread_create(&this->worker, NULL, _worker, this);
+	return this;
+}
+
+// Posts what is still queued and stops the worker
+void uploader_destroy(uploader_t *this) {
+	if (this) {
+		flags_set(&this->flags, UPLOADER_FLAG_STOP);
+		pthread_join(this->worker, NULL);
+		if (this->hnd)
+			curl_easy_cleanup((CURL*) this->hnd);
+		if (this->headers)
+			curl_slist_free_all((struct curl_slist*) this->headers);
+		if (this->zstream) {
+			deflateEnd((z_stream*) this->zstream);
+			arena_free(this->zstream);
+			arena_free(this->wire);
+		}
+		spool_close(this->spool);
+		spsc_ring_destroy(this->queue);
+		arena_free(this);
+	}
+}
+
+// Set before the first write, like the spool, the compression and the overflow policy
+void uploader_set_batch(uploader_t *this, unsigned int max_lines, int max_delay_ms) {
+	this->max_lines = max_lines ? max_lines : 1;
+	this->max_delay_ms = max_delay_ms;
+}
+
+// Keeps the lines of the failed posts in a spool in dir, replayed at replay_rate lines per second (0: as fast as InfluxDB takes them). Returns -1 if it cannot be opened
+int uploader_set_spool(uploader_t *this, const char *dir, uint64_t max_bytes, unsigned int replay_rate) {
+	spool_t *spool = spool_open(dir, max_bytes);
+	if (!spool)
+		return -1;
+
+	this->spool = spool;
+	this->replay_rate = replay_rate;
+	this->replay_tokens = 0;
+	this->replay_refill_ns = _now_ns();
+	flags_set(&this->flags, UPLOADER_FLAG_QUEUED); // records of a previous run
+	return 0;
+}
+
+// Gzips the bodies at level (1 to 9, 0 posts them as they are) and sizes the batches so that a body takes about target_bytes on the wire
+// (0: UPLOADER_BATCH_BYTES of lines). Returns -1 if zlib cannot be set up, the bodies are then posted as they are
+int uploader_set_compression(uploader_t *this, int level, size_t target_bytes) {
+	this->target_bytes = target_bytes;
+
+	if (level > 0 && !this->zstream) {
+		z_stream *z = (z_stream*) arena_calloc(1, sizeof(z_stream));
+		z->zalloc = _zalloc;
+		z->zfree = _zfree;
+		// +16: a gzip header and trailer around the deflate data
+		if (deflateInit2(z, level, Z_DEFLATED, 16 + UPLOADER_GZIP_WINDOW_BITS, UPLOADER_GZIP_MEM_LEVEL, Z_DEFAULT_STRATEGY) != Z_OK) {
+			arena_free(z);
+			this->gzip_level = 0;
+			_resize_batch(this);
+			return -1;
+		}
+		this->wire_size = deflateBound(z, UPLOADER_BATCH_BYTES);
+		this->wire = (char*) arena_malloc(this->wire_size);
+		if (this->hnd)
+			this->headers = curl_slist_append(NULL, "Content-Encoding: gzip");
+		this->zstream = z;
+		this->ratio = UPLOADER_GZIP_RATIO;
+	} else if (level > 0) {
+		deflateParams((z_stream*) this->zstream, level, Z_DEFAULT_STRATEGY);
+	}
+
+	this->gzip_level = level > 0 ? level : 0;
+	_resize_batch(this);
+	return 0;
+}
+
+// What to do with a line when the queue is full, spilling needs a spool
+void uploader_set_overflow(uploader_t *this, uploader_overflow_t overflow) {
+	this->overflow = overflow;
+}
+
+// Queues one line (no '\n') for the worker, never blocks on the network. Returns -1 if the line was not kept
+int uploader_write(uploader_t *this, const char *line) {
+	int64_t t0 = _now_ns();
+	size_t len = strlen(line);
+	uploader_line_t rec;
+	int res = 0;
+
+	atomic_fetch_add_explicit(&this->lines, 1, memory_order_relaxed);
+	if (len > UPLOADER_LINE_LEN) {
+		atomic_fetch_add_explicit(&this->rejected, 1, memory_order_relaxed);
+		return -1;
+	}
+	rec.enqueued_ns = t0;
+	rec.len = len;
+	memcpy(rec.text, line, len);
+
+	if (this->overflow == UPLOADER_SPILL && this->spool) {
+		if (spsc_ring_push(this->queue, &rec) != 0) {
+			// the spool keeps the line protocol as posted, '\n' included: a line of UPLOADER_LINE_LEN fills rec.text
+			char spill[UPLOADER_LINE_LEN + 1];
+			memcpy(spill, line, len);
+			spill[len] = '\n';
+			if (spool_append(this->spool, spill, len + 1, 1) == 0) {
+				atomic_fetch_add_explicit(&this->spilled, 1, memory_order_relaxed);
+			} else {
+				atomic_fetch_add_explicit(&this->rejected, 1, memory_order_relaxed);
+				res = -1;
+			}
+		}
+	} else {
+		spsc_ring_push_evict(this->queue, &rec); // the evicted one is counted by the queue
+	}
+	// a flag already set costs no system call, the worker clears QUEUED only when it has nothing to post
+	unsigned int queued = spsc_ring_size(this->queue);
+	flags_set(&this->flags, queued >= this->max_lines || queued >= UPLOADER_QUEUE_LINES / 2 ? UPLOADER_FLAG_QUEUED | UPLOADER_FLAG_FULL : UPLOADER_FLAG_QUEUED);
+
+	unsigned long long enqueue_ns = _now_ns() - t0;
+	this->enqueue_sum_ns += enqueue_ns;
+	if (enqueue_ns > this->enqueue_max_ns)
+		this->enqueue_max_ns = enqueue_ns;
+	return res;
+}
+
+// Has the worker post everything queued, and waits for it. Returns the result of its last post
+int uploader_flush(uploader_t *this) {
+	unsigned int bits = flags_set(&this->flags, UPLOADER_FLAG_FLUSH) | UPLOADER_FLAG_FLUSH;
+
+	while (bits & UPLOADER_FLAG_FLUSH)
+		bits = flags_wait(&this->flags, UPLOADER_FLAG_FLUSH, bits, -1);
+	return this->last_res;
+}
+
+// Lines waiting in the queue
+unsigned int uploader_queued(uploader_t *this) {
+	return spsc_ring_size(this->queue);
+}
+
+// Any thread: the counters, those of the worker as of its last wake-up
+void uploader_read_stats(uploader_t *this, uploader_stats_t *stats) {
+	flags_seqlock_read(&this->published_lock, stats, &this->published, sizeof(uploader_stats_t));
+	stats->lines = atomic_load_explicit(&this->lines, memory_order_relaxed);
+	stats->rejected = atomic_load_explicit(&this->rejected, memory_order_relaxed);
+	stats->spilled = atomic_load_explicit(&this->spilled, memory_order_relaxed);
+	stats->evicted = atomic_load_explicit(&this->queue->evicted, memory_order_relaxed);
+}
@@ -0,0 +1,147 @@
+/*
+ * uploadlib.h
+ *
+ * InfluxDB line protocol writer shared by every room of the process. The main loop only enqueues:
+ * uploader_write copies the line to a bounded lock-free queue and returns, a worker thread of the
+ * uploader packs the queued lines into one multi-line body and posts it when it holds max_lines
+ * lines, is full, or its oldest line is max_delay_ms old, so the channels of every room and
+ * several processing rounds go in a single request. A slow or restarting InfluxDB only holds the
+ * worker, never the display, buzzer or LEDs. One curl handle is kept for the life of the
+ * uploader: its HTTP/1.1 connection stays open between posts.
+ *
+ * With a spool (spoollib) nothing is lost while InfluxDB is down or restarting: the body of a
+ * post that fails goes to the spool, and once the posts work again the worker posts the spooled
+ * records back, oldest first and in large batches, after the queued lines and at no more than
+ * replay_rate lines per second so that the backfill does not hold the live values back. A failed
+ * replay is retried every UPLOADER_RETRY_MS.
+ *
+ * Bodies can be gzipped (Content-Encoding: gzip, which the InfluxDB /write endpoint takes) with
+ * one deflate context set up once and reset for every body. The batches are then sized by what
+ * they take on the wire: the raw bytes of a batch follow the compression ratio of the last bodies
+ * so that each post is about target_bytes, up to UPLOADER_BATCH_BYTES of lines.
+ *
+ * When the queue is full (the worker stuck in a post) the overflow policy decides: drop the
+ * oldest queued line for the new one, or append the new one to the spool. Created without a URL
+ * nothing is posted (dry run, used by the benchmarks).
+ *
+ *  Created on: 17 oct. 2026
+ *      Author: Victoria M. Gullon and Marcos Gomez
+ */
+
+#ifndef LIBS_UPLOADLIB_H_
+#define LIBS_UPLOADLIB_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "spscring.h"
+#include "flaglib.h"
+#include "spoollib.h"
+
+#define UPLOADER_URL_LEN 128
+#define UPLOADER_LINE_LEN 240 // longest line, the queue records are fixed size
+#define UPLOADER_QUEUE_LINES 4096
+#define UPLOADER_BATCH_BYTES 65536 // raw lines of a body, compressed or not
+#define UPLOADER_MIN_BATCH_BYTES 4096 // the adaptive batches are not made smaller, and smaller bodies do not update the ratio
+#define UPLOADER_BATCH_LINES 5000 // the batch size InfluxDB recommends
+#define UPLOADER_MAX_DELAY_MS 60000
+#define UPLOADER_TIMEOUT_MS 5000 // longest post
+#define UPLOADER_RETRY_MS 5000 // between replays while InfluxDB does not answer
+#define UPLOADER_REPLAY_RATE 5000 // lines per second, about one full batch
+#define UPLOADER_GZIP_LEVEL 1 // the fastest, the larger levels gain little on line protocol
+#define UPLOADER_GZIP_WINDOW_BITS 14 // 16 KB: the lines of a room repeat well within it, and the zlib buffers fit the 64 KB pool class
+#define UPLOADER_GZIP_MEM_LEVEL 7
+#define UPLOADER_GZIP_RATIO 4.5 // first guess of raw/compressed bytes, until the first bodies are measured
+#define UPLOADER_TARGET_BYTES 8192 // of a compressed body on the wire
+
+// flags of the worker
+#define UPLOADER_FLAG_QUEUED 0x01 // lines were enqueued, left set while the worker holds a batch
+#define UPLOADER_FLAG_FULL 0x02 // the queue holds a batch, or half its capacity
+#define UPLOADER_FLAG_FLUSH 0x04 // post everything now, cleared by the worker when done
+#define UPLOADER_FLAG_STOP 0x08
+
+typedef enum {
+	UPLOADER_DROP_OLDEST, UPLOADER_SPILL
+} uploader_overflow_t;
+
+typedef struct {
+	int64_t enqueued_ns; // CLOCK_MONOTONIC
+	uint32_t len;
+	char text[UPLOADER_LINE_LEN];
+} uploader_line_t;
+
+// The counters read together from another thread
+typedef struct {
+	unsigned long lines, rejected, spilled, evicted;
+	unsigned long posts, errors, dropped, spooled, replayed;
+	unsigned long long bytes, wire_bytes;
+} uploader_stats_t;
+
+typedef struct {
+	char url[UPLOADER_URL_LEN]; // write endpoint, empty for a dry run
+	void *hnd; // CURL easy handle, its connection is reused from one post to the next
+
+	// producer side (main loop)
+	spsc_ring_t *queue; // of uploader_line_t
+	flags_t flags;
+	uploader_overflow_t overflow;
+	spool_t *spool; // NULL: the lines of the failed posts are dropped
+
+	// worker
+	pthread_t worker;
+	char batch[UPLOADER_BATCH_BYTES]; // lines waiting, each one ended by '\n'
+	size_t batch_len;
+	unsigned int batch_lines;
+	int64_t batch_since_ns; // enqueue time of the oldest line of the batch
+	char replay[UPLOADER_BATCH_BYTES]; // spooled records being posted again
+	unsigned int max_lines;
+	int max_delay_ms;
+	unsigned int replay_rate; // lines per second, 0 for no limit
+	double replay_tokens;
+	int64_t replay_refill_ns;
+	int64_t replay_retry_ns; // no replay before, set when one fails
+	int last_res; // of the last post
+
+	// compression, set up by uploader_set_compression
+	int gzip_level; // 0: bodies posted as they are
+	void *zstream; // z_stream, reset for every body
+	char *wire; // the compressed body
+	size_t wire_size;
+	void *headers; // curl_slist with the Content-Encoding
+	size_t target_bytes; // of a body on the wire, 0 for none
+	size_t batch_limit; // raw bytes of a batch, from target_bytes and ratio
+	double ratio; // raw/compressed bytes of the last bodies
+
+	// statistics, each one written by one side and read approximately by the other (see uploader_read_stats for an exact copy)
+	atomic_ulong lines; // lines handed to the uploader
+	atomic_ulong rejected; // longer than UPLOADER_LINE_LEN, or the spool could not take them
+	atomic_ulong spilled; // lines that did not fit in the queue, appended to the spool
+	unsigned long posts; // requests made
+	unsigned long errors; // posts that failed
+	unsigned long dropped; // lines of the failed posts with no spool to keep them (the ones evicted from the queue are counted by it)
+	unsigned long spooled; // lines of the failed posts kept in the spool
+	unsigned long replayed; // spooled lines posted
+	unsigned long long bytes; // bodies posted, before compression
+	unsigned long long wire_bytes; // bodies posted, as sent
+	unsigned long compressed; // bodies gzipped
+	unsigned long long compress_sum_ns, compress_max_ns; // CPU time of the worker in deflate, per body
+	unsigned long long enqueue_sum_ns, enqueue_max_ns; // uploader_write
+	unsigned long long post_sum_ns, post_max_ns; // curl_easy_perform
+	unsigned long long delay_sum_ms, delay_max_ms; // from the enqueue of the oldest line of a batch to the end of its post
+	flags_seqlock_t published_lock;
+	uploader_stats_t published; // the worker counters, copied by the worker once per wake-up
+} uploader_t;
+
+uploader_t* uploader_new(const char *url);
+void uploader_destroy(uploader_t *this);
+void uploader_set_batch(uploader_t *this, unsigned int max_lines, int max_delay_ms);
+int uploader_set_spool(uploader_t *this, const char *dir, uint64_t max_bytes, unsigned int replay_rate);
+int uploader_set_compression(uploader_t *this, int level, size_t target_bytes);
+void uploader_set_overflow(uploader_t *this, uploader_overflow_t overflow);
+int uploader_write(uploader_t *this, const char *line);
+int uploader_flush(uploader_t *this);
+unsigned int uploader_queued(uploader_t *this);
+void uploader_read_stats(uploader_t *this, uploader_stats_t *stats);
+
+#endif /* LIBS_UPLOADLIB_H_ */
@@ -0,0 +1,159 @@
+/*
+ * windowstats.c
+ *
+ *  Created on: 17 oct. 2026
+ *      Author: Victoria M. Gullon and Marcos Gomez
+ */
+
+#include <stdlib.h>
+
+#include "windowstats.h"
+#include "arenalib.h"
+
+static double _value(const SensorSampleType *sample) {
+	return sample->value.type == is_int ? sample->value.val.ival : sample->value.val.fval;
+}
+
+// sample pushed at position pos, still in the ring as long as it is in the window
+static double _value_at(window_stats_t *this, unsigned int pos) {
+	return _value(&this->ring->data[pos & this->ring->mask]);
+}
+
+window_stats_t* window_stats_new(sample_ring_t *ring, unsigned int len) {
+	unsigned int size = 1;
+	while (size < len)
+		size <<= 1;
+
+	window_stats_t *this = (window_stats_t*) arena_malloc(sizeof(window_stats_t));
+	this->ring = ring;
+	this->len = len < sample_ring_capacity(ring) ? len : sample_ring_capacity(ring);
+	this->min_q = (unsigned int*) arena_malloc(size * sizeof(unsigned int));
+	this->max_q = (unsigned int*) arena_malloc(size * sizeof(unsigned int));
+	this->q_mask = size - 1;
+	this->order = NULL;
+	window_stats_reset(this);
+
+	return this;
+}
+
+void window_stats_destroy(window_stats_t *this) {
+	if (this) {
+		arena_free(this->min_q);
+		arena_free(this->max_q);
+		order_stats_destroy(this->order);
+		arena_free(this);
+	}
+}
+
+// Also empties the ring
+void window_stats_reset(window_stats_t *this) {
+	sample_ring_reset(this->ring);
+	this->n = this->n_valid = 0;
+	this->sum = this->sum_sq = 0;
+	this->min_head = this->min_tail = this->max_head = this->max_tail = 0;
+	if (this->order)
+		order_stats_reset(this->order);
+}
+
+// Keeps the valid samples sorted from now on, O(log n) per push. Also empties the window
+void window_stats_enable_percentiles(window_stats_t *this) {
+	if (this->order == NULL)
+		this->order = order_stats_new(this->len);
+	window_stats_reset(this);
+}
+
+// Pushes the sample to the ring, the oldest one leaves the window. O(1) amortised, O(log n) with percentiles
+void window_stats_push(window_stats_t *this, const SensorSampleType *sample) {
+	unsigned int pos = this->ring->head;
+
+	if (this->n == this->len) {
+		// read before the push, with a ring as long as the window the slot is about to be overwritten
+		const SensorSampleType *old = &this->ring->data[(pos - this->len) & this->ring->mask];
+		if (old->value.type != is_error) {
+			double v = _value(old);
+			this->sum -= v;
+			this->sum_sq -= v * v;
+			this->n_valid--;
+			if (this->order)
+				order_stats_remove(this->order, v);
+		}
+	} else {
+		this->n++;
+	}
+
+	// drop the candidates that left the window
+	if (this->min_head != this->min_tail && pos + 1 - this->min_q[this->min_head & this->q_mask] > this->len)
+		this->min_head++;
+	if (this->max_head != this->max_tail && pos + 1 - this->max_q[this->max_head & this->q_mask] > this->len)
+		this->max_head++;
+
+	sample_ring_push(this->ring, sample);
+
+	if (sample->value.type == is_error)
+		return;
+
+	double v = _value(sample);
+	this->sum += v;
+	this->sum_sq += v * v;
+	this->n_valid++;
+	if (this->order)
+		order_stats_insert(this->order, v);
+
+	// a new sample makes every older candidate that is not lower (higher) than it useless
+	while (this->min_tail != this->min_head && _value_at(this, this->min_q[(this->min_tail - 1) & this->q_mask]) >= v)
+		this->min_tail--;
+	this->min_q[this->min_tail++ & this->q_mask] = pos;
+
+	while (this->max_tail != this->max_head && _value_at(this, this->max_q[(this->max_tail - 1) & this->q_mask]) <= v)
+		this->max_tail--;
+	this->max_q[this->max_tail++ & this->q_mask] = pos;
+}
+
+int window_stats_min(window_stats_t *this, double *min) {
+	if (this->n_valid == 0)
+		return -1;
+	*min = _value_at(this, this->min_q[this->min_head & this->q_mask]);
+	return 0;
+}
+
+int window_stats_max(window_stats_t *this, double *max) {
+	if (this->n_valid == 0)
+		return -1;
+	*max = _value_at(this, this->max_q[this->max_head & this->q_mask]);
+	return 0;
+}
+
+int window_stats_mean(window_stats_t *this, double *mean) {
+	if (this->n_valid == 0)
+		return -1;
+	*mean = this->sum / this->n_valid;
+	return 0;
+}
+
+int window_stats_variance(window_stats_t *this, double *variance) {
+	if (this->n_valid == 0)
+		return -1;
+	double mean = this->sum / this->n_valid;
+	double var = this->sum_sq / this->n_valid - mean * mean;
+	*variance = var > 0 ? var : 0; // rounding can leave it slightly negative
+	return 0;
+}
+
+// Mean without the highest and the lowest sample, needs three valid samples
+int window_stats_trimmed_mean(window_stats_t *this, double *mean) {
+	double min, max;
+
+	if (this->n_valid < 3)
+		return -1;
+	window_stats_min(this, &min);
+	window_stats_max(this, &max);
+	*mean = (this->sum - min - max) / (this->n_valid - 2);
+	return 0;
+}
+
+// Percentile 50 is the median. Returns -1 as well if the percentiles are not enabled
+int window_stats_percentile(window_stats_t *this, double percentile, double *value) {
+	if (this->order == NULL)
+		return -1;
+	return order_stats_percentile(this->order, percentile, value);
+}
@@ -0,0 +1,50 @@
+/*
+ * windowstats.h
+ *
+ * Statistics of the last len samples of a sample ring, kept up to date on every push so that
+ * reading them costs the same whatever the window length: running sum and sum of squares (mean,
+ * variance) plus two monotonic deques of sample positions (min, max). The trimmed mean drops the
+ * highest and the lowest sample. Failed readings take a place in the window but are left out of
+ * every statistic. Medians and percentiles need an order statistics list, only kept when enabled.
+ *
+ *  Created on: 17 oct. 2026
+ *      Author: Victoria M. Gullon and Marcos Gomez
+ */
+
+#ifndef LIBS_WINDOWSTATS_H_
+#define LIBS_WINDOWSTATS_H_
+
+#include "samplering.h"
+#include "orderstats.h"
+
+typedef struct {
+	sample_ring_t *ring; // holds the samples of the window, at least len of them
+	unsigned int len; // window length in samples
+	unsigned int n; // samples in the window, up to len
+	unsigned int n_valid; // of which are not failed readings
+	double sum;
+	double sum_sq;
+
+	// positions (ring head counts) of the candidates for min/max, oldest first
+	unsigned int *min_q, *max_q;
+	unsigned int q_mask;
+	unsigned int min_head, min_tail, max_head, max_tail;
+
+	order_stats_t *order; // valid samples of the window sorted, NULL unless percentiles are enabled
+} window_stats_t;
+
+window_stats_t* window_stats_new(sample_ring_t *ring, unsigned int len);
+void window_stats_destroy(window_stats_t *this);
+void window_stats_reset(window_stats_t *this);
+void window_stats_push(window_stats_t *this, const SensorSampleType *sample);
+void window_stats_enable_percentiles(window_stats_t *this);
+
+// Each returns 0, or -1 if the window does not hold enough valid samples
+int window_stats_min(window_stats_t *this, double *min);
+int window_stats_max(window_stats_t *this, double *max);
+int window_stats_mean(window_stats_t *this, double *mean);
+int window_stats_variance(window_stats_t *this, double *variance);
+int window_stats_trimmed_mean(window_stats_t *this, double *mean);
+int window_stats_percentile(window_stats_t *this, double percentile, double *value);
+
+#endif /* LIBS_WINDOWSTATS_H_ */
@@ -8,13 +8,15 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
 #include <wiringPi.h>
 
 #define DEB
 
-volatile int measurement_flags = 0x00;
-volatile int output_flags = 0x00;
-
 float temp_crit_low = 5.0;
 float temp_crit_high = 33.0;
 float temp_warn_low = 18.0;
@@ -32,6 +34,20 @@ int dht_t_ms = 5000;
 int bh1750_t_ms = 5000;
 int ccs811_t_ms = 5000;
 int output_t_ms = 5000;
+int temp_window = 5; // samples processed per channel, optional lines at the end of roompi.conf
+int rh_window = 5;
+int lux_window = 5;
+int eco2_window = 5;
+float temp_percentile = 0; // 0 keeps the trimmed mean, 50 takes the median of the window
+float rh_percentile = 0;
+float lux_percentile = 0;
+float eco2_percentile = 0;
+float temp_deadband = 0; // uploaded when it moves more than this, 0 uploads every value
+float rh_deadband = 0;
+float lux_deadband = 0;
+float eco2_deadband = 0;
+int deadband_silence_ms = 600000; // a value is uploaded at least this often
+int swinging_door = 0; // 0 holds the last value sent, 1 rebuilds the series with lines between them
 
 volatile int buzzer_disabled = 0x0;
 
@@ -39,12 +55,84 @@ volatile int buzzer_disabled = 0x0;
 #include "libs/systemtype.h"
 #include "controllers/measurementctrl.h"
 #include "controllers/outputctrl.h"
+#include "libs/threadlib.h"
+#include "libs/arenalib.h"
+#include "libs/metricslib.h"
+
+#define GATEWAY_MAX_ROOMS 8
+#define GATEWAY_MAX_I2C_BUSES 8
+#define ARENA_ROOM_SIZE (12 << 20) // a room with the largest windows and percentiles on every channel, and its history index
+#define ARENA_COMMON_SIZE (5 << 20) // reactors, uploader, the libcurl pools and the /metrics buffers
+
+arena_t *roompi_arena; // every object of the process is carved from it
+SystemType *roompi_system; // room with the display, LEDs, buzzer and buttons (NULL in gateway mode)
+SystemType *roompi_rooms[GATEWAY_MAX_ROOMS]; // every room driven by this process
+int roompi_n_rooms = 0;
+uploader_t *roompi_uploader; // shared by every room
+metrics_server_t *roompi_metrics; // GET /metrics, NULL if its port was taken
+reactor_t *roompi_reactor; // main loop: measurement processing and outputs of every room
+reactor_t *roompi_i2c_reactors[GATEWAY_MAX_I2C_BUSES]; // I2C acquisition threads, one per bus in use: BH1750s and CCS811s
+reactor_t *roompi_gpio_reactor; // GPIO acquisition thread: DHT11s
+
+// Acquisition threads, one per bus so that a slow sensor never delays the display or another bus
+void* acquisitionThread(void *arg) {
+	reactor_run((reactor_t*) arg);
+	return NULL;
+}
+
+reactor_t* systemI2CReactor(int bus) {
+	if (roompi_i2c_reactors[bus] == NULL)
+		roompi_i2c_reactors[bus] = reactor_new();
+	return roompi_i2c_reactors[bus];
+}
+
+// Every reactor of the process with its name, returns how many
+int systemReactors(reactor_t **reactors, char names[][8]) {
+	int n = 0;
+	reactors[n] = roompi_reactor;
+	strcpy(names[n++], "main");
+	reactors[n] = roompi_gpio_reactor;
+	strcpy(names[n++], "gpio");
+	for (int bus = 0; bus < GATEWAY_MAX_I2C_BUSES; bus++) {
+		if (roompi_i2c_reactors[bus]) {
+			reactors[n] = roompi_i2c_reactors[bus];
+			sprintf(names[n++], "i2c-%d", bus);
+		}
+	}
+	return n;
+}
+
+CCS811Sensor* systemSetupCCS811(int id, int i2c_bus, int addr, int addr_pin, int interrupt_pin, int rst_pin) {
+	CCS811Sensor *ccs_sensor = CCS811Sensor__create_on_bus(id, i2c_bus, addr, addr_pin, interrupt_pin, rst_pin);
+
+	CCS811Sensor__connect(ccs_sensor);
+
+	union ApplicationRegister appreg1 = ccs_sensor->app_register;
+	appreg1.meas_mode.reserved2 = 0;             //We dont know what reserved bits do, so let's put them zero
+	appreg1.meas_mode.reserved1 = 0;             //We dont know what reserved bits do, so let's put them zero
+	appreg1.meas_mode.driveMode = MODE1_EACH_1S; //Lets select the operation mode: MODE0_IDLE MODE1_EACH_1S MODE2_EACH_10S MODE3_EACH_60S MODE4_EACH_250MS
+	appreg1.meas_mode.int_data_ready = 1;        //Lets enable the interrupt pin after we have a valid data
+	appreg1.meas_mode.int_thresh = 0;            //We are going to disable the interrupts for thresholds
 
-SystemType *roompi_system;
+	CCS811Sensor__set_app_register(ccs_sensor, appreg1);
+	CCS811Sensor__write_register(ccs_sensor, MEAS_MODE);
+
+	return ccs_sensor;
+}
+
+// Reserves the arena for that many rooms and carves everything created from now on from it. Only the pages
+// actually carved take memory, the rest is address space
+void systemArenaSetup(int n_rooms) {
+	roompi_arena = arena_new(ARENA_COMMON_SIZE + (size_t) n_rooms * ARENA_ROOM_SIZE);
+	if (roompi_arena == NULL)
+		printf("[LOG] Cannot reserve the arena, objects will be allocated from the heap\n");
+	arena_use(roompi_arena);
+}
 
 SystemType* systemSetup(void) {
 
 	printf("[LOG] System is being initialized and set up...\n");
+	systemArenaSetup(1);
 	// wiringPi Setup
 	wiringPiSetup();
 
@@ -59,19 +147,7 @@ SystemType* systemSetup(void) {
 
 	// CCS811 CO2 sensor Creation and Setup
 	printf("[LOG-CCS811Sensor]  CCS811Sensor is being initialized and set up...\n");
-	CCS811Sensor *ccs_sensor = CCS811Sensor__create(5, CCS811_ADDR_LOW, 0, 3, 2);
-
-	CCS811Sensor__connect(ccs_sensor);
-
-	union ApplicationRegister appreg1 = ccs_sensor->app_register;
-	appreg1.meas_mode.reserved2 = 0;             //We dont know what reserved bits do, so let's put them zero
-	appreg1.meas_mode.reserved1 = 0;             //We dont know what reserved bits do, so let's put them zero
-	appreg1.meas_mode.driveMode = MODE1_EACH_1S; //Lets select the operation mode: MODE0_IDLE MODE1_EACH_1S MODE2_EACH_10S MODE3_EACH_60S MODE4_EACH_250MS
-	appreg1.meas_mode.int_data_ready = 1;        //Lets enable the interrupt pin after we have a valid data
-	appreg1.meas_mode.int_thresh = 0;            //We are going to disable the interrupts for thresholds
-
-	CCS811Sensor__set_app_register(ccs_sensor, appreg1);
-	CCS811Sensor__write_register(ccs_sensor, MEAS_MODE);
+	CCS811Sensor *ccs_sensor = systemSetupCCS811(5, 1, CCS811_ADDR_LOW, 0, 3, 2);
 
 	/* Creation of the attached actuators */
 
@@ -133,8 +209,315 @@ SystemType* systemSetup(void) {
 	return roompi_system;
 }
 
+// Gateway mode: one headless room per line of the file, "<room id> <i2c bus> <bh1750 addr> <ccs811 addr> <dht11 pin>",
+// -1 for a sensor the room does not have. Returns the number of rooms created
+// One room per line of the gateway file: "id bus bh1750_addr ccs811_addr dht11_pin". Comments, blank and malformed lines are not rooms
+int gatewayParseRoom(const char *line, int *id, int *bus, int *bh_addr, int *ccs_addr, int *dht_pin) {
+	if (line[0] == '#' || sscanf(line, "%d %d %i %i %d", id, bus, bh_addr, ccs_addr, dht_pin) != 5)
+		return 0;
+	return *bus >= 0 && *bus < GATEWAY_MAX_I2C_BUSES;
+}
+
+int gatewaySetup(const char *path) {
+	printf("[LOG] Gateway is being initialized and set up from %s...\n", path);
+	wiringPiSetup();
+
+	FILE *fp = fopen(path, "r");
+	if (fp == NULL)
+		return 0;
+
+	char line[128];
+	int n_rooms = 0, id, bus, bh_addr, ccs_addr, dht_pin;
+	while (fgets(line, sizeof(line), fp) != NULL)
+		n_rooms += gatewayParseRoom(line, &id, &bus, &bh_addr, &ccs_addr, &dht_pin);
+	systemArenaSetup(n_rooms < GATEWAY_MAX_ROOMS ? n_rooms : GATEWAY_MAX_ROOMS);
+	rewind(fp);
+
+	while (roompi_n_rooms < GATEWAY_MAX_ROOMS && fgets(line, sizeof(line), fp) != NULL) {
+		if (!gatewayParseRoom(line, &id, &bus, &bh_addr, &ccs_addr, &dht_pin))
+			continue;
+
+		printf("[LOG] Room %d: i2c-%d BH1750 %s CCS811 %s DHT11 %s\n", id, bus, bh_addr >= 0 ? "yes" : "no", ccs_addr >= 0 ? "yes" : "no", dht_pin >= 0 ? "yes" : "no");
+		DHT11Sensor *dht_sensor = dht_pin >= 0 ? DHT11Sensor__create(1, dht_pin) : NULL;
+		BH1750Sensor *bh_sensor = bh_addr >= 0 ? BH1750Sensor__create_on_bus(4, bus, bh_addr, CONTINUOUS_H_RES) : NULL;
+		CCS811Sensor *ccs_sensor = ccs_addr >= 0 ? systemSetupCCS811(5, bus, ccs_addr, -1, -1, -1) : NULL;
+
+		SystemContext *ctx = SystemContext__create(id, dht_sensor, bh_sensor, ccs_sensor, NULL, NULL, NULL);
+		roompi_rooms[roompi_n_rooms++] = SystemType__setup(ctx, MeasurementCtrl__setup(ctx), OutputCtrl__setup(ctx));
+	}
+	fclose(fp);
+
+	return roompi_n_rooms;
+}
+
+// I2C bus of the room's sensors (1, the Pi's default, if it has none)
+int systemRoomI2CBus(SystemType *room) {
+	if (room->root_system->sensor_light)
+		return room->root_system->sensor_light->i2c_bus;
+	if (room->root_system->sensor_co2)
+		return room->root_system->sensor_co2->i2c_bus;
+	return 1;
+}
+
+// Starts the timers of the room and asks for a first measurement of every sensor
+void systemStart(SystemType *room) {
+	SystemContext *ctx = room->root_system;
+	unsigned int pending = 0;
+
+	tmr_startms(room->root_measurement_ctrl->timer, meas_t_ms);
+	if (ctx->sensor_temp_humid) {
+		tmr_startms(ctx->sensor_temp_humid->timer, dht_t_ms); // fire temp humid fsm every 5 seconds
+		pending |= FLAG_TEMP_HUMID_PENDING_MEASUREMENT;
+	}
+	if (ctx->sensor_light) {
+		tmr_startms(ctx->sensor_light->timer, bh1750_t_ms); // fire light fsm every 5 seconds
+		pending |= FLAG_LIGHT_PENDING_MEASUREMENT;
+	}
+	if (ctx->sensor_co2) {
+		tmr_startms(ctx->sensor_co2->timer, ccs811_t_ms);  // fire co2 fsm every 5 seconds
+		pending |= FLAG_CO2_PENDING_MEASUREMENT;
+	}
+
+	// Output system timer
+	if (ctx->actuator_display)
+		tmr_startms(room->root_output_ctrl->timer, output_t_ms);
+
+	// values restored by a warm restart: a processing round now brings the alerts (LEDs, buzzer) in line with them
+	for (int i = 0; i < sizeof(ctx->sensor_values) / sizeof(SensorValueType); i++) {
+		if (ctx->sensor_values[i].type != is_error)
+			pending |= FLAG_PERFORM_PROCESSING;
+	}
+
+	flags_set(&ctx->measurement_flags, pending);
+}
+
+// Stops every timer of the room, nothing changes its flags or posts to the reactors afterwards
+void systemStop(SystemType *room) {
+	SystemContext *ctx = room->root_system;
+
+	tmr_stop(room->root_measurement_ctrl->timer);
+	if (ctx->sensor_temp_humid) {
+		tmr_stop(ctx->sensor_temp_humid->timer);
+		tmr_stop(ctx->sensor_temp_humid->start_timer);
+	}
+	if (ctx->sensor_light) {
+		tmr_stop(ctx->sensor_light->timer);
+		tmr_stop(ctx->sensor_light->conversion_timer);
+	}
+	if (ctx->sensor_co2) {
+		tmr_stop(ctx->sensor_co2->timer);
+		tmr_stop(ctx->sensor_co2->data_timer);
+	}
+	if (ctx->actuator_display)
+		tmr_stop(room->root_output_ctrl->timer);
+}
+
+void systemDumpFSM(reactor_t *reactor, fsm_t *fsm, const char *name) {
+	for (int j = 0; j < reactor->n_fsms; j++) {
+		if (reactor->fsms[j].fsm != fsm)
+			continue;
+
+		double guard_evals_s, transitions_s;
+		reactor_fsm_rates(reactor, j, &guard_evals_s, &transitions_s);
+		printf("[LOG-FSM] %-12s guards %lu (%.2f/s) transitions %lu (%.2f/s)\n", name, fsm->guard_evals, guard_evals_s, fsm->transitions, transitions_s);
+#ifdef FSM_TRACE
+		fsm_trace_dump(fsm, name, stdout);
+#endif
+	}
+}
+
+// SIGUSR1: dump internal statistics
+void systemDumpStats(void) {
+	reactor_t *reactors[GATEWAY_MAX_I2C_BUSES + 2];
+	char reactor_names[GATEWAY_MAX_I2C_BUSES + 2][8];
+	int n_reactors = systemReactors(reactors, reactor_names);
+	for (int i = 0; i < n_reactors; i++) {
+		printf("[LOG-Reactor] %-5s wakeups %lu fires %lu dispatch avg %.3f ms max %.3f ms\n", reactor_names[i], reactors[i]->wakeups, reactors[i]->fires,
+				reactors[i]->dispatches ? reactors[i]->dispatch_sum_ns / 1e6 / reactors[i]->dispatches : 0.0, reactors[i]->dispatch_max_ns / 1e6);
+	}
+
+	for (int r = 0; r < roompi_n_rooms; r++) {
+		SystemType *system = roompi_rooms[r];
+		SystemContext *ctx = system->root_system;
+		reactor_t *i2c_reactor = roompi_i2c_reactors[systemRoomI2CBus(system)];
+		printf("[LOG] Room %d\n", ctx->id_classroom);
+
+		tmr_print_stats(system->root_measurement_ctrl->timer, "MeasurementCtrl", stdout);
+		systemDumpFSM(roompi_reactor, system->root_measurement_ctrl->fsm, "measurement");
+		if (ctx->sensor_temp_humid) {
+			tmr_print_stats(ctx->sensor_temp_humid->timer, "DHT11Sensor", stdout);
+			systemDumpFSM(roompi_gpio_reactor, ctx->sensor_temp_humid->fsm, "temp_humid");
+		}
+		if (ctx->sensor_light) {
+			tmr_print_stats(ctx->sensor_light->timer, "BH1750Sensor", stdout);
+			systemDumpFSM(i2c_reactor, ctx->sensor_light->fsm, "light");
+		}
+		if (ctx->sensor_co2) {
+			tmr_print_stats(ctx->sensor_co2->timer, "CCS811Sensor", stdout);
+			systemDumpFSM(i2c_reactor, ctx->sensor_co2->fsm, "co2");
+		}
+		if (ctx->actuator_display)
+			tmr_print_stats(system->root_output_ctrl->timer, "OutputCtrl", stdout);
+		systemDumpFSM(roompi_reactor, system->root_output_ctrl->fsm_buzzer, "buzzer");
+		systemDumpFSM(roompi_reactor, system->root_output_ctrl->fsm_leds, "leds");
+		systemDumpFSM(roompi_reactor, system->root_output_ctrl->fsm_info, "info");
+		systemDumpFSM(roompi_reactor, system->root_output_ctrl->fsm_warnings, "warnings");
+
+		char *queue_names[3] = { "DHT11Sensor", "BH1750Sensor", "CCS811Sensor" };
+		for (int i = 0; i < 3; i++) {
+			spsc_ring_t *q = ctx->sensor_queues[i];
+			printf("[LOG-Queue] %-16s pushed %lu dropped %lu queued %u of %u\n", queue_names[i], q->pushed, q->dropped, spsc_ring_size(q), spsc_ring_capacity(q));
+		}
+	}
+
+	for (int r = 0; r < roompi_n_rooms; r++) {
+		tsdb_t *store = roompi_rooms[r]->root_system->store;
+		if (store)
+			printf("[LOG-Store] room %-4d samples %lu blocks %llu staged %u file writes %lu checkpoints %lu recovered %lu\n", roompi_rooms[r]->root_system->id_classroom,
+					store->samples, (unsigned long long) tsdb_n_blocks(store), store->n_staged, store->flushes, store->checkpoints, store->recovered);
+		rollup_log_t *log = roompi_rooms[r]->root_system->rollup_log;
+		printf("[LOG-Rollup] room %-4d closed %lu kept %llu page writes %lu\n", roompi_rooms[r]->root_system->id_classroom, roompi_rooms[r]->root_system->rollups->closed,
+				log ? (unsigned long long) rollup_log_n_records(log) : 0ULL, log ? log->pages : 0UL);
+		state_file_t *state = roompi_rooms[r]->root_system->state;
+		if (state)
+			printf("[LOG-State] room %-4d commits %lu\n", roompi_rooms[r]->root_system->id_classroom, state->commits);
+		unsigned long offered = 0, sent = 0;
+		for (int i = 0; i < 4; i++) {
+			offered += roompi_rooms[r]->root_system->sensor_deadband[i].offered;
+			sent += roompi_rooms[r]->root_system->sensor_deadband[i].sent_values;
+		}
+		printf("[LOG-Deadband] room %-4d values %lu uploaded %lu\n", roompi_rooms[r]->root_system->id_classroom, offered, sent);
+	}
+
+	uploader_t *up = roompi_uploader;
+	unsigned long lines = up->lines ? up->lines : 1, posts = up->posts ? up->posts : 1;
+	printf("[LOG-Uploader] lines %lu posts %lu errors %lu dropped %lu evicted %lu rejected %lu spilled %lu queued %u\n", up->lines, up->posts, up->errors, up->dropped,
+			up->queue->evicted, up->rejected, up->spilled, uploader_queued(up));
+	printf("[LOG-Uploader] enqueue avg %llu max %llu ns, post avg %llu max %llu ms, delay avg %llu max %llu ms\n", up->enqueue_sum_ns / lines, up->enqueue_max_ns,
+			up->post_sum_ns / posts / 1000000, up->post_max_ns / 1000000, up->delay_sum_ms / posts, up->delay_max_ms);
+	if (up->spool)
+		printf("[LOG-Spool] spooled %lu replayed %lu pending %llu KB segments %u syncs %lu corrupt %lu lost %llu KB\n", up->spooled, up->replayed,
+				(unsigned long long) spool_pending(up->spool) / 1024, up->spool->last_segment - up->spool->first_segment + 1, up->spool->syncs, up->spool->corrupt,
+				up->spool->lost_bytes / 1024);
+	if (up->compressed)
+		printf("[LOG-Uploader] gzip %llu of %llu KB (ratio %.2f) batches of %zu KB deflate avg %llu max %llu us\n", up->wire_bytes / 1024, up->bytes / 1024,
+				(double) up->bytes / up->wire_bytes, up->batch_limit / 1024, up->compress_sum_ns / up->compressed / 1000, up->compress_max_ns / 1000);
+	if (roompi_metrics)
+		printf("[LOG-Metrics] port %d scrapes %lu errors %lu refused %lu overflows %lu render avg %llu max %llu us\n", roompi_metrics->port, roompi_metrics->scrapes,
+				roompi_metrics->errors, roompi_metrics->refused, roompi_metrics->overflows,
+				roompi_metrics->scrapes ? roompi_metrics->render_sum_ns / roompi_metrics->scrapes / 1000 : 0ULL, roompi_metrics->render_max_ns / 1000);
+	if (roompi_arena) {
+		printf("[LOG-Alloc] arena %zu of %zu KB carves %lu late %lu spills %lu pool blocks %lu in use %lu", roompi_arena->used / 1024, roompi_arena->size / 1024,
+				roompi_arena->carves, roompi_arena->late_carves, roompi_arena->spills, roompi_arena->pool_blocks, roompi_arena->pool_in_use);
+#ifdef ARENA_COUNT_MALLOC
+		printf(" heap allocations since setup %lu", arena_heap_allocs() - roompi_arena->heap_allocs_at_seal);
+#endif
+		printf("\n");
+	}
+	fflush(stdout);
+}
+
+// Signal handler (through a signalfd on the main reactor): SIGUSR1 dumps the statistics, SIGTERM and SIGINT end the main loop
+void systemSignal(int fd, void *user_data) {
+	struct signalfd_siginfo si;
+	if (read(fd, &si, sizeof(si)) != sizeof(si))
+		return;
+
+	if (si.ssi_signo == SIGUSR1) {
+		systemDumpStats();
+	} else {
+		printf("[LOG] Signal %u, stopping\n", si.ssi_signo);
+		reactor_stop(roompi_reactor);
+	}
+}
+
+// Checkpoint timer (a timerfd on the main reactor, which owns the history): what is still in memory goes to the files
+void systemCheckpoint(int fd, void *user_data) {
+	uint64_t expirations;
+	if (read(fd, &expirations, sizeof(expirations)) != sizeof(expirations))
+		return;
+
+	for (int r = 0; r < roompi_n_rooms; r++)
+		SystemContext__checkpoint(roompi_rooms[r]->root_system);
+}
+
+// Render callback of the /metrics endpoint, run by its thread on every scrape: the rooms, then the uploader, the arena and the endpoint itself
+void systemRenderMetrics(void *user_data, metrics_writer_t *w) {
+	SystemContext *systems[GATEWAY_MAX_ROOMS];
+	for (int r = 0; r < roompi_n_rooms; r++)
+		systems[r] = roompi_rooms[r]->root_system;
+	MeasurementCtrl__render_metrics(systems, roompi_n_rooms, w);
+
+	uploader_stats_t up;
+	uploader_read_stats(roompi_uploader, &up);
+	metrics_family(w, "roompi_upload_lines_total", "counter", "Lines handed to the uploader");
+	metrics_sample(w, "roompi_upload_lines_total", NULL, up.lines);
+	metrics_family(w, "roompi_upload_posts_total", "counter", "Requests made to InfluxDB");
+	metrics_sample(w, "roompi_upload_posts_total", NULL, up.posts);
+	metrics_family(w, "roompi_upload_errors_total", "counter", "Requests that failed");
+	metrics_sample(w, "roompi_upload_errors_total", NULL, up.errors);
+	metrics_family(w, "roompi_upload_lost_lines_total", "counter", "Lines given up, by reason");
+	metrics_sample(w, "roompi_upload_lost_lines_total", "reason=\"dropped\"", up.dropped);
+	metrics_sample(w, "roompi_upload_lost_lines_total", "reason=\"evicted\"", up.evicted);
+	metrics_sample(w, "roompi_upload_lost_lines_total", "reason=\"rejected\"", up.rejected);
+	metrics_family(w, "roompi_upload_spool_lines_total", "counter", "Lines through the spool, by direction");
+	metrics_sample(w, "roompi_upload_spool_lines_total", "direction=\"spilled\"", up.spilled);
+	metrics_sample(w, "roompi_upload_spool_lines_total", "direction=\"spooled\"", up.spooled);
+	metrics_sample(w, "roompi_upload_spool_lines_total", "direction=\"replayed\"", up.replayed);
+	metrics_family(w, "roompi_upload_bytes_total", "counter", "Bodies posted, before compression and as sent");
+	metrics_sample(w, "roompi_upload_bytes_total", "encoding=\"identity\"", up.bytes);
+	metrics_sample(w, "roompi_upload_bytes_total", "encoding=\"wire\"", up.wire_bytes);
+	metrics_family(w, "roompi_upload_queued_lines", "gauge", "Lines waiting in the queue");
+	metrics_sample(w, "roompi_upload_queued_lines", NULL, uploader_queued(roompi_uploader));
+	if (roompi_uploader->spool) {
+		metrics_family(w, "roompi_upload_spool_pending_bytes", "gauge", "Spooled records not posted yet");
+		metrics_sample(w, "roompi_upload_spool_pending_bytes", NULL, spool_pending(roompi_uploader->spool));
+	}
+
+	if (roompi_arena) {
+		// the uploader carves pool blocks while this runs
+		pthread_mutex_lock(&roompi_arena->lock);
+		size_t used = roompi_arena->used;
+		unsigned long spills = roompi_arena->spills;
+		pthread_mutex_unlock(&roompi_arena->lock);
+		metrics_family(w, "roompi_arena_used_bytes", "gauge", "Bytes carved from the arena");
+		metrics_sample(w, "roompi_arena_used_bytes", NULL, used);
+		metrics_family(w, "roompi_arena_spills_total", "counter", "Allocations the arena could not take, served by malloc");
+		metrics_sample(w, "roompi_arena_spills_total", NULL, spills);
+	}
+
+	if (roompi_metrics) {
+		metrics_family(w, "roompi_metrics_scrapes_total", "counter", "Scrapes of this endpoint, this one excluded");
+		metrics_sample(w, "roompi_metrics_scrapes_total", NULL, roompi_metrics->scrapes);
+		metrics_family(w, "roompi_metrics_errors_total", "counter", "Requests answered with an error status");
+		metrics_sample(w, "roompi_metrics_errors_total", NULL, roompi_metrics->errors);
+		metrics_family(w, "roompi_metrics_refused_total", "counter", "Connections closed for want of a slot");
+		metrics_sample(w, "roompi_metrics_refused_total", NULL, roompi_metrics->refused);
+		metrics_family(w, "roompi_metrics_overflows_total", "counter", "Scrapes cut short for want of room in the response buffer");
+		metrics_sample(w, "roompi_metrics_overflows_total", NULL, roompi_metrics->overflows);
+	}
+}
+
 int main(int argc, char **argv) {
-	roompi_system = systemSetup();
+	// SIGUSR1, SIGTERM and SIGINT are only consumed through a signalfd, block them before any thread gets created
+	sigset_t signal_sigset;
+	sigemptyset(&signal_sigset);
+	sigaddset(&signal_sigset, SIGUSR1);
+	sigaddset(&signal_sigset, SIGTERM);
+	sigaddset(&signal_sigset, SIGINT);
+	pthread_sigmask(SIG_BLOCK, &signal_sigset, NULL);
+
+	if (argc > 2 && strcmp(argv[1], "--gateway") == 0) {
+		// one headless room per sensor set listed in the file, no display, LEDs, buzzer or buttons
+		if (gatewaySetup(argv[2]) == 0) {
+			printf("[LOG] No rooms in %s\n", argv[2]);
+			return 1;
+		}
+		roompi_system = NULL;
+	} else {
+		roompi_system = systemSetup();
+		roompi_rooms[roompi_n_rooms++] = roompi_system;
+	}
 
 	int filerr = 0;
 
@@ -142,15 +525,17 @@ int main(int argc, char **argv) {
 	FILE *fp = fopen("/home/pi/roompi.conf", "r");
 	if (fp != NULL) {
 		char chunk[64];
-		char parsed[8];
+		char parsed[sizeof(chunk)];
 
-		for (int i = 0; i < 18; i++) {
+		for (int i = 0; i < 32; i++) {
 			if (fgets(chunk, sizeof(chunk), fp) != NULL) {
 				char *cp = strrchr(chunk, ' ');
 				if (cp && *(cp + 1)) {
-					sprintf(parsed, "%s", cp + 1);
+					snprintf(parsed, sizeof(parsed), "%s", cp + 1);
 					switch (i) {
 					case 0:
+						if (roompi_system == NULL)
+							break;
 						LCD1602Display__set_cursor(roompi_system->root_system->actuator_display, 0, 0);
 						LCD1602Display__print(roompi_system->root_system->actuator_display, "                ");
 						char aux[64];
@@ -212,18 +597,76 @@ int main(int argc, char **argv) {
 					case 17:
 						output_t_ms = atoi(parsed);
 						break;
+					case 18:
+						temp_window = atoi(parsed);
+						break;
+					case 19:
+						rh_window = atoi(parsed);
+						break;
+					case 20:
+						lux_window = atoi(parsed);
+						break;
+					case 21:
+						eco2_window = atoi(parsed);
+						break;
+					case 22:
+						temp_percentile = atof(parsed);
+						break;
+					case 23:
+						rh_percentile = atof(parsed);
+						break;
+					case 24:
+						lux_percentile = atof(parsed);
+						break;
+					case 25:
+						eco2_percentile = atof(parsed);
+						break;
+					case 26:
+						temp_deadband = atof(parsed);
+						break;
+					case 27:
+						rh_deadband = atof(parsed);
+						break;
+					case 28:
+						lux_deadband = atof(parsed);
+						break;
+					case 29:
+						eco2_deadband = atof(parsed);
+						break;
+					case 30:
+						deadband_silence_ms = atoi(parsed);
+						break;
+					case 31:
+						swinging_door = atoi(parsed);
+						break;
 					default:
 						break;
 					}
 				} else
 					filerr = 1;
-			} else
+			} else if (i < 18) // files without the window and filter lines keep the defaults
 				filerr = 1;
 		}
 	} else
 		filerr = 1;
 
-	if (filerr) {
+	int windows[4] = { temp_window, rh_window, lux_window, eco2_window };
+	float percentiles[4] = { temp_percentile, rh_percentile, lux_percentile, eco2_percentile };
+	float deadbands[4] = { temp_deadband, rh_deadband, lux_deadband, eco2_deadband };
+	for (int r = 0; r < roompi_n_rooms; r++) {
+		if (SystemContext__set_periods(roompi_rooms[r]->root_system, meas_t_ms, dht_t_ms, bh1750_t_ms, ccs811_t_ms) < 0)
+			filerr = 1;
+		for (int i = 0; i < 4; i++) {
+			if (SystemContext__set_window(roompi_rooms[r]->root_system, i, windows[i]) < 0)
+				filerr = 1;
+			if (SystemContext__set_filter(roompi_rooms[r]->root_system, i, percentiles[i]) < 0)
+				filerr = 1;
+			if (SystemContext__set_deadband(roompi_rooms[r]->root_system, i, swinging_door ? DEADBAND_SWINGING_DOOR : DEADBAND_HOLD, deadbands[i], deadband_silence_ms) < 0)
+				filerr = 1;
+		}
+	}
+
+	if (filerr && roompi_system) {
 		LCD1602Display__set_cursor(roompi_system->root_system->actuator_display, 0, 0);
 		LCD1602Display__write(roompi_system->root_system->actuator_display, 2);
 		LCD1602Display__print(roompi_system->root_system->actuator_display, "I/O roompi.conf");
@@ -234,61 +677,143 @@ int main(int argc, char **argv) {
 
 	int button_pins[3] = { 22, 21, 30 }; // button pin nos from left to right button on the board
 
-	// set pullup on button pins
-	for (int i = 0; i < 3; i++) {
-		pullUpDnControl(button_pins[i], PUD_UP);
-		pinMode(button_pins[i], INPUT);
-	}
-
 	// define buttons ISRs
 	void _force_meas_processing_isr() {
-		measurement_flags |= FLAG_PERFORM_PROCESSING;
+		flags_set(&roompi_system->root_system->measurement_flags, FLAG_PERFORM_PROCESSING);
 	}
 
 	void _force_next_display_isr() {
-		output_flags |= FLAG_NEXT_DISPLAY_INFO;
+		flags_set(&roompi_system->root_system->output_flags, FLAG_NEXT_DISPLAY_INFO);
 	}
 
 	void _toggle_buzzer_isr() {
 		buzzer_disabled ^= 0x1;
-		if (!(measurement_flags & (FLAG_TEMP_EMERGENCY | FLAG_HUMID_EMERGENCY | FLAG_LIGHT_EMERGENCY | FLAG_CO2_EMERGENCY))) {
+		if (!(flags_get(&roompi_system->root_system->measurement_flags) & FLAG_EMERGENCY_MASK)) {
 			BuzzerOutput__disable(roompi_system->root_system->actuator_buzzer);
 		} else {
 			BuzzerOutput__toggle(roompi_system->root_system->actuator_buzzer);
 		}
 	}
 
-	// ISRs setup
-	wiringPiISR(button_pins[0], INT_EDGE_FALLING, _force_meas_processing_isr);
-	wiringPiISR(button_pins[1], INT_EDGE_FALLING, _force_next_display_isr);
-	wiringPiISR(button_pins[2], INT_EDGE_FALLING, _toggle_buzzer_isr);
+	roompi_uploader = uploader_new("http://localhost:8086/write?db=db0");
+	// line protocol compresses about 5 to 1, the batches are sized for what they take on the wire
+	if (uploader_set_compression(roompi_uploader, UPLOADER_GZIP_LEVEL, UPLOADER_TARGET_BYTES) != 0)
+		printf("[LOG] Cannot set up zlib, the uploads will not be compressed\n");
+	// while InfluxDB is down or slow the lines wait on the SD card, the failed posts and what does not fit in the queue
+	if (uploader_set_spool(roompi_uploader, "/home/pi/roompi.spool", SPOOL_DEFAULT_MAX_BYTES, UPLOADER_REPLAY_RATE) == 0)
+		uploader_set_overflow(roompi_uploader, UPLOADER_SPILL);
+	else
+		printf("[LOG] Cannot open /home/pi/roompi.spool, the lines will be dropped while InfluxDB is down\n");
+
+	// local history of every sample, kept on the SD card whether the database is reachable or not
+	for (int r = 0; r < roompi_n_rooms; r++) {
+		char store_path[64], rollup_path[64], state_path[64];
+		if (roompi_system) {
+			sprintf(store_path, "/home/pi/roompi.tsdb");
+			sprintf(rollup_path, "/home/pi/roompi.rollup");
+			sprintf(state_path, "/home/pi/roompi.state");
+		} else {
+			sprintf(store_path, "/home/pi/roompi-%d.tsdb", roompi_rooms[r]->root_system->id_classroom);
+			sprintf(rollup_path, "/home/pi/roompi-%d.rollup", roompi_rooms[r]->root_system->id_classroom);
+			sprintf(state_path, "/home/pi/roompi-%d.state", roompi_rooms[r]->root_system->id_classroom);
+		}
+		if (SystemContext__open_store(roompi_rooms[r]->root_system, store_path, TSDB_DEFAULT_BLOCKS) < 0)
+			printf("[LOG] Cannot open %s, the samples of room %d will not be kept\n", store_path, roompi_rooms[r]->root_system->id_classroom);
+		if (SystemContext__open_rollup_log(roompi_rooms[r]->root_system, rollup_path, ROLLUP_LOG_DEFAULT_RECORDS) < 0)
+			printf("[LOG] Cannot open %s, the rollups of room %d will not be kept\n", rollup_path, roompi_rooms[r]->root_system->id_classroom);
+
+		// windows and values of the last run, the display skips "Calibrando..." after a restart
+		int restored = SystemContext__open_state(roompi_rooms[r]->root_system, state_path);
+		if (restored < 0)
+			printf("[LOG] Cannot open %s, room %d will start cold\n", state_path, roompi_rooms[r]->root_system->id_classroom);
+		else if (restored > 0)
+			printf("[LOG] Room %d resumed with %d samples from %s\n", roompi_rooms[r]->root_system->id_classroom, restored, state_path);
+	}
 
-	tmr_startms(roompi_system->root_measurement_ctrl->timer, meas_t_ms);
-	tmr_startms(roompi_system->root_system->sensor_temp_humid->timer, dht_t_ms); // fire temp humid fsm every 5 seconds
-	tmr_startms(roompi_system->root_system->sensor_light->timer, bh1750_t_ms); // fire light fsm every 5 seconds
-	tmr_startms(roompi_system->root_system->sensor_co2->timer, ccs811_t_ms);  // fire co2 fsm every 5 seconds
+	// Reactor setup: each FSM is only fired when one of the flag bits its guards read changes (or one of its events is posted).
+	// The rooms share the main loop, the GPIO thread and one I2C thread per bus
+	roompi_reactor = reactor_new();
+	roompi_gpio_reactor = reactor_new();
+	reactor_add_fd(roompi_reactor, signalfd(-1, &signal_sigset, SFD_CLOEXEC), systemSignal, NULL);
+
+	// the history reaches its files every SYSTEM_CHECKPOINT_MS, not only when its blocks fill up or at the stop
+	int checkpoint_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	struct itimerspec checkpoint_period = { { SYSTEM_CHECKPOINT_MS / 1000, 0 }, { SYSTEM_CHECKPOINT_MS / 1000, 0 } };
+	timerfd_settime(checkpoint_fd, 0, &checkpoint_period, NULL);
+	reactor_add_fd(roompi_reactor, checkpoint_fd, systemCheckpoint, NULL);
+
+	for (int r = 0; r < roompi_n_rooms; r++) {
+		roompi_rooms[r]->root_system->uploader = roompi_uploader;
+		if (SystemType__attach(roompi_rooms[r], roompi_reactor, systemI2CReactor(systemRoomI2CBus(roompi_rooms[r])), roompi_gpio_reactor) < 0)
+			printf("[LOG] Room %d does not fit in the reactors, some of its FSMs will not run\n", roompi_rooms[r]->root_system->id_classroom);
+	}
 
-	// Output system timer
-	tmr_startms(roompi_system->root_output_ctrl->timer, output_t_ms);
-
-	measurement_flags |= FLAG_LIGHT_PENDING_MEASUREMENT;
-	measurement_flags |= FLAG_TEMP_HUMID_PENDING_MEASUREMENT;
-	measurement_flags |= FLAG_CO2_PENDING_MEASUREMENT;
-
-	StatusLEDOutput__set_color(roompi_system->root_system->actuator_leds, GREEN);
-
-	while (1) {
-		fsm_fire(roompi_system->root_measurement_ctrl->fsm);
-		fsm_fire(roompi_system->root_system->sensor_temp_humid->fsm);
-		fsm_fire(roompi_system->root_system->sensor_light->fsm);
-		fsm_fire(roompi_system->root_system->sensor_co2->fsm);
-		fsm_fire(roompi_system->root_output_ctrl->fsm_buzzer);
-		fsm_fire(roompi_system->root_output_ctrl->fsm_leds);
-		fsm_fire(roompi_system->root_output_ctrl->fsm_info);
-		fsm_fire(roompi_system->root_output_ctrl->fsm_warnings);
+	reactor_t *reactors[GATEWAY_MAX_I2C_BUSES + 2];
+	char reactor_names[GATEWAY_MAX_I2C_BUSES + 2][8];
+	int n_reactors = systemReactors(reactors, reactor_names);
+
+#ifdef FSM_TRACE
+	// transition counts, output latency histograms and the last transitions of every FSM, dumped on SIGUSR1
+	if (getenv("ROOMPI_FSM_TRACE")) {
+		for (int i = 0; i < n_reactors; i++) {
+			for (int j = 0; j < reactors[i]->n_fsms; j++)
+				fsm_trace_enable(reactors[i]->fsms[j].fsm);
+		}
+	}
+#endif
+
+	pthread_t acquisition_threads[GATEWAY_MAX_I2C_BUSES + 2];
+	for (int i = 1; i < n_reactors; i++)
+		pthread_create(&acquisition_threads[i], NULL, acquisitionThread, reactors[i]); // everything but the main loop, joined at the stop
+
+	if (roompi_system) {
+		// set pullup on button pins
+		for (int i = 0; i < 3; i++) {
+			pullUpDnControl(button_pins[i], PUD_UP);
+			pinMode(button_pins[i], INPUT);
+		}
+
+		// ISRs setup
+		wiringPiISR(button_pins[0], INT_EDGE_FALLING, _force_meas_processing_isr);
+		wiringPiISR(button_pins[1], INT_EDGE_FALLING, _force_next_display_isr);
+		wiringPiISR(button_pins[2], INT_EDGE_FALLING, _toggle_buzzer_isr);
 	}
 
-	SystemType__destroy(roompi_system);
+	for (int r = 0; r < roompi_n_rooms; r++)
+		systemStart(roompi_rooms[r]);
+
+	if (roompi_system)
+		StatusLEDOutput__set_color(roompi_system->root_system->actuator_leds, GREEN);
+
+	// pull endpoint for Prometheus, the values, alerts and counters of every room on demand
+	roompi_metrics = metrics_new(METRICS_DEFAULT_PORT, systemRenderMetrics, NULL);
+	if (!roompi_metrics)
+		printf("[LOG] Cannot listen on port %d, /metrics will not be served\n", METRICS_DEFAULT_PORT);
+
+	// setup done: nothing is carved or allocated from here on, [LOG-Alloc] shows it
+	tzset(); // the time zone of the display clock, loaded on its first use otherwise
+	if (roompi_arena)
+		arena_seal(roompi_arena);
+
+	// blocks until a timer, ISR or FSM output posts an event, then fires only the interested FSMs. Returns on SIGTERM or SIGINT
+	reactor_run(roompi_reactor);
+
+	// the timers first, then the threads that use the rooms, then the rooms: their history and state files are closed
+	// with everything they hold in memory, and the uploader posts or spools the lines still queued
+	for (int r = 0; r < roompi_n_rooms; r++)
+		systemStop(roompi_rooms[r]);
+	for (int i = 1; i < n_reactors; i++) {
+		reactor_stop(reactors[i]);
+		pthread_join(acquisition_threads[i], NULL);
+		reactor_destroy(reactors[i]);
+	}
+	metrics_destroy(roompi_metrics);
+	reactor_destroy(roompi_reactor);
+	close(checkpoint_fd);
+	for (int r = 0; r < roompi_n_rooms; r++)
+		SystemType__destroy(roompi_rooms[r]);
+	uploader_destroy(roompi_uploader);
+	printf("[LOG] Stopped\n");
 
 	return 0;
 }
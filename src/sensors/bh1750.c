@@ -20,26 +20,29 @@
 #include "../utils.h"
 #include "../libs/systemlib.h"
 #include "../libs/systemtype.h"
+#include "../libs/arenalib.h"
 
 // FSM Functions and variables
 
-extern int measurement_flags; // grab global light flags
-
 // Timer
 static void _light_timer_isr(union sigval value);
+static void _light_conversion_timer_isr(union sigval value);
 
 // FSM states enum
-enum _light_fsm_state { LIGHT_MEASUREMENT };
+enum _light_fsm_state { LIGHT_IDLE, LIGHT_WAITING_CONVERSION };
 
 // FSM input check functions
 static int _light_pending_measurement(fsm_t *this);
+static int _light_conversion_done(fsm_t *this);
 
 // FSM output action functions
+static void _light_start_measurement(fsm_t *this);
 static void _light_do_measurement(fsm_t *this);
 
 // { EstadoOrigen, CondicionDeDisparo, EstadoFinal, AccionesSiTransicion }
 static fsm_trans_t _light_fsm_tt[] = {
-		{ LIGHT_MEASUREMENT, _light_pending_measurement, LIGHT_MEASUREMENT, _light_do_measurement },
+		{ LIGHT_IDLE, _light_pending_measurement, LIGHT_WAITING_CONVERSION, _light_start_measurement },
+		{ LIGHT_WAITING_CONVERSION, _light_conversion_done, LIGHT_IDLE, _light_do_measurement },
 		{-1, NULL, -1, NULL}
 };
 
@@ -47,19 +50,34 @@ static fsm_trans_t _light_fsm_tt[] = {
 
 
 BH1750Sensor* BH1750Sensor__create(int id, int addr, int mode) {
-	BH1750Sensor* result = (BH1750Sensor*) malloc(sizeof(BH1750Sensor));
+	return BH1750Sensor__create_on_bus(id, 1, addr, mode);
+}
+
+BH1750Sensor* BH1750Sensor__create_on_bus(int id, int i2c_bus, int addr, int mode) {
+	BH1750Sensor* result = (BH1750Sensor*) arena_malloc(sizeof(BH1750Sensor));
 	result->id = id;
+	result->i2c_bus = i2c_bus;
 	result->addr = addr;
 	result->mode = mode;
 	result->lux = 0;
-	result->fd = wiringPiI2CSetup(addr);
+	result->start_result = 0;
+	atomic_init(&result->conversion_done, 0);
+	result->system = NULL;
+	result->reactor = NULL;
+
+	char device[16];
+	sprintf(device, "/dev/i2c-%d", i2c_bus);
+	result->fd = wiringPiI2CSetupInterface(device, addr);
 
 	// Timer instantiation
 	tmr_t *light_timer = tmr_new(_light_timer_isr); // creado pero no iniciado
 	result->timer = light_timer;
+	result->timer->user_data = result;
+	result->conversion_timer = tmr_new(_light_conversion_timer_isr);
+	result->conversion_timer->user_data = result;
 
 	// FSM creation
-	result->fsm = (fsm_t *) fsm_new(LIGHT_MEASUREMENT, _light_fsm_tt, result); //3rd param pointer available under user_data
+	result->fsm = (fsm_t *) fsm_new(LIGHT_IDLE, _light_fsm_tt, result); //3rd param pointer available under user_data
 
 
 	return result;
@@ -69,7 +87,8 @@ void BH1750Sensor__destroy(BH1750Sensor* sensor_instance)  {
 	if (sensor_instance) {
 		fsm_destroy(sensor_instance->fsm);
 		tmr_destroy(sensor_instance->timer);
-		free(sensor_instance);
+		tmr_destroy(sensor_instance->conversion_timer);
+		arena_free(sensor_instance);
 	}
 }
 
@@ -77,31 +96,62 @@ int BH1750Sensor__lux_value(BH1750Sensor* sensor_instance) {
 	return sensor_instance->lux;
 }
 
+// Blocking measurement (start, wait for the conversion, collect), not to be used from the FSMs
 int BH1750Sensor__perform_measurement(BH1750Sensor* sensor_instance) {
+	int r = BH1750Sensor__start_measurement(sensor_instance);
+	delay(BH1750_CONVERSION_MS);
+	BH1750Sensor__collect_measurement(sensor_instance);
+	return r;
+}
+
+// Sends the measurement opcode, the result can be collected BH1750_CONVERSION_MS later
+int BH1750Sensor__start_measurement(BH1750Sensor* sensor_instance) {
 	//wiringPiI2CWrite(sensor_instance->fd, RESET);
 	int r = wiringPiI2CWrite(sensor_instance->fd, sensor_instance->mode); // error if function returns < 0
-	delay(180);
+	sensor_instance->start_result = r;
+	return r;
+}
+
+int BH1750Sensor__collect_measurement(BH1750Sensor* sensor_instance) {
 	short word = wiringPiI2CReadReg16(sensor_instance->fd, 0x00);
 	word = bswap_16(word);
 	sensor_instance->lux = word / 1.2;
-	return r;
+	return sensor_instance->start_result;
 }
 
 /************************/
 
 static void _light_timer_isr(union sigval value) {
-	piLock(MEASUREMENT_LOCK);
-	measurement_flags |= FLAG_LIGHT_PENDING_MEASUREMENT;
-	piUnlock(MEASUREMENT_LOCK);
+	BH1750Sensor* bh = (BH1750Sensor*) ((tmr_t*) value.sival_ptr)->user_data;
+	flags_set(&bh->system->measurement_flags, FLAG_LIGHT_PENDING_MEASUREMENT); // the reactor fires the sensor FSM on the change
+}
+
+static void _light_conversion_timer_isr(union sigval value) {
+	BH1750Sensor* bh = (BH1750Sensor*) ((tmr_t*) value.sival_ptr)->user_data;
+	atomic_store(&bh->conversion_done, 1); // the expiry itself is the condition, there is no second event to wait for
+	reactor_post(bh->reactor, EVENT_LIGHT);
 }
 
 static int _light_pending_measurement(fsm_t *this) {
-	return (measurement_flags & FLAG_LIGHT_PENDING_MEASUREMENT);
+	BH1750Sensor* bh = (BH1750Sensor*) this->user_data;
+	return (flags_get(&bh->system->measurement_flags) & FLAG_LIGHT_PENDING_MEASUREMENT);
+}
+
+static int _light_conversion_done(fsm_t *this) {
+	BH1750Sensor* bh = (BH1750Sensor*) this->user_data;
+	return atomic_load(&bh->conversion_done);
+}
+
+static void _light_start_measurement(fsm_t *this) {
+	BH1750Sensor* bh = (BH1750Sensor*) this->user_data;
+	BH1750Sensor__start_measurement(bh);
+	atomic_store(&bh->conversion_done, 0);
+	tmr_startms_oneshot(bh->conversion_timer, BH1750_CONVERSION_MS); // come back when the conversion is done
 }
 
 static void _light_do_measurement(fsm_t *this) {
 	BH1750Sensor* bh = (BH1750Sensor*) this->user_data;
-	int r = BH1750Sensor__perform_measurement(bh);
+	int r = BH1750Sensor__collect_measurement(bh);
 
 	SensorValueType res_light_val; // craft SensorValueType instance with type Integer and value measured lux or error
 	if (r < 0) {
@@ -113,13 +163,7 @@ static void _light_do_measurement(fsm_t *this) {
 		res_light_val.val.ival = BH1750Sensor__lux_value(bh);
 	}
 
-	extern SystemType *roompi_system; // get the current system
-
-	piLock(STORAGE_LOCK);
-	CircularBufferPush(roompi_system->root_system->sensor_storage[2], (SensorValueType*) &res_light_val, sizeof(res_light_val)); // light circular buffer is at index 2 of the table
-	piUnlock(STORAGE_LOCK);
+	SystemContext__publish_sample(bh->system, SENSOR_QUEUE_LIGHT, 2, res_light_val); // light circular buffer is at index 2 of the table
 
-	piLock(MEASUREMENT_LOCK);
-	measurement_flags &= ~(FLAG_LIGHT_PENDING_MEASUREMENT);
-	piUnlock(MEASUREMENT_LOCK);
+	flags_clear(&bh->system->measurement_flags, FLAG_LIGHT_PENDING_MEASUREMENT);
 }
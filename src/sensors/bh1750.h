@@ -8,9 +8,10 @@
 #ifndef BH1750_H_
 #define BH1750_H_
 
+#include <stdatomic.h>
 #include "../libs/fsm.h"
 #include "../libs/timerlib.h"
-#include "../libs/circularbuffer.h"
+#include "../libs/reactorlib.h"
 
 #define FLAG_LIGHT_PENDING_MEASUREMENT 0x02
 
@@ -28,23 +29,35 @@
 #define ONE_TIME_H_RES2 0x21
 #define ONE_TIME_L_RES 0x23
 
+#define BH1750_CONVERSION_MS 180 // max H-resolution measurement time
+
 // Adjusting sensor sensitivity is possible by changing MTreg,
 // but not necessary for our case
 
 typedef struct {
 	int id; // sensor id
+	int i2c_bus; // N of /dev/i2c-N
 	int addr; // sensor i2c address
 	int mode; // sensor operating mode (continuous/one time-hires/lowres)
 	int fd; // file descriptor handle representing the i2c device
 	int lux;
+	int start_result; // result of the last measurement start (< 0 on I2C error)
+	atomic_int conversion_done; // set when conversion_timer expires, the conversion time has elapsed
 
 	fsm_t *fsm; // FSM that performs a measurement from the light sensor
 	tmr_t *timer; // timer that goberns a flag used by the light sensor measurement FSM (5 s periodic)
+	tmr_t *conversion_timer; // one-shot timer that wakes the FSM up when the conversion is done
+
+	struct SystemContext *system; // room the sensor belongs to, set by SystemContext__create
+	reactor_t *reactor; // acquisition reactor of the sensor's bus, set by SystemType__attach
 } BH1750Sensor;
 
 BH1750Sensor* BH1750Sensor__create(int id, int addr, int mode);
+BH1750Sensor* BH1750Sensor__create_on_bus(int id, int i2c_bus, int addr, int mode);
 void BH1750Sensor__destroy(BH1750Sensor* sensor_instance);
 int BH1750Sensor__perform_measurement(BH1750Sensor* sensor_instance);
+int BH1750Sensor__start_measurement(BH1750Sensor* sensor_instance);
+int BH1750Sensor__collect_measurement(BH1750Sensor* sensor_instance);
 int BH1750Sensor__lux_value(BH1750Sensor* sensor_instance);
 
 #endif /* BH1750_H_ */
@@ -21,6 +21,7 @@
 #include "../utils.h"
 #include "../libs/systemlib.h"
 #include "../libs/systemtype.h"
+#include "../libs/arenalib.h"
 
 const char getRegister(const char reg, const int numBytes);
 char* getSelectedRegister(char registerSelected);
@@ -30,42 +31,55 @@ int writeI2CBytes(CCS811Sensor *sensor_instance, const char reg, int numBytes);
 
 // FSM Functions and variables
 
-extern int measurement_flags; // grab global co2 flags
-
 // Timer
 static void _co2_timer_isr(union sigval value);
+static void _co2_data_timer_isr(union sigval value);
 
 // FSM states enum
 enum _light_fsm_state {
-	CO2_MEASUREMENT
+	CO2_IDLE, CO2_WAITING_DATA
 };
 
 // FSM input check functions
 static int _co2_pending_measurement(fsm_t *this);
+static int _co2_data_available(fsm_t *this);
 
 // FSM output action functions
+static void _co2_start_measurement(fsm_t *this);
 static void _co2_do_measurement(fsm_t *this);
 
 // { EstadoOrigen, CondicionDeDisparo, EstadoFinal, AccionesSiTransicion }
-static fsm_trans_t _co2_fsm_tt[] = { { CO2_MEASUREMENT, _co2_pending_measurement, CO2_MEASUREMENT, _co2_do_measurement }, { -1, NULL, -1, NULL } };
+static fsm_trans_t _co2_fsm_tt[] = { { CO2_IDLE, _co2_pending_measurement, CO2_WAITING_DATA, _co2_start_measurement }, { CO2_WAITING_DATA, _co2_data_available, CO2_IDLE,
+		_co2_do_measurement }, { -1, NULL, -1, NULL } };
 
 /************************/
 CCS811Sensor* CCS811Sensor__create(int id, int addr, int addr_pin, int interrupt_pin, int rst_pin) {
-	CCS811Sensor *result = (CCS811Sensor*) malloc(sizeof(CCS811Sensor));
+	return CCS811Sensor__create_on_bus(id, 1, addr, addr_pin, interrupt_pin, rst_pin);
+}
+
+CCS811Sensor* CCS811Sensor__create_on_bus(int id, int i2c_bus, int addr, int addr_pin, int interrupt_pin, int rst_pin) {
+	CCS811Sensor *result = (CCS811Sensor*) arena_malloc(sizeof(CCS811Sensor));
 
 	result->id = id;
+	result->i2c_bus = i2c_bus;
 	result->addr = addr;
 
 	result->addr_pin = addr_pin;
 	result->interrupt_pin = interrupt_pin;
 	result->rst_pin = rst_pin;
+	atomic_init(&result->data_done, 0);
+	result->system = NULL;
+	result->reactor = NULL;
 
 	// Timer instantiation
 	tmr_t *co2_timer = tmr_new(_co2_timer_isr); // creado pero no iniciado
 	result->timer = co2_timer;
+	result->timer->user_data = result;
+	result->data_timer = tmr_new(_co2_data_timer_isr);
+	result->data_timer->user_data = result;
 
 	// FSM creation
-	result->fsm = (fsm_t*) fsm_new(CO2_MEASUREMENT, _co2_fsm_tt, result); //3rd param pointer available under user_data
+	result->fsm = (fsm_t*) fsm_new(CO2_IDLE, _co2_fsm_tt, result); //3rd param pointer available under user_data
 
 	return result;
 
@@ -75,7 +89,8 @@ void CCS811Sensor__destroy(CCS811Sensor *sensor_instance) {
 	if (sensor_instance) {
 		fsm_destroy(sensor_instance->fsm);
 		tmr_destroy(sensor_instance->timer);
-		free(sensor_instance);
+		tmr_destroy(sensor_instance->data_timer);
+		arena_free(sensor_instance);
 	}
 }
 
@@ -98,7 +113,8 @@ int CCS811Sensor__connect(CCS811Sensor *sensor_instance) {
 		}
 	}
 
-	char *filename = "/dev/i2c-1";
+	char filename[16];
+	sprintf(filename, "/dev/i2c-%d", sensor_instance->i2c_bus);
 	if ((sensor_instance->file = open(filename, O_RDWR)) < 0) {
 		DEBUG("Connecting to the I2C bus failed");
 		return ERROR;
@@ -238,6 +254,27 @@ void CCS811Sensor_print_app_register(CCS811Sensor *sensor_instance) {
 	printf("\r\n");
 }
 
+// Blocking measurement, not to be used from the FSMs
+int CCS811Sensor__perform_measurement(CCS811Sensor *sensor_instance) {
+	CCS811Sensor__start_measurement(sensor_instance, 25.0, 50.0);
+	delay(CCS811_DATA_WAIT_MS);
+	return CCS811Sensor__collect_measurement(sensor_instance);
+}
+
+// Requests a new sample, ALG_RESULT_DATA can be read CCS811_DATA_WAIT_MS later
+void CCS811Sensor__start_measurement(CCS811Sensor *sensor_instance, float temp, float humidity) {
+	//CCS811Sensor__set_environment_data(sensor_instance, temp, humidity);
+}
+
+// Reads ALG_RESULT_DATA into the application register, ERROR if the sensor reports an error or no eCO2 value
+int CCS811Sensor__collect_measurement(CCS811Sensor *sensor_instance) {
+	if (CCS811Sensor__read_register(sensor_instance, ALG_RESULT_DATA) == ERROR)
+		return ERROR;
+	if (sensor_instance->app_register.status.error || sensor_instance->app_register.alg_result_data.eco2 == 0)
+		return ERROR;
+	return OK;
+}
+
 char* getSelectedRegister(char registerSelected) {
 	switch (registerSelected) {
 	case 0x00:
@@ -353,37 +390,49 @@ const char getRegister(const char reg, const int numBytes) {
 /************************/
 
 static void _co2_timer_isr(union sigval value) {
-	piLock(MEASUREMENT_LOCK);
-	measurement_flags |= FLAG_CO2_PENDING_MEASUREMENT;
-	piUnlock(MEASUREMENT_LOCK);
+	CCS811Sensor *ccs = (CCS811Sensor*) ((tmr_t*) value.sival_ptr)->user_data;
+	flags_set(&ccs->system->measurement_flags, FLAG_CO2_PENDING_MEASUREMENT); // the reactor fires the sensor FSM on the change
+}
+
+static void _co2_data_timer_isr(union sigval value) {
+	CCS811Sensor *ccs = (CCS811Sensor*) ((tmr_t*) value.sival_ptr)->user_data;
+	atomic_store(&ccs->data_done, 1); // the expiry itself is the condition, there is no second event to wait for
+	reactor_post(ccs->reactor, EVENT_CO2);
 }
 
 static int _co2_pending_measurement(fsm_t *this) {
-	return (measurement_flags & FLAG_CO2_PENDING_MEASUREMENT);
+	CCS811Sensor *ccs = (CCS811Sensor*) this->user_data;
+	return (flags_get(&ccs->system->measurement_flags) & FLAG_CO2_PENDING_MEASUREMENT);
 }
 
-static void _co2_do_measurement(fsm_t *this) {
+static int _co2_data_available(fsm_t *this) {
 	CCS811Sensor *ccs = (CCS811Sensor*) this->user_data;
+	return atomic_load(&ccs->data_done);
+}
 
-	extern SystemType *roompi_system; // get the current system
-	SensorValueType t_value = roompi_system->root_system->sensor_values[0];
-	SensorValueType rh_value = roompi_system->root_system->sensor_values[1];
+static void _co2_start_measurement(fsm_t *this) {
+	CCS811Sensor *ccs = (CCS811Sensor*) this->user_data;
+
+	SensorValueType t_value = ccs->system->sensor_values[0];
+	SensorValueType rh_value = ccs->system->sensor_values[1];
 
 	if (t_value.type != is_error && rh_value.type != is_error) { //no se si se puede hacer esto porque ahora esto es controlado por master y quizas aunque siga el flag de pending activo ya tenemos medida quw poder usar
-		//CCS811Sensor__set_environment_data(ccs, t_value.val.fval, rh_value.val.fval);
+		CCS811Sensor__start_measurement(ccs, t_value.val.fval, rh_value.val.fval);
 	} else {
-		//CCS811Sensor__set_environment_data(ccs, 25.0, 50.0);
+		CCS811Sensor__start_measurement(ccs, 25.0, 50.0);
 	}
+	atomic_store(&ccs->data_done, 0);
+	tmr_startms_oneshot(ccs->data_timer, CCS811_DATA_WAIT_MS); // come back when the data can be read
+}
+
+static void _co2_do_measurement(fsm_t *this) {
+	CCS811Sensor *ccs = (CCS811Sensor*) this->user_data;
 
 	// check if co2 measurement available, if not nothing happens
-		delay(200);
-		CCS811Sensor__read_register(ccs, ALG_RESULT_DATA);
+		int err = CCS811Sensor__collect_measurement(ccs) == ERROR; // No error: 0, Error: 1
 		int eco2 = ccs->app_register.alg_result_data.eco2;
-		int err = ccs->app_register.status.error; // No error: 0, Error: 1
 		SensorValueType res_co2_val; // craft SensorValueType instance with type Integer and value measured co2 or error
 
-		if (eco2 == 0)
-			err = 1;
 		if (err > 0) {
 			// we have an error
 			res_co2_val.type = is_error;
@@ -393,11 +442,7 @@ static void _co2_do_measurement(fsm_t *this) {
 			res_co2_val.val.ival = eco2;
 		}
 
-		piLock(STORAGE_LOCK);
-		CircularBufferPush(roompi_system->root_system->sensor_storage[3], &res_co2_val, sizeof(res_co2_val)); // co2 circular buffer is at index 2 of the table
-		piUnlock(STORAGE_LOCK);
+		SystemContext__publish_sample(ccs->system, SENSOR_QUEUE_CO2, 3, res_co2_val); // co2 circular buffer is at index 3 of the table
 
-		piLock(MEASUREMENT_LOCK);
-		measurement_flags &= ~(FLAG_CO2_PENDING_MEASUREMENT);
-		piUnlock(MEASUREMENT_LOCK);
+		flags_clear(&ccs->system->measurement_flags, FLAG_CO2_PENDING_MEASUREMENT);
 	}
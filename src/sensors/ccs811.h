@@ -10,12 +10,15 @@
 #define SENSORS_CCS811_H_
 
 #include<stdint.h>
+#include <stdatomic.h>
 #include "../libs/fsm.h"
 #include "../libs/timerlib.h"
-#include "../libs/circularbuffer.h"
+#include "../libs/reactorlib.h"
 
 #define FLAG_CO2_PENDING_MEASUREMENT 0x04
 
+#define CCS811_DATA_WAIT_MS 200 // wait between a measurement request and reading ALG_RESULT_DATA
+
 #define MODE0_IDLE 0b000
 #define MODE1_EACH_1S 0b001
 #define MODE2_EACH_10S 0b010
@@ -145,6 +148,7 @@ union ApplicationRegister {
 
 typedef struct {
 	int id; // sensor id
+	int i2c_bus; // N of /dev/i2c-N
 	int addr; // sensor i2c address
 	int addr_pin; // address setting pin
 	int interrupt_pin; // interrupt pin
@@ -152,12 +156,18 @@ typedef struct {
 	int file; // file descriptor for i2c
 
 	union ApplicationRegister app_register; // application register
+	atomic_int data_done; // set when data_timer expires, ALG_RESULT_DATA can be read
 
 	fsm_t *fsm; // FSM that performs a measurement from the co2 sensor
 	tmr_t *timer; // timer that goberns a flag used by the co2 sensor measurement FSM (x s periodic) // no se el tiempo aun
+	tmr_t *data_timer; // one-shot timer that wakes the FSM up when the data can be read
+
+	struct SystemContext *system; // room the sensor belongs to, set by SystemContext__create
+	reactor_t *reactor; // acquisition reactor of the sensor's bus, set by SystemType__attach
 } CCS811Sensor;
 
 CCS811Sensor* CCS811Sensor__create(int id, int addr, int addr_pin, int interrupt_pin, int rst_pin);
+CCS811Sensor* CCS811Sensor__create_on_bus(int id, int i2c_bus, int addr, int addr_pin, int interrupt_pin, int rst_pin);
 void CCS811Sensor__destroy(CCS811Sensor *sensor_instance);
 void CCS811Sensor__set_app_register(CCS811Sensor *sensor_instance, union ApplicationRegister app_register);
 int CCS811Sensor__connect(CCS811Sensor *sensor_instance);
@@ -170,5 +180,8 @@ uint8_t CCS811Sensor__available(CCS811Sensor *sensor_instance);
 int CCS811Sensor_print_status(CCS811Sensor *sensor_instance);
 void CCS811Sensor_clear_app_register(CCS811Sensor *sensor_instance);
 void CCS811Sensor_print_app_register(CCS811Sensor *sensor_instance);
+int CCS811Sensor__perform_measurement(CCS811Sensor *sensor_instance);
+void CCS811Sensor__start_measurement(CCS811Sensor *sensor_instance, float temp, float humidity);
+int CCS811Sensor__collect_measurement(CCS811Sensor *sensor_instance);
 
 #endif /* SENSORS_CCS811_H_ */
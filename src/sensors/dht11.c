@@ -17,26 +17,29 @@
 #include "../utils.h"
 #include "../libs/systemlib.h"
 #include "../libs/systemtype.h"
+#include "../libs/arenalib.h"
 
 // FSM Functions and variables
 
-extern int measurement_flags; // grab global light flags
-
 // Timer
 static void _temp_humid_timer_isr(union sigval value);
+static void _temp_humid_start_timer_isr(union sigval value);
 
 // FSM states enum
-enum _temp_humid_fsm_state { TEMP_HUMID_MEASUREMENT };
+enum _temp_humid_fsm_state { TEMP_HUMID_IDLE, TEMP_HUMID_WAITING_START };
 
 // FSM input check functions
 static int _temp_humid_pending_measurement(fsm_t *this);
+static int _temp_humid_start_done(fsm_t *this);
 
 // FSM output action functions
+static void _temp_humid_start_measurement(fsm_t *this);
 static void _temp_humid_do_measurement(fsm_t *this);
 
 // { EstadoOrigen, CondicionDeDisparo, EstadoFinal, AccionesSiTransicion }
 static fsm_trans_t _temp_humid_fsm_tt[] = {
-		{ TEMP_HUMID_MEASUREMENT, _temp_humid_pending_measurement, TEMP_HUMID_MEASUREMENT, _temp_humid_do_measurement },
+		{ TEMP_HUMID_IDLE, _temp_humid_pending_measurement, TEMP_HUMID_WAITING_START, _temp_humid_start_measurement },
+		{ TEMP_HUMID_WAITING_START, _temp_humid_start_done, TEMP_HUMID_IDLE, _temp_humid_do_measurement },
 		{-1, NULL, -1, NULL}
 };
 
@@ -44,19 +47,25 @@ static fsm_trans_t _temp_humid_fsm_tt[] = {
 
 
 DHT11Sensor* DHT11Sensor__create(int id, int data_pin) {
-	DHT11Sensor *result = (DHT11Sensor*) malloc(sizeof(DHT11Sensor));
+	DHT11Sensor *result = (DHT11Sensor*) arena_malloc(sizeof(DHT11Sensor));
 	result->id = id;
 	result->data_pin = data_pin;
 	result->t_value = 0;
 	result->rh_value = 0;
 	result->timestamp = 0;
+	atomic_init(&result->start_done, 0);
+	result->system = NULL;
+	result->reactor = NULL;
 
 	// Timer instantiation
 		tmr_t *temp_humid_timer = tmr_new(_temp_humid_timer_isr); // creado pero no iniciado
 		result->timer = temp_humid_timer;
+		result->timer->user_data = result;
+		result->start_timer = tmr_new(_temp_humid_start_timer_isr);
+		result->start_timer->user_data = result;
 
 		// FSM creation
-		result->fsm = (fsm_t *) fsm_new(TEMP_HUMID_MEASUREMENT, _temp_humid_fsm_tt, result); //3rd param pointer available under user_data
+		result->fsm = (fsm_t *) fsm_new(TEMP_HUMID_IDLE, _temp_humid_fsm_tt, result); //3rd param pointer available under user_data
 
 
 	return result;
@@ -66,8 +75,9 @@ void DHT11Sensor__destroy(DHT11Sensor *sensor_instance) {
 	if (sensor_instance) {
 		fsm_destroy(sensor_instance->fsm);
 		tmr_destroy(sensor_instance->timer);
+		tmr_destroy(sensor_instance->start_timer);
 		// reset....
-		free(sensor_instance);
+		arena_free(sensor_instance);
 	};
 }
 
@@ -79,7 +89,21 @@ float DHT11Sensor__rh_value(DHT11Sensor *sensor_instance) {
 	return sensor_instance->rh_value;
 }
 
+// Blocking measurement (start pulse, wait, read), not to be used from the FSMs
 int DHT11Sensor__perform_measurement(DHT11Sensor *sensor_instance) {
+	DHT11Sensor__start_measurement(sensor_instance);
+	delay(DHT11_START_PULSE_MS);
+	return DHT11Sensor__collect_measurement(sensor_instance);
+}
+
+// Pulls the data line down, DHT11Sensor__collect_measurement must be called DHT11_START_PULSE_MS later
+void DHT11Sensor__start_measurement(DHT11Sensor *sensor_instance) {
+	pinMode(sensor_instance->data_pin, OUTPUT);
+	digitalWrite(sensor_instance->data_pin, LOW);
+}
+
+// Releases the line and reads the 40 bits answer. This part is bit-banged and timing critical (~5 ms), it cannot be split
+int DHT11Sensor__collect_measurement(DHT11Sensor *sensor_instance) {
 	// test data
 	//sensor_instance->t_value = 25.0;
 	//sensor_instance->rh_value = 17.0;
@@ -95,12 +119,7 @@ int DHT11Sensor__perform_measurement(DHT11Sensor *sensor_instance) {
 
 	data[0] = data[1] = data[2] = data[3] = data[4] = 0;
 
-	/* pull pin down for 18 milliseconds */
-	pinMode(DHT_PIN, OUTPUT);
-	digitalWrite(DHT_PIN, LOW);
-	delay(18);
-
-	/* prepare to read the pin */
+	/* prepare to read the pin (it has been pulled down for 18 milliseconds) */
 	pinMode(DHT_PIN, INPUT);
 
 	/* detect change and read data */
@@ -167,18 +186,36 @@ int DHT11Sensor__perform_measurement(DHT11Sensor *sensor_instance) {
 /************************/
 
 static void _temp_humid_timer_isr(union sigval value) {
-	piLock(MEASUREMENT_LOCK);
-	measurement_flags |= FLAG_TEMP_HUMID_PENDING_MEASUREMENT;
-	piUnlock(MEASUREMENT_LOCK);
+	DHT11Sensor* dht = (DHT11Sensor*) ((tmr_t*) value.sival_ptr)->user_data;
+	flags_set(&dht->system->measurement_flags, FLAG_TEMP_HUMID_PENDING_MEASUREMENT); // the reactor fires the sensor FSM on the change
+}
+
+static void _temp_humid_start_timer_isr(union sigval value) {
+	DHT11Sensor* dht = (DHT11Sensor*) ((tmr_t*) value.sival_ptr)->user_data;
+	atomic_store(&dht->start_done, 1); // the expiry itself is the condition, there is no second event to wait for
+	reactor_post(dht->reactor, EVENT_TEMP_HUMID);
 }
 
 static int _temp_humid_pending_measurement(fsm_t *this) {
-	return (measurement_flags & FLAG_TEMP_HUMID_PENDING_MEASUREMENT);
+	DHT11Sensor* dht = (DHT11Sensor*) this->user_data;
+	return (flags_get(&dht->system->measurement_flags) & FLAG_TEMP_HUMID_PENDING_MEASUREMENT);
+}
+
+static int _temp_humid_start_done(fsm_t *this) {
+	DHT11Sensor* dht = (DHT11Sensor*) this->user_data;
+	return atomic_load(&dht->start_done);
+}
+
+static void _temp_humid_start_measurement(fsm_t *this) {
+	DHT11Sensor* dht = (DHT11Sensor*) this->user_data;
+	DHT11Sensor__start_measurement(dht);
+	atomic_store(&dht->start_done, 0);
+	tmr_startms_oneshot(dht->start_timer, DHT11_START_PULSE_MS); // come back when the start pulse is done
 }
 
 static void _temp_humid_do_measurement(fsm_t *this) {
 	DHT11Sensor* dht = (DHT11Sensor*) this->user_data;
-	int r = DHT11Sensor__perform_measurement(dht);
+	int r = DHT11Sensor__collect_measurement(dht);
 
 	SensorValueType res_temp_val; // craft SensorValueType instance with type Integer and value measured temp or error
 	SensorValueType res_humid_val; // craft SensorValueType instance with type Integer and value measured humid or error
@@ -199,15 +236,9 @@ static void _temp_humid_do_measurement(fsm_t *this) {
 		res_humid_val.val.fval = DHT11Sensor__rh_value(dht);
 	}
 
-	extern SystemType *roompi_system; // get the current system
-
-	piLock(STORAGE_LOCK);
-	CircularBufferPush(roompi_system->root_system->sensor_storage[0], (SensorValueType*) &res_temp_val, sizeof(res_temp_val));
-	CircularBufferPush(roompi_system->root_system->sensor_storage[1], (SensorValueType*) &res_humid_val, sizeof(res_humid_val));
-	piUnlock(STORAGE_LOCK);
+	SystemContext__publish_sample(dht->system, SENSOR_QUEUE_TEMP_HUMID, 0, res_temp_val);
+	SystemContext__publish_sample(dht->system, SENSOR_QUEUE_TEMP_HUMID, 1, res_humid_val);
 
-	piLock(MEASUREMENT_LOCK);
-	measurement_flags &= ~(FLAG_TEMP_HUMID_PENDING_MEASUREMENT);
-	piUnlock(MEASUREMENT_LOCK);
+	flags_clear(&dht->system->measurement_flags, FLAG_TEMP_HUMID_PENDING_MEASUREMENT);
 
 }
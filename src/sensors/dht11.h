@@ -8,21 +8,29 @@
 #ifndef DHT11_H_
 #define DHT11_H_
 
+#include <stdatomic.h>
 #include "../libs/fsm.h"
 #include "../libs/timerlib.h"
-#include "../libs/circularbuffer.h"
+#include "../libs/reactorlib.h"
 
 #define FLAG_TEMP_HUMID_PENDING_MEASUREMENT 0x01
 
+#define DHT11_START_PULSE_MS 18 // the host holds the line low this long to request a reading
+
 typedef struct {
 	int id; // sensor id
 	float t_value; // temperature value
 	float rh_value; // relative humidity value
 	int data_pin; // wPi pin the sensor is connected to
 	unsigned int timestamp; // last measurement timestamp
+	atomic_int start_done; // set when start_timer expires, the start pulse is long enough
 
 	fsm_t *fsm; // FSM that performs a measurement from the temp humid sensor
 	tmr_t *timer; // timer that goberns a flag used by the temp humid sensor measurement FSM (5 s periodic)
+	tmr_t *start_timer; // one-shot timer that wakes the FSM up at the end of the start pulse
+
+	struct SystemContext *system; // room the sensor belongs to, set by SystemContext__create
+	reactor_t *reactor; // acquisition reactor of the sensor's bus, set by SystemType__attach
 } DHT11Sensor;
 
 DHT11Sensor* DHT11Sensor__create(int id, int data_pin);
@@ -30,5 +38,7 @@ void DHT11Sensor__destroy(DHT11Sensor *sensor_instance);
 float DHT11Sensor__t_value(DHT11Sensor *sensor_instance);
 float DHT11Sensor__rh_value(DHT11Sensor *sensor_instance);
 int DHT11Sensor__perform_measurement(DHT11Sensor *sensor_instance);
+void DHT11Sensor__start_measurement(DHT11Sensor *sensor_instance);
+int DHT11Sensor__collect_measurement(DHT11Sensor *sensor_instance);
 
 #endif /* DHT11_H_ */
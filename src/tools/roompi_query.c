@@ -0,0 +1,99 @@
+/*
+ * roompi_query.c
+ *
+ * Command line range queries over the local time-series store of a room. Prints one CSV line per
+ * bucket (start, samples, mean, min, max); the step is in seconds, 0 for one bucket over the whole
+ * range. Times are "YYYY-MM-DD HH:MM[:SS]" in local time, or ms since the epoch.
+ *
+ * gcc -O2 src/tools/roompi_query.c src/libs/tsdblib.c src/libs/arenalib.c -o roompi-query
+ * ./roompi-query /home/pi/roompi.tsdb eco2 "2026-10-16 09:00" "2026-10-16 14:00" 60
+ *
+ *  Created on: 17 oct. 2026
+ *      Author: Victoria M. Gullon and Marcos Gomez
+ */
+
+#define _XOPEN_SOURCE 700
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../libs/tsdblib.h"
+
+static const char *channel_names[4] = { "temp", "rh", "lux", "eco2" };
+
+// Returns 0, or -1 if it is not a time
+static int _parse_time(const char *text, int64_t *ms) {
+	struct tm tm;
+	char *end;
+
+	long long value = strtoll(text, &end, 10);
+	if (*end == '\0') {
+		*ms = value;
+		return 0;
+	}
+
+	memset(&tm, 0, sizeof(tm));
+	end = strptime(text, "%Y-%m-%d %H:%M", &tm);
+	if (end && *end == ':')
+		end = strptime(end + 1, "%S", &tm);
+	if (!end || *end != '\0')
+		return -1;
+
+	tm.tm_isdst = -1;
+	*ms = mktime(&tm) * 1000LL;
+	return 0;
+}
+
+static int _parse_channel(const char *text) {
+	for (int c = 0; c < 4; c++) {
+		if (strcmp(text, channel_names[c]) == 0)
+			return c;
+	}
+	return atoi(text);
+}
+
+int main(int argc, char **argv) {
+	int64_t from_ms, to_ms;
+
+	if (argc < 5 || _parse_time(argv[3], &from_ms) < 0 || _parse_time(argv[4], &to_ms) < 0) {
+		fprintf(stderr, "usage: %s <file> <temp|rh|lux|eco2> <from> <to> [step_s]\n", argv[0]);
+		return 1;
+	}
+
+	int channel = _parse_channel(argv[2]);
+	int64_t step_ms = argc > 5 ? atoll(argv[5]) * 1000 : 0;
+
+	tsdb_t *db = tsdb_open(argv[1], 0, 0);
+	if (!db) {
+		fprintf(stderr, "%s is not a RoomPi store\n", argv[1]);
+		return 1;
+	}
+
+	unsigned int n_buckets = step_ms > 0 ? (to_ms - from_ms + step_ms - 1) / step_ms : 1;
+	tsdb_agg_t *buckets = (tsdb_agg_t*) malloc(n_buckets * sizeof(tsdb_agg_t));
+	int n = tsdb_query(db, channel, from_ms, to_ms, step_ms, buckets, n_buckets);
+	if (n < 0) {
+		fprintf(stderr, "bad channel or range\n");
+		tsdb_close(db);
+		return 1;
+	}
+
+	printf("start,samples,mean,min,max\n");
+	for (int k = 0; k < n; k++) {
+		time_t start = buckets[k].start_ms / 1000;
+		char when[32];
+
+		strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", localtime(&start));
+		if (buckets[k].count > 0)
+			printf("%s,%u,%.3f,%.2f,%.2f\n", when, buckets[k].count, tsdb_agg_mean(&buckets[k]), buckets[k].min, buckets[k].max);
+		else
+			printf("%s,0,,,\n", when);
+	}
+	fprintf(stderr, "%lu blocks answered from the index, %lu decoded\n", db->blocks_summarized, db->blocks_decoded);
+
+	free(buckets);
+	tsdb_close(db);
+	return 0;
+}